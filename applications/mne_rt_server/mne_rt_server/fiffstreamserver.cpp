@@ -44,6 +44,9 @@
 
 #include "mne_rt_server.h"
 
+#include <fiff/fiff_stream.h>
+#include <fiff/fiff_constants.h>
+
 #include <stdlib.h>
 
 //=============================================================================================================
@@ -352,10 +355,19 @@ void FiffStreamServer::forwardMeasInfo(qint32 ID, const FiffInfo& p_fiffInfo)
 }
 
 //=============================================================================================================
-//ToDo increase preformance --> try inline
+
 void FiffStreamServer::forwardRawBuffer(QSharedPointer<Eigen::MatrixXf> m_pMatRawData)
 {
-    emit remitRawBuffer(m_pMatRawData);
+    if(m_qClientList.isEmpty()) {
+        return;
+    }
+
+    //Serialize the buffer only once, all clients queue the same implicitly shared frame
+    QByteArray t_blockFrame;
+    FiffStream t_FiffStreamOut(&t_blockFrame, QIODevice::WriteOnly);
+    t_FiffStreamOut.write_float(FIFF_DATA_BUFFER, m_pMatRawData->data(), m_pMatRawData->rows()*m_pMatRawData->cols());
+
+    emit remitRawBuffer(t_blockFrame);
 }
 
 //=============================================================================================================
@@ -50,6 +50,7 @@
 
 #include <QStringList>
 #include <QTcpServer>
+#include <QByteArray>
 
 //=============================================================================================================
 // DEFINE NAMESPACE RTSERVER
@@ -117,7 +118,7 @@ signals:
     void stopMeasFiffStreamClient(qint32 ID);
 
     void remitMeasInfo(qint32 ID, const FIFFLIB::FiffInfo& p_fiffInfo);
-    void remitRawBuffer(QSharedPointer<Eigen::MatrixXf>);
+    void remitRawBuffer(const QByteArray& p_blockFrame);
 
     void closeFiffStreamServer();
 
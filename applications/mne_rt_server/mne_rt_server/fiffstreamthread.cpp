@@ -58,6 +58,8 @@
 //=============================================================================================================
 
 #include <QtNetwork>
+#include <QtEndian>
+#include <QMutexLocker>
 
 //=============================================================================================================
 // USED NAMESPACES
@@ -67,6 +69,15 @@ using namespace UTILSLIB;
 using namespace RTSERVER;
 using namespace FIFFLIB;
 
+//=============================================================================================================
+// DEFINE GLOBAL VARIABLES
+//=============================================================================================================
+
+namespace {
+    const qint64 MAX_PENDING_BYTES = 4*1024*1024;  /**< Bytes the socket may hold before the queue is throttled. */
+    const qint32 TAG_HEADER_SIZE = 4*sizeof(qint32);  /**< Size of a FIFF tag header (kind, type, size, next). */
+}
+
 //=============================================================================================================
 // DEFINE MEMBER METHODS
 //=============================================================================================================
@@ -76,9 +87,20 @@ FiffStreamThread::FiffStreamThread(qint32 id, int socketDescriptor, QObject *par
 , m_iDataClientId(id)
 , m_sDataClientAlias(QString(""))
 , m_iSocketDescriptor(socketDescriptor)
+, m_iMaxQueuedFrames(64)
+, m_slowClientPolicy(Coalesce)
+, m_bDisconnectRequested(false)
 , m_bIsSendingRawBuffer(false)
 , m_bIsRunning(false)
 {
+    m_statistics.iBytesSent = 0;
+    m_statistics.iFramesSent = 0;
+    m_statistics.iFramesDropped = 0;
+    m_statistics.iQueuedFrames = 0;
+    m_statistics.iMaxLagMs = 0;
+    m_statistics.dMeanLagMs = 0.0;
+
+    m_timer.start();
 }
 
 //=============================================================================================================
@@ -91,6 +113,7 @@ FiffStreamThread::~FiffStreamThread()
         t_pFiffStreamServer->m_qClientList.remove(m_iDataClientId);
 
     m_bIsRunning = false;
+    QThread::quit();
     QThread::wait();
 }
 
@@ -102,12 +125,15 @@ void FiffStreamThread::startMeas(qint32 ID)
     {
         qDebug() << "Activate raw buffer sending.";
 
-        m_qMutex.lock();
         // ToDo send start meas
-        FiffStream t_FiffStreamOut(&m_qSendBlock, QIODevice::WriteOnly);
+        QByteArray t_blockFrame;
+        FiffStream t_FiffStreamOut(&t_blockFrame, QIODevice::WriteOnly);
         t_FiffStreamOut.start_block(FIFFB_RAW_DATA);
+        enqueueFrame(t_blockFrame, false);
+
+        //Raw buffers are queued only behind the start block
+        QMutexLocker locker(&m_qMutex);
         m_bIsSendingRawBuffer = true;
-        m_qMutex.unlock();
     }
 }
 
@@ -121,10 +147,13 @@ void FiffStreamThread::stopMeas(qint32 ID)
         qDebug() << "stop raw buffer sending.";
 
         m_qMutex.lock();
-        FiffStream t_FiffStreamOut(&m_qSendBlock, QIODevice::WriteOnly);
-        t_FiffStreamOut.end_block(FIFFB_RAW_DATA);
         m_bIsSendingRawBuffer = false;
         m_qMutex.unlock();
+
+        QByteArray t_blockFrame;
+        FiffStream t_FiffStreamOut(&t_blockFrame, QIODevice::WriteOnly);
+        t_FiffStreamOut.end_block(FIFFB_RAW_DATA);
+        enqueueFrame(t_blockFrame, false);
     }
 }
 
@@ -167,44 +196,224 @@ void FiffStreamThread::parseCommand(FiffTag::SPtr p_pTag)
 
 //=============================================================================================================
 
-void FiffStreamThread::sendRawBuffer(QSharedPointer<Eigen::MatrixXf> m_pMatRawData)
+void FiffStreamThread::setSlowClientPolicy(SlowClientPolicy p_policy)
+{
+    QMutexLocker locker(&m_qMutex);
+    m_slowClientPolicy = p_policy;
+}
+
+//=============================================================================================================
+
+void FiffStreamThread::setMaxQueuedFrames(qint32 p_iMaxQueuedFrames)
+{
+    QMutexLocker locker(&m_qMutex);
+    m_iMaxQueuedFrames = qMax(1, p_iMaxQueuedFrames);
+}
+
+//=============================================================================================================
+
+FiffStreamThread::ClientStatistics FiffStreamThread::getStatistics()
+{
+    QMutexLocker locker(&m_qMutex);
+    ClientStatistics t_statistics = m_statistics;
+    t_statistics.iQueuedFrames = m_qSendQueue.size();
+    return t_statistics;
+}
+
+//=============================================================================================================
+
+void FiffStreamThread::sendRawBuffer(const QByteArray& p_blockFrame)
 {
-    if(m_bIsSendingRawBuffer)
+    enqueueFrame(p_blockFrame, true);
+}
+
+//=============================================================================================================
+
+void FiffStreamThread::enqueueFrame(const QByteArray& p_blockFrame, bool p_bIsRawBuffer)
+{
+    QMutexLocker locker(&m_qMutex);
+
+    //
+    // The sending state is tested under the lock, so that no raw buffer is queued behind the end block
+    //
+    if(p_bIsRawBuffer && !m_bIsSendingRawBuffer)
     {
-//        qDebug() << "Send RawBuffer to client";
+        return;
+    }
 
-        m_qMutex.lock();
+    //
+    // Apply the slow client policy. Control frames (block start/end, measurement info, client id) are never dropped.
+    //
+    if(p_bIsRawBuffer && m_qSendQueue.size() >= m_iMaxQueuedFrames)
+    {
+        ++m_statistics.iFramesDropped;
 
-        FiffStream t_FiffStreamOut(&m_qSendBlock, QIODevice::WriteOnly);
-        t_FiffStreamOut.write_float(FIFF_DATA_BUFFER,m_pMatRawData->data(),m_pMatRawData->rows()*m_pMatRawData->cols());
+        switch(m_slowClientPolicy)
+        {
+            case DropNewest:
+                return;
+
+            case Coalesce:
+            {
+                int i = 0;
+                while(i < m_qSendQueue.size() && !m_qSendQueue.at(i).bIsRawBuffer)
+                {
+                    ++i;
+                }
+
+                if(i == m_qSendQueue.size())
+                {
+                    return;
+                }
+
+                m_qSendQueue.removeAt(i);
+                break;
+            }
+
+            case Disconnect:
+                if(!m_bDisconnectRequested)
+                {
+                    m_bDisconnectRequested = true;
+                    locker.unlock();
+                    emit sendQueueFilled();
+                }
+                return;
+        }
+    }
 
+    bool t_bWasEmpty = m_qSendQueue.isEmpty();
+
+    SendFrame t_frame;
+    t_frame.blockData = p_blockFrame;
+    t_frame.bIsRawBuffer = p_bIsRawBuffer;
+    t_frame.iQueuedAtMs = m_timer.elapsed();
+    m_qSendQueue.enqueue(t_frame);
+
+    locker.unlock();
+
+    //The socket's event loop keeps draining a non-empty queue on its own, it only needs to be woken up when the
+    //queue was empty
+    if(t_bWasEmpty)
+    {
+        emit sendQueueFilled();
+    }
+}
+
+//=============================================================================================================
+
+void FiffStreamThread::flushSendQueue(QTcpSocket& p_qTcpSocket)
+{
+    if(p_qTcpSocket.state() != QAbstractSocket::ConnectedState)
+    {
+        return;
+    }
+
+    qint64 t_iBudget = MAX_PENDING_BYTES - p_qTcpSocket.bytesToWrite();
+    QList<SendFrame> t_lBatch;
+    qint64 t_iBatchBytes = 0;
+
+    m_qMutex.lock();
+
+    if(m_bDisconnectRequested)
+    {
         m_qMutex.unlock();
 
+        printf("FiffStreamClient (ID %d): send queue is full, disconnecting slow client\r\n\n", m_iDataClientId);
+        p_qTcpSocket.abort();
+        QThread::quit();
+        return;
+    }
+
+    //
+    // Take as many frames as the socket's write buffer accepts. If it is full, draining continues on bytesWritten.
+    // A single frame larger than the budget is let through once the socket's write buffer is empty.
+    //
+    qint64 t_iNow = m_timer.elapsed();
+    while(!m_qSendQueue.isEmpty())
+    {
+        qint64 t_iFrameBytes = m_qSendQueue.head().blockData.size();
+        if(t_iBatchBytes + t_iFrameBytes > t_iBudget && !(t_lBatch.isEmpty() && p_qTcpSocket.bytesToWrite() == 0))
+        {
+            break;
+        }
+
+        SendFrame t_frame = m_qSendQueue.dequeue();
+        qint64 t_iLagMs = t_iNow - t_frame.iQueuedAtMs;
+
+        ++m_statistics.iFramesSent;
+        m_statistics.iBytesSent += t_iFrameBytes;
+        m_statistics.iMaxLagMs = qMax(m_statistics.iMaxLagMs, t_iLagMs);
+        m_statistics.dMeanLagMs += (t_iLagMs - m_statistics.dMeanLagMs) / m_statistics.iFramesSent;
+
+        t_iBatchBytes += t_iFrameBytes;
+        t_lBatch.append(t_frame);
+    }
+
+    m_qMutex.unlock();
+
+    if(t_lBatch.isEmpty())
+    {
+        return;
+    }
+
+    //
+    // Write the batch with a single call. QTcpSocket has no scatter/gather write, hence several frames are gathered
+    // into one contiguous block so that they leave in as few send calls as possible.
+    //
+    if(t_lBatch.size() == 1)
+    {
+        p_qTcpSocket.write(t_lBatch.first().blockData);
+    }
+    else
+    {
+        QByteArray t_blockBatch;
+        t_blockBatch.reserve(t_iBatchBytes);
+        for(const SendFrame& t_frame : t_lBatch)
+        {
+            t_blockBatch.append(t_frame.blockData);
+        }
+        p_qTcpSocket.write(t_blockBatch);
     }
-//    else
-//    {
-//        qDebug() << "Send RawBuffer is not activated";
-//    }
 }
 
 //=============================================================================================================
 
-//void FiffStreamThread::sendData(QTcpSocket& p_qTcpSocket)
-//{
-//    if(p_qTcpSocket.state() != QAbstractSocket::UnconnectedState && m_bIsRunning)
-//    {
-//        m_qMutex.lock();
-//        qint32 t_iBlockSize = m_qSendBlock.size();
-//        if(t_iBlockSize > 0)
-//        {
-////            qDebug() << "data available" << t_iBlockSize;
-//            qint32 t_iBytesWritten = p_qTcpSocket.write(m_qSendBlock);
-//            qDebug()<<"[Block to write]"<<t_iBlockSize<<"[bytes has been Written]"<<t_iBytesWritten;
-//            p_qTcpSocket.waitForBytesWritten();
-//        }
-//        m_qMutex.unlock();
-//    }
-//}
+void FiffStreamThread::readCommands(QTcpSocket& p_qTcpSocket, FiffStream& p_FiffStreamIn)
+{
+    while(p_qTcpSocket.bytesAvailable() >= TAG_HEADER_SIZE)
+    {
+        //
+        // Peek at the tag header and only read the tag once its data was received completely
+        //
+        QByteArray t_blockHeader = p_qTcpSocket.peek(TAG_HEADER_SIZE);
+        qint32 t_iTagSize = qFromBigEndian<qint32>(reinterpret_cast<const uchar*>(t_blockHeader.constData()) + 2*sizeof(qint32));
+
+        if(t_iTagSize < 0)
+        {
+            printf("FiffStreamClient (ID %d): received corrupt tag, disconnecting\r\n\n", m_iDataClientId);
+            p_qTcpSocket.abort();
+            QThread::quit();
+            return;
+        }
+
+        if(p_qTcpSocket.bytesAvailable() < TAG_HEADER_SIZE + t_iTagSize)
+        {
+            return;
+        }
+
+        FiffTag::SPtr t_pTag;
+        p_FiffStreamIn.read_tag_info(t_pTag, false);
+        p_FiffStreamIn.read_tag_data(t_pTag);
+
+        //
+        // Parse the tag
+        //
+        if(t_pTag->kind == FIFF_MNE_RT_COMMAND)
+        {
+            parseCommand(t_pTag);
+        }
+    }
+}
 
 //=============================================================================================================
 
@@ -212,9 +421,8 @@ void FiffStreamThread::sendMeasurementInfo(qint32 ID, const FiffInfo& p_fiffInfo
 {
     if(ID == m_iDataClientId)
     {
-        m_qMutex.lock();
-
-        FiffStream t_FiffStreamOut(&m_qSendBlock, QIODevice::WriteOnly);
+        QByteArray t_blockFrame;
+        FiffStream t_FiffStreamOut(&t_blockFrame, QIODevice::WriteOnly);
 
 //        qint32 init_info[2];
 //        init_info[0] = FIFF_MNE_RT_CLIENT_ID;
@@ -225,9 +433,9 @@ void FiffStreamThread::sendMeasurementInfo(qint32 ID, const FiffInfo& p_fiffInfo
 //FiffStream::start_writing_raw
 
         p_fiffInfo.writeToStream(&t_FiffStreamOut);
-        m_qMutex.unlock();
+        enqueueFrame(t_blockFrame, false);
 
-//        qDebug() << "MeasInfo Blocksize: " << m_qSendBlock.size();
+//        qDebug() << "MeasInfo Blocksize: " << t_blockFrame.size();
     }
 }
 
@@ -235,49 +443,15 @@ void FiffStreamThread::sendMeasurementInfo(qint32 ID, const FiffInfo& p_fiffInfo
 
 void FiffStreamThread::writeClientId()
 {
-    FiffStream t_FiffStreamOut(&m_qSendBlock, QIODevice::WriteOnly);
+    QByteArray t_blockFrame;
+    FiffStream t_FiffStreamOut(&t_blockFrame, QIODevice::WriteOnly);
 
     t_FiffStreamOut.write_int(FIFF_MNE_RT_CLIENT_ID, &m_iDataClientId);
+    enqueueFrame(t_blockFrame, false);
 }
 
 //=============================================================================================================
 
-//void FiffStreamThread::readProc(QTcpSocket& p_qTcpSocket)
-//{
-//    FiffStream t_FiffStreamIn(&p_qTcpSocket);
-
-//    //
-//    // Read: Wait 10ms for incomming tag header, read and continue
-//    //
-//    p_qTcpSocket.waitForReadyRead(10);
-
-//    if (p_qTcpSocket.bytesAvailable() >= (int)sizeof(qint32)*4)
-//    {
-//        qDebug() << "goes to read bytes " ;
-//        FiffTag::SPtr t_pTag;
-//        FiffTag::read_tag_info(&t_FiffStreamIn, t_pTag, false);
-
-//        //
-//        // wait until tag size data are available and read the data
-//        //
-//        while (p_qTcpSocket.bytesAvailable() < t_pTag->size())
-//        {
-//            p_qTcpSocket.waitForReadyRead(10);
-//        }
-//        FiffTag::read_tag_data(&t_FiffStreamIn, t_pTag);
-
-//        //
-//        // Parse the tag
-//        //
-//        if(t_pTag->kind == FIFF_MNE_RT_COMMAND)
-//        {
-//            parseCommand(t_pTag);
-//        }
-//    }
-//}
-
-//=============================================================================================================
-
 void FiffStreamThread::run()
 {
     m_bIsRunning = true;
@@ -286,8 +460,10 @@ void FiffStreamThread::run()
 
     connect(t_pParentServer, &FiffStreamServer::remitMeasInfo,
             this, &FiffStreamThread::sendMeasurementInfo);
+    //The raw buffer frames are serialized once by the server and queued directly, without a detour through the
+    //event loop of the thread owning this object
     connect(t_pParentServer, &FiffStreamServer::remitRawBuffer,
-            this, &FiffStreamThread::sendRawBuffer);
+            this, &FiffStreamThread::sendRawBuffer, Qt::DirectConnection);
     connect(t_pParentServer, &FiffStreamServer::startMeasFiffStreamClient,
             this, &FiffStreamThread::startMeas);
     connect(t_pParentServer, &FiffStreamServer::stopMeasFiffStreamClient,
@@ -308,63 +484,44 @@ void FiffStreamThread::run()
 
     FiffStream t_FiffStreamIn(&t_qTcpSocket);
 
-//    int i = 0;
-    while(t_qTcpSocket.state() != QAbstractSocket::UnconnectedState && m_bIsRunning)
+    //
+    // Event driven I/O: the socket lives in this thread, the handlers below run in its event loop
+    //
+    connect(this, &FiffStreamThread::sendQueueFilled,
+            &t_qTcpSocket, [this, &t_qTcpSocket]() {
+                flushSendQueue(t_qTcpSocket);
+            }, Qt::QueuedConnection);
+    connect(&t_qTcpSocket, &QTcpSocket::bytesWritten,
+            &t_qTcpSocket, [this, &t_qTcpSocket]() {
+                flushSendQueue(t_qTcpSocket);
+            });
+    connect(&t_qTcpSocket, &QTcpSocket::readyRead,
+            &t_qTcpSocket, [this, &t_qTcpSocket, &t_FiffStreamIn]() {
+                readCommands(t_qTcpSocket, t_FiffStreamIn);
+            });
+    connect(&t_qTcpSocket, &QTcpSocket::disconnected,
+            &t_qTcpSocket, [this]() {
+                QThread::quit();
+            });
+
+    //Frames and commands might have arrived before the handlers were connected
+    flushSendQueue(t_qTcpSocket);
+    readCommands(t_qTcpSocket, t_FiffStreamIn);
+
+    if(m_bIsRunning && t_qTcpSocket.state() != QAbstractSocket::UnconnectedState)
     {
-        //
-        // Write available data
-        //
-        m_qMutex.lock();
-        qint32 t_iBlockSize = m_qSendBlock.size();
-//        qDebug() << "data available" << t_iBlockSize;
-        if(t_iBlockSize > 0)
-        {
-            qint32 t_iBytesWritten = t_qTcpSocket.write(m_qSendBlock);
-//            qDebug() << ++i<< "[wrote bytes] " << t_iBytesWritten;
-            t_qTcpSocket.waitForBytesWritten();
-            if(t_iBytesWritten == t_iBlockSize)
-            {
-                m_qSendBlock.clear();
-            }
-            else
-            {
-                //we have to store bytes which were not written to the socket, due to writing limit
-                //m_qSendBlock = m_qSendBlock.mid(t_iBytesWritten, t_iBlockSize-t_iBytesWritten);
-                m_qSendBlock.remove(0,t_iBytesWritten); //higher performance then mid
-            }
-        }
-        m_qMutex.unlock();
-
-        //
-        // Read: Wait 10ms for incomming tag header, read and continue
-        //
-        t_qTcpSocket.waitForReadyRead(10);
-
-        if (t_qTcpSocket.bytesAvailable() >= (int)sizeof(qint32)*4)
-        {
-//            qDebug() << "goes to read bytes " ;
-            FiffTag::SPtr t_pTag;
-            t_FiffStreamIn.read_tag_info(t_pTag, false);
-
-            //
-            // wait until tag size data are available and read the data
-            //
-            while (t_qTcpSocket.bytesAvailable() < t_pTag->size())
-            {
-                t_qTcpSocket.waitForReadyRead(10);
-            }
-            t_FiffStreamIn.read_tag_data(t_pTag);
-
-            //
-            // Parse the tag
-            //
-            if(t_pTag->kind == FIFF_MNE_RT_COMMAND)
-            {
-                parseCommand(t_pTag);
-            }
-        }
+        exec();
     }
 
+    ClientStatistics t_statistics = getStatistics();
+    printf("FiffStreamClient (ID %d): sent %lld frames (%lld bytes), dropped %lld raw buffers, lag mean %.2f ms max %lld ms\r\n\n",
+           m_iDataClientId,
+           t_statistics.iFramesSent,
+           t_statistics.iBytesSent,
+           t_statistics.iFramesDropped,
+           t_statistics.dMeanLagMs,
+           t_statistics.iMaxLagMs);
+
     t_qTcpSocket.disconnectFromHost();
     if(t_qTcpSocket.state() != QAbstractSocket::UnconnectedState)
         t_qTcpSocket.waitForDisconnected();
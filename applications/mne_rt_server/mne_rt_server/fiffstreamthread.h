@@ -53,6 +53,9 @@
 #include <QTcpSocket>
 #include <QMutex>
 #include <QSharedPointer>
+#include <QQueue>
+#include <QByteArray>
+#include <QElapsedTimer>
 
 //=============================================================================================================
 // DEFINE NAMESPACE RTSERVER
@@ -65,11 +68,41 @@ namespace RTSERVER
 // FORWARD DECLARATIONS
 //=============================================================================================================
 
+//=============================================================================================================
+/**
+ * DECLARE CLASS FiffStreamThread
+ *
+ * @brief The FiffStreamThread class serves one FIFF stream client. Outgoing FIFF tags are pre-serialized into
+ *        frames and put into a bounded per-client send queue, which is drained by the socket's event loop.
+ */
 class FiffStreamThread : public QThread
 {
     Q_OBJECT
 
 public:
+    //=========================================================================================================
+    /**
+     * What to do with new raw buffers when the send queue of a slow client is full.
+     */
+    enum SlowClientPolicy {
+        DropNewest,     /**< Discard the new raw buffer. */
+        Coalesce,       /**< Discard the oldest queued raw buffer, so the client keeps up with the newest data. */
+        Disconnect      /**< Disconnect the client. */
+    };
+
+    //=========================================================================================================
+    /**
+     * Throughput and lag counters of one client.
+     */
+    struct ClientStatistics {
+        qint64  iBytesSent;         /**< Number of bytes handed to the socket. */
+        qint64  iFramesSent;        /**< Number of frames handed to the socket. */
+        qint64  iFramesDropped;     /**< Number of raw buffers dropped due to a full send queue. */
+        qint32  iQueuedFrames;      /**< Number of frames currently waiting in the send queue. */
+        qint64  iMaxLagMs;          /**< Maximum time a frame waited in the send queue in ms. */
+        double  dMeanLagMs;         /**< Mean time a frame waited in the send queue in ms. */
+    };
+
     FiffStreamThread(qint32 id, int socketDescriptor, QObject *parent);
 
     ~FiffStreamThread();
@@ -86,11 +119,94 @@ public:
 
     void writeClientId();
 
+    //=========================================================================================================
+    /**
+     * Sets the policy which is applied when the send queue is full.
+     *
+     * @param [in] p_policy      The slow client policy.
+     */
+    void setSlowClientPolicy(SlowClientPolicy p_policy);
+
+    //=========================================================================================================
+    /**
+     * Sets the maximal number of frames in the send queue.
+     *
+     * @param [in] p_iMaxQueuedFrames    The maximal number of queued frames.
+     */
+    void setMaxQueuedFrames(qint32 p_iMaxQueuedFrames);
+
+    //=========================================================================================================
+    /**
+     * Returns the throughput and lag counters of this client.
+     *
+     * @return The client statistics.
+     */
+    ClientStatistics getStatistics();
+
+    //=========================================================================================================
+    /**
+     * Queues a pre-serialized raw buffer tag for sending. Thread safe, the frame data is implicitly shared.
+     *
+     * @param [in] p_blockFrame  The serialized FIFF_DATA_BUFFER tag.
+     */
+    void sendRawBuffer(const QByteArray& p_blockFrame);
+
 //    void sendData(QTcpSocket& p_qTcpSocket);
 
 signals:
     void error(QTcpSocket::SocketError socketError);
 
+    //=========================================================================================================
+    /**
+     * Emitted when frames were added to an empty send queue.
+     */
+    void sendQueueFilled();
+
+protected:
+    //=========================================================================================================
+    /**
+     * A serialized FIFF tag frame waiting in the send queue.
+     */
+    struct SendFrame {
+        QByteArray  blockData;      /**< The serialized tag(s). */
+        bool        bIsRawBuffer;   /**< Whether the frame holds a raw buffer, i.e., whether it may be dropped. */
+        qint64      iQueuedAtMs;    /**< Time at which the frame was queued. */
+    };
+
+    //=========================================================================================================
+    /**
+     * Adds a frame to the send queue and applies the slow client policy. Raw buffers are only queued while the
+     * measurement is started. Thread safe.
+     *
+     * @param [in] p_blockFrame      The serialized frame.
+     * @param [in] p_bIsRawBuffer    Whether the frame holds a raw buffer.
+     */
+    void enqueueFrame(const QByteArray& p_blockFrame, bool p_bIsRawBuffer);
+
+    //=========================================================================================================
+    /**
+     * Hands queued frames to the socket until the queue is empty or the socket's write buffer is full. Must be
+     * called from within run().
+     *
+     * @param [in] p_qTcpSocket  The client socket.
+     */
+    void flushSendQueue(QTcpSocket& p_qTcpSocket);
+
+    //=========================================================================================================
+    /**
+     * Reads and parses all completely received tags. Must be called from within run().
+     *
+     * @param [in] p_qTcpSocket      The client socket.
+     * @param [in] p_FiffStreamIn    The FIFF stream reading from the socket.
+     */
+    void readCommands(QTcpSocket& p_qTcpSocket, FIFFLIB::FiffStream& p_FiffStreamIn);
+
+    void startMeas(qint32 ID);
+
+    void stopMeas(qint32 ID);
+
+    QQueue<SendFrame> m_qSendQueue;             /**< Bounded queue of frames waiting to be sent. Guarded by m_qMutex. */
+
 private:
     qint32 m_iDataClientId;
     QString m_sDataClientAlias;
@@ -98,28 +214,34 @@ private:
     int m_iSocketDescriptor;
 
     QMutex m_qMutex;
-    QByteArray m_qSendBlock;
-
-    bool m_bIsSendingRawBuffer;
+    qint32 m_iMaxQueuedFrames;                  /**< Maximal number of frames in the send queue. */
+    SlowClientPolicy m_slowClientPolicy;        /**< Policy applied when the send queue is full. */
+    bool m_bDisconnectRequested;                /**< Whether the client is to be disconnected. */
 
-    bool m_bIsRunning;
+    QElapsedTimer m_timer;                      /**< Clock for the lag counters. */
+    ClientStatistics m_statistics;              /**< Throughput and lag counters. */
 
-    void startMeas(qint32 ID);
+    bool m_bIsSendingRawBuffer;                 /**< Whether raw buffers are queued. Guarded by m_qMutex. */
 
-    void stopMeas(qint32 ID);
+    bool m_bIsRunning;
 
     void sendMeasurementInfo(qint32 ID, const FIFFLIB::FiffInfo& p_fiffInfo);
 
-    void sendRawBuffer(QSharedPointer<Eigen::MatrixXf> m_pMatRawData);
     //void readToBuffer1();
 //    void readProc(QTcpSocket& p_qTcpSocket);
 };
 
+//=============================================================================================================
+// INLINE DEFINITIONS
+//=============================================================================================================
+
 inline qint32 FiffStreamThread::getID()
 {
     return m_iDataClientId;
 }
 
+//=============================================================================================================
+
 inline QString FiffStreamThread::getAlias()
 {
     return m_sDataClientAlias;
@@ -119,7 +119,7 @@ void RealTimeMultiSampleArrayWidget::update(SCMEASLIB::Measurement::SPtr pMeasur
                 initDisplayControllWidgets();
             }
         } else if (!m_pRTMSA->getMultiSampleArray().isEmpty()) {
-            //Add data to table view
+            //Add data to table view. The blocks are shared, no samples are copied.
             m_pChannelDataView->addData(m_pRTMSA->getMultiSampleArray());
         }
     }
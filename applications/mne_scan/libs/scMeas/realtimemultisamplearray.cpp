@@ -40,6 +40,7 @@
 #include "realtimemultisamplearray.h"
 
 #include <iostream>
+#include <utility>
 
 //=============================================================================================================
 // QT INCLUDES
@@ -53,6 +54,7 @@
 
 using namespace SCMEASLIB;
 using namespace FIFFLIB;
+using namespace UTILSLIB;
 using namespace Eigen;
 
 //=============================================================================================================
@@ -228,25 +230,38 @@ void RealTimeMultiSampleArray::initFromFiffInfo(FiffInfo::SPtr &p_pFiffInfo)
 //=============================================================================================================
 
 void RealTimeMultiSampleArray::setValue(const MatrixXd& mat)
+{
+    appendBlock(SampleBlock(mat));
+}
+
+//=============================================================================================================
+
+void RealTimeMultiSampleArray::setValue(MatrixXd&& mat)
+{
+    appendBlock(SampleBlock(std::move(mat)));
+}
+
+//=============================================================================================================
+
+void RealTimeMultiSampleArray::setValue(const SampleBlock& block)
+{
+    appendBlock(block);
+}
+
+//=============================================================================================================
+
+void RealTimeMultiSampleArray::appendBlock(const SampleBlock& block)
 {
     if(!m_bChInfoIsInit)
         return;
 
     m_qMutex.lock();
     //check vector size
-    if(mat.rows() != m_qListChInfo.size())
+    if(block.rows() != m_qListChInfo.size())
         qCritical() << "Error Occured in RealTimeMultiSampleArrayNew::setVector: Vector size does not match the number of channels! ";
 
-    //ToDo
-//    //Check if maximum exceeded //ToDo speed this up
-//    for(qint32 i = 0; i < v.size(); ++i)
-//    {
-//        if(v[i] < m_qListChInfo[i].getMinValue()) v[i] = m_qListChInfo[i].getMinValue();
-//        else if(v[i] > m_qListChInfo[i].getMaxValue()) v[i] = m_qListChInfo[i].getMaxValue();
-//    }
-
-    //Store
-    m_matSamples.push_back(mat);
+    //Store. The samples are shared with every consumer, no copy is made here.
+    m_matSamples.push_back(block);
 
     m_qMutex.unlock();
     if(m_matSamples.size() >= m_iMultiArraySize)
@@ -257,4 +272,3 @@ void RealTimeMultiSampleArray::setValue(const MatrixXd& mat)
         m_qMutex.unlock();
     }
 }
-
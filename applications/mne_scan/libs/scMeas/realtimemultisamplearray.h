@@ -45,6 +45,7 @@
 #include "realtimesamplearraychinfo.h"
 
 #include <fiff/fiff_info.h>
+#include <utils/generics/sampleblock.h>
 
 //=============================================================================================================
 // QT INCLUDES
@@ -193,20 +194,46 @@ public:
 
     //=========================================================================================================
     /**
-     * Returns the gathered multi sample array.
+     * Returns the gathered multi sample array. The blocks are shared with all consumers, i.e., keeping a copy of
+     * a block does not copy the samples. Use SampleBlock::detach to modify a block.
      *
      * @return the current multi sample array.
      */
-    inline const QList<Eigen::MatrixXd>& getMultiSampleArray();
+    inline const QList<UTILSLIB::SampleBlock>& getMultiSampleArray();
 
     //=========================================================================================================
     /**
-     * Attaches a value to the sample array list.
+     * Attaches a value to the sample array list. The samples are copied once.
      *
      * @param [in] mat   the value which is attached to the sample array list.
      */
     virtual void setValue(const Eigen::MatrixXd& mat);
 
+    //=========================================================================================================
+    /**
+     * Attaches a value to the sample array list without copying the samples.
+     *
+     * @param [in] mat   the value which is moved into the sample array list.
+     */
+    void setValue(Eigen::MatrixXd&& mat);
+
+    //=========================================================================================================
+    /**
+     * Attaches a shared block to the sample array list without copying the samples.
+     *
+     * @param [in] block   the block which is attached to the sample array list.
+     */
+    void setValue(const UTILSLIB::SampleBlock& block);
+
+private:
+    //=========================================================================================================
+    /**
+     * Appends a block and notifies the observers once the multi array size is reached.
+     *
+     * @param [in] block   the block which is attached to the sample array list.
+     */
+    void appendBlock(const UTILSLIB::SampleBlock& block);
+
 private:
     mutable QMutex              m_qMutex;           /**< Mutex to ensure thread safety */
 
@@ -215,7 +242,7 @@ private:
     QString                     m_sXMLLayoutFile;   /**< Layout file name. */
     double                      m_dSamplingRate;    /**< Sampling rate of the RealTimeSampleArray.*/
     qint32                      m_iMultiArraySize;  /**< Sample size of the multi sample array.*/
-    QList<Eigen::MatrixXd>      m_matSamples;       /**< The multi sample array.*/
+    QList<UTILSLIB::SampleBlock> m_matSamples;      /**< The multi sample array.*/
     bool                        m_bChInfoIsInit;    /**< If channel info is initialized.*/
 
     QList<RealTimeSampleArrayChInfo> m_qListChInfo; /**< Channel info list.*/
@@ -317,7 +344,7 @@ qint32 RealTimeMultiSampleArray::getMultiArraySize() const
 
 //=============================================================================================================
 
-inline const QList<Eigen::MatrixXd>& RealTimeMultiSampleArray::getMultiSampleArray()
+inline const QList<UTILSLIB::SampleBlock>& RealTimeMultiSampleArray::getMultiSampleArray()
 {
     return m_matSamples;
 }
@@ -214,6 +214,8 @@ void Averaging::initPluginControlWidgets()
 
         connect(pAveragingSettingsView, &AveragingSettingsView::changeNumAverages,
                 this, &Averaging::onChangeNumAverages);
+        connect(pAveragingSettingsView, &AveragingSettingsView::changeCumulativeAverage,
+                this, &Averaging::onChangeCumulativeAverage);
         connect(pAveragingSettingsView, &AveragingSettingsView::changeBaselineFrom,
                 this, &Averaging::onChangeBaselineFrom);
         connect(pAveragingSettingsView, &AveragingSettingsView::changeBaselineTo,
@@ -281,6 +283,7 @@ void Averaging::initPluginControlWidgets()
         m_pRtAve->setBaselineFrom(iBaselineFromSamples, pAveragingSettingsView->getBaselineFromSeconds());
         m_pRtAve->setBaselineTo(iBaselineToSamples, pAveragingSettingsView->getBaselineToSeconds());
         m_pRtAve->setBaselineActive(pAveragingSettingsView->getDoBaselineCorrection());
+        m_pRtAve->setCumulativeAverage(pAveragingSettingsView->getCumulativeAverage());
         m_pRtAve->setArtifactReduction(pArtifactSettingsView->getThresholdMap());
 
         m_bPluginControlWidgetsInit = true;
@@ -299,6 +302,16 @@ void Averaging::onChangeNumAverages(qint32 numAve)
 
 //=============================================================================================================
 
+void Averaging::onChangeCumulativeAverage(bool bCumulative)
+{
+    QMutexLocker locker(&m_qMutex);
+    if(m_pRtAve) {
+        m_pRtAve->setCumulativeAverage(bCumulative);
+    }
+}
+
+//=============================================================================================================
+
 void Averaging::onChangeStimChannel(const QString& sStimCh)
 {
     QMutexLocker locker(&m_qMutex);
@@ -136,6 +136,14 @@ public:
      */
     void onChangeNumAverages(qint32 numAve);
 
+    //=========================================================================================================
+    /**
+     * Switch between the moving and the cumulative average
+     *
+     * @param[in] bCumulative     whether to average all trials since the last reset
+     */
+    void onChangeCumulativeAverage(bool bCumulative);
+
     //=========================================================================================================
     /**
      * Change the stim channel
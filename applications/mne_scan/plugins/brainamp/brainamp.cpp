@@ -377,7 +377,7 @@ void BrainAMP::run()
             //pop matrix
             if(m_pCircularBuffer->pop(matData)) {
                 //emit values to real time multi sample array
-                m_pRMTSA_BrainAMP->data()->setValue(matData);
+                m_pRMTSA_BrainAMP->data()->setValue(std::move(matData));
             }       
         }
     }
@@ -389,7 +389,7 @@ void BrainFlowBoard::run()
     int iSampleIterator, iReceivedSamples, i, j;
     iSampleIterator = 0;
     Eigen::VectorXd vec(m_iNumberChannels);
-    Eigen::MatrixXd matrix (m_iNumberChannels, m_uiSamplesPerBlock);
+    Eigen::MatrixXd matrix;
     double **data = NULL;
     QList<Eigen::VectorXd> lSampleBlockBuffer;
 
@@ -397,6 +397,9 @@ void BrainFlowBoard::run()
         usleep(lSamplingPeriod);
         iSampleIterator = 0;
 
+        //The previous block was moved to the output, start a new one
+        matrix.resize(m_iNumberChannels, m_uiSamplesPerBlock);
+
         //get samples from device until the complete matrix is filled, i.e. the samples per block size is met
         while(iSampleIterator < m_uiSamplesPerBlock && !isInterruptionRequested()) {
             //Get sample block from device
@@ -433,7 +436,7 @@ void BrainFlowBoard::run()
             delete[] data;
         }
 
-        m_pOutput->data()->setValue(matrix);
+        m_pOutput->data()->setValue(std::move(matrix));
     }
 }
 
@@ -225,7 +225,7 @@ void DummyToolbox::run()
             //Send the data to the connected plugins and the online display
             //Unocmment this if you also uncommented the m_pOutput in the constructor above
             if(!isInterruptionRequested()) {
-                m_pOutput->data()->setValue(matData);
+                m_pOutput->data()->setValue(std::move(matData));
             }
         }
     }
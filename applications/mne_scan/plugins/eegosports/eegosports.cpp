@@ -712,7 +712,7 @@ void EEGoSports::run()
                 if(m_pCircularBuffer->pop(matData)) {
                     //emit values to real time multi sample array
                     //qDebug()<<"EEGoSports::run - mat size"<<matValue.rows()<<"x"<<matValue.cols();
-                    m_pRMTSA_EEGoSports->data()->setValue(matData);
+                    m_pRMTSA_EEGoSports->data()->setValue(std::move(matData));
                 }
             }      
         }
@@ -198,7 +198,7 @@ void FtBuffer::run()
         if(m_pCircularBuffer->pop(matData)) {
             //emit values
             if(!isInterruptionRequested()) {
-                m_pRTMSA_BufferOutput->data()->setValue(matData);
+                m_pRTMSA_BufferOutput->data()->setValue(std::move(matData));
             }
         }
     }
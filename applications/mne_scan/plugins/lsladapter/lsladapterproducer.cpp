@@ -131,7 +131,7 @@ void LSLAdapterProducer::readStream()
                 }
 
                 // publish new block
-                m_pRTMSA->data()->setValue(matOutput);
+                m_pRTMSA->data()->setValue(std::move(matOutput));
             }
         }
         catch (std::exception& e) {
@@ -303,7 +303,7 @@ void Natus::run()
         if(m_pCircularBuffer->pop(matData)) {
             //emit values
             if(!isInterruptionRequested()) {
-                m_pRMTSA_Natus->data()->setValue(matData);
+                m_pRMTSA_Natus->data()->setValue(std::move(matData));
             }
         }
     }
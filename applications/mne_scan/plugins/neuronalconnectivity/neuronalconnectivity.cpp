@@ -96,13 +96,15 @@ NeuronalConnectivity::NeuronalConnectivity()
 , m_pRtConnectivity(RtConnectivity::SPtr::create())
 , m_pActionShowYourWidget(Q_NULLPTR)
 {
-    AbstractMetric::m_bStorageModeIsActive = true;
-    AbstractMetric::m_iNumberBinStart = 0;
-    AbstractMetric::m_iNumberBinAmount = 100;
+    // The settings only hold the parameters. The trials are kept in the sliding window of the rt connectivity worker.
+    m_connectivitySettings.setFrequencyBins(0, 100);
 
     //Init rt connectivity worker
-    connect(m_pRtConnectivity.data(), &RtConnectivity::newConnectivityResultAvailable,
+    connect(m_pRtConnectivity.data(), &RtConnectivity::newSlidingWindowResultAvailable,
             this, &NeuronalConnectivity::onNewConnectivityResultAvailable);
+
+    m_pRtConnectivity->setSlidingWindowSize(m_iNumberAverages);
+    m_pRtConnectivity->setSlidingWindowSettings(m_connectivitySettings);
 }
 
 //=============================================================================================================
@@ -205,6 +207,8 @@ bool NeuronalConnectivity::start()
 bool NeuronalConnectivity::stop()
 {
     m_pRtConnectivity->restart();
+    m_pRtConnectivity->setSlidingWindowSize(m_iNumberAverages);
+    m_pRtConnectivity->setSlidingWindowSettings(m_connectivitySettings);
 
     requestInterruption();
     wait(500);
@@ -255,6 +259,7 @@ void NeuronalConnectivity::updateSource(SCMEASLIB::Measurement::SPtr pMeasuremen
 
             // Generate network nodes
             m_connectivitySettings.setNodePositions(*pRTSE->getFwdSolution(), *pRTSE->getSurfSet());
+            m_pRtConnectivity->setSlidingWindowSettings(m_connectivitySettings);
         }
 
         if(!m_bPluginControlWidgetsInit) {
@@ -274,30 +279,14 @@ void NeuronalConnectivity::updateSource(SCMEASLIB::Measurement::SPtr pMeasuremen
 
             m_iBlockSize = pRTSE->getValue().first()->data.cols() - iZeroIdx;
 
-            // Check row and colum integrity and restart if necessary
-            if(m_connectivitySettings.size() != 0) {
-                if(m_iBlockSize != m_connectivitySettings.at(0).matData.cols()) {
-                    m_connectivitySettings.clearAllData();
-                    m_pRtConnectivity->restart();
-                }
-            }
-
-            // No copy necessary since we do a deep copy in connectivity settings before the measurement
-            // overwrites the matrix
-            m_connectivitySettings.append(pRTSE->getValue()[i]->data.block(0,
-                                                                           iZeroIdx,
-                                                                           pRTSE->getValue()[i]->data.rows(),
-                                                                           pRTSE->getValue()[i]->data.cols() - iZeroIdx));
-        }
-
-        //Pop data from buffer
-        if(m_connectivitySettings.size() >= m_iNumberAverages) {
-            m_pRtConnectivity->restart();
-            m_connectivitySettings.removeFirst(m_connectivitySettings.size()-m_iNumberAverages);
+            // Only the new trial is sent to the worker. The worker restarts its window if the block size changed
+            // and evicts the oldest trial.
+            m_timer.restart();
+            m_pRtConnectivity->appendTrial(pRTSE->getValue()[i]->data.block(0,
+                                                                            iZeroIdx,
+                                                                            pRTSE->getValue()[i]->data.rows(),
+                                                                            pRTSE->getValue()[i]->data.cols() - iZeroIdx));
         }
-
-        m_timer.restart();
-        m_pRtConnectivity->append(m_connectivitySettings);
     }
 }
 
@@ -333,7 +322,6 @@ void NeuronalConnectivity::updateRTMSA(SCMEASLIB::Measurement::SPtr pMeasurement
                 m_pFiffInfo = pRTMSA->info();
                 generateNodeVertices();
                 m_iNumberBadChannels = m_pFiffInfo->bads.size();
-                m_pRtConnectivity->restart();
             }
 
             MatrixXd data;
@@ -342,31 +330,15 @@ void NeuronalConnectivity::updateRTMSA(SCMEASLIB::Measurement::SPtr pMeasurement
                 const MatrixXd& t_mat = pRTMSA->getMultiSampleArray()[i];
                 m_iBlockSize = pRTMSA->getMultiSampleArray()[i].cols();
 
-                // Check row and colum integrity and restart if necessary
-                if(m_connectivitySettings.size() != 0) {
-                    if(m_iBlockSize != m_connectivitySettings.at(0).matData.cols()) {
-                        m_connectivitySettings.clearAllData();
-                        m_pRtConnectivity->restart();
-                    }
-                }
-
                 data.resize(m_vecPicks.cols(), t_mat.cols());
 
                 for(qint32 j = 0; j < m_vecPicks.cols(); ++j) {
                     data.row(j) = t_mat.row(m_vecPicks[j]);
                 }
 
-                m_connectivitySettings.append(data);
+                m_timer.restart();
+                m_pRtConnectivity->appendTrial(data);
             }
-
-            //Pop data from buffer
-            if(m_connectivitySettings.size() > m_iNumberAverages) {
-                m_pRtConnectivity->restart();
-                m_connectivitySettings.removeFirst(m_connectivitySettings.size()-m_iNumberAverages);
-            }
-
-            m_timer.restart();
-            m_pRtConnectivity->append(m_connectivitySettings);
         }
     }
 }
@@ -425,14 +397,6 @@ void NeuronalConnectivity::updateRTEV(SCMEASLIB::Measurement::SPtr pMeasurement)
 
                     m_iBlockSize = t_mat.cols();
 
-                    // Check row and colum integrity and restart if necessary
-                    if(m_connectivitySettings.size() != 0) {
-                        if(m_iBlockSize != m_connectivitySettings.at(0).matData.cols()) {
-                            m_connectivitySettings.clearAllData();
-                            m_pRtConnectivity->restart();
-                        }
-                    }
-
                     MatrixXd data;
                     data.resize(m_vecPicks.cols(), t_mat.cols());
 
@@ -440,16 +404,8 @@ void NeuronalConnectivity::updateRTEV(SCMEASLIB::Measurement::SPtr pMeasurement)
                         data.row(j) = t_mat.row(m_vecPicks[j]);
                     }
 
-                    m_connectivitySettings.append(data);
-
-                    //Pop data from buffer
-                    if(m_connectivitySettings.size() > m_iNumberAverages) {
-                        m_pRtConnectivity->restart();
-                        m_connectivitySettings.removeFirst(m_connectivitySettings.size()-m_iNumberAverages);
-                    }
-
                     m_timer.restart();
-                    m_pRtConnectivity->append(m_connectivitySettings);
+                    m_pRtConnectivity->appendTrial(data);
 
                     break;
                 }
@@ -495,7 +451,10 @@ void NeuronalConnectivity::generateNodeVertices()
 
     //Set node 3D positions to connectivity settings
     m_connectivitySettings.setNodePositions(*m_pFiffInfo, m_vecPicks);
-    m_connectivitySettings.clearAllData();
+
+    // The node positions and the number of channels changed, start a new sliding window
+    m_pRtConnectivity->clearSlidingWindow();
+    m_pRtConnectivity->setSlidingWindowSettings(m_connectivitySettings);
 }
 
 //=============================================================================================================
@@ -541,12 +500,8 @@ void NeuronalConnectivity::run()
 
 //=============================================================================================================
 
-void NeuronalConnectivity::onNewConnectivityResultAvailable(const QList<Network>& connectivityResults,
-                                                            const ConnectivitySettings& connectivitySettings)
+void NeuronalConnectivity::onNewConnectivityResultAvailable(const QList<Network>& connectivityResults)
 {
-    m_connectivitySettings = connectivitySettings;
-    m_connectivitySettings.setConnectivityMethods(m_sConnectivityMethods);
-
     for(int i = 0; i < connectivityResults.size(); ++i) {
         m_pCircularBuffer->push(connectivityResults.at(i));
     }
@@ -562,9 +517,8 @@ void NeuronalConnectivity::onMetricChanged(const QString& sMetric)
 
     m_sConnectivityMethods = QStringList() << sMetric;
     m_connectivitySettings.setConnectivityMethods(m_sConnectivityMethods);
-    if(m_pRtConnectivity && this->isRunning()) {
-        m_pRtConnectivity->restart();
-        m_pRtConnectivity->append(m_connectivitySettings);
+    if(m_pRtConnectivity) {
+        m_pRtConnectivity->setSlidingWindowSettings(m_connectivitySettings);
     }
 }
 
@@ -573,6 +527,10 @@ void NeuronalConnectivity::onMetricChanged(const QString& sMetric)
 void NeuronalConnectivity::onNumberTrialsChanged(int iNumberTrials)
 {
     m_iNumberAverages = iNumberTrials;
+
+    if(m_pRtConnectivity) {
+        m_pRtConnectivity->setSlidingWindowSize(m_iNumberAverages);
+    }
 }
 
 //=============================================================================================================
@@ -580,8 +538,11 @@ void NeuronalConnectivity::onNumberTrialsChanged(int iNumberTrials)
 void NeuronalConnectivity::onWindowTypeChanged(const QString& windowType)
 {
     if(m_connectivitySettings.getWindowType() != windowType) {
-        m_connectivitySettings.clearIntermediateData();
         m_connectivitySettings.setWindowType(windowType);
+
+        if(m_pRtConnectivity) {
+            m_pRtConnectivity->setSlidingWindowSettings(m_connectivitySettings);
+        }
     }
 }
 
@@ -590,7 +551,7 @@ void NeuronalConnectivity::onWindowTypeChanged(const QString& windowType)
 void NeuronalConnectivity::onTriggerTypeChanged(const QString& triggerType)
 {
     if(triggerType != m_sAvrType) {
-        m_connectivitySettings.clearAllData();
+        m_pRtConnectivity->clearSlidingWindow();
         m_sAvrType = triggerType;
     }
 }
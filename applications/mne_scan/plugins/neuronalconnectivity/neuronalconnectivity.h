@@ -189,10 +189,9 @@ protected:
     /**
      * Slot called when a new real-time connectivity estimate is available.
      *
-     * @param [in] connectivityResult        The new connectivity estimate
+     * @param [in] connectivityResults       The new connectivity estimates
      */
-    void onNewConnectivityResultAvailable(const QList<CONNECTIVITYLIB::Network>& connectivityResults,
-                                          const CONNECTIVITYLIB::ConnectivitySettings& connectivitySettings);
+    void onNewConnectivityResultAvailable(const QList<CONNECTIVITYLIB::Network>& connectivityResults);
 
     //=========================================================================================================
     /**
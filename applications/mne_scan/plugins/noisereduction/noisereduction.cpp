@@ -410,7 +410,7 @@ void NoiseReduction::run()
 
             //Send the data to the connected plugins and the display
             if(!isInterruptionRequested()) {
-                m_pNoiseReductionOutput->data()->setValue(matData);
+                m_pNoiseReductionOutput->data()->setValue(std::move(matData));
             }
         }
     }
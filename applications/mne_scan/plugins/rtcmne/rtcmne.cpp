@@ -580,6 +580,7 @@ void RtcMne::run()
     float tstep;
     float lambda2 = 1.0f / pow(1.0f, 2); //ToDo estimate lambda using covariance
     MNESourceEstimate sourceEstimate;
+    MNESourceEstimate sourceEstimateRaw;
     bool bEvokedInput = false;
     bool bRawInput = false;
     bool bUpdateMinimumNorm = false;
@@ -625,18 +626,25 @@ void RtcMne::run()
                     }
 
                     //TODO: Add picking here. See evoked part as input.
-                    sourceEstimate = pMinimumNorm->calculateInverse(matDataResized,
-                                                                    0.0f,
-                                                                    tstep,
-                                                                    true);
+                    //The source estimate is reused for every block. If only one time point is picked, only this one is computed.
+                    bool bApplied = false;
+
+                    if(iTimePointSps < matDataResized.cols() && iTimePointSps >= 0) {
+                        bApplied = pMinimumNorm->applyInverse(matDataResized.col(iTimePointSps),
+                                                              sourceEstimateRaw,
+                                                              iTimePointSps * tstep,
+                                                              tstep,
+                                                              true);
+                    } else {
+                        bApplied = pMinimumNorm->applyInverse(matDataResized,
+                                                              sourceEstimateRaw,
+                                                              0.0f,
+                                                              tstep,
+                                                              true);
+                    }
 
-                    if(!sourceEstimate.isEmpty()) {
-                        if(iTimePointSps < sourceEstimate.data.cols() && iTimePointSps >= 0) {
-                            sourceEstimate = sourceEstimate.reduce(iTimePointSps,1);
-                            m_pRTSEOutput->data()->setValue(sourceEstimate);
-                        } else {
-                            m_pRTSEOutput->data()->setValue(sourceEstimate);
-                        }
+                    if(bApplied) {
+                        m_pRTSEOutput->data()->setValue(sourceEstimateRaw);
                     }
                 }
             } else {
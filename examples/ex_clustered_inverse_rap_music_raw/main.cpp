@@ -246,6 +246,7 @@ int main(int argc, char *argv[])
         //
 //        fiff_int_t nproj = MNE::make_projector_info(raw.info, raw.proj); Using the member function instead
         fiff_int_t nproj = raw.info.make_projector(raw.proj);
+        raw.invalidateReadOperators();
 
         if (nproj == 0)
         {
@@ -272,6 +273,7 @@ int main(int argc, char *argv[])
         qDebug() << "This part needs to be debugged";
         if(MNE::make_compensator(raw.info, current_comp, dest_comp, raw.comp))
         {
+            raw.invalidateReadOperators();
             raw.info.set_current_comp(dest_comp);
             printf("Appropriate compensator added to change to grade %d.\n",dest_comp);
         }
@@ -42,6 +42,7 @@
 #include <rtprocessing/rtconnectivity.h>
 
 #include <connectivity/metrics/abstractmetric.h>
+#include <connectivity/metrics/crossspectraldensity.h>
 #include <connectivity/connectivitysettings.h>
 #include <connectivity/network/network.h>
 #include <connectivity/network/networknode.h>
@@ -280,8 +281,9 @@ public:
                 m_pEpochSignalCoursePlot->show();
             }
 
-            if(iRowNumber < m_settings.at(iTrialNumber).vecTapSpectra.size()) {
-                Eigen::RowVectorXd plotVec = m_settings.at(iTrialNumber).vecTapSpectra.at(iRowNumber).cwiseAbs().row(0);
+            if(iRowNumber < m_settings.at(iTrialNumber).matTapSpectra.rows()) {
+                int iNTapers = m_settings.at(iTrialNumber).matTapSpectra.cols() / (m_settings.getFFTSize() / 2 + 1);
+                Eigen::RowVectorXd plotVec = CrossSpectralDensity::getTaperedSpectraRow(m_settings.at(iTrialNumber).matTapSpectra, iRowNumber, iNTapers).cwiseAbs().row(0);
                 Eigen::Map<Eigen::VectorXd> v1(plotVec.data(), plotVec.size());
                 Eigen::VectorXd temp =v1;
                 if(!m_pSpectrumPlot) {
@@ -127,10 +127,6 @@ int main(int argc, char *argv[])
     QApplication a(argc, argv);
     QApplication::addLibraryPath(QApplication::applicationDirPath()+"/../lib");
 
-    AbstractMetric::m_bStorageModeIsActive = false;
-    AbstractMetric::m_iNumberBinStart = 0;
-    AbstractMetric::m_iNumberBinAmount = 50;
-
     QCommandLineParser parser;
     parser.setApplicationDescription("Connectivity Example");
     parser.addHelpOption();
@@ -397,6 +393,8 @@ int main(int argc, char *argv[])
     pConnectivitySettingsManager->m_settings.setConnectivityMethods(QStringList() << sConnectivityMethod);
     pConnectivitySettingsManager->m_settings.setSamplingFrequency(raw.info.sfreq);
     pConnectivitySettingsManager->m_settings.setWindowType("hanning");
+    pConnectivitySettingsManager->m_settings.setStorageModeActive(false);
+    pConnectivitySettingsManager->m_settings.setFrequencyBins(0, 50);
 
     ConnectivitySettings::IntermediateTrialData connectivityData;
     for(int i = 0; i < matDataList.size(); i++) {
@@ -115,10 +115,6 @@ int main(int argc, char *argv[])
     qInstallMessageHandler(ApplicationLogger::customLogWriter);
     QApplication a(argc, argv);
 
-    AbstractMetric::m_bStorageModeIsActive = false;
-//    AbstractMetric::m_iNumberBinStart = 8;
-//    AbstractMetric::m_iNumberBinAmount = 4;
-
     QCommandLineParser parser;
     parser.setApplicationDescription("Connectivity Comparison Example");
     parser.addHelpOption();
@@ -351,6 +347,8 @@ int main(int argc, char *argv[])
 
     conSettings.setSamplingFrequency(raw.info.sfreq);
     conSettings.setWindowType("hanning");
+    conSettings.setStorageModeActive(false);
+//    conSettings.setFrequencyBins(8, 4);
 
     QList<Network> lNetworks = Connectivity::calculate(conSettings);
 
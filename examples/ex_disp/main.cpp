@@ -167,6 +167,7 @@ int main(int argc, char *argv[])
         //   Create the projector
         //
         fiff_int_t nproj = raw.info.make_projector(raw.proj);
+        raw.invalidateReadOperators();
 
         if (nproj == 0)
             printf("The projection vectors do not apply to these channels\n");
@@ -191,6 +192,7 @@ int main(int argc, char *argv[])
         qDebug() << "This part needs to be debugged";
         if(MNE::make_compensator(raw.info, current_comp, dest_comp, raw.comp))
         {
+            raw.invalidateReadOperators();
             raw.info.set_current_comp(dest_comp);
             printf("Appropriate compensator added to change to grade %d.\n",dest_comp);
         }
@@ -154,6 +154,7 @@ int main(int argc, char *argv[])
         //   Create the projector
         //
         fiff_int_t nproj = raw.info.make_projector(raw.proj);
+        raw.invalidateReadOperators();
 
         if (nproj == 0)
             qWarning("The projection vectors do not apply to these channels\n");
@@ -177,6 +178,7 @@ int main(int argc, char *argv[])
     {
         if(MNE::make_compensator(raw.info, current_comp, dest_comp, raw.comp))
         {
+            raw.invalidateReadOperators();
             raw.info.set_current_comp(dest_comp);
             qInfo("Appropriate compensator added to change to grade %d.\n",dest_comp);
         }
@@ -42,6 +42,7 @@
 
 #include "connectivitysettings.h"
 #include "network/network.h"
+#include "metrics/abstractmetric.h"
 #include "metrics/correlation.h"
 #include "metrics/crosscorrelation.h"
 #include "metrics/coherence.h"
@@ -91,6 +92,10 @@ QList<Network> Connectivity::calculate(ConnectivitySettings& connectivitySetting
     QElapsedTimer timer;
     timer.start();
 
+    // Compute the tapered spectra and CSD of each trial once for all requested spectral metrics
+    AbstractMetric::computeIntermediateData(connectivitySettings,
+                                            lMethods);
+
     if(lMethods.contains("WPLI")) {
         results.append(WeightedPhaseLagIndex::calculate(connectivitySettings));
     }
@@ -91,7 +91,10 @@ public:
 
     //=========================================================================================================
     /**
-     * Computes the network based on the current settings.
+     * Computes the network based on the current settings. The spectral data of each trial is computed once and
+     * shared by all requested spectral methods.
+     *
+     * @param[in] connectivitySettings   The input data and parameters.
      *
      * @return Returns the list with calculated networks for each provided method.
      */
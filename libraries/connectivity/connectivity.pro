@@ -77,6 +77,7 @@ SOURCES += \
     metrics/correlation.cpp \
     metrics/crosscorrelation.cpp \
     metrics/coherency.cpp \
+    metrics/crossspectraldensity.cpp \
     metrics/coherence.cpp \
     metrics/imagcoherence.cpp \
     metrics/unbiasedsquaredphaselagindex.cpp \
@@ -96,6 +97,7 @@ HEADERS += \
     metrics/correlation.h \
     metrics/crosscorrelation.h \
     metrics/coherency.h \
+    metrics/crossspectraldensity.h \
     metrics/coherence.h \
     metrics/imagcoherence.h \
     metrics/unbiasedsquaredphaselagindex.h \
@@ -76,6 +76,9 @@ ConnectivitySettings::ConnectivitySettings()
 : m_fFreqResolution(1.0f)
 , m_fSFreq(1000.0f)
 , m_sWindowType("hanning")
+, m_bStorageModeIsActive(false)
+, m_iNumberBinStart(-1)
+, m_iNumberBinAmount(-1)
 {
     m_iNfft = int(m_fSFreq/m_fFreqResolution);
     qRegisterMetaType<CONNECTIVITYLIB::ConnectivitySettings>("CONNECTIVITYLIB::ConnectivitySettings");
@@ -95,21 +98,22 @@ void ConnectivitySettings::clearAllData()
 void ConnectivitySettings::clearIntermediateData() 
 {
     for (int i = 0; i < m_trialData.size(); ++i) {
+        m_trialData[i].iSummedUp = 0;
         m_trialData[i].matPsd.resize(0,0);
-        m_trialData[i].vecPairCsd.clear();
-        m_trialData[i].vecTapSpectra.clear();
-        m_trialData[i].vecPairCsdNormalized.clear();
-        m_trialData[i].vecPairCsdImagSign.clear();
-        m_trialData[i].vecPairCsdImagAbs.clear();
-        m_trialData[i].vecPairCsdImagSqrd.clear();
+        m_trialData[i].matTapSpectra.resize(0,0);
+        m_trialData[i].matCsd.resize(0,0);
+        m_trialData[i].matCsdNormalized.resize(0,0);
+        m_trialData[i].matCsdImagSign.resize(0,0);
+        m_trialData[i].matCsdImagAbs.resize(0,0);
+        m_trialData[i].matCsdImagSqrd.resize(0,0);
     }
 
     m_intermediateSumData.matPsdSum.resize(0,0);
-    m_intermediateSumData.vecPairCsdSum.clear();
-    m_intermediateSumData.vecPairCsdNormalizedSum.clear();
-    m_intermediateSumData.vecPairCsdImagSignSum.clear();
-    m_intermediateSumData.vecPairCsdImagAbsSum.clear();
-    m_intermediateSumData.vecPairCsdImagSqrdSum.clear();
+    m_intermediateSumData.matCsdSum.resize(0,0);
+    m_intermediateSumData.matCsdNormalizedSum.resize(0,0);
+    m_intermediateSumData.matCsdImagSignSum.resize(0,0);
+    m_intermediateSumData.matCsdImagAbsSum.resize(0,0);
+    m_intermediateSumData.matCsdImagSqrdSum.resize(0,0);
 }
 
 //*******************************************************************************************************
@@ -179,28 +183,7 @@ void ConnectivitySettings::removeFirst(int iAmount)
 
     // Substract influence of trials from overall summed up intermediate data and remove from data list
     for (int j = 0; j < iAmount; ++j) {
-        for (int i = 0; i < m_trialData.first().matData.rows(); ++i) {
-            if(i < m_intermediateSumData.vecPairCsdSum.size() && (m_intermediateSumData.vecPairCsdSum.size() == m_trialData.first().vecPairCsd.size())) {
-                m_intermediateSumData.vecPairCsdSum[i].second -= m_trialData.first().vecPairCsd.at(i).second;
-            }
-            if(i < m_intermediateSumData.vecPairCsdNormalizedSum.size() && (m_intermediateSumData.vecPairCsdNormalizedSum.size() == m_trialData.first().vecPairCsdNormalized.size())) {
-                m_intermediateSumData.vecPairCsdNormalizedSum[i].second -= m_trialData.first().vecPairCsdNormalized.at(i).second;
-            }
-            if(i < m_intermediateSumData.vecPairCsdImagSignSum.size() && (m_intermediateSumData.vecPairCsdImagSignSum.size() == m_trialData.first().vecPairCsdImagSign.size())) {
-                m_intermediateSumData.vecPairCsdImagSignSum[i].second -= m_trialData.first().vecPairCsdImagSign.at(i).second;
-            }
-            if(i < m_intermediateSumData.vecPairCsdImagAbsSum.size() && (m_intermediateSumData.vecPairCsdImagAbsSum.size() == m_trialData.first().vecPairCsdImagAbs.size())) {
-                m_intermediateSumData.vecPairCsdImagAbsSum[i].second -= m_trialData.first().vecPairCsdImagAbs.at(i).second;
-            }
-            if(i < m_intermediateSumData.vecPairCsdImagSqrdSum.size() && (m_intermediateSumData.vecPairCsdImagSqrdSum.size() == m_trialData.first().vecPairCsdImagSqrd.size())) {
-                m_intermediateSumData.vecPairCsdImagSqrdSum[i].second -= m_trialData.first().vecPairCsdImagSqrd.at(i).second;
-            }
-        }
-
-        if(m_intermediateSumData.matPsdSum.rows() == m_trialData.first().matPsd.rows() &&
-           m_intermediateSumData.matPsdSum.cols() == m_trialData.first().matPsd.cols() ) {
-            m_intermediateSumData.matPsdSum -= m_trialData.first().matPsd;
-        }
+        substractFromSum(m_trialData.first());
 
         m_trialData.removeFirst();
     }
@@ -230,28 +213,7 @@ void ConnectivitySettings::removeLast(int iAmount)
 
     // Substract influence of trials from overall summed up intermediate data and remove from data list
     for (int j = 0; j < iAmount; ++j) {
-        for (int i = 0; i < m_trialData.last().matData.rows(); ++i) {
-            if(i < m_intermediateSumData.vecPairCsdSum.size() && (m_intermediateSumData.vecPairCsdSum.size() == m_trialData.last().vecPairCsd.size())) {
-                m_intermediateSumData.vecPairCsdSum[i].second -= m_trialData.last().vecPairCsd.at(i).second;
-            }
-            if(i < m_intermediateSumData.vecPairCsdNormalizedSum.size() && (m_intermediateSumData.vecPairCsdNormalizedSum.size() == m_trialData.last().vecPairCsdNormalized.size())) {
-                m_intermediateSumData.vecPairCsdNormalizedSum[i].second -= m_trialData.last().vecPairCsdNormalized.at(i).second;
-            }
-            if(i < m_intermediateSumData.vecPairCsdImagSignSum.size() && (m_intermediateSumData.vecPairCsdImagSignSum.size() == m_trialData.last().vecPairCsdImagSign.size())) {
-                m_intermediateSumData.vecPairCsdImagSignSum[i].second -= m_trialData.last().vecPairCsdImagSign.at(i).second;
-            }
-            if(i < m_intermediateSumData.vecPairCsdImagAbsSum.size() && (m_intermediateSumData.vecPairCsdImagAbsSum.size() == m_trialData.last().vecPairCsdImagAbs.size())) {
-                m_intermediateSumData.vecPairCsdImagAbsSum[i].second -= m_trialData.last().vecPairCsdImagAbs.at(i).second;
-            }
-            if(i < m_intermediateSumData.vecPairCsdImagSqrdSum.size() && (m_intermediateSumData.vecPairCsdImagSqrdSum.size() == m_trialData.last().vecPairCsdImagSqrd.size())) {
-                m_intermediateSumData.vecPairCsdImagSqrdSum[i].second -= m_trialData.last().vecPairCsdImagSqrd.at(i).second;
-            }
-        }
-
-        if(m_intermediateSumData.matPsdSum.rows() == m_trialData.last().matPsd.rows() &&
-           m_intermediateSumData.matPsdSum.cols() == m_trialData.last().matPsd.cols() ) {
-            m_intermediateSumData.matPsdSum -= m_trialData.last().matPsd;
-        }
+        substractFromSum(m_trialData.last());
 
         m_trialData.removeLast();
     }
@@ -339,6 +301,51 @@ const QString& ConnectivitySettings::getWindowType() const
 
 //*******************************************************************************************************
 
+void ConnectivitySettings::setStorageModeActive(bool bStorageModeIsActive)
+{
+    m_bStorageModeIsActive = bStorageModeIsActive;
+}
+
+//*******************************************************************************************************
+
+bool ConnectivitySettings::isStorageModeActive() const
+{
+    return m_bStorageModeIsActive;
+}
+
+//*******************************************************************************************************
+
+void ConnectivitySettings::setFrequencyBins(int iNumberBinStart,
+                                            int iNumberBinAmount)
+{
+    if(m_iNumberBinStart == iNumberBinStart && m_iNumberBinAmount == iNumberBinAmount) {
+        return;
+    }
+
+    // Clear all intermediate data since the sums were computed for the old frequency bins
+    clearIntermediateData();
+
+    m_iNumberBinStart = iNumberBinStart;
+    m_iNumberBinAmount = iNumberBinAmount;
+}
+
+//*******************************************************************************************************
+
+int ConnectivitySettings::getNumberBinStart() const
+{
+    return isFrequencyBinRangeValid() ? m_iNumberBinStart : 0;
+}
+
+//*******************************************************************************************************
+
+int ConnectivitySettings::getNumberBinAmount() const
+{
+    // Use the half spectrum if the range is not valid
+    return isFrequencyBinRangeValid() ? m_iNumberBinAmount : m_iNfft / 2 + 1;
+}
+
+//*******************************************************************************************************
+
 void ConnectivitySettings::setNodePositions(const FiffInfo& fiffInfo,
                                             const RowVectorXi& picks)
 {
@@ -416,3 +423,57 @@ ConnectivitySettings::IntermediateSumData& ConnectivitySettings::getIntermediate
 {
     return m_intermediateSumData;
 }
+
+//*******************************************************************************************************
+
+bool ConnectivitySettings::isFrequencyBinRangeValid() const
+{
+    int iNFreqs = m_iNfft / 2 + 1;
+
+    return m_iNumberBinStart >= 0 &&
+           m_iNumberBinAmount > 0 &&
+           m_iNumberBinStart + m_iNumberBinAmount <= iNFreqs;
+}
+
+//*******************************************************************************************************
+
+void ConnectivitySettings::substractFromSum(const IntermediateTrialData& trialData)
+{
+    const int iSummedUp = trialData.iSummedUp;
+
+    // Only substract the data which was actually added to the sum for this trial. If it was not kept, the sums cannot be
+    // updated and are recomputed from scratch on the next calculation.
+    if(((iSummedUp & PsdSum) && trialData.matPsd.size() != m_intermediateSumData.matPsdSum.size()) ||
+       ((iSummedUp & CsdSum) && trialData.matCsd.size() != m_intermediateSumData.matCsdSum.size()) ||
+       ((iSummedUp & CsdNormalizedSum) && trialData.matCsdNormalized.size() != m_intermediateSumData.matCsdNormalizedSum.size()) ||
+       ((iSummedUp & CsdImagSignSum) && trialData.matCsdImagSign.size() != m_intermediateSumData.matCsdImagSignSum.size()) ||
+       ((iSummedUp & CsdImagAbsSum) && trialData.matCsdImagAbs.size() != m_intermediateSumData.matCsdImagAbsSum.size()) ||
+       ((iSummedUp & CsdImagSqrdSum) && trialData.matCsdImagSqrd.size() != m_intermediateSumData.matCsdImagSqrdSum.size())) {
+        clearIntermediateData();
+        return;
+    }
+
+    if(iSummedUp & PsdSum) {
+        m_intermediateSumData.matPsdSum -= trialData.matPsd;
+    }
+
+    if(iSummedUp & CsdSum) {
+        m_intermediateSumData.matCsdSum -= trialData.matCsd;
+    }
+
+    if(iSummedUp & CsdNormalizedSum) {
+        m_intermediateSumData.matCsdNormalizedSum -= trialData.matCsdNormalized;
+    }
+
+    if(iSummedUp & CsdImagSignSum) {
+        m_intermediateSumData.matCsdImagSignSum -= trialData.matCsdImagSign;
+    }
+
+    if(iSummedUp & CsdImagAbsSum) {
+        m_intermediateSumData.matCsdImagAbsSum -= trialData.matCsdImagAbs;
+    }
+
+    if(iSummedUp & CsdImagSqrdSum) {
+        m_intermediateSumData.matCsdImagSqrdSum -= trialData.matCsdImagSqrd;
+    }
+}
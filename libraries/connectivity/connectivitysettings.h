@@ -95,24 +95,45 @@ public:
     typedef QSharedPointer<ConnectivitySettings> SPtr;            /**< Shared pointer type for ConnectivitySettings. */
     typedef QSharedPointer<const ConnectivitySettings> ConstSPtr; /**< Const shared pointer type for ConnectivitySettings. */
 
+    /**
+     * The intermediate data which is summed up over all trials.
+     */
+    enum IntermediateSum {
+        PsdSum              = 0x01,
+        CsdSum              = 0x02,
+        CsdNormalizedSum    = 0x04,
+        CsdImagSignSum      = 0x08,
+        CsdImagAbsSum       = 0x10,
+        CsdImagSqrdSum      = 0x20
+    };
+
+    /**
+     * The spectral data of one trial. The CSD based matrices use the compact pair layout of CrossSpectralDensity,
+     * i.e. one row per pair (i,j) with i <= j and one column per used frequency bin. iSummedUp holds the
+     * IntermediateSum flags of the sums this trial was already added to, also if its own matrices were not kept.
+     */
     struct IntermediateTrialData {
+        int                 iSummedUp = 0;
         Eigen::MatrixXd     matData;
         Eigen::MatrixXd     matPsd;
-        QVector<Eigen::MatrixXcd>               vecTapSpectra;
-        QVector<QPair<int,Eigen::MatrixXcd> >   vecPairCsd;
-        QVector<QPair<int,Eigen::MatrixXcd> >   vecPairCsdNormalized;
-        QVector<QPair<int,Eigen::MatrixXd> >    vecPairCsdImagSign;
-        QVector<QPair<int,Eigen::MatrixXd> >    vecPairCsdImagAbs;
-        QVector<QPair<int,Eigen::MatrixXd> >    vecPairCsdImagSqrd;
+        Eigen::MatrixXcd    matTapSpectra;
+        Eigen::MatrixXcd    matCsd;
+        Eigen::MatrixXcd    matCsdNormalized;
+        Eigen::MatrixXd     matCsdImagSign;
+        Eigen::MatrixXd     matCsdImagAbs;
+        Eigen::MatrixXd     matCsdImagSqrd;
     };
 
+    /**
+     * The spectral data summed over all trials, in the same layout as IntermediateTrialData.
+     */
     struct IntermediateSumData {
         Eigen::MatrixXd     matPsdSum;
-        QVector<QPair<int,Eigen::MatrixXcd> >   vecPairCsdSum;
-        QVector<QPair<int,Eigen::MatrixXcd> >   vecPairCsdNormalizedSum;
-        QVector<QPair<int,Eigen::MatrixXd> >    vecPairCsdImagSignSum;
-        QVector<QPair<int,Eigen::MatrixXd> >    vecPairCsdImagAbsSum;
-        QVector<QPair<int,Eigen::MatrixXd> >    vecPairCsdImagSqrdSum;
+        Eigen::MatrixXcd    matCsdSum;
+        Eigen::MatrixXcd    matCsdNormalizedSum;
+        Eigen::MatrixXd     matCsdImagSignSum;
+        Eigen::MatrixXd     matCsdImagAbsSum;
+        Eigen::MatrixXd     matCsdImagSqrdSum;
     };
 
     //=========================================================================================================
@@ -157,6 +178,44 @@ public:
 
     const QString& getWindowType() const;
 
+    //=========================================================================================================
+    /**
+     * Sets whether the intermediate data of each trial (tapered spectra, PSD, CSD, ...) is kept after it was added
+     * to the sums. Keeping it allows to remove single trials from the sums later on, at the cost of memory.
+     *
+     * @param[in] bStorageModeIsActive   Whether to keep the intermediate data of each trial.
+     */
+    void setStorageModeActive(bool bStorageModeIsActive);
+
+    bool isStorageModeActive() const;
+
+    //=========================================================================================================
+    /**
+     * Sets the range of frequency bins the spectral metrics are computed for. An invalid range, e.g. the default
+     * of -1, selects the full spectrum.
+     *
+     * @param[in] iNumberBinStart    The first frequency bin.
+     * @param[in] iNumberBinAmount   The number of frequency bins.
+     */
+    void setFrequencyBins(int iNumberBinStart,
+                          int iNumberBinAmount);
+
+    //=========================================================================================================
+    /**
+     * Returns the first used frequency bin, resolved against the current FFT length.
+     *
+     * @return The first used frequency bin.
+     */
+    int getNumberBinStart() const;
+
+    //=========================================================================================================
+    /**
+     * Returns the number of used frequency bins, resolved against the current FFT length.
+     *
+     * @return The number of used frequency bins.
+     */
+    int getNumberBinAmount() const;
+
     void setNodePositions(const FIFFLIB::FiffInfo& fiffInfo,
                           const Eigen::RowVectorXi& picks);
 
@@ -172,6 +231,23 @@ public:
     IntermediateSumData& getIntermediateSumData();
 
 protected:
+    //=========================================================================================================
+    /**
+     * Returns whether the frequency bin range is valid for the current FFT length.
+     *
+     * @return Whether the frequency bin range is valid.
+     */
+    bool isFrequencyBinRangeValid() const;
+
+    //=========================================================================================================
+    /**
+     * Substracts the intermediate data of a trial from the intermediate sum data. If the trial's intermediate data
+     * was not kept (storage mode inactive), all sums are cleared instead and get recomputed on the next calculation.
+     *
+     * @param[in] trialData     The trial which is about to be removed.
+     */
+    void substractFromSum(const IntermediateTrialData& trialData);
+
     QStringList                     m_sConnectivityMethods;         /**< The connectivity methods. */
     QString                         m_sWindowType;                  /**< The window type used to compute tapered spectra. */
 
@@ -179,6 +255,10 @@ protected:
     int                             m_iNfft;                        /**< The FFT length. Also includes the negativ frequencies. Gets recalculated if the sFreq or spectrum resolution change. */
     float                           m_fFreqResolution;              /**< The spectrum's resolution. */
 
+    bool                            m_bStorageModeIsActive;         /**< Whether the intermediate data of each trial is kept. */
+    int                             m_iNumberBinStart;              /**< The first used frequency bin. -1 for the full spectrum. */
+    int                             m_iNumberBinAmount;             /**< The number of used frequency bins. -1 for the full spectrum. */
+
     Eigen::MatrixX3f                m_matNodePositions;             /**< The node position in 3D space. */
 
     IntermediateSumData             m_intermediateSumData;          /**< The intermediate sum data holds data calculated over all trials as a whole. */
@@ -37,11 +37,16 @@
 //=============================================================================================================
 
 #include "abstractmetric.h"
+#include "crossspectraldensity.h"
+
+#include <utils/spectral.h>
 
 //=============================================================================================================
 // QT INCLUDES
 //=============================================================================================================
 
+#include <QtConcurrent>
+
 //=============================================================================================================
 // EIGEN INCLUDES
 //=============================================================================================================
@@ -51,15 +56,13 @@
 //=============================================================================================================
 
 using namespace CONNECTIVITYLIB;
+using namespace Eigen;
+using namespace UTILSLIB;
 
 //=============================================================================================================
 // DEFINE GLOBAL METHODS
 //=============================================================================================================
 
-bool AbstractMetric::m_bStorageModeIsActive = false;
-int AbstractMetric::m_iNumberBinStart = -1;
-int AbstractMetric::m_iNumberBinAmount = -1;
-
 //=============================================================================================================
 // DEFINE MEMBER METHODS
 //=============================================================================================================
@@ -68,3 +71,225 @@ AbstractMetric::AbstractMetric()
 {
 }
 
+//=============================================================================================================
+
+void AbstractMetric::computeIntermediateData(ConnectivitySettings& connectivitySettings,
+                                             const QStringList& lMethods)
+{
+    if(connectivitySettings.isEmpty()) {
+        return;
+    }
+
+    int iIntermediateSums = getIntermediateSums(lMethods);
+
+    if(iIntermediateSums == 0) {
+        return;
+    }
+
+    // Only process trials which were not added to all needed sums yet
+    bool bAllSummedUp = true;
+
+    for(int i = 0; i < connectivitySettings.size(); ++i) {
+        if((connectivitySettings.at(i).iSummedUp & iIntermediateSums) != iIntermediateSums) {
+            bAllSummedUp = false;
+            break;
+        }
+    }
+
+    if(bAllSummedUp) {
+        return;
+    }
+
+    #ifdef EIGEN_FFTW_DEFAULT
+        fftw_make_planner_thread_safe();
+    #endif
+
+    int iSignalLength = connectivitySettings.at(0).matData.cols();
+    int iNfft = connectivitySettings.getFFTSize();
+    int iNBinStart = connectivitySettings.getNumberBinStart();
+    int iNBinAmount = connectivitySettings.getNumberBinAmount();
+    bool bStorageModeIsActive = connectivitySettings.isStorageModeActive();
+
+    // Generate tapers
+    QPair<MatrixXd, VectorXd> tapers = Spectral::generateTapers(iSignalLength, connectivitySettings.getWindowType());
+
+    QMutex mutex;
+
+    std::function<void(ConnectivitySettings::IntermediateTrialData&)> computeLambda = [&](ConnectivitySettings::IntermediateTrialData& inputData) {
+        computeTrial(inputData,
+                     connectivitySettings.getIntermediateSumData(),
+                     mutex,
+                     iIntermediateSums,
+                     iNfft,
+                     iNBinStart,
+                     iNBinAmount,
+                     bStorageModeIsActive,
+                     tapers);
+    };
+
+    QFuture<void> result = QtConcurrent::map(connectivitySettings.getTrialData(),
+                                             computeLambda);
+    result.waitForFinished();
+}
+
+//=============================================================================================================
+
+int AbstractMetric::getIntermediateSums(const QStringList& lMethods)
+{
+    int iIntermediateSums = 0;
+
+    if(lMethods.contains("COH") || lMethods.contains("IMAGCOH")) {
+        iIntermediateSums |= ConnectivitySettings::PsdSum | ConnectivitySettings::CsdSum;
+    }
+
+    if(lMethods.contains("PLI") || lMethods.contains("USPLI")) {
+        iIntermediateSums |= ConnectivitySettings::CsdImagSignSum;
+    }
+
+    if(lMethods.contains("WPLI")) {
+        iIntermediateSums |= ConnectivitySettings::CsdSum | ConnectivitySettings::CsdImagAbsSum;
+    }
+
+    if(lMethods.contains("DSWPLI")) {
+        iIntermediateSums |= ConnectivitySettings::CsdSum | ConnectivitySettings::CsdImagAbsSum | ConnectivitySettings::CsdImagSqrdSum;
+    }
+
+    if(lMethods.contains("PLV")) {
+        iIntermediateSums |= ConnectivitySettings::CsdNormalizedSum;
+    }
+
+    return iIntermediateSums;
+}
+
+//=============================================================================================================
+
+void AbstractMetric::computeTrial(ConnectivitySettings::IntermediateTrialData& inputData,
+                                  ConnectivitySettings::IntermediateSumData& sumData,
+                                  QMutex& mutex,
+                                  int iIntermediateSums,
+                                  int iNfft,
+                                  int iNBinStart,
+                                  int iNBinAmount,
+                                  bool bStorageModeIsActive,
+                                  const QPair<MatrixXd, VectorXd>& tapers)
+{
+    // Only compute what was not added to the sums yet
+    int iMissingSums = iIntermediateSums & ~inputData.iSummedUp;
+
+    if(iMissingSums == 0) {
+        return;
+    }
+
+    int iNRows = inputData.matData.rows();
+    int iNPairs = CrossSpectralDensity::getNumberOfPairs(iNRows);
+
+    // Calculate tapered spectra if not available already
+    if(inputData.matTapSpectra.rows() != iNRows) {
+        CrossSpectralDensity::computeTaperedSpectra(inputData.matTapSpectra,
+                                                    inputData.matData,
+                                                    tapers,
+                                                    iNfft);
+    }
+
+    // Compute PSD
+    if((iMissingSums & ConnectivitySettings::PsdSum) && inputData.matPsd.rows() != iNRows) {
+        CrossSpectralDensity::computePsd(inputData.matPsd,
+                                         inputData.matTapSpectra,
+                                         tapers.second,
+                                         iNfft,
+                                         iNBinStart,
+                                         iNBinAmount);
+    }
+
+    // Compute CSD, all other sums are derived from it
+    if((iMissingSums & ~ConnectivitySettings::PsdSum) && inputData.matCsd.rows() != iNPairs) {
+        CrossSpectralDensity::computeCsd(inputData.matCsd,
+                                         inputData.matTapSpectra,
+                                         tapers.second,
+                                         iNfft,
+                                         iNBinStart,
+                                         iNBinAmount);
+    }
+
+    if((iMissingSums & ConnectivitySettings::CsdNormalizedSum) && inputData.matCsdNormalized.rows() != iNPairs) {
+        inputData.matCsdNormalized = inputData.matCsd.cwiseQuotient(inputData.matCsd.cwiseAbs());
+    }
+
+    if((iMissingSums & ConnectivitySettings::CsdImagSignSum) && inputData.matCsdImagSign.rows() != iNPairs) {
+        inputData.matCsdImagSign = inputData.matCsd.imag().cwiseSign();
+    }
+
+    if((iMissingSums & ConnectivitySettings::CsdImagAbsSum) && inputData.matCsdImagAbs.rows() != iNPairs) {
+        inputData.matCsdImagAbs = inputData.matCsd.imag().cwiseAbs();
+    }
+
+    if((iMissingSums & ConnectivitySettings::CsdImagSqrdSum) && inputData.matCsdImagSqrd.rows() != iNPairs) {
+        inputData.matCsdImagSqrd = inputData.matCsd.imag().array().square();
+    }
+
+    // Add to sums
+    mutex.lock();
+
+    if(iMissingSums & ConnectivitySettings::PsdSum) {
+        if(sumData.matPsdSum.size() == 0) {
+            sumData.matPsdSum = inputData.matPsd;
+        } else {
+            sumData.matPsdSum += inputData.matPsd;
+        }
+    }
+
+    if(iMissingSums & ConnectivitySettings::CsdSum) {
+        if(sumData.matCsdSum.size() == 0) {
+            sumData.matCsdSum = inputData.matCsd;
+        } else {
+            sumData.matCsdSum += inputData.matCsd;
+        }
+    }
+
+    if(iMissingSums & ConnectivitySettings::CsdNormalizedSum) {
+        if(sumData.matCsdNormalizedSum.size() == 0) {
+            sumData.matCsdNormalizedSum = inputData.matCsdNormalized;
+        } else {
+            sumData.matCsdNormalizedSum += inputData.matCsdNormalized;
+        }
+    }
+
+    if(iMissingSums & ConnectivitySettings::CsdImagSignSum) {
+        if(sumData.matCsdImagSignSum.size() == 0) {
+            sumData.matCsdImagSignSum = inputData.matCsdImagSign;
+        } else {
+            sumData.matCsdImagSignSum += inputData.matCsdImagSign;
+        }
+    }
+
+    if(iMissingSums & ConnectivitySettings::CsdImagAbsSum) {
+        if(sumData.matCsdImagAbsSum.size() == 0) {
+            sumData.matCsdImagAbsSum = inputData.matCsdImagAbs;
+        } else {
+            sumData.matCsdImagAbsSum += inputData.matCsdImagAbs;
+        }
+    }
+
+    if(iMissingSums & ConnectivitySettings::CsdImagSqrdSum) {
+        if(sumData.matCsdImagSqrdSum.size() == 0) {
+            sumData.matCsdImagSqrdSum = inputData.matCsdImagSqrd;
+        } else {
+            sumData.matCsdImagSqrdSum += inputData.matCsdImagSqrd;
+        }
+    }
+
+    inputData.iSummedUp |= iMissingSums;
+
+    mutex.unlock();
+
+    //Do not store data to save memory
+    if(!bStorageModeIsActive) {
+        inputData.matPsd.resize(0,0);
+        inputData.matTapSpectra.resize(0,0);
+        inputData.matCsd.resize(0,0);
+        inputData.matCsdNormalized.resize(0,0);
+        inputData.matCsdImagSign.resize(0,0);
+        inputData.matCsdImagAbs.resize(0,0);
+        inputData.matCsdImagSqrd.resize(0,0);
+    }
+}
@@ -40,6 +40,7 @@
 //=============================================================================================================
 
 #include "../connectivity_global.h"
+#include "../connectivitysettings.h"
 
 //=============================================================================================================
 // QT INCLUDES
@@ -47,6 +48,9 @@
 
 #include <QSharedPointer>
 #include <QVector>
+#include <QStringList>
+#include <QPair>
+#include <QMutex>
 
 //=============================================================================================================
 // EIGEN INCLUDES
@@ -87,11 +91,52 @@ public:
      */
     explicit AbstractMetric();
 
-    static bool     m_bStorageModeIsActive;
-    static int      m_iNumberBinStart;
-    static int      m_iNumberBinAmount;
+    //=========================================================================================================
+    /**
+     * Computes the intermediate data needed by the given spectral methods for all trials which were not added to
+     * the sums yet. The tapered spectra and the CSD of a trial are computed once and shared by all given methods,
+     * so that requesting several methods at once costs one FFT per trial and row. Non spectral methods are ignored.
+     *
+     * @param[in] connectivitySettings   The input data and parameters.
+     * @param[in] lMethods               The methods, e.g. "COH" or "WPLI".
+     */
+    static void computeIntermediateData(ConnectivitySettings& connectivitySettings,
+                                        const QStringList& lMethods);
 
 protected:
+    //=========================================================================================================
+    /**
+     * Returns the ConnectivitySettings::IntermediateSum flags of the sums needed by the given methods.
+     *
+     * @param[in] lMethods   The methods.
+     *
+     * @return The needed sums.
+     */
+    static int getIntermediateSums(const QStringList& lMethods);
+
+    //=========================================================================================================
+    /**
+     * Computes the intermediate data of one trial and adds it to the sums. This function gets called in parallel.
+     *
+     * @param[in] inputData              The input data.
+     * @param[out]sumData                The sums over all trials.
+     * @param[in] mutex                  The mutex used to safely access sumData.
+     * @param[in] iIntermediateSums      The ConnectivitySettings::IntermediateSum flags of the needed sums.
+     * @param[in] iNfft                  The FFT length.
+     * @param[in] iNBinStart             The first used frequency bin.
+     * @param[in] iNBinAmount            The number of used frequency bins.
+     * @param[in] bStorageModeIsActive   Whether to keep the intermediate data of the trial.
+     * @param[in] tapers                 The taper information.
+     */
+    static void computeTrial(ConnectivitySettings::IntermediateTrialData& inputData,
+                             ConnectivitySettings::IntermediateSumData& sumData,
+                             QMutex& mutex,
+                             int iIntermediateSums,
+                             int iNfft,
+                             int iNBinStart,
+                             int iNBinAmount,
+                             bool bStorageModeIsActive,
+                             const QPair<Eigen::MatrixXd, Eigen::VectorXd>& tapers);
 };
 
 //=============================================================================================================
@@ -119,37 +119,18 @@ public:
 private:
     //=========================================================================================================
     /**
-     * Computes the coherency values. This function gets called in parallel.
+     * Computes CSD/sqrt(PSD_X * PSD_Y) from the summed CSD and PSD and adds the absolute value, respectively the
+     * imaginary part, as edges to the network.
      *
-     * @param[in]    inputData           The input data.
-     * @param[out]   matPsdSum           The sum of all PSD matrices for each trial.
-     * @param[out]   vecPairCsdSum       The sum of all CSD matrices for each trial.
-     * @param[in]    mutex               The mutex used to safely access matPsdSum and vecPairCsdSum.
-     * @param[in]    iNRows              The number of rows.
-     * @param[in]    iNFreqs             The number of frequenciy bins.
-     * @param[in]    iNfft               The FFT length.
-     * @param[in]    tapers              The taper information.
+     * @param[out]   finalNetwork        The resulting network.
+     * @param[in]    matCsdSum           The sum of all CSD matrices for each trial.
+     * @param[in]    matPsdSum           The sum of all PSD matrices for each trial.
      */
-    static void compute(ConnectivitySettings::IntermediateTrialData& inputData,
-                        Eigen::MatrixXd& matPsdSum,
-                        QVector<QPair<int,Eigen::MatrixXcd> >& vecPairCsdSum,
-                        QMutex& mutex,
-                        int iNRows,
-                        int iNFreqs,
-                        int iNfft,
-                        const QPair<Eigen::MatrixXd, Eigen::VectorXd>& tapers);
-
-    //=========================================================================================================
-    /**
-     * Computes the PSD and CSD. This function gets called in parallel.
-     */
-    static void computePSDCSDAbs(QMutex& mutex,
-                                 Network& finalNetwork,
-                                 const QPair<int,Eigen::MatrixXcd>& pairInput,
+    static void computePSDCSDAbs(Network& finalNetwork,
+                                 const Eigen::MatrixXcd& matCsdSum,
                                  const Eigen::MatrixXd& matPsdSum);
-    static void computePSDCSDImag(QMutex& mutex,
-                                  Network& finalNetwork,
-                                  const QPair<int,Eigen::MatrixXcd>& pairInput,
+    static void computePSDCSDImag(Network& finalNetwork,
+                                  const Eigen::MatrixXcd& matCsdSum,
                                   const Eigen::MatrixXd& matPsdSum);
 };
 
@@ -38,7 +38,6 @@
 
 #include "correlation.h"
 #include "network/networknode.h"
-#include "network/networkedge.h"
 #include "network/network.h"
 
 //=============================================================================================================
@@ -134,23 +133,19 @@ Network Correlation::calculate(ConnectivitySettings& connectivitySettings)
 //    qWarning() << "ComputeSpectraPSDCSD" << iTime;
 //    timer.restart();
 
-    //Add edges to network
-    MatrixXd matWeight(1,1);
-    QSharedPointer<NetworkEdge> pEdge;
+    //Add the upper triangle row by row to the network
+    MatrixXd matPairWeights(matDist.rows()*(matDist.rows()+1)/2, 1);
     int j;
+    int iPair = 0;
 
     for(int i = 0; i < matDist.rows(); ++i) {
-        for(j = i; j < matDist.cols(); ++j) {
-            matWeight << matDist(i,j);
-
-            pEdge = QSharedPointer<NetworkEdge>(new NetworkEdge(i, j, matWeight));
-
-            finalNetwork.getNodeAt(i)->append(pEdge);
-            finalNetwork.getNodeAt(j)->append(pEdge);
-            finalNetwork.append(pEdge);
+        for(j = i; j < matDist.cols(); ++j, ++iPair) {
+            matPairWeights(iPair,0) = matDist(i,j);
         }
     }
 
+    finalNetwork.setPairWeights(std::move(matPairWeights));
+
 //    iTime = timer.elapsed();
 //    qWarning() << "Compute" << iTime;
 //    timer.restart();
@@ -37,8 +37,8 @@
 //=============================================================================================================
 
 #include "crosscorrelation.h"
+#include "crossspectraldensity.h"
 #include "network/networknode.h"
-#include "network/networkedge.h"
 #include "network/network.h"
 
 #include <utils/spectral.h>
@@ -50,12 +50,6 @@
 #include <QDebug>
 #include <QtConcurrent>
 
-//=============================================================================================================
-// EIGEN INCLUDES
-//=============================================================================================================
-
-#include <unsupported/Eigen/FFT>
-
 //=============================================================================================================
 // USED NAMESPACES
 //=============================================================================================================
@@ -84,10 +78,6 @@ Network CrossCorrelation::calculate(ConnectivitySettings& connectivitySettings)
 //    qint64 iTime = 0;
 //    timer.start();
 
-    #ifdef EIGEN_FFTW_DEFAULT
-        fftw_make_planner_thread_safe();
-    #endif
-
     Network finalNetwork("XCOR");
 
     if(connectivitySettings.isEmpty()) {
@@ -95,10 +85,6 @@ Network CrossCorrelation::calculate(ConnectivitySettings& connectivitySettings)
         return finalNetwork;
     }
 
-    if(AbstractMetric::m_bStorageModeIsActive == false) {
-        connectivitySettings.clearIntermediateData();
-    }
-
     finalNetwork.setSamplingFrequency(connectivitySettings.getSamplingFrequency());
 
     //Create nodes
@@ -132,6 +118,7 @@ Network CrossCorrelation::calculate(ConnectivitySettings& connectivitySettings)
                 matDist,
                 mutex,
                 iNfft,
+                connectivitySettings.isStorageModeActive(),
                 tapers);
     };
 
@@ -150,23 +137,19 @@ Network CrossCorrelation::calculate(ConnectivitySettings& connectivitySettings)
 //    qWarning() << "ComputeSpectraPSDCSD" << iTime;
 //    timer.restart();
 
-    //Add edges to network
-    MatrixXd matWeight(1,1);
-    QSharedPointer<NetworkEdge> pEdge;
+    //Add the upper triangle row by row to the network
+    MatrixXd matPairWeights(matDist.rows()*(matDist.rows()+1)/2, 1);
     int j;
+    int iPair = 0;
 
     for(int i = 0; i < matDist.rows(); ++i) {
-        for(j = i; j < matDist.cols(); ++j) {
-            matWeight << matDist(i,j);
-
-            pEdge = QSharedPointer<NetworkEdge>(new NetworkEdge(i, j, matWeight));
-
-            finalNetwork.getNodeAt(i)->append(pEdge);
-            finalNetwork.getNodeAt(j)->append(pEdge);
-            finalNetwork.append(pEdge);
+        for(j = i; j < matDist.cols(); ++j, ++iPair) {
+            matPairWeights(iPair,0) = matDist(i,j);
         }
     }
 
+    finalNetwork.setPairWeights(std::move(matPairWeights));
+
 //    iTime = timer.elapsed();
 //    qWarning() << "Compute" << iTime;
 //    timer.restart();
@@ -180,49 +163,22 @@ void CrossCorrelation::compute(ConnectivitySettings::IntermediateTrialData& inpu
                                MatrixXd& matDist,
                                QMutex& mutex,
                                int iNfft,
+                               bool bStorageModeIsActive,
                                const QPair<MatrixXd, VectorXd>& tapers)
 {
 //    QElapsedTimer timer;
 //    qint64 iTime = 0;
 //    timer.start();
 
-    // Calculate tapered spectra if not available already
-    RowVectorXd vecInputFFT, rowData;
-    RowVectorXcd vecResultFreq;
-
-    FFT<double> fft;
-    fft.SetFlag(fft.HalfSpectrum);
-
-    int i, j;
     int iNRows = inputData.matData.rows();
+    int iNTapers = tapers.first.rows();
 
     // Calculate tapered spectra if not available already
-    // This code was copied and changed modified Utils/Spectra since we do not want to call the function due to time loss.
-    if(inputData.vecTapSpectra.isEmpty()) {
-        int iNFreqs = int(floor(iNfft / 2.0)) + 1;
-        MatrixXcd matTapSpectrum(tapers.first.rows(), iNFreqs);
-
-        for (i = 0; i < iNRows; ++i) {
-            // Substract mean
-            rowData.array() = inputData.matData.row(i).array() - inputData.matData.row(i).mean();
-
-            // Calculate tapered spectra
-            for(j = 0; j < tapers.first.rows(); j++) {
-                // Zero padd if necessary. The zero padding in Eigen's FFT is only working for column vectors.
-                if (rowData.cols() < iNfft) {
-                    vecInputFFT.setZero(iNfft);
-                    vecInputFFT.block(0,0,1,rowData.cols()) = rowData.cwiseProduct(tapers.first.row(j));;
-                } else {
-                    vecInputFFT = rowData.cwiseProduct(tapers.first.row(j));
-                }
-
-                // FFT for freq domain returning the half spectrum and multiply taper weights
-                fft.fwd(vecResultFreq, vecInputFFT, iNfft);
-                matTapSpectrum.row(j) = vecResultFreq * tapers.second(j);
-            }
-
-            inputData.vecTapSpectra.append(matTapSpectrum);
-        }
+    if(inputData.matTapSpectra.rows() != iNRows) {
+        CrossSpectralDensity::computeTaperedSpectra(inputData.matTapSpectra,
+                                                    inputData.matData,
+                                                    tapers,
+                                                    iNfft);
     }
 
 //    iTime = timer.elapsed();
@@ -232,22 +188,28 @@ void CrossCorrelation::compute(ConnectivitySettings::IntermediateTrialData& inpu
     // Perform multiplication and transform back to time domain to find max XCOR coefficient
     // Note that the result in time domain is mirrored around the center of the data (compared to Matlab)
     MatrixXd matDistTrial = MatrixXd::Zero(iNRows, iNRows);
-    RowVectorXcd vecResultXCor;
-    int idx = 0;
+    int iNFreqs = inputData.matTapSpectra.cols() / iNTapers;
     double denom = tapers.second.sum();
 
-    for(i = 0; i < inputData.vecTapSpectra.size(); ++i) {
-        vecResultFreq = inputData.vecTapSpectra.at(i).colwise().sum() / denom;
+    // Average over tapers once per row, one column per row
+    MatrixXcd matSpectra(iNFreqs, iNRows);
+
+    for(int f = 0; f < iNFreqs; ++f) {
+        matSpectra.row(f) = inputData.matTapSpectra.middleCols(f * iNTapers, iNTapers).rowwise().sum().transpose() / denom;
+    }
 
-        for(j = i; j < inputData.vecTapSpectra.size(); ++j) {
-            vecResultXCor = vecResultFreq.cwiseProduct(inputData.vecTapSpectra.at(j).colwise().sum() / denom);
+    // The products of row i with all rows j >= i are transformed back in one batch with the cached FFT plans
+    MatrixXcd matResultFreq;
+    MatrixXd matResultXCor;
 
-            fft.inv(vecInputFFT, vecResultXCor, iNfft);
+    for(int i = 0; i < iNRows; ++i) {
+        matResultFreq = matSpectra.rightCols(iNRows - i).array().colwise() * matSpectra.col(i).array();
 
-            vecInputFFT.maxCoeff(&idx);
+        Spectral::computeInverseHalfSpectra(matResultXCor,
+                                            matResultFreq,
+                                            iNfft);
 
-            matDistTrial(i,j) = vecInputFFT(idx);
-        }
+        matDistTrial.row(i).tail(iNRows - i) = matResultXCor.colwise().maxCoeff();
     }
 
 //    iTime = timer.elapsed();
@@ -270,7 +232,7 @@ void CrossCorrelation::compute(ConnectivitySettings::IntermediateTrialData& inpu
 //    qDebug() << QThread::currentThreadId() << "CrossCorrelation::compute timer - Summing up matDist:" << iTime;
 //    timer.restart();
 
-    if(!m_bStorageModeIsActive) {
-        inputData.vecTapSpectra.clear();
+    if(!bStorageModeIsActive) {
+        inputData.matTapSpectra.resize(0,0);
     }
 }
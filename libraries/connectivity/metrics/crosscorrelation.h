@@ -111,12 +111,14 @@ protected:
      * @param[out]   matDist             The sum of all edge weights.
      * @param[in]    mutex               The mutex used to safely access matDist.
      * @param[in]    iNfft               The FFT length.
+     * @param[in]    bStorageModeIsActive Whether to keep the tapered spectra of the trial.
      * @param[in]    tapers              The taper information.
      */
     static void compute(ConnectivitySettings::IntermediateTrialData& inputData,
                         Eigen::MatrixXd& matDist,
                         QMutex& mutex,
                         int iNfft,
+                        bool bStorageModeIsActive,
                         const QPair<Eigen::MatrixXd, Eigen::VectorXd>& tapers);
 };
 
@@ -0,0 +1,172 @@
+//=============================================================================================================
+/**
+ * @file     crossspectraldensity.cpp
+ * @author   Daniel Strohmeier <Daniel.Strohmeier@tu-ilmenau.de>;
+ *           Lorenz Esch <lesch@mgh.harvard.edu>
+ * @since    0.1.0
+ * @date     October, 2026
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2026, Daniel Strohmeier, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief     CrossSpectralDensity class definition.
+ *
+ */
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include "crossspectraldensity.h"
+
+#include <utils/spectral.h>
+
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace CONNECTIVITYLIB;
+using namespace Eigen;
+using namespace UTILSLIB;
+
+//=============================================================================================================
+// DEFINE GLOBAL METHODS
+//=============================================================================================================
+
+//=============================================================================================================
+// DEFINE MEMBER METHODS
+//=============================================================================================================
+
+void CrossSpectralDensity::computeTaperedSpectra(MatrixXcd& matTapSpectra,
+                                                 const MatrixXd& matData,
+                                                 const QPair<MatrixXd, VectorXd>& tapers,
+                                                 int iNfft)
+{
+    // All rows and tapers are transformed in one batch with the FFT plans cached for this thread. The mean is
+    // subtracted and the taper weights are multiplied while transforming, and the spectra are written in the
+    // interleaved layout directly. The trials are already processed in parallel, so no further threads are used here.
+    Spectral::computeTaperedSpectraMatrix(matTapSpectra,
+                                          matData,
+                                          tapers.first,
+                                          iNfft,
+                                          tapers.second,
+                                          true,
+                                          false);
+}
+
+//=============================================================================================================
+
+MatrixXcd CrossSpectralDensity::getTaperedSpectraRow(const MatrixXcd& matTapSpectra,
+                                                     int iRow,
+                                                     int iNTapers)
+{
+    if(iNTapers <= 0 || iRow < 0 || iRow >= matTapSpectra.rows()) {
+        return MatrixXcd();
+    }
+
+    const int iNFreqs = matTapSpectra.cols() / iNTapers;
+    MatrixXcd matTapSpectrum(iNTapers, iNFreqs);
+
+    for (int f = 0; f < iNFreqs; ++f) {
+        matTapSpectrum.col(f) = matTapSpectra.block(iRow, f * iNTapers, 1, iNTapers).transpose();
+    }
+
+    return matTapSpectrum;
+}
+
+//=============================================================================================================
+
+void CrossSpectralDensity::computePsd(MatrixXd& matPsd,
+                                      const MatrixXcd& matTapSpectra,
+                                      const VectorXd& vecTaperWeights,
+                                      int iNfft,
+                                      int iNBinStart,
+                                      int iNBinAmount)
+{
+    const int iNTapers = vecTaperWeights.rows();
+    const int iNFreqs = int(floor(iNfft / 2.0)) + 1;
+    const double denomPSD = vecTaperWeights.cwiseAbs2().sum() / 2.0;
+
+    matPsd.resize(matTapSpectra.rows(), iNBinAmount);
+
+    if(iNBinAmount <= 0) {
+        return;
+    }
+
+    // Compute PSD (average over tapers if necessary)
+    for (int b = 0; b < iNBinAmount; ++b) {
+        matPsd.col(b) = matTapSpectra.middleCols((iNBinStart + b) * iNTapers, iNTapers).cwiseAbs2().rowwise().sum() / denomPSD;
+    }
+
+    // Divide first and last element by 2 due to half spectrum
+    if(iNBinStart == 0) {
+        matPsd.col(0) /= 2.0;
+    }
+
+    if(iNfft % 2 == 0 && iNBinStart + iNBinAmount >= iNFreqs) {
+        matPsd.col(iNBinAmount - 1) /= 2.0;
+    }
+}
+
+//=============================================================================================================
+
+void CrossSpectralDensity::computeCsd(MatrixXcd& matCsd,
+                                      const MatrixXcd& matTapSpectra,
+                                      const VectorXd& vecTaperWeights,
+                                      int iNfft,
+                                      int iNBinStart,
+                                      int iNBinAmount)
+{
+    const int iNRows = matTapSpectra.rows();
+    const int iNTapers = vecTaperWeights.rows();
+    const int iNFreqs = int(floor(iNfft / 2.0)) + 1;
+    const double denomCSD = vecTaperWeights.cwiseAbs2().sum() / 2.0;
+
+    matCsd.resize(getNumberOfPairs(iNRows), iNBinAmount);
+
+    if(iNBinAmount <= 0) {
+        return;
+    }
+
+    MatrixXcd matBinCsd(iNRows, iNRows);
+
+    for (int b = 0; b < iNBinAmount; ++b) {
+        // Hermitian rank update with the (rows x tapers) block of this bin. Only the lower triangle is computed, which
+        // holds conj(CSD(i,j)) at (j,i). Hence column i holds the pairs (i,j), j >= i, contiguously.
+        matBinCsd.triangularView<Lower>().setZero();
+        matBinCsd.selfadjointView<Lower>().rankUpdate(matTapSpectra.middleCols((iNBinStart + b) * iNTapers, iNTapers), 1.0 / denomCSD);
+
+        for (int i = 0; i < iNRows; ++i) {
+            matCsd.col(b).segment(getPairIndex(i, i, iNRows), iNRows - i) = matBinCsd.col(i).tail(iNRows - i).conjugate();
+        }
+    }
+
+    // Divide first and last element by 2 due to half spectrum
+    if(iNBinStart == 0) {
+        matCsd.col(0) /= 2.0;
+    }
+
+    if(iNfft % 2 == 0 && iNBinStart + iNBinAmount >= iNFreqs) {
+        matCsd.col(iNBinAmount - 1) /= 2.0;
+    }
+}
@@ -0,0 +1,196 @@
+//=============================================================================================================
+/**
+ * @file     crossspectraldensity.h
+ * @author   Daniel Strohmeier <Daniel.Strohmeier@tu-ilmenau.de>;
+ *           Lorenz Esch <lesch@mgh.harvard.edu>
+ * @since    0.1.0
+ * @date     October, 2026
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2026, Daniel Strohmeier, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief     CrossSpectralDensity class declaration.
+ *
+ */
+
+#ifndef CROSSSPECTRALDENSITY_H
+#define CROSSSPECTRALDENSITY_H
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include "../connectivity_global.h"
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QPair>
+
+//=============================================================================================================
+// EIGEN INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+//=============================================================================================================
+// DEFINE NAMESPACE CONNECTIVITYLIB
+//=============================================================================================================
+
+namespace CONNECTIVITYLIB {
+
+//=============================================================================================================
+/**
+ * Computes the tapered spectra, PSD and all-pairs CSD of one trial for the spectral connectivity metrics.
+ *
+ * The tapered spectra of a trial are stored as one contiguous (frequency x taper x row) tensor, i.e. a matrix with
+ * one row per data row and the iNTapers columns of frequency bin f starting at column f * iNTapers. This way the
+ * Hermitian row x row CSD of a frequency bin is a single rank update (SYRK/HERK) of a contiguous block.
+ *
+ * The CSD is stored in a compact upper triangle layout: one row per pair (i,j) with i <= j, ordered by i and then
+ * j (see getPairIndex), and one column per used frequency bin. All metrics derive their values element-wise
+ * from this layout.
+ *
+ * @brief Computes tapered spectra, PSD and all-pairs CSD in a compact layout.
+ */
+class CONNECTIVITYSHARED_EXPORT CrossSpectralDensity
+{
+
+public:
+    //=========================================================================================================
+    /**
+     * deleted default constructor (static class).
+     */
+    CrossSpectralDensity() = delete;
+
+    //=========================================================================================================
+    /**
+     * Returns the number of pairs (i,j) with i <= j, i.e. the number of rows of the compact CSD layout.
+     *
+     * @param[in] iNRows     The number of data rows.
+     *
+     * @return The number of pairs.
+     */
+    static inline int getNumberOfPairs(int iNRows);
+
+    //=========================================================================================================
+    /**
+     * Returns the row of the pair (i,j) in the compact CSD layout.
+     *
+     * @param[in] i          The first row index.
+     * @param[in] j          The second row index, j >= i.
+     * @param[in] iNRows     The number of data rows.
+     *
+     * @return The row of the pair in the compact CSD layout.
+     */
+    static inline int getPairIndex(int i,
+                                   int j,
+                                   int iNRows);
+
+    //=========================================================================================================
+    /**
+     * Computes the tapered spectra of all (demeaned) data rows.
+     *
+     * @param[out] matTapSpectra     The tapered spectra (rows x (iNFreqs * iNTapers)), multiplied with the taper weights.
+     * @param[in]  matData           The data (rows x samples).
+     * @param[in]  tapers            The tapers and their weights.
+     * @param[in]  iNfft             The FFT length.
+     */
+    static void computeTaperedSpectra(Eigen::MatrixXcd& matTapSpectra,
+                                      const Eigen::MatrixXd& matData,
+                                      const QPair<Eigen::MatrixXd, Eigen::VectorXd>& tapers,
+                                      int iNfft);
+
+    //=========================================================================================================
+    /**
+     * Returns the tapered spectra of one data row in the (tapers x frequencies) layout of Spectral::computeTaperedSpectraRow.
+     *
+     * @param[in] matTapSpectra      The tapered spectra as computed by computeTaperedSpectra.
+     * @param[in] iRow               The data row.
+     * @param[in] iNTapers           The number of tapers.
+     *
+     * @return The tapered spectra of the row.
+     */
+    static Eigen::MatrixXcd getTaperedSpectraRow(const Eigen::MatrixXcd& matTapSpectra,
+                                                 int iRow,
+                                                 int iNTapers);
+
+    //=========================================================================================================
+    /**
+     * Computes the PSD of all data rows for the used frequency bins.
+     *
+     * @param[out] matPsd            The PSD (rows x iNBinAmount).
+     * @param[in]  matTapSpectra     The tapered spectra as computed by computeTaperedSpectra.
+     * @param[in]  vecTaperWeights   The taper weights.
+     * @param[in]  iNfft             The FFT length.
+     * @param[in]  iNBinStart        The first used frequency bin.
+     * @param[in]  iNBinAmount       The number of used frequency bins.
+     */
+    static void computePsd(Eigen::MatrixXd& matPsd,
+                           const Eigen::MatrixXcd& matTapSpectra,
+                           const Eigen::VectorXd& vecTaperWeights,
+                           int iNfft,
+                           int iNBinStart,
+                           int iNBinAmount);
+
+    //=========================================================================================================
+    /**
+     * Computes the CSD of all pairs (i,j) with i <= j for the used frequency bins. The CSD of one frequency bin is
+     * computed as one Hermitian rank update of the bin's (rows x tapers) block of tapered spectra.
+     *
+     * @param[out] matCsd            The CSD in the compact upper triangle layout (getNumberOfPairs(rows) x iNBinAmount).
+     * @param[in]  matTapSpectra     The tapered spectra as computed by computeTaperedSpectra.
+     * @param[in]  vecTaperWeights   The taper weights.
+     * @param[in]  iNfft             The FFT length.
+     * @param[in]  iNBinStart        The first used frequency bin.
+     * @param[in]  iNBinAmount       The number of used frequency bins.
+     */
+    static void computeCsd(Eigen::MatrixXcd& matCsd,
+                           const Eigen::MatrixXcd& matTapSpectra,
+                           const Eigen::VectorXd& vecTaperWeights,
+                           int iNfft,
+                           int iNBinStart,
+                           int iNBinAmount);
+};
+
+//=============================================================================================================
+// INLINE DEFINITIONS
+//=============================================================================================================
+
+inline int CrossSpectralDensity::getNumberOfPairs(int iNRows)
+{
+    return iNRows * (iNRows + 1) / 2;
+}
+
+//=============================================================================================================
+
+inline int CrossSpectralDensity::getPairIndex(int i,
+                                              int j,
+                                              int iNRows)
+{
+    return i * iNRows - i * (i - 1) / 2 + (j - i);
+}
+} // namespace CONNECTIVITYLIB
+
+#endif // CROSSSPECTRALDENSITY_H
@@ -45,6 +45,9 @@
 #include <utils/spectral.h>
 
 #include <limits>
+#include <vector>
+#include <algorithm>
+#include <functional>
 
 //=============================================================================================================
 // QT INCLUDES
@@ -74,7 +77,8 @@ using namespace UTILSLIB;
 
 Network::Network(const QString& sConnectivityMethod,
                  double dThreshold)
-: m_sConnectivityMethod(sConnectivityMethod)
+: m_minMaxFreqBins(QPair<int,int>(-1,-1))
+, m_sConnectivityMethod(sConnectivityMethod)
 , m_minMaxFullWeights(QPair<double,double>(std::numeric_limits<double>::max(),0.0))
 , m_minMaxThresholdedWeights(QPair<double,double>(std::numeric_limits<double>::max(),0.0))
 , m_dThreshold(dThreshold)
@@ -95,6 +99,26 @@ MatrixXd Network::getFullConnectivityMatrix(bool bGetMirroredVersion) const
     MatrixXd matDist(m_lNodes.size(), m_lNodes.size());
     matDist.setZero();
 
+    if(isCompact()) {
+        int i,j;
+        int iPair = 0;
+
+        for(i = 0; i < matDist.rows(); ++i) {
+            // Skip the pair (i,i)
+            ++iPair;
+
+            for(j = i + 1; j < matDist.cols(); ++j, ++iPair) {
+                matDist(i,j) = m_vecPairWeights(iPair);
+
+                if(bGetMirroredVersion) {
+                    matDist(j,i) = m_vecPairWeights(iPair);
+                }
+            }
+        }
+
+        return matDist;
+    }
+
     for(int i = 0; i < m_lFullEdges.size(); ++i) {
         int row = m_lFullEdges.at(i)->getStartNodeID();
         int col = m_lFullEdges.at(i)->getEndNodeID();
@@ -119,6 +143,28 @@ MatrixXd Network::getThresholdedConnectivityMatrix(bool bGetMirroredVersion) con
     MatrixXd matDist(m_lNodes.size(), m_lNodes.size());
     matDist.setZero();
 
+    if(isCompact()) {
+        int i,j;
+        int iPair = 0;
+
+        for(i = 0; i < matDist.rows(); ++i) {
+            // Skip the pair (i,i)
+            ++iPair;
+
+            for(j = i + 1; j < matDist.cols(); ++j, ++iPair) {
+                if(fabs(m_vecPairWeights(iPair)) >= m_dThreshold) {
+                    matDist(i,j) = m_vecPairWeights(iPair);
+
+                    if(bGetMirroredVersion) {
+                        matDist(j,i) = m_vecPairWeights(iPair);
+                    }
+                }
+            }
+        }
+
+        return matDist;
+    }
+
     for(int i = 0; i < m_lThresholdedEdges.size(); ++i) {
         int row = m_lThresholdedEdges.at(i)->getStartNodeID();
         int col = m_lThresholdedEdges.at(i)->getEndNodeID();
@@ -138,16 +184,52 @@ MatrixXd Network::getThresholdedConnectivityMatrix(bool bGetMirroredVersion) con
 
 //=============================================================================================================
 
-const QList<NetworkEdge::SPtr>& Network::getFullEdges() const
+QList<NetworkEdge::SPtr> Network::getFullEdges() const
 {
-    return m_lFullEdges;
+    if(!isCompact()) {
+        return m_lFullEdges;
+    }
+
+    QList<NetworkEdge::SPtr> lEdges;
+    int i,j;
+    int iPair = 0;
+
+    for(i = 0; i < m_lNodes.size(); ++i) {
+        // Skip the pair (i,i)
+        ++iPair;
+
+        for(j = i + 1; j < m_lNodes.size(); ++j, ++iPair) {
+            lEdges << createPairEdge(i, j, iPair);
+        }
+    }
+
+    return lEdges;
 }
 
 //=============================================================================================================
 
-const QList<NetworkEdge::SPtr>& Network::getThresholdedEdges() const
+QList<NetworkEdge::SPtr> Network::getThresholdedEdges() const
 {
-    return m_lThresholdedEdges;
+    if(!isCompact()) {
+        return m_lThresholdedEdges;
+    }
+
+    QList<NetworkEdge::SPtr> lEdges;
+    int i,j;
+    int iPair = 0;
+
+    for(i = 0; i < m_lNodes.size(); ++i) {
+        // Skip the pair (i,i)
+        ++iPair;
+
+        for(j = i + 1; j < m_lNodes.size(); ++j, ++iPair) {
+            if(fabs(m_vecPairWeights(iPair)) >= m_dThreshold) {
+                lEdges << createPairEdge(i, j, iPair);
+            }
+        }
+    }
+
+    return lEdges;
 }
 
 //=============================================================================================================
@@ -170,6 +252,14 @@ qint16 Network::getFullDistribution() const
 {
     qint16 distribution = 0;
 
+    if(isCompact()) {
+        VectorXi vecIndegrees, vecOutdegrees;
+        getCompactDegrees(false, vecIndegrees, vecOutdegrees);
+        distribution = vecIndegrees.sum() + vecOutdegrees.sum();
+
+        return distribution;
+    }
+
     for(int i = 0; i < m_lNodes.size(); ++i) {
         distribution += m_lNodes.at(i)->getFullDegree();
     }
@@ -183,6 +273,14 @@ qint16 Network::getThresholdedDistribution() const
 {
     qint16 distribution = 0;
 
+    if(isCompact()) {
+        VectorXi vecIndegrees, vecOutdegrees;
+        getCompactDegrees(true, vecIndegrees, vecOutdegrees);
+        distribution = vecIndegrees.sum() + vecOutdegrees.sum();
+
+        return distribution;
+    }
+
     for(int i = 0; i < m_lNodes.size(); ++i) {
         distribution += m_lNodes.at(i)->getThresholdedDegree();
     }
@@ -192,6 +290,26 @@ qint16 Network::getThresholdedDistribution() const
 
 //=============================================================================================================
 
+VectorXi Network::getThresholdedDegrees() const
+{
+    if(isCompact()) {
+        VectorXi vecIndegrees, vecOutdegrees;
+        getCompactDegrees(true, vecIndegrees, vecOutdegrees);
+
+        return vecIndegrees + vecOutdegrees;
+    }
+
+    VectorXi vecDegrees(m_lNodes.size());
+
+    for(int i = 0; i < m_lNodes.size(); ++i) {
+        vecDegrees(i) = m_lNodes.at(i)->getThresholdedDegree();
+    }
+
+    return vecDegrees;
+}
+
+//=============================================================================================================
+
 void Network::setConnectivityMethod(const QString& sConnectivityMethod)
 {
     m_sConnectivityMethod = sConnectivityMethod;
@@ -225,6 +343,14 @@ QPair<int,int> Network::getMinMaxFullDegrees() const
     int maxDegree = 0;
     int minDegree = 1000000;
 
+    if(isCompact()) {
+        VectorXi vecIndegrees, vecOutdegrees;
+        getCompactDegrees(false, vecIndegrees, vecOutdegrees);
+        VectorXi vecDegrees = vecIndegrees + vecOutdegrees;
+
+        return QPair<int,int>(vecDegrees.minCoeff(), vecDegrees.maxCoeff());
+    }
+
     for(int i = 0; i < m_lNodes.size(); ++i) {
         if(m_lNodes.at(i)->getFullDegree() > maxDegree){
             maxDegree = m_lNodes.at(i)->getFullDegree();
@@ -243,6 +369,14 @@ QPair<int,int> Network::getMinMaxThresholdedDegrees() const
     int maxDegree = 0;
     int minDegree = 1000000;
 
+    if(isCompact()) {
+        VectorXi vecIndegrees, vecOutdegrees;
+        getCompactDegrees(true, vecIndegrees, vecOutdegrees);
+        VectorXi vecDegrees = vecIndegrees + vecOutdegrees;
+
+        return QPair<int,int>(vecDegrees.minCoeff(), vecDegrees.maxCoeff());
+    }
+
     for(int i = 0; i < m_lNodes.size(); ++i) {
         if(m_lNodes.at(i)->getThresholdedDegree() > maxDegree){
             maxDegree = m_lNodes.at(i)->getThresholdedDegree();
@@ -261,6 +395,14 @@ QPair<int,int> Network::getMinMaxFullIndegrees() const
     int maxDegree = 0;
     int minDegree = 1000000;
 
+    if(isCompact()) {
+        VectorXi vecIndegrees, vecOutdegrees;
+        getCompactDegrees(false, vecIndegrees, vecOutdegrees);
+        VectorXi vecDegrees = vecIndegrees;
+
+        return QPair<int,int>(vecDegrees.minCoeff(), vecDegrees.maxCoeff());
+    }
+
     for(int i = 0; i < m_lNodes.size(); ++i) {
         if(m_lNodes.at(i)->getFullIndegree() > maxDegree){
             maxDegree = m_lNodes.at(i)->getFullIndegree();
@@ -279,6 +421,14 @@ QPair<int,int> Network::getMinMaxThresholdedIndegrees() const
     int maxDegree = 0;
     int minDegree = 1000000;
 
+    if(isCompact()) {
+        VectorXi vecIndegrees, vecOutdegrees;
+        getCompactDegrees(true, vecIndegrees, vecOutdegrees);
+        VectorXi vecDegrees = vecIndegrees;
+
+        return QPair<int,int>(vecDegrees.minCoeff(), vecDegrees.maxCoeff());
+    }
+
     for(int i = 0; i < m_lNodes.size(); ++i) {
         if(m_lNodes.at(i)->getThresholdedIndegree() > maxDegree){
             maxDegree = m_lNodes.at(i)->getThresholdedIndegree();
@@ -297,6 +447,14 @@ QPair<int,int> Network::getMinMaxFullOutdegrees() const
     int maxDegree = 0;
     int minDegree = 1000000;
 
+    if(isCompact()) {
+        VectorXi vecIndegrees, vecOutdegrees;
+        getCompactDegrees(false, vecIndegrees, vecOutdegrees);
+        VectorXi vecDegrees = vecOutdegrees;
+
+        return QPair<int,int>(vecDegrees.minCoeff(), vecDegrees.maxCoeff());
+    }
+
     for(int i = 0; i < m_lNodes.size(); ++i) {
         if(m_lNodes.at(i)->getFullOutdegree() > maxDegree){
             maxDegree = m_lNodes.at(i)->getFullOutdegree();
@@ -315,6 +473,14 @@ QPair<int,int> Network::getMinMaxThresholdedOutdegrees() const
     int maxDegree = 0;
     int minDegree = 1000000;
 
+    if(isCompact()) {
+        VectorXi vecIndegrees, vecOutdegrees;
+        getCompactDegrees(true, vecIndegrees, vecOutdegrees);
+        VectorXi vecDegrees = vecOutdegrees;
+
+        return QPair<int,int>(vecDegrees.minCoeff(), vecDegrees.maxCoeff());
+    }
+
     for(int i = 0; i < m_lNodes.size(); ++i) {
         if(m_lNodes.at(i)->getThresholdedOutdegree() > maxDegree){
             maxDegree = m_lNodes.at(i)->getThresholdedOutdegree();
@@ -355,6 +521,53 @@ double Network::getThreshold()
 
 //=============================================================================================================
 
+void Network::setThresholdByNumberEdges(int iNumberEdges)
+{
+    std::vector<double> vecWeights;
+
+    if(isCompact()) {
+        vecWeights.reserve(m_vecPairWeights.size() - m_lNodes.size());
+
+        int i,j;
+        int iPair = 0;
+
+        for(i = 0; i < m_lNodes.size(); ++i) {
+            // Skip the pair (i,i)
+            ++iPair;
+
+            for(j = i + 1; j < m_lNodes.size(); ++j, ++iPair) {
+                vecWeights.push_back(fabs(m_vecPairWeights(iPair)));
+            }
+        }
+    } else {
+        vecWeights.reserve(m_lFullEdges.size());
+
+        for(int i = 0; i < m_lFullEdges.size(); ++i) {
+            vecWeights.push_back(fabs(m_lFullEdges.at(i)->getWeight()));
+        }
+    }
+
+    if(iNumberEdges <= 0) {
+        setThreshold(std::numeric_limits<double>::max());
+        return;
+    }
+
+    if(iNumberEdges >= int(vecWeights.size())) {
+        setThreshold(0.0);
+        return;
+    }
+
+    // Only partially sort the weights until the iNumberEdges-th strongest weight is in place
+    std::nth_element(vecWeights.begin(),
+                     vecWeights.begin() + iNumberEdges - 1,
+                     vecWeights.end(),
+                     std::greater<double>());
+
+    setThreshold(vecWeights[iNumberEdges - 1]);
+}
+
+//=============================================================================================================
+
 void Network::setFrequencyRange(float fLowerFreq, float fUpperFreq)
 {
     if(fLowerFreq > fUpperFreq || fUpperFreq < fLowerFreq) {
@@ -385,6 +598,12 @@ void Network::setFrequencyRange(float fLowerFreq, float fUpperFreq)
     int iLowerBin = fLowerFreq * dScaleFactor;
     int iUpperBin = fUpperFreq * dScaleFactor;
 
+    if(isCompact()) {
+        m_minMaxFreqBins = QPair<int,int>(iLowerBin,iUpperBin);
+        calculateAveragedPairWeights();
+        return;
+    }
+
     // Update the min max values
     m_minMaxFullWeights = QPair<double,double>(std::numeric_limits<double>::max(),0.0);
 
@@ -410,6 +629,11 @@ const QPair<float,float>& Network::getFrequencyRange() const
 
 void Network::append(NetworkEdge::SPtr newEdge)
 {
+    if(isCompact()) {
+        qDebug() << "Network::append - The weights are stored compactly. Edges can not be appended. Returning.";
+        return;
+    }
+
     if(newEdge->getEndNodeID() != newEdge->getStartNodeID()) {
         double dEdgeWeight = newEdge->getWeight();
         if(dEdgeWeight < m_minMaxFullWeights.first) {
@@ -435,9 +659,44 @@ void Network::append(NetworkNode::SPtr newNode)
 
 //=============================================================================================================
 
+void Network::setPairWeights(const MatrixXd& matPairWeights)
+{
+    setPairWeights(MatrixXd(matPairWeights));
+}
+
+//=============================================================================================================
+
+void Network::setPairWeights(MatrixXd&& matPairWeights)
+{
+    const int iNumberNodes = m_lNodes.size();
+
+    if(iNumberNodes == 0 || matPairWeights.rows() != iNumberNodes*(iNumberNodes+1)/2) {
+        qDebug() << "Network::setPairWeights - Number of pairs does not match the number of nodes. Returning.";
+        return;
+    }
+
+    if(!m_lFullEdges.isEmpty()) {
+        qDebug() << "Network::setPairWeights - Network already holds edge objects. Returning.";
+        return;
+    }
+
+    m_pMatPairWeights = QSharedPointer<const MatrixXd>(new MatrixXd(std::move(matPairWeights)));
+
+    calculateAveragedPairWeights();
+}
+
+//=============================================================================================================
+
+bool Network::isCompact() const
+{
+    return !m_pMatPairWeights.isNull();
+}
+
+//=============================================================================================================
+
 bool Network::isEmpty() const
 {
-    if(m_lFullEdges.isEmpty() || m_lNodes.isEmpty()) {
+    if((m_lFullEdges.isEmpty() && !isCompact()) || m_lNodes.isEmpty()) {
         return true;
     }
 
@@ -454,6 +713,13 @@ void Network::normalize()
         return;
     }
 
+    if(isCompact()) {
+        m_vecPairWeights /= m_minMaxFullWeights.second;
+
+        // Scale the threshold as well, so that the same edges stay above it
+        m_dThreshold /= m_minMaxFullWeights.second;
+    }
+
     for(int i = 0; i < m_lFullEdges.size(); ++i) {
         m_lFullEdges.at(i)->setWeight(m_lFullEdges.at(i)->getWeight()/m_minMaxFullWeights.second);
     }
@@ -521,3 +787,97 @@ int Network::getFFTSize()
     return m_iFFTSize;
 }
 
+//=============================================================================================================
+
+void Network::calculateAveragedPairWeights()
+{
+    if(!isCompact()) {
+        return;
+    }
+
+    const MatrixXd& matPairWeights = *m_pMatPairWeights;
+    int iStartWeightBin = m_minMaxFreqBins.first;
+    int iEndWeightBin = m_minMaxFreqBins.second;
+    int iNumberBins = matPairWeights.cols();
+
+    if(iStartWeightBin == -1 && iEndWeightBin == -1) {
+        m_vecPairWeights = matPairWeights.rowwise().mean();
+    } else if(iStartWeightBin >= 0 && iEndWeightBin >= iStartWeightBin && iStartWeightBin < iNumberBins) {
+        // The bins are stored column by column, so averaging a frequency range sweeps over contiguous memory
+        m_vecPairWeights = matPairWeights.middleCols(iStartWeightBin, qMin(iEndWeightBin, iNumberBins - 1) - iStartWeightBin + 1).rowwise().mean();
+    } else if(m_vecPairWeights.size() != matPairWeights.rows()) {
+        m_vecPairWeights = matPairWeights.rowwise().mean();
+    }
+
+    // Update the min max values
+    m_minMaxFullWeights = QPair<double,double>(std::numeric_limits<double>::max(),0.0);
+
+    int i,j;
+    int iPair = 0;
+    double dWeight;
+
+    for(i = 0; i < m_lNodes.size(); ++i) {
+        // Skip the pair (i,i)
+        ++iPair;
+
+        for(j = i + 1; j < m_lNodes.size(); ++j, ++iPair) {
+            dWeight = fabs(m_vecPairWeights(iPair));
+
+            if(dWeight < m_minMaxFullWeights.first) {
+                m_minMaxFullWeights.first = dWeight;
+            }
+
+            if(dWeight > m_minMaxFullWeights.second) {
+                m_minMaxFullWeights.second = dWeight;
+            }
+        }
+    }
+}
+
+//=============================================================================================================
+
+void Network::getCompactDegrees(bool bThresholded,
+                                VectorXi& vecIndegrees,
+                                VectorXi& vecOutdegrees) const
+{
+    vecIndegrees = VectorXi::Zero(m_lNodes.size());
+    vecOutdegrees = VectorXi::Zero(m_lNodes.size());
+
+    if(!isCompact()) {
+        return;
+    }
+
+    int i,j;
+    int iPair = 0;
+
+    for(i = 0; i < m_lNodes.size(); ++i) {
+        // Skip the pair (i,i)
+        ++iPair;
+
+        for(j = i + 1; j < m_lNodes.size(); ++j, ++iPair) {
+            if(!bThresholded || fabs(m_vecPairWeights(iPair)) >= m_dThreshold) {
+                ++vecOutdegrees(i);
+                ++vecIndegrees(j);
+            }
+        }
+    }
+}
+
+//=============================================================================================================
+
+NetworkEdge::SPtr Network::createPairEdge(int iStartNodeID,
+                                          int iEndNodeID,
+                                          int iPair) const
+{
+    NetworkEdge::SPtr pEdge = NetworkEdge::SPtr(new NetworkEdge(iStartNodeID,
+                                                                iEndNodeID,
+                                                                m_pMatPairWeights->row(iPair).transpose(),
+                                                                fabs(m_vecPairWeights(iPair)) >= m_dThreshold,
+                                                                m_minMaxFreqBins.first,
+                                                                m_minMaxFreqBins.second));
+
+    // Keep the current (e.g. normalized) averaged weight
+    pEdge->setWeight(m_vecPairWeights(iPair));
+
+    return pEdge;
+}
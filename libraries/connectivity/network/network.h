@@ -81,6 +81,11 @@ struct VisualizationInfo {
 /**
  * This class holds information (nodes and connecting edges) about a network, can compute a distance table and provide network metrics.
  *
+ * The edges can either be stored as NetworkEdge objects (see append) or compactly as one matrix holding the frequency
+ * resolved weights of all node pairs (see setPairWeights). The compact storage does not create any edge objects. The
+ * pair weight matrix is shared between copies of the network, so that networks can be passed around and buffered
+ * without copying the weights. Edge objects are only created on demand, e.g. by getThresholdedEdges.
+ *
  * @brief This class holds information about a network, can compute a distance table and provide network metrics.
  */
 
@@ -127,19 +132,21 @@ public:
 
     //=========================================================================================================
     /**
-     * Returns the full and non thresholded edges.
+     * Returns the full and non thresholded edges. If the weights are stored compactly, the edges are created from the
+     * pair weights on each call and are not attached to the nodes.
      *
      * @return Returns the network edges.
      */
-    const QList<QSharedPointer<NetworkEdge> >& getFullEdges() const;
+    QList<QSharedPointer<NetworkEdge> > getFullEdges() const;
 
     //=========================================================================================================
     /**
-     * Returns the thresholded edges.
+     * Returns the thresholded edges. If the weights are stored compactly, only the edges above the threshold are
+     * created from the pair weights on each call and are not attached to the nodes.
      *
      * @return Returns the network edges.
      */
-    const QList<QSharedPointer<NetworkEdge> >& getThresholdedEdges() const;
+    QList<QSharedPointer<NetworkEdge> > getThresholdedEdges() const;
 
     //=========================================================================================================
     /**
@@ -185,6 +192,14 @@ public:
      */
     qint16 getThresholdedDistribution() const;
 
+    //=========================================================================================================
+    /**
+     * Returns the degree of each node corresponding to the thresholded network.
+     *
+     * @return   The thresholded degree of each node.
+     */
+    Eigen::VectorXi getThresholdedDegrees() const;
+
     //=========================================================================================================
     /**
      * Sets the connectivity measure method used to create the data of this network structure.
@@ -281,6 +296,16 @@ public:
      */
     double getThreshold();
 
+    //=========================================================================================================
+    /**
+     * Sets the threshold of the network so that only the iNumberEdges strongest edges (absolute weight) are active.
+     * The threshold is found with a partial sort of the edge weights. Edges with the same weight as the weakest
+     * selected edge are kept as well.
+     *
+     * @param[in] iNumberEdges      The number of strongest edges to keep.
+     */
+    void setThresholdByNumberEdges(int iNumberEdges);
+
     //=========================================================================================================
     /**
      * Sets the frequency range to average from/to.
@@ -314,6 +339,33 @@ public:
      */
     void append(QSharedPointer<NetworkNode> newNode);
 
+    //=========================================================================================================
+    /**
+     * Stores the weights of all node pairs compactly instead of as edge objects. The pairs (i,j) with j >= i are
+     * stored row by row of the upper triangle, i.e. pair (i,j) is found at row i*N - i*(i-1)/2 + (j-i). The pairs
+     * with i == j are part of the layout but are not treated as edges. Must not be combined with appending edges.
+     * The nodes have to be appended first.
+     *
+     * @param[in] matPairWeights    The weights of the node pairs (N*(N+1)/2 pairs x frequency bins).
+     */
+    void setPairWeights(const Eigen::MatrixXd& matPairWeights);
+
+    //=========================================================================================================
+    /**
+     * Stores the weights of all node pairs compactly without copying them. See setPairWeights above.
+     *
+     * @param[in] matPairWeights    The weights of the node pairs (N*(N+1)/2 pairs x frequency bins).
+     */
+    void setPairWeights(Eigen::MatrixXd&& matPairWeights);
+
+    //=========================================================================================================
+    /**
+     * Returns whether the weights are stored compactly as pair weights.
+     *
+     * @return   Whether the weights are stored compactly.
+     */
+    bool isCompact() const;
+
     //=========================================================================================================
     /**
      * Returns whether the Network is empty by checking the number of nodes and edges.
@@ -393,11 +445,48 @@ public:
     int getFFTSize();
 
 protected:
+    //=========================================================================================================
+    /**
+     * Averages the compactly stored pair weights over the current frequency bins and updates the minimum and
+     * maximum weights.
+     */
+    void calculateAveragedPairWeights();
+
+    //=========================================================================================================
+    /**
+     * Counts the in- and outdegrees of the nodes from the compactly stored pair weights.
+     *
+     * @param[in] bThresholded      Whether to only count edges above the current threshold.
+     * @param[out] vecIndegrees     The indegree of each node.
+     * @param[out] vecOutdegrees    The outdegree of each node.
+     */
+    void getCompactDegrees(bool bThresholded,
+                           Eigen::VectorXi& vecIndegrees,
+                           Eigen::VectorXi& vecOutdegrees) const;
+
+    //=========================================================================================================
+    /**
+     * Creates an edge object from the compactly stored weights of a node pair.
+     *
+     * @param[in] iStartNodeID      The start node id of the edge.
+     * @param[in] iEndNodeID        The end node id of the edge.
+     * @param[in] iPair             The index of the pair in the pair weights.
+     *
+     * @return The new edge.
+     */
+    QSharedPointer<NetworkEdge> createPairEdge(int iStartNodeID,
+                                               int iEndNodeID,
+                                               int iPair) const;
+
     QList<QSharedPointer<NetworkEdge> >     m_lFullEdges;               /**< List with all edges of the network.*/
     QList<QSharedPointer<NetworkEdge> >     m_lThresholdedEdges;        /**< List with all the active (thresholded) edges of the network.*/
 
     QList<QSharedPointer<NetworkNode> >     m_lNodes;                   /**< List with all nodes of the network.*/
 
+    QSharedPointer<const Eigen::MatrixXd>   m_pMatPairWeights;          /**< The compactly stored weights of all node pairs (pairs x frequency bins). Shared between copies of the network.*/
+    Eigen::VectorXd                         m_vecPairWeights;           /**< The averaged weight of each node pair.*/
+    QPair<int,int>                          m_minMaxFreqBins;           /**< The lower/upper frequency bins to average the pair weights from/to. -1 means an average over all bins.*/
+
     Eigen::MatrixXd                         m_matDistMatrix;            /**< The distance matrix.*/
 
     QString                                 m_sConnectivityMethod;      /**< The connectivity measure method used to create the data of this network structure.*/
@@ -69,6 +69,7 @@ AveragingSettingsView::AveragingSettingsView(const QString& sSettingsPath,
 : AbstractView(parent)
 , m_pUi(new Ui::AverageSettingsViewWidget)
 , m_mapStimChsIndexNames(mapStimChsIndexNames)
+, m_bCumulativeAverage(false)
 {
     m_sSettingsPath = sSettingsPath;
     m_pUi->setupUi(this);
@@ -134,6 +135,13 @@ int AveragingSettingsView::getNumAverages()
 
 //=============================================================================================================
 
+bool AveragingSettingsView::getCumulativeAverage()
+{
+    return m_bCumulativeAverage;
+}
+
+//=============================================================================================================
+
 int AveragingSettingsView::getBaselineFromSeconds()
 {
     return m_iBaselineFromSeconds;
@@ -190,6 +198,12 @@ void AveragingSettingsView::redrawGUI()
     connect(m_pUi->m_pSpinBoxNumAverages, static_cast<void (QSpinBox::*)()>(&QSpinBox::editingFinished),
             this, &AveragingSettingsView::onChangeNumAverages);
 
+    //The number of averages only applies to the moving average
+    m_pUi->m_pCheckBoxCumulativeAverage->setChecked(m_bCumulativeAverage);
+    m_pUi->m_pSpinBoxNumAverages->setEnabled(!m_bCumulativeAverage);
+    connect(m_pUi->m_pCheckBoxCumulativeAverage, &QCheckBox::clicked,
+            this, &AveragingSettingsView::onChangeCumulativeAverage);
+
     //Pre Post stimulus
     m_pUi->m_pSpinBoxPreStimMSeconds->setValue(m_iPreStimSeconds);
     connect(m_pUi->m_pSpinBoxPreStimMSeconds, static_cast<void (QSpinBox::*)()>(&QSpinBox::editingFinished),
@@ -288,6 +302,7 @@ void AveragingSettingsView::saveSettings()
     settings.setValue(m_sSettingsPath + QString("/AveragingSettingsView/preStimSeconds"), m_iPreStimSeconds);
     settings.setValue(m_sSettingsPath + QString("/AveragingSettingsView/postStimSeconds"), m_iPostStimSeconds);
     settings.setValue(m_sSettingsPath + QString("/AveragingSettingsView/numAverages"), m_iNumAverages);
+    settings.setValue(m_sSettingsPath + QString("/AveragingSettingsView/cumulativeAverage"), m_bCumulativeAverage);
     settings.setValue(m_sSettingsPath + QString("/AveragingSettingsView/currentStimChannel"), m_sCurrentStimChan);
     settings.setValue(m_sSettingsPath + QString("/AveragingSettingsView/baselineFromSeconds"), m_iBaselineFromSeconds);
     settings.setValue(m_sSettingsPath + QString("/AveragingSettingsView/baselineToSeconds"), m_iBaselineToSeconds);
@@ -319,6 +334,7 @@ void AveragingSettingsView::loadSettings()
     }
 
     m_iNumAverages = settings.value(m_sSettingsPath + QString("/AveragingSettingsView/numAverages"), 10).toInt();
+    m_bCumulativeAverage = settings.value(m_sSettingsPath + QString("/AveragingSettingsView/cumulativeAverage"), false).toBool();
     m_sCurrentStimChan = settings.value(m_sSettingsPath + QString("/AveragingSettingsView/currentStimChannel"), "STI014").toString();
     m_bDoBaselineCorrection = settings.value(m_sSettingsPath + QString("/AveragingSettingsView/doBaselineCorrection"), false).toBool();
 }
@@ -342,6 +358,7 @@ void AveragingSettingsView::updateProcessingMode(ProcessingMode mode)
     switch(mode) {
         case ProcessingMode::Offline:
             m_pUi->m_pSpinBoxNumAverages->hide();
+            m_pUi->m_pCheckBoxCumulativeAverage->hide();
             m_pUi->m_pComboBoxChSelection->hide();
             m_pUi->m_pushButton_reset->hide();
             m_pUi->label->hide();
@@ -353,6 +370,7 @@ void AveragingSettingsView::updateProcessingMode(ProcessingMode mode)
             break;
         default: // default is realtime mode
             m_pUi->m_pSpinBoxNumAverages->show();
+            m_pUi->m_pCheckBoxCumulativeAverage->show();
             m_pUi->m_pComboBoxChSelection->show();
             m_pUi->m_pushButton_reset->show();
             m_pUi->label->show();
@@ -435,6 +453,18 @@ void AveragingSettingsView::onChangeNumAverages()
 
 //=============================================================================================================
 
+void AveragingSettingsView::onChangeCumulativeAverage()
+{
+    m_bCumulativeAverage = m_pUi->m_pCheckBoxCumulativeAverage->isChecked();
+    m_pUi->m_pSpinBoxNumAverages->setEnabled(!m_bCumulativeAverage);
+
+    emit changeCumulativeAverage(m_bCumulativeAverage);
+
+    saveSettings();
+}
+
+//=============================================================================================================
+
 void AveragingSettingsView::onChangeStimChannel()
 {
     m_sCurrentStimChan = m_pUi->m_pComboBoxChSelection->currentText();
@@ -107,6 +107,8 @@ public:
 
     int getNumAverages();
 
+    bool getCumulativeAverage();
+
     int getBaselineFromSeconds();
 
     int getBaselineToSeconds();
@@ -165,6 +167,7 @@ protected:
     void onChangeBaselineFrom();
     void onChangeBaselineTo();
     void onChangeNumAverages();    
+    void onChangeCumulativeAverage();
     void onChangeStimChannel();
 
     Ui::AverageSettingsViewWidget* m_pUi;              /**< Holds the user interface for the AverageSettingsViewWidget.*/
@@ -174,6 +177,7 @@ protected:
     QMap<QString,int>   m_mapStimChsIndexNames;
 
     int                 m_iNumAverages;
+    bool                m_bCumulativeAverage;
     int                 m_iPreStimSeconds;
     int                 m_iPostStimSeconds;
     int                 m_iBaselineFromSeconds;
@@ -186,6 +190,7 @@ signals:
     void changeBaselineFrom(qint32 value);
     void changeBaselineTo(qint32 value);
     void changeNumAverages(qint32 value);
+    void changeCumulativeAverage(bool state);
     void changeStimChannel(const QString& sStimName);
     void changeBaselineActive(bool state);
     void resetAverage(bool state);
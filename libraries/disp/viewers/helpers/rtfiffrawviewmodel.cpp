@@ -46,6 +46,7 @@
 #include <utils/ioutils.h>
 
 #include <rtprocessing/sphara.h>
+#include <rtprocessing/filter.h>
 #include <rtprocessing/detecttrigger.h>
 
 //=============================================================================================================
@@ -404,7 +405,7 @@ MatrixXd RtFiffRawViewModel::getLastBlock()
 
 //=============================================================================================================
 
-void RtFiffRawViewModel::addData(const QList<MatrixXd> &data)
+void RtFiffRawViewModel::addData(const QList<SampleBlock> &data)
 {
     //SSP
     bool doProj = m_bProjActivated && m_matDataRaw.cols() > 0 && m_matDataRaw.rows() == m_matProj.cols() ? true : false;
@@ -417,8 +418,9 @@ void RtFiffRawViewModel::addData(const QList<MatrixXd> &data)
 
     //Copy new data into the global data matrix
     for(qint32 b = 0; b < data.size(); ++b) {
-        int nCol = data.at(b).cols();
-        int nRow = data.at(b).rows();
+        const MatrixXd& matBlock = data.at(b).data();
+        int nCol = matBlock.cols();
+        int nRow = matBlock.rows();
 
         if(nRow != m_matDataRaw.rows()) {
             qDebug()<<"incoming data does not match internal data row size. Returning...";
@@ -441,19 +443,19 @@ void RtFiffRawViewModel::addData(const QList<MatrixXd> &data)
             if(doComp) {
                 if(doProj) {
                     //Comp + Proj
-                    m_matDataRaw.block(0, m_iCurrentSample, nRow, m_iResidual) = m_matSparseProjCompMult * data.at(b).block(0,0,nRow,m_iResidual);
+                    m_matDataRaw.block(0, m_iCurrentSample, nRow, m_iResidual) = m_matSparseProjCompMult * matBlock.block(0,0,nRow,m_iResidual);
                 } else {
                     //Comp
-                    m_matDataRaw.block(0, m_iCurrentSample, nRow, m_iResidual) = m_matSparseCompMult * data.at(b).block(0,0,nRow,m_iResidual);
+                    m_matDataRaw.block(0, m_iCurrentSample, nRow, m_iResidual) = m_matSparseCompMult * matBlock.block(0,0,nRow,m_iResidual);
                 }
             } else {
                 if(doProj)
                 {
                     //Proj
-                    m_matDataRaw.block(0, m_iCurrentSample, nRow, m_iResidual) = m_matSparseProjMult * data.at(b).block(0,0,nRow,m_iResidual);
+                    m_matDataRaw.block(0, m_iCurrentSample, nRow, m_iResidual) = m_matSparseProjMult * matBlock.block(0,0,nRow,m_iResidual);
                 } else {
                     //None - Raw
-                    m_matDataRaw.block(0, m_iCurrentSample, nRow, m_iResidual) = data.at(b).block(0,0,nRow,m_iResidual);
+                    m_matDataRaw.block(0, m_iCurrentSample, nRow, m_iResidual) = matBlock.block(0,0,nRow,m_iResidual);
                 }
             }
 
@@ -484,18 +486,18 @@ void RtFiffRawViewModel::addData(const QList<MatrixXd> &data)
         if(doComp) {
             if(doProj) {
                 //Comp + Proj
-                m_matDataRaw.block(0, m_iCurrentSample, nRow, nCol) = m_matSparseProjCompMult * data.at(b);
+                m_matDataRaw.block(0, m_iCurrentSample, nRow, nCol) = m_matSparseProjCompMult * matBlock;
             } else {
                 //Comp
-                m_matDataRaw.block(0, m_iCurrentSample, nRow, nCol) = m_matSparseCompMult * data.at(b);
+                m_matDataRaw.block(0, m_iCurrentSample, nRow, nCol) = m_matSparseCompMult * matBlock;
             }
         } else {
             if(doProj) {
                 //Proj
-                m_matDataRaw.block(0, m_iCurrentSample, nRow, nCol) = m_matSparseProjMult * data.at(b);
+                m_matDataRaw.block(0, m_iCurrentSample, nRow, nCol) = m_matSparseProjMult * matBlock;
             } else {
                 //None - Raw
-                m_matDataRaw.block(0, m_iCurrentSample, nRow, nCol) = data.at(b);
+                m_matDataRaw.block(0, m_iCurrentSample, nRow, nCol) = matBlock;
             }
         }
 
@@ -532,8 +534,8 @@ void RtFiffRawViewModel::addData(const QList<MatrixXd> &data)
         if(m_bTriggerDetectionActive) {
             int iOldDetectedTriggers = m_qMapDetectedTrigger[m_iCurrentTriggerChIndex].size();
 
-            QList<QPair<int,double> > qMapDetectedTrigger = RTPROCESSINGLIB::detectTriggerFlanksMax(data.at(b), m_iCurrentTriggerChIndex, m_iCurrentSample-nCol, m_dTriggerThreshold, true, 500);
-            //QList<QPair<int,double> > qMapDetectedTrigger = RTPROCESSINGLIB::detectTriggerFlanksGrad(data.at(b), m_iCurrentTriggerChIndex, m_iCurrentSample-nCol, m_dTriggerThreshold, false, "Rising");
+            QList<QPair<int,double> > qMapDetectedTrigger = RTPROCESSINGLIB::detectTriggerFlanksMax(matBlock, m_iCurrentTriggerChIndex, m_iCurrentSample-nCol, m_dTriggerThreshold, true, 500);
+            //QList<QPair<int,double> > qMapDetectedTrigger = RTPROCESSINGLIB::detectTriggerFlanksGrad(matBlock, m_iCurrentTriggerChIndex, m_iCurrentSample-nCol, m_dTriggerThreshold, false, "Rising");
 
             //Append results to already found triggers
             m_qMapDetectedTrigger[m_iCurrentTriggerChIndex].append(qMapDetectedTrigger);
@@ -1180,98 +1182,117 @@ void RtFiffRawViewModel::filterDataBlock(const MatrixXd &data, int iDataIndex)
         return;
     }
 
-    //Generate QList structure which can be handled by the QConcurrent framework
-    QList<QPair<QList<FilterKernel>,QPair<int,RowVectorXd> > > timeData;
+    QList<int> filterChannelIndex;
     QList<int> notFilterChannelIndex;
 
     for(qint32 i = 0; i < data.rows(); ++i) {
         if(m_filterChannelList.contains(m_pFiffInfo->chs.at(i).ch_name)) {
-            timeData.append(QPair<QList<FilterKernel>,QPair<int,RowVectorXd> >(m_filterKernel,QPair<int,RowVectorXd>(i,data.row(i))));
+            filterChannelIndex.append(i);
         } else {
             notFilterChannelIndex.append(i);
             }
     }
 
-    //Do the concurrent filtering
-    if(!timeData.isEmpty()) {
-        QFuture<void> future = QtConcurrent::map(timeData,
-                                             doFilterPerChannelRTMSA);
+    //Run the filters with the persistent engines. They keep the transformed kernels, FFT plans and buffers between blocks.
+    if(!filterChannelIndex.isEmpty()) {
+        RowVectorXi vecPicks(filterChannelIndex.size());
+        for(int i = 0; i < filterChannelIndex.size(); ++i) {
+            vecPicks[i] = filterChannelIndex.at(i);
+        }
 
-        future.waitForFinished();
+        const MatrixXd* pFilterInput = &data;
+
+        for(int i = 0; i < m_filterKernel.size(); ++i) {
+            if(m_lFilterEngines.size() <= i) {
+                m_lFilterEngines.append(QSharedPointer<FilterEngine>::create());
+                m_lFilteredBlocks.append(MatrixXd());
+            }
+
+            m_lFilterEngines[i]->setup(m_filterKernel.at(i),
+                                       pFilterInput->rows(),
+                                       pFilterInput->cols(),
+                                       vecPicks);
+            m_lFilterEngines[i]->convolve(*pFilterInput, m_lFilteredBlocks[i]);
+
+            pFilterInput = &m_lFilteredBlocks.at(i);
+        }
+
+        const MatrixXd& matFiltered = *pFilterInput;
 
         //Do the overlap add method and store in m_matDataFiltered
         int iFilterDelay = m_iMaxFilterLength/2;
-        int iFilteredNumberCols = timeData.at(0).second.second.cols();
+        int iFilteredNumberCols = matFiltered.cols();
 
-        for(int r = 0; r<timeData.size(); ++r) {
+        for(int r = 0; r<filterChannelIndex.size(); ++r) {
+            const int iRow = filterChannelIndex.at(r);
             if(iDataIndex+2*data.cols() > m_matDataRaw.cols()) {
                 //Handle last data block
                 //std::cout<<"Handle last data block"<<std::endl;
 
                 if(m_bDrawFilterFront) {
                     //Get the currently filtered data. This data has a delay of filterLength/2 in front and back.
-                    RowVectorXd tempData = timeData.at(r).second.second;
+                    RowVectorXd tempData = matFiltered.row(iRow);
 
                     //Perform the actual overlap add by adding the last filterlength data to the newly filtered one
-                    tempData.head(m_iMaxFilterLength) += m_matOverlap.row(timeData.at(r).second.first);
+                    tempData.head(m_iMaxFilterLength) += m_matOverlap.row(iRow);
 
                     //Write the newly calulated filtered data to the filter data matrix. Keep in mind that the current block also effect last part of the last block (begin at dataIndex-iFilterDelay).
                     int start = iDataIndex-iFilterDelay < 0 ? 0 : iDataIndex-iFilterDelay;
-                    m_matDataFiltered.row(timeData.at(r).second.first).segment(start,iFilteredNumberCols-m_iMaxFilterLength) = tempData.head(iFilteredNumberCols-m_iMaxFilterLength);
+                    m_matDataFiltered.row(iRow).segment(start,iFilteredNumberCols-m_iMaxFilterLength) = tempData.head(iFilteredNumberCols-m_iMaxFilterLength);
                 } else {
                     //Perform this else case everytime the filter was changed. Do not begin to plot from dataIndex-iFilterDelay because the impsulse response and m_matOverlap do not match with the new filter anymore.
-                    m_matDataFiltered.row(timeData.at(r).second.first).segment(iDataIndex-iFilterDelay,m_iMaxFilterLength) = timeData.at(r).second.second.segment(m_iMaxFilterLength,m_iMaxFilterLength);
-                    m_matDataFiltered.row(timeData.at(r).second.first).segment(iDataIndex+iFilterDelay,iFilteredNumberCols-2*m_iMaxFilterLength) = timeData.at(r).second.second.segment(m_iMaxFilterLength,iFilteredNumberCols-2*m_iMaxFilterLength);
+                    m_matDataFiltered.row(iRow).segment(iDataIndex-iFilterDelay,m_iMaxFilterLength) = matFiltered.row(iRow).segment(m_iMaxFilterLength,m_iMaxFilterLength);
+                    m_matDataFiltered.row(iRow).segment(iDataIndex+iFilterDelay,iFilteredNumberCols-2*m_iMaxFilterLength) = matFiltered.row(iRow).segment(m_iMaxFilterLength,iFilteredNumberCols-2*m_iMaxFilterLength);
                 }
 
                 //Refresh the m_matOverlap with the new calculated filtered data.
-                m_matOverlap.row(timeData.at(r).second.first) = timeData.at(r).second.second.tail(m_iMaxFilterLength);
+                m_matOverlap.row(iRow) = matFiltered.row(iRow).tail(m_iMaxFilterLength);
             } else if(iDataIndex == 0) {
                 //Handle first data block
                 //std::cout<<"Handle first data block"<<std::endl;
 
                 if(m_bDrawFilterFront) {
                     //Get the currently filtered data. This data has a delay of filterLength/2 in front and back.
-                    RowVectorXd tempData = timeData.at(r).second.second;
+                    RowVectorXd tempData = matFiltered.row(iRow);
 
                     //Add newly calculate data to the tail of the current filter data matrix
-                    m_matDataFiltered.row(timeData.at(r).second.first).segment(m_matDataFiltered.cols()-iFilterDelay-m_iResidual, iFilterDelay) = tempData.head(iFilterDelay) + m_matOverlap.row(timeData.at(r).second.first).head(iFilterDelay);
+                    m_matDataFiltered.row(iRow).segment(m_matDataFiltered.cols()-iFilterDelay-m_iResidual, iFilterDelay) = tempData.head(iFilterDelay) + m_matOverlap.row(iRow).head(iFilterDelay);
 
                     //Perform the actual overlap add by adding the last filterlength data to the newly filtered one
-                    tempData.head(m_iMaxFilterLength) += m_matOverlap.row(timeData.at(r).second.first);
-                    m_matDataFiltered.row(timeData.at(r).second.first).head(iFilteredNumberCols-m_iMaxFilterLength-iFilterDelay) = tempData.segment(iFilterDelay,iFilteredNumberCols-m_iMaxFilterLength-iFilterDelay);
+                    tempData.head(m_iMaxFilterLength) += m_matOverlap.row(iRow);
+                    m_matDataFiltered.row(iRow).head(iFilteredNumberCols-m_iMaxFilterLength-iFilterDelay) = tempData.segment(iFilterDelay,iFilteredNumberCols-m_iMaxFilterLength-iFilterDelay);
 
                     //Copy residual data from the front to the back. The residual is != 0 if the chosen block size cannot be evenly fit into the matrix size
-                    m_matDataFiltered.row(timeData.at(r).second.first).tail(m_iResidual) = m_matDataFiltered.row(timeData.at(r).second.first).head(m_iResidual);
+                    m_matDataFiltered.row(iRow).tail(m_iResidual) = m_matDataFiltered.row(iRow).head(m_iResidual);
                 } else {
                     //Perform this else case everytime the filter was changed. Do not begin to plot from dataIndex-iFilterDelay because the impsulse response and m_matOverlap do not match with the new filter anymore.
-                    m_matDataFiltered.row(timeData.at(r).second.first).head(m_iMaxFilterLength) = timeData.at(r).second.second.segment(m_iMaxFilterLength,m_iMaxFilterLength);
-                    m_matDataFiltered.row(timeData.at(r).second.first).segment(iFilterDelay,iFilteredNumberCols-2*m_iMaxFilterLength) = timeData.at(r).second.second.segment(m_iMaxFilterLength,iFilteredNumberCols-2*m_iMaxFilterLength);
+                    m_matDataFiltered.row(iRow).head(m_iMaxFilterLength) = matFiltered.row(iRow).segment(m_iMaxFilterLength,m_iMaxFilterLength);
+                    m_matDataFiltered.row(iRow).segment(iFilterDelay,iFilteredNumberCols-2*m_iMaxFilterLength) = matFiltered.row(iRow).segment(m_iMaxFilterLength,iFilteredNumberCols-2*m_iMaxFilterLength);
                 }
 
                 //Refresh the m_matOverlap with the new calculated filtered data.
-                m_matOverlap.row(timeData.at(r).second.first) = timeData.at(r).second.second.tail(m_iMaxFilterLength);
+                m_matOverlap.row(iRow) = matFiltered.row(iRow).tail(m_iMaxFilterLength);
             } else {
                 //Handle middle data blocks
                 //std::cout<<"Handle middle data block"<<std::endl;
 
                 if(m_bDrawFilterFront) {
                     //Get the currently filtered data. This data has a delay of filterLength/2 in front and back.
-                    RowVectorXd tempData = timeData.at(r).second.second;
+                    RowVectorXd tempData = matFiltered.row(iRow);
 
                     //Perform the actual overlap add by adding the last filterlength data to the newly filtered one
-                    tempData.head(m_iMaxFilterLength) += m_matOverlap.row(timeData.at(r).second.first);
+                    tempData.head(m_iMaxFilterLength) += m_matOverlap.row(iRow);
 
                     //Write the newly calulated filtered data to the filter data matrix. Keep in mind that the current block also effect last part of the last block (begin at dataIndex-iFilterDelay).
-                    m_matDataFiltered.row(timeData.at(r).second.first).segment(iDataIndex-iFilterDelay,iFilteredNumberCols-m_iMaxFilterLength) = tempData.head(iFilteredNumberCols-m_iMaxFilterLength);
+                    m_matDataFiltered.row(iRow).segment(iDataIndex-iFilterDelay,iFilteredNumberCols-m_iMaxFilterLength) = tempData.head(iFilteredNumberCols-m_iMaxFilterLength);
                 } else {
                     //Perform this else case everytime the filter was changed. Do not begin to plot from dataIndex-iFilterDelay because the impsulse response and m_matOverlap do not match with the new filter anymore.
-                    m_matDataFiltered.row(timeData.at(r).second.first).segment(iDataIndex-iFilterDelay,m_iMaxFilterLength).setZero();// = timeData.at(r).second.second.segment(m_iMaxFilterLength,m_iMaxFilterLength);
-                    m_matDataFiltered.row(timeData.at(r).second.first).segment(iDataIndex+iFilterDelay,iFilteredNumberCols-2*m_iMaxFilterLength) = timeData.at(r).second.second.segment(m_iMaxFilterLength,iFilteredNumberCols-2*m_iMaxFilterLength);
+                    m_matDataFiltered.row(iRow).segment(iDataIndex-iFilterDelay,m_iMaxFilterLength).setZero();// = matFiltered.row(iRow).segment(m_iMaxFilterLength,m_iMaxFilterLength);
+                    m_matDataFiltered.row(iRow).segment(iDataIndex+iFilterDelay,iFilteredNumberCols-2*m_iMaxFilterLength) = matFiltered.row(iRow).segment(m_iMaxFilterLength,iFilteredNumberCols-2*m_iMaxFilterLength);
                 }
 
                 //Refresh the m_matOverlap with the new calculated filtered data.
-                m_matOverlap.row(timeData.at(r).second.first) = timeData.at(r).second.second.tail(m_iMaxFilterLength);
+                m_matOverlap.row(iRow) = matFiltered.row(iRow).tail(m_iMaxFilterLength);
             }
         }
     }
@@ -47,6 +47,8 @@
 
 #include <rtprocessing/helpers/filterkernel.h>
 
+#include <utils/generics/sampleblock.h>
+
 //=============================================================================================================
 // QT INCLUDES
 //=============================================================================================================
@@ -70,6 +72,10 @@ namespace FIFFLIB {
     class FiffInfo;
 }
 
+namespace RTPROCESSINGLIB {
+    class FilterEngine;
+}
+
 //=============================================================================================================
 // DEFINE NAMESPACE DISPLIB
 //=============================================================================================================
@@ -181,11 +187,12 @@ public:
 
     //=========================================================================================================
     /**
-     * Adds multiple time points (QVector) for a channel set (VectorXd)
+     * Adds multiple time points (QVector) for a channel set (VectorXd). The blocks are read in place, no samples
+     * are copied.
      *
      * @param[in] data       data to add (Time points of channel samples)
      */
-    void addData(const QList<Eigen::MatrixXd> &data);
+    void addData(const QList<UTILSLIB::SampleBlock> &data);
 
     //=========================================================================================================
     /**
@@ -596,6 +603,8 @@ private:
     QMap<int,QList<QPair<int,double> > >m_qMapDetectedTriggerOldFreeze;             /**< Old detected trigger for each trigger channel while display is freezed. */
     QMap<qint32,float>                  m_qMapChScaling;                            /**< Channel scaling map. */
     QList<RTPROCESSINGLIB::FilterKernel>m_filterKernel;                             /**< List of currently active filters. */
+    QList<QSharedPointer<RTPROCESSINGLIB::FilterEngine> > m_lFilterEngines;        /**< One persistent filter engine per active filter. */
+    QList<Eigen::MatrixXd>              m_lFilteredBlocks;                          /**< Output of each filter engine, reused between blocks. */
     QStringList                         m_filterChannelList;                        /**< List of channels which are to be filtered.*/
     QStringList                         m_visibleChannelList;                       /**< List of currently visible channels in the view.*/
     QMap<qint32,qint32>                 m_qMapIdxRowSelection;                      /**< Selection mapping.*/
@@ -189,7 +189,7 @@ void RtFiffRawView::init(QSharedPointer<FIFFLIB::FiffInfo> &info)
 
 //=============================================================================================================
 
-void RtFiffRawView::addData(const QList<Eigen::MatrixXd> &data)
+void RtFiffRawView::addData(const QList<UTILSLIB::SampleBlock> &data)
 {
     if(!data.isEmpty()) {
         m_pModel->addData(data);
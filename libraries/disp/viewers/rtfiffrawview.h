@@ -43,6 +43,7 @@
 #include "abstractview.h"
 
 #include <fiff/fiff_proj.h>
+#include <utils/generics/sampleblock.h>
 
 //=============================================================================================================
 // QT INCLUDES
@@ -141,11 +142,11 @@ public:
 
     //=========================================================================================================
     /**
-     * Add data to the view.
+     * Add data to the view. The blocks are read in place, no samples are copied.
      *
      * @param [in] data    The new data.
      */
-    void addData(const QList<Eigen::MatrixXd>& data);
+    void addData(const QList<UTILSLIB::SampleBlock>& data);
 
     //=========================================================================================================
     /**
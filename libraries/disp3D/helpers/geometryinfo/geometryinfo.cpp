@@ -45,9 +45,10 @@
 // INCLUDES
 //=============================================================================================================
 
+#include <algorithm>
 #include <cmath>
 #include <fstream>
-#include <set>
+#include <functional>
 
 //=============================================================================================================
 // QT INCLUDES
@@ -147,6 +148,64 @@ QSharedPointer<MatrixXd> GeometryInfo::scdc(const MatrixX3f &matVertices,
 
 //=============================================================================================================
 
+QSharedPointer<SparseMatrix<double, RowMajor> > GeometryInfo::scdcSparse(const MatrixX3f &matVertices,
+                                                                         const QVector<QVector<int> > &vecNeighborVertices,
+                                                                         QVector<int> &vecVertSubset,
+                                                                         double dCancelDist)
+{
+    if(vecVertSubset.empty()) {
+        // caller passed an empty subset, need to fill in all vertex IDs
+        vecVertSubset.reserve(matVertices.rows());
+        for(qint32 id = 0; id < matVertices.rows(); ++id) {
+            vecVertSubset.push_back(id);
+        }
+    }
+
+    // convention: first dimension in distance table is "from", second dimension "to"
+    QSharedPointer<SparseMatrix<double, RowMajor> > returnMat = QSharedPointer<SparseMatrix<double, RowMajor> >::create(matVertices.rows(),
+                                                                                                                       vecVertSubset.size());
+
+    // distribute calculation on cores
+    int iCores = QThread::idealThreadCount();
+    if (iCores <= 0) {
+        // assume that we have at least two available cores
+        iCores = 2;
+    }
+    iCores = std::max(1, std::min(iCores, vecVertSubset.size()));
+
+    // start threads with their respective parts of the final subset
+    qint32 iSubArraySize = int(double(vecVertSubset.size()) / double(iCores));
+    QVector<QFuture<QVector<Triplet<double> > > > vecThreads(iCores);
+    qint32 iBegin = 0;
+
+    for (int i = 0; i < vecThreads.size(); ++i) {
+        //last round takes the remainder
+        qint32 iEnd = (i == vecThreads.size()-1) ? vecVertSubset.size() : iBegin + iSubArraySize;
+
+        vecThreads[i] = QtConcurrent::run(std::bind(iterativeDijkstraSparse,
+                                                    std::cref(matVertices),
+                                                    std::cref(vecNeighborVertices),
+                                                    std::cref(vecVertSubset),
+                                                    iBegin,
+                                                    iEnd,
+                                                    dCancelDist));
+        iBegin = iEnd;
+    }
+
+    // wait for all threads to finish and collect their distances
+    QVector<Triplet<double> > vecNonZeroEntries;
+    for (QFuture<QVector<Triplet<double> > >& f : vecThreads) {
+        f.waitForFinished();
+        vecNonZeroEntries.append(f.result());
+    }
+
+    returnMat->setFromTriplets(vecNonZeroEntries.begin(), vecNonZeroEntries.end());
+
+    return returnMat;
+}
+
+//=============================================================================================================
+
 QVector<int> GeometryInfo::projectSensors(const MatrixX3f &matVertices,
                                           const QVector<Vector3f> &vecSensorPositions)
 {
@@ -252,59 +311,120 @@ void GeometryInfo::iterativeDijkstra(QSharedPointer<MatrixXd> matOutputDistMatri
                                      qint32 iBegin,
                                      qint32 iEnd,
                                      double dCancelDistance) {
-    // initialization
-    const QVector<QVector<int> > &vecAdjacency = vecNeighborVertices;
-    qint32 n = vecAdjacency.size();
-    QVector<double> vecMinDists(n);
-    std::set< std::pair< double, qint32> > vertexQ;
-    const double INF = FLOAT_INFINITY;
+    DijkstraWorkspace workspace;
+    workspace.vecMinDists.fill(FLOAT_INFINITY, vecNeighborVertices.size());
 
     // outer loop, iterated for each vertex of 'vertSubset' between 'begin' and 'end'
     for (qint32 i = iBegin; i < iEnd; ++i) {
-        // init phase of dijkstra: set source node for current iteration and reset data fields
-        if(i ==123)
-            qDebug() << "blabla";
-        qint32 iRoot = vecVertSubset.at(i);
-        vertexQ.clear();
-        vecMinDists.fill(INF);
-        vecMinDists[iRoot] = 0.0;
-        vertexQ.insert(std::make_pair(vecMinDists[iRoot], iRoot));
-
-        // dijkstra main loop
-        while (vertexQ.empty() == false) {
-            // remove next vertex from queue
-            const double dDist = vertexQ.begin()->first;
-            const qint32 u = vertexQ.begin()->second;
-            vertexQ.erase(vertexQ.begin());
-
-            // check if we are still below cancel distance
-            if (dDist <= dCancelDistance) {
-                // visit each neighbour of u
-                const QVector<int>& vecNeighbours = vecAdjacency[u];
-
-                for (qint32 ne = 0; ne < vecNeighbours.length(); ++ne) {
-                    qint32 v = vecNeighbours[ne];
-
-                    // distance from source (i.e. root) to v, using u as its predecessor
-                    // calculate inline since designated function was magnitudes slower (even when declared as inline)
-                    const double dDistX = matVertices(u, 0) - matVertices(v, 0);
-                    const double dDistY = matVertices(u, 1) - matVertices(v, 1);
-                    const double dDistZ = matVertices(u, 2) - matVertices(v, 2);
-                    const double dDistWithU = dDist + sqrt(dDistX * dDistX + dDistY * dDistY + dDistZ * dDistZ);
-
-                    if (dDistWithU < vecMinDists[v]) {
-                        // this is a combination of insert and decreaseKey
-                        vertexQ.erase(std::make_pair(vecMinDists[v], v));
-                        vecMinDists[v] = dDistWithU;
-                        vertexQ.insert(std::make_pair(vecMinDists[v], v));
-                    }
-                }
+        dijkstra(workspace,
+                 matVertices,
+                 vecNeighborVertices,
+                 vecVertSubset.at(i),
+                 dCancelDistance);
+
+        // save results for current root in matrix, all vertices which were not reached stay at infinity
+        matOutputDistMatrix->col(i).setConstant(FLOAT_INFINITY);
+        for (qint32 v : workspace.vecReached) {
+            matOutputDistMatrix->coeffRef(v, i) = workspace.vecMinDists[v];
+        }
+    }
+}
+
+//=============================================================================================================
+
+QVector<Triplet<double> > GeometryInfo::iterativeDijkstraSparse(const MatrixX3f &matVertices,
+                                                                const QVector<QVector<int> > &vecNeighborVertices,
+                                                                const QVector<int> &vecVertSubset,
+                                                                qint32 iBegin,
+                                                                qint32 iEnd,
+                                                                double dCancelDistance) {
+    QVector<Triplet<double> > vecNonZeroEntries;
+    DijkstraWorkspace workspace;
+    workspace.vecMinDists.fill(FLOAT_INFINITY, vecNeighborVertices.size());
+
+    // outer loop, iterated for each vertex of 'vertSubset' between 'begin' and 'end'
+    for (qint32 i = iBegin; i < iEnd; ++i) {
+        dijkstra(workspace,
+                 matVertices,
+                 vecNeighborVertices,
+                 vecVertSubset.at(i),
+                 dCancelDistance);
+
+        // only keep the distances up to the cancel distance
+        for (qint32 v : workspace.vecReached) {
+            if (workspace.vecMinDists[v] <= dCancelDistance) {
+                vecNonZeroEntries.push_back(Triplet<double>(v, i, workspace.vecMinDists[v]));
             }
         }
+    }
+
+    return vecNonZeroEntries;
+}
+
+//=============================================================================================================
+
+void GeometryInfo::dijkstra(DijkstraWorkspace &workspace,
+                            const MatrixX3f &matVertices,
+                            const QVector<QVector<int> > &vecNeighborVertices,
+                            qint32 iRoot,
+                            double dCancelDistance) {
+    QVector<double> &vecMinDists = workspace.vecMinDists;
+    QVector<qint32> &vecReached = workspace.vecReached;
+    std::vector<std::pair<double, qint32> > &vecHeap = workspace.vecHeap;
+    const std::greater<std::pair<double, qint32> > compare;
+
+    // init phase of dijkstra: reset the vertices reached from the previous root and set the new root
+    for (qint32 v : vecReached) {
+        vecMinDists[v] = FLOAT_INFINITY;
+    }
+    vecReached.clear();
+    vecHeap.clear();
+
+    vecMinDists[iRoot] = 0.0;
+    vecReached.push_back(iRoot);
+    vecHeap.push_back(std::make_pair(0.0, iRoot));
+
+    // dijkstra main loop
+    while (!vecHeap.empty()) {
+        // remove next vertex from queue
+        std::pop_heap(vecHeap.begin(), vecHeap.end(), compare);
+        const double dDist = vecHeap.back().first;
+        const qint32 u = vecHeap.back().second;
+        vecHeap.pop_back();
+
+        // vertices are popped in order of their distance, so all remaining ones are above the cancel distance too
+        if (dDist > dCancelDistance) {
+            break;
+        }
+
+        // skip outdated entries, the vertex was already pushed again with a shorter distance
+        if (dDist > vecMinDists[u]) {
+            continue;
+        }
 
-        // save results for current root in matrix
-        for (qint32 m = 0; m < vecMinDists.size(); ++m) {
-            matOutputDistMatrix->coeffRef(m , i) = vecMinDists[m];
+        // visit each neighbour of u
+        const QVector<int>& vecNeighbours = vecNeighborVertices[u];
+
+        for (qint32 ne = 0; ne < vecNeighbours.length(); ++ne) {
+            qint32 v = vecNeighbours[ne];
+
+            // distance from source (i.e. root) to v, using u as its predecessor
+            // calculate inline since designated function was magnitudes slower (even when declared as inline)
+            const double dDistX = matVertices(u, 0) - matVertices(v, 0);
+            const double dDistY = matVertices(u, 1) - matVertices(v, 1);
+            const double dDistZ = matVertices(u, 2) - matVertices(v, 2);
+            const double dDistWithU = dDist + sqrt(dDistX * dDistX + dDistY * dDistY + dDistZ * dDistZ);
+
+            if (dDistWithU < vecMinDists[v]) {
+                if (vecMinDists[v] == FLOAT_INFINITY) {
+                    vecReached.push_back(v);
+                }
+
+                // push instead of decreaseKey, the old entry is skipped when it is popped
+                vecMinDists[v] = dDistWithU;
+                vecHeap.push_back(std::make_pair(dDistWithU, v));
+                std::push_heap(vecHeap.begin(), vecHeap.end(), compare);
+            }
         }
     }
 }
@@ -339,3 +459,39 @@ QVector<int> GeometryInfo::filterBadChannels(QSharedPointer<Eigen::MatrixXd> mat
     }
     return vecBadColumns;
 }
+
+//=============================================================================================================
+
+QVector<int> GeometryInfo::filterBadChannels(QSharedPointer<SparseMatrix<double, RowMajor> > matDistanceTable,
+                                             const FIFFLIB::FiffInfo& fiffInfo,
+                                             qint32 iSensorType) {
+    // use pointer to avoid copying of FiffChInfo objects
+    QVector<int> vecBadColumns;
+    QVector<const FiffChInfo*> vecSensors;
+    for(const FiffChInfo& s : fiffInfo.chs){
+        //Only take EEG with V as unit or MEG magnetometers with T as unit
+        if(s.kind == iSensorType && (s.unit == FIFF_UNIT_T || s.unit == FIFF_UNIT_V)){
+           vecSensors.push_back(&s);
+        }
+    }
+
+    QVector<bool> vecIsBad(vecSensors.size(), false);
+    for(const QString& b : fiffInfo.bads){
+        for(int col = 0; col < vecSensors.size(); ++col){
+            if(vecSensors[col]->ch_name == b){
+                vecBadColumns.push_back(col);
+                vecIsBad[col] = true;
+                break;
+            }
+        }
+    }
+
+    // removing the distances of a bad column is the same as setting them to infinity
+    if(!vecBadColumns.isEmpty()) {
+        matDistanceTable->prune([&vecIsBad](Index, Index col, double) {
+            return col >= vecIsBad.size() || !vecIsBad[int(col)];
+        });
+    }
+
+    return vecBadColumns;
+}
@@ -47,6 +47,8 @@
 //=============================================================================================================
 
 #include <limits>
+#include <utility>
+#include <vector>
 
 //=============================================================================================================
 // QT INCLUDES
@@ -60,6 +62,7 @@
 //=============================================================================================================
 
 #include <Eigen/Core>
+#include <Eigen/SparseCore>
 
 //=============================================================================================================
 // FORWARD DECLARATIONS
@@ -121,6 +124,24 @@ public:
                                                 QVector<int> &pVecVertSubset,
                                                 double dCancelDist = FLOAT_INFINITY);
 
+    //=========================================================================================================
+    /**
+     * @brief scdcSparse                     Calculates surface constrained distances on a mesh and only stores the
+     *                                       distances which are within the cancel distance.
+     *
+     * @param[in] matVertices                The surface on which distances should be calculated.
+     * @param[in] vecNeighborVertices        The neighbor vertex information.
+     * @param[in/out] pVecVertSubset         The subset of IDs for which the distances should be calculated.
+     * @param[in] dCancelDist                Distances higher than this are not stored.
+     *
+     * @return                               A sparse row major (CSR) double matrix. One column represents the distances for one vertex
+     *                                       inside of the passed subset, entries which are not stored are to be read as infinity.
+     */
+    static QSharedPointer<Eigen::SparseMatrix<double, Eigen::RowMajor> > scdcSparse(const Eigen::MatrixX3f &matVertices,
+                                                                                    const QVector<QVector<int> > &vecNeighborVertices,
+                                                                                    QVector<int> &pVecVertSubset,
+                                                                                    double dCancelDist = FLOAT_INFINITY);
+
     //=========================================================================================================
     /**
      * @brief                            Calculates the nearest neighbor (euclidian distance) vertex to each sensor
@@ -148,7 +169,31 @@ public:
                                           const FIFFLIB::FiffInfo& fiffInfo,
                                           qint32 iSensorType);
 
+    //=========================================================================================================
+    /**
+     * @brief filterBadChannels          Filters bad channels from a sparse distance table, i.e. removes all distances of the bad columns
+     *
+     * @param[out] matDistanceTable      Result of scdcSparse.
+     * @param[in] fiffInfo               Container for sensors.
+     * @param[in] iSensorType            Sensor type to be filtered out, use fiff constants.
+     *
+     * @return Vector of bad channel indices.
+     */
+    static QVector<int> filterBadChannels(QSharedPointer<Eigen::SparseMatrix<double, Eigen::RowMajor> > matDistanceTable,
+                                          const FIFFLIB::FiffInfo& fiffInfo,
+                                          qint32 iSensorType);
+
 protected:
+    //=========================================================================================================
+    /**
+     * Workspace of the Dijkstra search. One workspace is reused for all roots which are handled by one thread.
+     */
+    struct DijkstraWorkspace {
+        QVector<double>                         vecMinDists;    /**< Distances to the current root, infinity if not reached. */
+        QVector<qint32>                         vecReached;     /**< The vertices which were reached from the current root. */
+        std::vector<std::pair<double, qint32> > vecHeap;        /**< Binary min heap of (distance, vertex) pairs. */
+    };
+
     //=========================================================================================================
     /**
      * @brief squared        Implemented for better readability only
@@ -192,6 +237,44 @@ protected:
                                   qint32 iBegin,
                                   qint32 iEnd,
                                   double dCancelDistance);
+
+    //=========================================================================================================
+    /**
+     * @brief iterativeDijkstraSparse   Calculates shortest distances on the mesh for each vertex of the passed vector that lies between the two indices
+     *                                  and only keeps the distances up to the cancel distance
+     *
+     * @param[in] matVertices           The surface on which distances should be calculated
+     * @param[in] vecNeighborVertices   The neighbor vertex information.
+     * @param[in] vecVertSubset         The subset of vertices
+     * @param[in] iBegin                Start index of distance calculation
+     * @param[in] iEnd                  End index of distance calculation, exclusive
+     * @param[in] dCancelDistance       Distance threshold: distances higher than this are not stored
+     *
+     * @return                          The (vertex, subset index, distance) triplets of the calculated distances
+     */
+    static QVector<Eigen::Triplet<double> > iterativeDijkstraSparse(const Eigen::MatrixX3f &matVertices,
+                                                                    const QVector<QVector<int> > &vecNeighborVertices,
+                                                                    const QVector<int> &vecVertSubset,
+                                                                    qint32 iBegin,
+                                                                    qint32 iEnd,
+                                                                    double dCancelDistance);
+
+    //=========================================================================================================
+    /**
+     * @brief dijkstra                  Calculates the shortest distances from one root vertex with a binary heap. The search stops at the cancel
+     *                                  distance, so only the vertices in workspace.vecReached have to be reset for the next root.
+     *
+     * @param[in, out] workspace        The workspace of the calling thread, holds the distances and reached vertices afterwards
+     * @param[in] matVertices           The surface on which distances should be calculated
+     * @param[in] vecNeighborVertices   The neighbor vertex information.
+     * @param[in] iRoot                 The root vertex
+     * @param[in] dCancelDistance       Distance threshold: vertices which are farther away from the root are not expanded
+     */
+    static void dijkstra(DijkstraWorkspace &workspace,
+                         const Eigen::MatrixX3f &matVertices,
+                         const QVector<QVector<int> > &vecNeighborVertices,
+                         qint32 iRoot,
+                         double dCancelDistance);
 };
 
 //=============================================================================================================
@@ -121,6 +121,26 @@ public:
                                                                               const double dCancelDist = FLOAT_INFINITY,
                                                                               const QVector<int> &vecExcludeIndex = QVector<int>());
 
+    //=========================================================================================================
+    /**
+     * Same as above, but for a sparse distance table as created by GeometryInfo::scdcSparse. Distances which are not stored in the
+     * table are treated as infinity. Only the stored distances are visited, so the costs scale with the number of distances
+     * within the cancel distance instead of the number of vertices times the number of sensors.
+     *
+     * @param[in] vecProjectedSensors           Vector of IDs of sensor vertices
+     * @param[in] matDistanceTable              Sparse row major matrix that contains all needed distances
+     * @param[in] interpolationFunction         Function that computes interpolation coefficients using the distance values
+     * @param[in] dCancelDist                   Distances higher than this are ignored, i.e. the respective coefficients are set to zero
+     * @param[in] vecExcludeIndex               The indices to be excluded from vecProjectedSensors, e.g., bad channels (empty by default)
+     *
+     * @return                                  The distance matrix created
+     */
+    static QSharedPointer<Eigen::SparseMatrix<float> > createInterpolationMat(const QVector<int> &vecProjectedSensors,
+                                                                              const QSharedPointer<Eigen::SparseMatrix<double, Eigen::RowMajor> > matDistanceTable,
+                                                                              double (*interpolationFunction) (double),
+                                                                              const double dCancelDist = FLOAT_INFINITY,
+                                                                              const QVector<int> &vecExcludeIndex = QVector<int>());
+
     //=========================================================================================================
     /**
      * The interpolation essentially corresponds to a matrix * vector multiplication. A vector of sensor data (i.e. a vector of double-values)
@@ -42,6 +42,18 @@
 #include "fiff_tag.h"
 #include "fiff_stream.h"
 #include "cstdlib"
+#include "cstring"
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QAtomicInt>
+#include <QDebug>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPointer>
 
 //=============================================================================================================
 // USED NAMESPACES
@@ -50,6 +62,129 @@
 using namespace FIFFLIB;
 using namespace Eigen;
 
+//=============================================================================================================
+// DEFINE GLOBAL METHODS
+//=============================================================================================================
+
+template<typename T>
+static inline double fiff_raw_sample(const fiff_data_t* p, bool bSwap)
+{
+    T value;
+
+    if(bSwap) {
+        fiff_data_t swapped[sizeof(T)];
+        for(size_t i = 0; i < sizeof(T); ++i)
+            swapped[i] = p[sizeof(T) - 1 - i];
+        memcpy(&value, swapped, sizeof(T));
+    } else {
+        memcpy(&value, p, sizeof(T));
+    }
+
+    return static_cast<double>(value);
+}
+
+//=============================================================================================================
+
+/**
+ * Converts the samples [firstPick, firstPick+nPick) of a raw buffer (nchan x nsamp, column major, stored as T) into
+ * the columns dest ... dest+nPick-1 of out. If sel is given only the selected channels are converted. If pCal is given
+ * each output row is scaled by its calibration factor.
+ */
+template<typename T>
+static void fiff_decode_raw_samples(const fiff_data_t* pData,
+                                    qint32 nchan,
+                                    fiff_int_t firstPick,
+                                    fiff_int_t nPick,
+                                    const RowVectorXi& sel,
+                                    const double* pCal,
+                                    bool bSwap,
+                                    MatrixXd& out,
+                                    fiff_int_t dest)
+{
+    const qint32 nrow = sel.size() > 0 ? sel.size() : nchan;
+
+    for(fiff_int_t c = 0; c < nPick; ++c) {
+        const fiff_data_t* pSample = pData + (qint64)(firstPick + c) * nchan * sizeof(T);
+        double* pOut = out.col(dest + c).data();
+
+        for(qint32 r = 0; r < nrow; ++r) {
+            const qint32 ch = sel.size() > 0 ? sel[r] : r;
+            const double value = fiff_raw_sample<T>(pSample + ch * sizeof(T), bSwap);
+            pOut[r] = pCal ? pCal[r] * value : value;
+        }
+    }
+}
+
+//=============================================================================================================
+
+/**
+ * Returns a new operator version. Versions are unique across all FiffRawData objects, since copies share their
+ * operator cache.
+ */
+static int fiff_next_operator_version()
+{
+    static QAtomicInt s_iVersion(0);
+    return s_iVersion.fetchAndAddRelaxed(1) + 1;
+}
+
+//=============================================================================================================
+
+template<typename Derived>
+static inline bool fiff_equal(const MatrixBase<Derived>& a, const MatrixBase<Derived>& b)
+{
+    return a.rows() == b.rows() && a.cols() == b.cols() && a == b;
+}
+
+//=============================================================================================================
+
+/**
+ * Calibration and multiplication matrices of read_raw_segment together with the setup they were built for.
+ */
+struct FiffRawData::RawReadOperator
+{
+    bool matches(int version, const RowVectorXi& selection) const
+    {
+        return iVersion == version && fiff_equal(sel, selection);
+    }
+
+    int                             iVersion;   /**< Version of proj, comp and cals the matrices were built for. */
+    Eigen::RowVectorXi              sel;        /**< Channel selection the matrices were built for. */
+    Eigen::SparseMatrix<double>     cal;        /**< Calibration matrix. */
+    Eigen::SparseMatrix<double>     mult;       /**< Multiplication matrix (compensator, projection, calibration). Empty if not needed. */
+    Eigen::VectorXd                 calSel;     /**< Calibration factors of the output rows. */
+};
+
+//=============================================================================================================
+
+/**
+ * State shared between the reads of a FiffRawData object.
+ */
+struct FiffRawData::RawReadCache
+{
+    enum { MaxOperators = 4 };  /**< Number of operators (i.e., different selections) to keep. */
+
+    RawReadCache()
+    : pMap(Q_NULLPTR)
+    , iMapSize(0)
+    , bMapFailed(false)
+    {
+    }
+
+    ~RawReadCache()
+    {
+        QObject::disconnect(closeConnection);
+    }
+
+    QMutex                      mutex;              /**< Guards the cache. */
+    QPointer<QFile>             pFile;              /**< The file the mapping belongs to. */
+    QMetaObject::Connection     closeConnection;    /**< Connection to aboutToClose of pFile. */
+    const uchar*                pMap;               /**< The memory-mapped file. NULL if not mapped yet. */
+    qint64                      iMapSize;           /**< Size of the mapping in bytes. */
+    bool                        bMapFailed;         /**< Whether mapping the file failed, e.g., because it is too large. */
+
+    QList<QSharedPointer<const RawReadOperator> >   lOperators;     /**< Recently used operators, most recent first. */
+};
+
 //=============================================================================================================
 // DEFINE MEMBER METHODS
 //=============================================================================================================
@@ -57,6 +192,8 @@ using namespace Eigen;
 FiffRawData::FiffRawData()
 : first_samp(-1)
 , last_samp(-1)
+, m_pReadCache(new RawReadCache)
+, m_iOperatorVersion(fiff_next_operator_version())
 {
 }
 
@@ -65,6 +202,8 @@ FiffRawData::FiffRawData()
 FiffRawData::FiffRawData(QIODevice &p_IODevice)
 : first_samp(-1)
 , last_samp(-1)
+, m_pReadCache(new RawReadCache)
+, m_iOperatorVersion(fiff_next_operator_version())
 {
     //setup FiffRawData object
     if(!FiffStream::setup_read_raw(p_IODevice, *this))
@@ -80,6 +219,8 @@ FiffRawData::FiffRawData(QIODevice &p_IODevice)
 FiffRawData::FiffRawData(QIODevice &p_IODevice, bool b_littleEndian)
 : first_samp(-1)
 , last_samp(-1)
+, m_pReadCache(new RawReadCache)
+, m_iOperatorVersion(fiff_next_operator_version())
 {
     //setup FiffRawData object
     if(!FiffStream::setup_read_raw(p_IODevice, *this, false, b_littleEndian))
@@ -101,6 +242,8 @@ FiffRawData::FiffRawData(const FiffRawData &p_FiffRawData)
 , rawdir(p_FiffRawData.rawdir)
 , proj(p_FiffRawData.proj)
 , comp(p_FiffRawData.comp)
+, m_pReadCache(p_FiffRawData.m_pReadCache)
+, m_iOperatorVersion(p_FiffRawData.m_iOperatorVersion)
 {
 }
 
@@ -121,11 +264,34 @@ void FiffRawData::clear()
     rawdir.clear();
     proj = MatrixXd();
     comp.clear();
+    invalidateReadOperators();
 }
 
 //=============================================================================================================
-#include <QElapsedTimer>
-#include <QDebug>
+
+void FiffRawData::setProj(const MatrixXd& p_proj)
+{
+    proj = p_proj;
+    invalidateReadOperators();
+}
+
+//=============================================================================================================
+
+void FiffRawData::setComp(const FiffCtfComp& p_comp)
+{
+    comp = p_comp;
+    invalidateReadOperators();
+}
+
+//=============================================================================================================
+
+void FiffRawData::invalidateReadOperators()
+{
+    m_iOperatorVersion = fiff_next_operator_version();
+}
+
+//=============================================================================================================
+
 bool FiffRawData::read_raw_segment(MatrixXd& data,
                                    MatrixXd& times,
                                    fiff_int_t from,
@@ -133,13 +299,27 @@ bool FiffRawData::read_raw_segment(MatrixXd& data,
                                    const RowVectorXi& sel,
                                    bool do_debug) const
 {
-    bool projAvailable = true;
+    SparseMatrix<double> multSegment;
+
+    return read_raw_segment(data,
+                            times,
+                            multSegment,
+                            from,
+                            to,
+                            sel,
+                            do_debug);
+}
 
-    if (this->proj.size() == 0) {
-        //qDebug() << "FiffRawData::read_raw_segment - No projectors setup. Consider calling MNE::setup_compensators.";
-        projAvailable = false;
-    }
+//=============================================================================================================
 
+bool FiffRawData::read_raw_segment(MatrixXd& data,
+                                   MatrixXd& times,
+                                   SparseMatrix<double>& multSegment,
+                                   fiff_int_t from,
+                                   fiff_int_t to,
+                                   const RowVectorXi& sel,
+                                   bool do_debug) const
+{
     if(from == -1)
         from = this->first_samp;
     if(to == -1)
@@ -159,213 +339,35 @@ bool FiffRawData::read_raw_segment(MatrixXd& data,
     }
     //printf("Reading %d ... %d  =  %9.3f ... %9.3f secs...", from, to, ((float)from)/this->info.sfreq, ((float)to)/this->info.sfreq);
     //
-    //  Initialize the data and calibration vector
+    //  Initialize the data and fetch the calibration and multiplication matrices
     //
     qint32 nchan = this->info.nchan;
     qint32 dest  = 0;//1;
-    qint32 i, k, r;
-
-    typedef Eigen::Triplet<double> T;
-    std::vector<T> tripletList;
-    tripletList.reserve(nchan);
-    for(i = 0; i < nchan; ++i)
-        tripletList.push_back(T(i, i, this->cals[i]));
-
-    SparseMatrix<double> cal(nchan, nchan);
-    cal.setFromTriplets(tripletList.begin(), tripletList.end());
-//    cal.makeCompressed();
-
-    MatrixXd mult_full;
-    //
-    if (sel.size() == 0)
-    {
-        data = MatrixXd(nchan, to-from+1);
-//            data->setZero();
-        if (projAvailable || this->comp.kind != -1)
-        {
-            if (!projAvailable)
-                mult_full = this->comp.data->data*cal;
-            else if (this->comp.kind == -1)
-                mult_full = this->proj*cal;
-            else
-                mult_full = this->proj*this->comp.data->data*cal;
-        }
-    }
-    else
-    {
-        data = MatrixXd(sel.size(),to-from+1);
-//            data->setZero();
-
-        MatrixXd selVect(sel.size(), nchan);
-
-        selVect.setZero();
-
-        if (!projAvailable && this->comp.kind == -1)
-        {
-            tripletList.clear();
-            tripletList.reserve(sel.size());
-            for(i = 0; i < sel.size(); ++i)
-                tripletList.push_back(T(i, i, this->cals[sel[i]]));
-            cal = SparseMatrix<double>(sel.size(), sel.size());
-            cal.setFromTriplets(tripletList.begin(), tripletList.end());
-        }
-        else
-        {
-            if (!projAvailable)
-            {
-                qDebug() << "This has to be debugged! #1";
-                for( i = 0; i  < sel.size(); ++i)
-                    selVect.row(i) = this->comp.data->data.block(sel[i],0,1,nchan);
-                mult_full = selVect*cal;
-            }
-            else if (this->comp.kind == -1)
-            {
-                for( i = 0; i  < sel.size(); ++i)
-                    selVect.row(i) = this->proj.block(sel[i],0,1,nchan);
+    qint32 i, k;
 
-                mult_full = selVect*cal;
-            }
-            else
-            {
-                qDebug() << "This has to be debugged! #3";
-                for( i = 0; i  < sel.size(); ++i)
-                    selVect.row(i) = this->proj.block(sel[i],0,1,nchan);
+    QSharedPointer<const RawReadOperator> pOperator = read_operator(sel);
 
-                mult_full = selVect*this->comp.data->data*cal;
-            }
-        }
-    }
+    data = MatrixXd(sel.size() == 0 ? nchan : sel.size(), to-from+1);
 
-    //
-    // Make mult sparse
-    //
-    tripletList.clear();
-    tripletList.reserve(mult_full.rows()*mult_full.cols());
-    for(i = 0; i < mult_full.rows(); ++i)
-        for(k = 0; k < mult_full.cols(); ++k)
-            if(mult_full(i,k) != 0)
-                tripletList.push_back(T(i, k, mult_full(i,k)));
-
-    SparseMatrix<double> mult(mult_full.rows(),mult_full.cols());
-    if(tripletList.size() > 0)
-        mult.setFromTriplets(tripletList.begin(), tripletList.end());
-//    mult.makeCompressed();
-
-    FiffStream::SPtr fid;
     if (!this->file->device()->isOpen())
     {
         if (!this->file->device()->open(QIODevice::ReadOnly))
         {
             printf("Cannot open file %s",this->info.filename.toUtf8().constData());
+            return false;
         }
-        fid = this->file;
-    }
-    else
-    {
-        fid = this->file;
     }
 
-    MatrixXd one, newData, tmp_data;
-    FiffRawDir thisRawDir;
-    FiffTag::SPtr t_pTag;
+    MatrixXd matScratch;
     fiff_int_t first_pick, last_pick, picksamp;
     for(k = 0; k < this->rawdir.size(); ++k)
     {
-        thisRawDir = this->rawdir[k];
+        const FiffRawDir& thisRawDir = this->rawdir[k];
         //
         //  Do we need this buffer
         //
         if (thisRawDir.last > from)
         {
-            if (thisRawDir.ent->kind == -1)
-            {
-                //
-                //  Take the easy route: skip is translated to zeros
-                //
-                if(do_debug)
-                    printf("S");
-                if (sel.cols() <= 0)
-                    one.resize(nchan,thisRawDir.nsamp);
-                else
-                    one.resize(sel.cols(),thisRawDir.nsamp);
-
-                one.setZero();
-            }
-            else
-            {
-                fid->read_tag(t_pTag, thisRawDir.ent->pos);
-                //
-                //   Depending on the state of the projection and selection
-                //   we proceed a little bit differently
-                //
-                if (mult.cols() == 0)
-                {
-                    if (sel.cols() == 0)
-                    {
-                        if (t_pTag->type == FIFFT_DAU_PACK16)
-                            one = cal*(Map< MatrixDau16 >( t_pTag->toDauPack16(),nchan, thisRawDir.nsamp)).cast<double>();
-                        else if(t_pTag->type == FIFFT_INT)
-                            one = cal*(Map< MatrixXi >( t_pTag->toInt(),nchan, thisRawDir.nsamp)).cast<double>();
-                        else if(t_pTag->type == FIFFT_FLOAT)
-                            one = cal*(Map< MatrixXf >( t_pTag->toFloat(),nchan, thisRawDir.nsamp)).cast<double>();
-                        else if(t_pTag->type == FIFFT_SHORT)
-                            one = cal*(Map< MatrixShort >( t_pTag->toShort(),nchan, thisRawDir.nsamp)).cast<double>();
-                        else
-                            printf("Data Storage Format not known yet [1]!! Type: %d\n", t_pTag->type);
-                    }
-                    else
-                    {
-                        //ToDo find a faster solution for this!! --> make cal and mul sparse like in MATLAB
-                        newData.resize(sel.cols(), thisRawDir.nsamp); //ToDo this can be done much faster, without newData
-
-                        if (t_pTag->type == FIFFT_DAU_PACK16)
-                        {
-                            tmp_data = (Map< MatrixDau16 > ( t_pTag->toDauPack16(),nchan, thisRawDir.nsamp)).cast<double>();
-
-                            for(r = 0; r < sel.size(); ++r)
-                                newData.block(r,0,1,thisRawDir.nsamp) = tmp_data.block(sel[r],0,1,thisRawDir.nsamp);
-                        }
-                        else if(t_pTag->type == FIFFT_INT)
-                        {
-                            tmp_data = (Map< MatrixXi >( t_pTag->toInt(),nchan, thisRawDir.nsamp)).cast<double>();
-
-                            for(r = 0; r < sel.size(); ++r)
-                                newData.block(r,0,1,thisRawDir.nsamp) = tmp_data.block(sel[r],0,1,thisRawDir.nsamp);
-                        }
-                        else if(t_pTag->type == FIFFT_FLOAT)
-                        {
-                            tmp_data = (Map< MatrixXf > ( t_pTag->toFloat(),nchan, thisRawDir.nsamp)).cast<double>();
-
-                            for(r = 0; r < sel.size(); ++r)
-                                newData.block(r,0,1,thisRawDir.nsamp) = tmp_data.block(sel[r],0,1,thisRawDir.nsamp);
-                        }
-                        else if(t_pTag->type == FIFFT_SHORT)
-                        {
-                            tmp_data = (Map< MatrixShort > ( t_pTag->toShort(),nchan, thisRawDir.nsamp)).cast<double>();
-
-                            for(r = 0; r < sel.size(); ++r)
-                                newData.block(r,0,1,thisRawDir.nsamp) = tmp_data.block(sel[r],0,1,thisRawDir.nsamp);
-                        }
-                        else
-                        {
-                            printf("Data Storage Format not known yet [2]!! Type: %d\n", t_pTag->type);
-                        }
-
-                        one = cal*newData;
-                    }
-                }
-                else
-                {
-                    if (t_pTag->type == FIFFT_DAU_PACK16)
-                        one = mult*(Map< MatrixDau16 >( t_pTag->toDauPack16(),nchan, thisRawDir.nsamp)).cast<double>();
-                    else if(t_pTag->type == FIFFT_INT)
-                        one = mult*(Map< MatrixXi >( t_pTag->toInt(),nchan, thisRawDir.nsamp)).cast<double>();
-                    else if(t_pTag->type == FIFFT_FLOAT)
-                        one = mult*(Map< MatrixXf >( t_pTag->toFloat(),nchan, thisRawDir.nsamp)).cast<double>();
-                    else
-                        printf("Data Storage Format not known yet [3]!! Type: %d\n", t_pTag->type);
-                }
-            }
             //
             //  The picking logic is a bit complicated
             //
@@ -426,10 +428,34 @@ bool FiffRawData::read_raw_segment(MatrixXd& data,
 
             if (picksamp > 0)
             {
-//                    for(r = 0; r < data->rows(); ++r)
-//                        for(c = 0; c < picksamp; ++c)
-//                            (*data)(r,dest + c) = one(r,first_pick + c);
-                data.block(0,dest,data.rows(),picksamp) = one.block(0, first_pick, data.rows(), picksamp);
+                if (thisRawDir.ent->kind == -1)
+                {
+                    //
+                    //  Take the easy route: skip is translated to zeros
+                    //
+                    if(do_debug)
+                        printf("S");
+                    data.block(0,dest,data.rows(),picksamp).setZero();
+                }
+                else
+                {
+                    //
+                    //  Convert the picked samples straight into the output block
+                    //
+                    if(!read_raw_buffer(thisRawDir,
+                                        first_pick,
+                                        picksamp,
+                                        sel,
+                                        pOperator->calSel,
+                                        pOperator->mult,
+                                        data,
+                                        dest,
+                                        matScratch))
+                    {
+                        printf("Could not read raw data buffer %d\n", k);
+                        return false;
+                    }
+                }
 
                 dest += picksamp;
             }
@@ -444,9 +470,10 @@ bool FiffRawData::read_raw_segment(MatrixXd& data,
         }
     }
 
-    if (!this->file->device()->isOpen()) {
-        this->file->device()->close();
-    }
+    if(pOperator->mult.cols()==0)
+        multSegment = pOperator->cal;
+    else
+        multSegment = pOperator->mult;
 
     times = MatrixXd(1, to-from+1);
 
@@ -458,45 +485,167 @@ bool FiffRawData::read_raw_segment(MatrixXd& data,
 
 //=============================================================================================================
 
-bool FiffRawData::read_raw_segment(MatrixXd& data,
-                                   MatrixXd& times,
-                                   SparseMatrix<double>& multSegment,
-                                   fiff_int_t from,
-                                   fiff_int_t to,
-                                   const RowVectorXi& sel,
-                                   bool do_debug) const
+bool FiffRawData::read_raw_buffer(qint32 iBuffer,
+                                  MatrixXd& data,
+                                  const RowVectorXi& sel) const
 {
-    bool projAvailable = true;
-
-    if (this->proj.size() == 0) {
-        //qInfo() << "FiffRawData::read_raw_segment - No projectors setup. Consider calling MNE::setup_compensators.";
-        projAvailable = false;
+    if(iBuffer < 0 || iBuffer >= this->rawdir.size()) {
+        printf("Raw data buffer %d does not exist\n", iBuffer);
+        return false;
     }
 
-    if(from == -1)
-        from = this->first_samp;
-    if(to == -1)
-        to = this->last_samp;
+    const FiffRawDir& thisRawDir = this->rawdir[iBuffer];
+
+    data.resize(sel.size() == 0 ? this->info.nchan : sel.size(), thisRawDir.nsamp);
+
     //
-    //  Initial checks
+    //  Skip is translated to zeros
     //
-    if(from < this->first_samp)
-        from = this->first_samp;
-    if(to > this->last_samp)
-        to = this->last_samp;
+    if (thisRawDir.ent->kind == -1) {
+        data.setZero();
+        return true;
+    }
+
+    if (!this->file->device()->isOpen())
+    {
+        if (!this->file->device()->open(QIODevice::ReadOnly))
+        {
+            printf("Cannot open file %s",this->info.filename.toUtf8().constData());
+            return false;
+        }
+    }
+
+    QSharedPointer<const RawReadOperator> pOperator = read_operator(sel);
+    MatrixXd matScratch;
+
+    return read_raw_buffer(thisRawDir,
+                           0,
+                           thisRawDir.nsamp,
+                           sel,
+                           pOperator->calSel,
+                           pOperator->mult,
+                           data,
+                           0,
+                           matScratch);
+}
+
+//=============================================================================================================
+
+bool FiffRawData::read_raw_buffer(const FiffRawDir& rawDir,
+                                  fiff_int_t firstPick,
+                                  fiff_int_t nPick,
+                                  const RowVectorXi& sel,
+                                  const VectorXd& calSel,
+                                  const SparseMatrix<double>& mult,
+                                  MatrixXd& data,
+                                  fiff_int_t dest,
+                                  MatrixXd& matScratch) const
+{
+    const qint32 nchan = this->info.nchan;
+    const qint64 iDataPos = (qint64)rawDir.ent->pos + (qint64)FIFFC_DATA_OFFSET;
+    const fiff_data_t* pData = Q_NULLPTR;
+    fiff_int_t type = rawDir.ent->type;
+    bool bSwap = false;
+    FiffTag::SPtr t_pTag;
+
     //
-    if(from > to)
+    //  Prefer the memory-mapped file: no tag object and no copy of the payload
+    //
+    qint64 iMapSize = 0;
+    const uchar* pMap = map_file(iMapSize);
+
+    if(pMap && rawDir.ent->pos >= 0 && iDataPos + rawDir.ent->size <= iMapSize)
     {
-        printf("No data in this range\n");
+        pData = reinterpret_cast<const fiff_data_t*>(pMap + iDataPos);
+        bSwap = (this->file->byteOrder() == QDataStream::LittleEndian) != (NATIVE_ENDIAN == FIFFV_LITTLE_ENDIAN);
+    }
+    else
+    {
+        if(!this->file->read_tag(t_pTag, rawDir.ent->pos))
+            return false;
+        pData = t_pTag->data();
+        type = t_pTag->type;
+    }
+
+    qint32 iSampleSize;
+    switch(type) {
+        case FIFFT_DAU_PACK16:
+        case FIFFT_SHORT:
+            iSampleSize = 2;
+            break;
+        case FIFFT_INT:
+        case FIFFT_FLOAT:
+            iSampleSize = 4;
+            break;
+        default:
+            printf("Data Storage Format not known yet!! Type: %d\n", type);
+            return false;
+    }
+
+    if((qint64)nchan * rawDir.nsamp * iSampleSize > (t_pTag.isNull() ? rawDir.ent->size : t_pTag->size())) {
+        printf("Raw data buffer at %d is too small for %d channels x %d samples\n", rawDir.ent->pos, nchan, rawDir.nsamp);
         return false;
     }
-    //printf("Reading %d ... %d  =  %9.3f ... %9.3f secs...", from, to, ((float)from)/this->info.sfreq, ((float)to)/this->info.sfreq);
+
+    //
+    //   Depending on the state of the projection we either write the calibrated selection directly
+    //   or convert all channels into the scratch block and apply the projection afterwards
+    //
+    const bool bProject = mult.cols() != 0;
+    const RowVectorXi& selDecode = bProject ? defaultRowVectorXi : sel;
+    const double* pCal = bProject ? Q_NULLPTR : calSel.data();
+    MatrixXd& matOut = bProject ? matScratch : data;
+    fiff_int_t destOut = bProject ? 0 : dest;
+
+    if(bProject)
+        matScratch.resize(nchan, nPick);
+
+    switch(type) {
+        case FIFFT_DAU_PACK16:
+            fiff_decode_raw_samples<fiff_dau_pack16_t>(pData, nchan, firstPick, nPick, selDecode, pCal, bSwap, matOut, destOut);
+            break;
+        case FIFFT_SHORT:
+            fiff_decode_raw_samples<fiff_short_t>(pData, nchan, firstPick, nPick, selDecode, pCal, bSwap, matOut, destOut);
+            break;
+        case FIFFT_INT:
+            fiff_decode_raw_samples<fiff_int_t>(pData, nchan, firstPick, nPick, selDecode, pCal, bSwap, matOut, destOut);
+            break;
+        case FIFFT_FLOAT:
+            fiff_decode_raw_samples<fiff_float_t>(pData, nchan, firstPick, nPick, selDecode, pCal, bSwap, matOut, destOut);
+            break;
+    }
+
+    if(bProject)
+        data.block(0, dest, data.rows(), nPick).noalias() = mult * matScratch;
+
+    return true;
+}
+
+//=============================================================================================================
+
+QSharedPointer<const FiffRawData::RawReadOperator> FiffRawData::read_operator(const RowVectorXi& sel) const
+{
+    QMutexLocker locker(&m_pReadCache->mutex);
+
     //
-    //  Initialize the data and calibration vector
+    //  Reuse the operator if the operator version and the selection did not change since it was built
     //
+    for(qint32 j = 0; j < m_pReadCache->lOperators.size(); ++j) {
+        if(m_pReadCache->lOperators[j]->matches(m_iOperatorVersion, sel)) {
+            m_pReadCache->lOperators.move(j, 0);
+            return m_pReadCache->lOperators.first();
+        }
+    }
+
+    bool projAvailable = true;
+
+    if (this->proj.size() == 0) {
+        //qInfo() << "FiffRawData::read_raw_segment - No projectors setup. Consider calling MNE::setup_compensators.";
+        projAvailable = false;
+    }
+
     qint32 nchan = this->info.nchan;
-    qint32 dest  = 0;//1;
-    qint32 i, k, r;
+    qint32 i, k;
 
     typedef Eigen::Triplet<double> T;
     std::vector<T> tripletList;
@@ -512,8 +661,6 @@ bool FiffRawData::read_raw_segment(MatrixXd& data,
     //
     if (sel.size() == 0)
     {
-        data = MatrixXd(nchan, to-from+1);
-//            data->setZero();
         if (projAvailable || this->comp.kind != -1)
         {
             if (!projAvailable)
@@ -526,9 +673,6 @@ bool FiffRawData::read_raw_segment(MatrixXd& data,
     }
     else
     {
-        data = MatrixXd(sel.size(),to-from+1);
-//            data->setZero();
-
         MatrixXd selVect(sel.size(), nchan);
 
         selVect.setZero();
@@ -582,218 +726,78 @@ bool FiffRawData::read_raw_segment(MatrixXd& data,
     SparseMatrix<double> mult(mult_full.rows(),mult_full.cols());
     if(tripletList.size() > 0)
         mult.setFromTriplets(tripletList.begin(), tripletList.end());
-//    mult.makeCompressed();
+    mult.makeCompressed();
 
     //
+    //  Calibration factors of the output rows, used when no projection needs to be applied
+    //
+    VectorXd calSel(sel.size() == 0 ? nchan : sel.size());
+    for(i = 0; i < calSel.size(); ++i)
+        calSel[i] = sel.size() == 0 ? this->cals[i] : this->cals[sel[i]];
 
-    FiffStream::SPtr fid;
-    if (!this->file->device()->isOpen())
-    {
-        if (!this->file->device()->open(QIODevice::ReadOnly))
-        {
-            printf("Cannot open file %s",this->info.filename.toUtf8().constData());
-        }
-        fid = this->file;
-    }
-    else
-    {
-        fid = this->file;
-    }
 
-    MatrixXd one;
-    fiff_int_t first_pick, last_pick, picksamp;
-    for(k = 0; k < this->rawdir.size(); ++k)
-    {
-        FiffRawDir thisRawDir = this->rawdir[k];
-        //
-        //  Do we need this buffer
-        //
-        if (thisRawDir.last > from)
-        {
-            if (thisRawDir.ent->kind == -1)
-            {
-                //
-                //  Take the easy route: skip is translated to zeros
-                //
-                if(do_debug)
-                    printf("S");
-                if (sel.cols() <= 0)
-                    one.resize(nchan,thisRawDir.nsamp);
-                else
-                    one.resize(sel.cols(),thisRawDir.nsamp);
+    QSharedPointer<RawReadOperator> pOperator(new RawReadOperator);
+    pOperator->iVersion = m_iOperatorVersion;
+    pOperator->sel = sel;
+    pOperator->cal = cal;
+    pOperator->mult = mult;
+    pOperator->calSel = calSel;
 
-                one.setZero();
-            }
-            else
-            {
-                FiffTag::SPtr t_pTag;
-                fid->read_tag(t_pTag, thisRawDir.ent->pos);
-                //
-                //   Depending on the state of the projection and selection
-                //   we proceed a little bit differently
-                //
-                if (mult.cols() == 0)
-                {
-                    if (sel.cols() == 0)
-                    {
-                        if (t_pTag->type == FIFFT_DAU_PACK16)
-                            one = cal*(Map< MatrixDau16 >( t_pTag->toDauPack16(),nchan, thisRawDir.nsamp)).cast<double>();
-                        else if(t_pTag->type == FIFFT_INT)
-                            one = cal*(Map< MatrixXi >( t_pTag->toInt(),nchan, thisRawDir.nsamp)).cast<double>();
-                        else if(t_pTag->type == FIFFT_FLOAT)
-                            one = cal*(Map< MatrixXf >( t_pTag->toFloat(),nchan, thisRawDir.nsamp)).cast<double>();
-                        else if(t_pTag->type == FIFFT_SHORT)
-                            one = cal*(Map< MatrixShort >( t_pTag->toShort(),nchan, thisRawDir.nsamp)).cast<double>();
-                        else
-                            printf("Data Storage Format not known yet [1]!! Type: %d\n", t_pTag->type);
-                    }
-                    else
-                    {
+    m_pReadCache->lOperators.prepend(pOperator);
+    while(m_pReadCache->lOperators.size() > RawReadCache::MaxOperators)
+        m_pReadCache->lOperators.removeLast();
 
-                        //ToDo find a faster solution for this!! --> make cal and mul sparse like in MATLAB
-                        MatrixXd newData(sel.cols(), thisRawDir.nsamp); //ToDo this can be done much faster, without newData
-
-                        if (t_pTag->type == FIFFT_DAU_PACK16)
-                        {
-                            MatrixXd tmp_data = (Map< MatrixDau16 > ( t_pTag->toDauPack16(),nchan, thisRawDir.nsamp)).cast<double>();
-
-                            for(r = 0; r < sel.size(); ++r)
-                                newData.block(r,0,1,thisRawDir.nsamp) = tmp_data.block(sel[r],0,1,thisRawDir.nsamp);
-                        }
-                        else if(t_pTag->type == FIFFT_INT)
-                        {
-                            MatrixXd tmp_data = (Map< MatrixXi >( t_pTag->toInt(),nchan, thisRawDir.nsamp)).cast<double>();
-
-                            for(r = 0; r < sel.size(); ++r)
-                                newData.block(r,0,1,thisRawDir.nsamp) = tmp_data.block(sel[r],0,1,thisRawDir.nsamp);
-                        }
-                        else if(t_pTag->type == FIFFT_FLOAT)
-                        {
-                            MatrixXd tmp_data = (Map< MatrixXf > ( t_pTag->toFloat(),nchan, thisRawDir.nsamp)).cast<double>();
-
-                            for(r = 0; r < sel.size(); ++r)
-                                newData.block(r,0,1,thisRawDir.nsamp) = tmp_data.block(sel[r],0,1,thisRawDir.nsamp);
-                        }
-                        else if(t_pTag->type == FIFFT_SHORT)
-                        {
-                            MatrixXd tmp_data = (Map< MatrixShort > ( t_pTag->toShort(),nchan, thisRawDir.nsamp)).cast<double>();
-
-                            for(r = 0; r < sel.size(); ++r)
-                                newData.block(r,0,1,thisRawDir.nsamp) = tmp_data.block(sel[r],0,1,thisRawDir.nsamp);
-                        }
-                        else
-                        {
-                            printf("Data Storage Format not known yet [2]!! Type: %d\n", t_pTag->type);
-                        }
-
-                        one = cal*newData;
-                    }
-                }
-                else
-                {
-                    if (t_pTag->type == FIFFT_DAU_PACK16)
-                        one = mult*(Map< MatrixDau16 >( t_pTag->toDauPack16(),nchan, thisRawDir.nsamp)).cast<double>();
-                    else if(t_pTag->type == FIFFT_INT)
-                        one = mult*(Map< MatrixXi >( t_pTag->toInt(),nchan, thisRawDir.nsamp)).cast<double>();
-                    else if(t_pTag->type == FIFFT_FLOAT)
-                        one = mult*(Map< MatrixXf >( t_pTag->toFloat(),nchan, thisRawDir.nsamp)).cast<double>();
-                    else
-                        printf("Data Storage Format not known yet [3]!! Type: %d\n", t_pTag->type);
-                }
-            }
-            //
-            //  The picking logic is a bit complicated
-            //
-            if (to >= thisRawDir.last && from <= thisRawDir.first)
-            {
-                //
-                //  We need the whole buffer
-                //
-                first_pick = 0;//1;
-                last_pick  = thisRawDir.nsamp - 1;
-                if (do_debug)
-                    printf("W");
-            }
-            else if (from > thisRawDir.first)
-            {
-                first_pick = from - thisRawDir.first;// + 1;
-                if(to < thisRawDir.last)
-                {
-                    //
-                    //  Something from the middle
-                    //
-//                    qDebug() << "This needs to be debugged!";
-                    last_pick = thisRawDir.nsamp + to - thisRawDir.last - 1;//is this alright?
-                    if (do_debug)
-                        printf("M");
-                }
-                else
-                {
-                    //
-                    //  From the middle to the end
-                    //
-                    last_pick = thisRawDir.nsamp - 1;
-                    if (do_debug)
-                        printf("E");
-                }
-            }
-            else
-            {
-                //
-                //  From the beginning to the middle
-                //
-                first_pick = 0;//1;
-                last_pick  = to - thisRawDir.first;// + 1;
-                if (do_debug)
-                    printf("B");
-            }
-            //
-            //  Now we are ready to pick
-            //
-            picksamp = last_pick - first_pick + 1;
+    return pOperator;
+}
 
-            if(do_debug)
-            {
-                qDebug() << "first_pick: " << first_pick;
-                qDebug() << "last_pick: " << last_pick;
-                qDebug() << "picksamp: " << picksamp;
-            }
+//=============================================================================================================
 
-            if (picksamp > 0)
-            {
-//                    for(r = 0; r < data->rows(); ++r)
-//                        for(c = 0; c < picksamp; ++c)
-//                            (*data)(r,dest + c) = one(r,first_pick + c);
-                data.block(0,dest,data.rows(),picksamp) = one.block(0, first_pick, data.rows(), picksamp);
+const uchar* FiffRawData::map_file(qint64& size) const
+{
+    size = 0;
+
+    QFile* pFile = qobject_cast<QFile*>(this->file->device());
+    if(!pFile || !pFile->isOpen())
+        return Q_NULLPTR;
+
+    QMutexLocker locker(&m_pReadCache->mutex);
+
+    if(m_pReadCache->pFile != pFile)
+    {
+        m_pReadCache->pFile = pFile;
+        m_pReadCache->pMap = Q_NULLPTR;
+        m_pReadCache->iMapSize = 0;
+        m_pReadCache->bMapFailed = false;
 
-                dest += picksamp;
-            }
-        }
         //
-        //  Done?
+        //  QFile drops all mappings on close, so forget the pointer before that happens. Only one connection is
+        //  kept per cache, the one to a previously used device is dropped.
         //
-        if (thisRawDir.last >= to)
-        {
-            //printf(" [done]\n");
-            break;
-        }
+        QObject::disconnect(m_pReadCache->closeConnection);
+
+        QWeakPointer<RawReadCache> wpCache = m_pReadCache.toWeakRef();
+        m_pReadCache->closeConnection = QObject::connect(pFile, &QIODevice::aboutToClose, [wpCache]() {
+            if(QSharedPointer<RawReadCache> pCache = wpCache.toStrongRef()) {
+                QMutexLocker locker(&pCache->mutex);
+                pCache->pMap = Q_NULLPTR;
+                pCache->iMapSize = 0;
+                pCache->bMapFailed = false;
+            }
+        });
     }
 
-    if(mult.cols()==0)
-        multSegment = cal;
-    else
-        multSegment = mult;
+    if(!m_pReadCache->pMap && !m_pReadCache->bMapFailed)
+    {
+        m_pReadCache->pMap = pFile->map(0, pFile->size());
 
-    if (!this->file->device()->isOpen()) {
-        this->file->device()->close();
+        if(m_pReadCache->pMap)
+            m_pReadCache->iMapSize = pFile->size();
+        else
+            m_pReadCache->bMapFailed = true;
     }
 
-    times = MatrixXd(1, to-from+1);
-
-    for (i = 0; i < times.cols(); ++i)
-        times(0, i) = ((float)(from+i)) / this->info.sfreq;
-
-    return true;
+    size = m_pReadCache->iMapSize;
+    return m_pReadCache->pMap;
 }
 
 //=============================================================================================================
@@ -117,6 +117,29 @@ public:
      */
     void clear();
 
+    //=========================================================================================================
+    /**
+     * Sets the SSP operator and invalidates the operators cached by the reads.
+     *
+     * @param[in] p_proj     the SSP operator to apply to the data.
+     */
+    void setProj(const Eigen::MatrixXd& p_proj);
+
+    //=========================================================================================================
+    /**
+     * Sets the compensator and invalidates the operators cached by the reads.
+     *
+     * @param[in] p_comp     the compensator to apply to the data.
+     */
+    void setComp(const FiffCtfComp& p_comp);
+
+    //=========================================================================================================
+    /**
+     * Invalidates the calibration and projection operators cached by the reads. Has to be called after proj, comp
+     * or cals were modified in place, e.g., by FiffInfo::make_projector(raw.proj).
+     */
+    void invalidateReadOperators();
+
     //=========================================================================================================
     /**
      * True if fiff raw data are empty.
@@ -192,6 +215,74 @@ public:
                                 float to,
                                 const Eigen::RowVectorXi& sel = defaultRowVectorXi) const;
 
+    //=========================================================================================================
+    /**
+     * Reads a single raw data buffer. Readers which need many (possibly overlapping) segments can walk rawdir
+     * once and decode every buffer only once instead of calling read_raw_segment for every segment.
+     *
+     * @param[in] iBuffer    index of the buffer in rawdir.
+     * @param[out] data      returns the calibrated, compensated and projected data of the buffer (channels x rawdir[iBuffer].nsamp).
+     * @param[in] sel        channel selection vector (optional).
+     *
+     * @return true if succeeded, false otherwise.
+     */
+    bool read_raw_buffer(qint32 iBuffer,
+                         Eigen::MatrixXd& data,
+                         const Eigen::RowVectorXi& sel = defaultRowVectorXi) const;
+
+private:
+    //=========================================================================================================
+    /**
+     * Reads the samples firstPick ... firstPick+nPick-1 of a single raw data buffer and writes them calibrated,
+     * compensated and projected to the columns dest ... dest+nPick-1 of data. The samples are converted directly
+     * from the memory-mapped file whenever the underlying device is a QFile. Otherwise the buffer is read as a tag.
+     *
+     * @param[in] rawDir         the raw directory entry of the buffer.
+     * @param[in] firstPick      first sample of the buffer to read.
+     * @param[in] nPick          number of samples to read.
+     * @param[in] sel            channel selection vector.
+     * @param[in] calSel         calibration factors of the output rows. Only used when mult is empty.
+     * @param[in] mult           the multiplication matrix (compensator, projection, calibration). Might be empty.
+     * @param[in, out] data      the output data matrix.
+     * @param[in] dest           first column of data to write to.
+     * @param[in, out] matScratch    scratch matrix holding all channels when mult needs to be applied.
+     *
+     * @return true if succeeded, false otherwise.
+     */
+    bool read_raw_buffer(const FiffRawDir& rawDir,
+                         fiff_int_t firstPick,
+                         fiff_int_t nPick,
+                         const Eigen::RowVectorXi& sel,
+                         const Eigen::VectorXd& calSel,
+                         const Eigen::SparseMatrix<double>& mult,
+                         Eigen::MatrixXd& data,
+                         fiff_int_t dest,
+                         Eigen::MatrixXd& matScratch) const;
+
+    //=========================================================================================================
+    /**
+     * Maps the fiff file into memory. The mapping is created once and reused until the file is closed.
+     *
+     * @param[out] size      the size of the mapping in bytes.
+     *
+     * @return pointer to the mapped file, NULL if the device is not a file or could not be mapped.
+     */
+    const uchar* map_file(qint64& size) const;
+
+    struct RawReadOperator;
+    struct RawReadCache;
+
+    //=========================================================================================================
+    /**
+     * Returns the calibration and multiplication matrices for the given selection. The matrices are built once
+     * and reused as long as the selection and the operator version stay the same.
+     *
+     * @param[in] sel        channel selection vector.
+     *
+     * @return the calibration and multiplication matrices.
+     */
+    QSharedPointer<const RawReadOperator> read_operator(const Eigen::RowVectorXi& sel) const;
+
 public:
     FiffStream::SPtr file;      /**< replaces fid */
     FiffInfo info;              /**< Fiff measurement information */
@@ -199,9 +290,12 @@ public:
     fiff_int_t last_samp;       /**< Do we have a skip ToDo... */
     Eigen::RowVectorXd cals;    /**< Calibration values. ToDo: Check if RowVectorXd is enough */
     QList<FiffRawDir> rawdir;   /**< Special fiff diretory entry for raw data. */
-    Eigen::MatrixXd proj;       /**< SSP operator to apply to the data. */
-    FiffCtfComp comp;           /**< Compensator. */
+    Eigen::MatrixXd proj;       /**< SSP operator to apply to the data. Call invalidateReadOperators after modifying it in place. */
+    FiffCtfComp comp;           /**< Compensator. Call invalidateReadOperators after modifying it in place. */
 
+private:
+    QSharedPointer<RawReadCache> m_pReadCache;  /**< File mapping and calibration/projection operators shared by all reads. */
+    int m_iOperatorVersion;                     /**< Identifies proj, comp and cals. A new, globally unique value is drawn whenever they change. */
 
 };
 } // NAMESPACE
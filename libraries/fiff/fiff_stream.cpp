@@ -1892,6 +1892,7 @@ bool FiffStream::setup_read_raw(QIODevice &p_IODevice,
     //
     data.cals       = cals;
     data.rawdir     = rawdir;
+    data.invalidateReadOperators();
     //data->proj       = [];
     //data.comp       = [];
     //
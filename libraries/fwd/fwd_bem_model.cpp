@@ -53,13 +53,19 @@
 #include <fiff/fiff_stream.h>
 #include <fiff/fiff_named_matrix.h>
 
+#include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QTemporaryFile>
+#include <QCryptographicHash>
 #include <QList>
 #include <QThread>
 #include <QtConcurrent>
+#include <QAtomicInt>
 
 #define _USE_MATH_DEFINES
 #include <math.h>
+#include <algorithm>
 
 #include <Eigen/Dense>
 
@@ -67,6 +73,8 @@ static float Qx[] = {1.0,0.0,0.0};
 static float Qy[] = {0.0,1.0,0.0};
 static float Qz[] = {0.0,0.0,1.0};
 
+#define FWD_BEM_FILL_TILE  64                  /* Number of rows per parallel tile when filling the BEM coefficients */
+
 #ifndef TRUE
 #define TRUE 1
 #endif
@@ -183,15 +191,94 @@ void fromFloatEigenMatrix_40(const Eigen::MatrixXf& from_mat, float **& to_mat)
     fromFloatEigenMatrix_40(from_mat, to_mat, from_mat.rows(), from_mat.cols());
 }
 
-float **mne_lu_invert_40(float **mat,int dim)
+#define LU_BLOCK_40 128                         /* Block size of the blocked LU decomposition */
+
+typedef Eigen::Matrix<float,Eigen::Dynamic,Eigen::Dynamic,Eigen::RowMajor> MatrixXfRowMajor_40;
+
+static bool mne_blocked_lu_40(Eigen::Map<MatrixXfRowMajor_40>& A, Eigen::VectorXi& perm)
 /*
-      * Invert a matrix using the LU decomposition from
-      * LAPACK
+ * In-place, cache-blocked LU decomposition with partial pivoting (P A = L U).
+ * The trailing matrix updates are distributed over all cores.
+ */
+{
+    const int n = A.rows();
+    int k0,kb,k,p,m;
+
+    perm.resize(n);
+    for (k = 0; k < n; k++)
+        perm[k] = k;
+
+    for (k0 = 0; k0 < n; k0 += LU_BLOCK_40) {
+        kb = std::min(LU_BLOCK_40,n-k0);
+        /*
+         * Factorize the panel, the row interchanges are applied to the whole rows
+         */
+        for (k = k0; k < k0+kb; k++) {
+            A.col(k).tail(n-k).cwiseAbs().maxCoeff(&p);
+            p += k;
+            if (A(p,k) == 0.0f)
+                return false;
+            if (p != k) {
+                A.row(k).swap(A.row(p));
+                std::swap(perm[k],perm[p]);
+            }
+            A.col(k).tail(n-k-1) /= A(k,k);
+            if (k+1 < k0+kb)
+                A.block(k+1,k+1,n-k-1,k0+kb-k-1).noalias() -= A.col(k).tail(n-k-1) * A.row(k).segment(k+1,k0+kb-k-1);
+        }
+        if (k0+kb == n)
+            break;
+        /*
+         * U12 = L11^-1 A12
+         */
+        m = n-k0-kb;
+        A.block(k0,k0,kb,kb).triangularView<Eigen::UnitLower>().solveInPlace(A.block(k0,k0+kb,kb,m));
+        /*
+         * A22 = A22 - L21 U12 in tiles of rows
+         */
+        QVector<int> tiles;
+        for (k = k0+kb; k < n; k += LU_BLOCK_40)
+            tiles.append(k);
+        QtConcurrent::blockingMap(tiles, [&](int r0) {
+            int rb = std::min(LU_BLOCK_40,n-r0);
+            A.block(r0,k0+kb,rb,m).noalias() -= A.block(r0,k0,rb,kb) * A.block(k0,k0+kb,kb,m);
+        });
+    }
+    return true;
+}
+
+float **FwdBemModel::fwd_bem_lu_invert(float **mat,int dim)
+/*
+      * Invert a matrix using a blocked, parallel LU decomposition
+      * The rows of mat are expected to be contiguous (ALLOC_CMATRIX_40)
       */
 {
-    Eigen::MatrixXf eigen_mat = toFloatEigenMatrix_40(mat, dim, dim);
-    Eigen::MatrixXf eigen_mat_inv = eigen_mat.inverse();
-    fromFloatEigenMatrix_40(eigen_mat_inv, mat);
+    Eigen::Map<MatrixXfRowMajor_40> A(mat[0],dim,dim);
+    Eigen::VectorXi perm;
+
+    if (!mne_blocked_lu_40(A,perm)) {
+        printf("Singular matrix in fwd_bem_lu_invert\n");
+        return NULL;
+    }
+    /*
+     * inv(A) = inv(U) inv(L) P, computed in independent tiles of columns
+     */
+    MatrixXfRowMajor_40 inv(dim,dim);
+    QVector<int> tiles;
+    for (int c0 = 0; c0 < dim; c0 += LU_BLOCK_40)
+        tiles.append(c0);
+    QtConcurrent::blockingMap(tiles, [&](int c0) {
+        int cb = std::min(LU_BLOCK_40,dim-c0);
+        Eigen::MatrixXf X = Eigen::MatrixXf::Zero(dim,cb);
+        for (int i = 0; i < dim; i++)
+            if (perm[i] >= c0 && perm[i] < c0+cb)
+                X(i,perm[i]-c0) = 1.0f;
+        A.triangularView<Eigen::UnitLower>().solveInPlace(X);
+        A.triangularView<Eigen::Upper>().solveInPlace(X);
+        inv.block(0,c0,dim,cb) = X;
+    });
+    A = inv;
+
     return mat;
 }
 
@@ -344,6 +431,7 @@ static struct {
 
 #define BEM_SUFFIX     "-bem.fif"
 #define BEM_SOL_SUFFIX "-bem-sol.fif"
+#define BEM_SOL_CACHE_DIR_ENV "MNE_BEM_SOLUTION_CACHE_DIR"   /* Overrides the directory of the solution cache */
 
 //============================= misc_util.c =============================
 
@@ -1054,10 +1142,7 @@ float **FwdBemModel::fwd_bem_lin_pot_coeff(const QList<MneSurfaceOld*>& surfs)
     float **sub_mat = NULL;
     int   np1,np2,ntri,np_tot,np_max;
     float **nodes;
-    MneTriangle*   tri;
-    double omega[3];
-    double *row = NULL;
-    int    j,k,p,q,c;
+    int    j,k,p,q;
     int    joff,koff;
     MneSurfaceOld* surf1;
     MneSurfaceOld* surf2;
@@ -1072,7 +1157,6 @@ float **FwdBemModel::fwd_bem_lin_pot_coeff(const QList<MneSurfaceOld*>& surfs)
     for (j = 0; j < np_tot; j++)
         for (k = 0; k < np_tot; k++)
             mat[j][k] = 0.0;
-    row        = MALLOC_40(np_max,double);
     sub_mat = MALLOC_40(np_max,float *);
     for (p = 0, joff = 0; p < surfs.size(); p++, joff = joff + np1) {
         surf1 = surfs[p];
@@ -1086,27 +1170,38 @@ float **FwdBemModel::fwd_bem_lin_pot_coeff(const QList<MneSurfaceOld*>& surfs)
             fprintf(stderr,"\t\t%s (%d) -> %s (%d) ... ",
                     fwd_bem_explain_surface(surf1->id).toUtf8().constData(),np1,
                     fwd_bem_explain_surface(surf2->id).toUtf8().constData(),np2);
-
-            for (j = 0; j < np1; j++) {
-                for (k = 0; k < np2; k++)
-                    row[k] = 0.0;
-                for (k = 0, tri = surf2->tris; k < ntri; k++,tri++) {
-                    /*
-               * No contribution from a triangle that
-               * this vertex belongs to
-               */
-                    if (p == q && (tri->vert[0] == j || tri->vert[1] == j || tri->vert[2] == j))
-                        continue;
-                    /*
-               * Otherwise do the hard job
-               */
-                    lin_pot_coeff (nodes[j],tri,omega);
-                    for (c = 0; c < 3; c++)
-                        row[tri->vert[c]] = row[tri->vert[c]] - omega[c];
+            /*
+             * The rows are independent of each other, compute them in parallel tiles
+             */
+            QVector<int> tiles;
+            for (j = 0; j < np1; j += FWD_BEM_FILL_TILE)
+                tiles.append(j);
+            QtConcurrent::blockingMap(tiles, [&](int j0) {
+                VectorXd     row(np2);
+                double       omega[3];
+                MneTriangle* tri;
+                int          jj,kk,c;
+
+                for (jj = j0; jj < std::min(j0+FWD_BEM_FILL_TILE,np1); jj++) {
+                    row.setZero();
+                    for (kk = 0, tri = surf2->tris; kk < ntri; kk++,tri++) {
+                        /*
+                         * No contribution from a triangle that
+                         * this vertex belongs to
+                         */
+                        if (p == q && (tri->vert[0] == jj || tri->vert[1] == jj || tri->vert[2] == jj))
+                            continue;
+                        /*
+                         * Otherwise do the hard job
+                         */
+                        lin_pot_coeff (nodes[jj],tri,omega);
+                        for (c = 0; c < 3; c++)
+                            row[tri->vert[c]] = row[tri->vert[c]] - omega[c];
+                    }
+                    for (kk = 0; kk < np2; kk++)
+                        mat[jj+joff][kk+koff] = row[kk];
                 }
-                for (k = 0; k < np2; k++)
-                    mat[j+joff][k+koff] = row[k];
-            }
+            });
             if (p == q) {
                 for (j = 0; j < np1; j++)
                     sub_mat[j] = mat[j+joff]+koff;
@@ -1115,7 +1210,6 @@ float **FwdBemModel::fwd_bem_lin_pot_coeff(const QList<MneSurfaceOld*>& surfs)
             fprintf(stderr,"[done]\n");
         }
     }
-    FREE_40(row);
     FREE_40(sub_mat);
     return(mat);
 }
@@ -1220,7 +1314,7 @@ float **FwdBemModel::fwd_bem_multi_solution(float **solids, float **gamma, int n
     for (k = 0; k < ntot; k++)
         solids[k][k] = solids[k][k] + 1.0;
 
-    return (mne_lu_invert_40(solids,ntot));
+    return (fwd_bem_lu_invert(solids,ntot));
 }
 
 //=============================================================================================================
@@ -1246,7 +1340,6 @@ void FwdBemModel::fwd_bem_ip_modify_solution(float **solution, float **ip_soluti
     int s;
     int j,k,joff,koff,ntot,nlast;
     float mult;
-    float *row = NULL;
     float **sub = NULL;
 
     for (s = 0, koff = 0; s < nsurf-1; s++)
@@ -1254,51 +1347,29 @@ void FwdBemModel::fwd_bem_ip_modify_solution(float **solution, float **ip_soluti
     nlast = ntri[nsurf-1];
     ntot  = koff + nlast;
 
-    row = MALLOC_40(nlast,float);
     sub = MALLOC_40(ntot,float *);
     mult = (1.0 + ip_mult)/ip_mult;
+    /*
+     * Both matrices are allocated with ALLOC_CMATRIX_40, i.e., their rows are contiguous
+     */
+    Map<MatrixXfRowMajor_40> ip(ip_solution[0],nlast,nlast);
 
     fprintf(stderr,"\t\tCombining...");
-#ifndef OLD
-    fprintf(stderr,"t ");
-    mne_transpose_square_40(ip_solution,nlast);
-#endif
     for (s = 0, joff = 0; s < nsurf; s++) {
         fprintf(stderr,"%d3 ",s+1);
         /*
-        * Pick the correct submatrix
-        */
-        for (j = 0; j < ntri[s]; j++)
-            sub[j] = solution[j+joff]+koff;
-        /*
-        * Multiply
+        * Pick the correct submatrix and multiply
         */
-#ifdef OLD
-        for (j = 0; j < ntri[s]; j++) {
-            for (k = 0; k < nlast; k++) {
-                res = mne_dot_vectors_skip_skip(sub[j],1,ip_solution[0]+k,nlast,nlast);
-                row[k] = sub[j][k] - 2.0*res;
-            }
-            for (k = 0; k < nlast; k++)
-                sub[j][k] = row[k];
-        }
-#else
-        for (j = 0; j < ntri[s]; j++) {
-            for (k = 0; k < nlast; k++)
-                row[k] = mne_dot_vectors_40(sub[j],ip_solution[k],nlast);
-            mne_add_scaled_vector_to_40(row,-2.0,sub[j],nlast);
-        }
-#endif
+        Map<MatrixXfRowMajor_40,0,OuterStride<> > sub_sol(solution[joff]+koff,ntri[s],nlast,OuterStride<>(ntot));
+        sub_sol -= 2.0f*(sub_sol*ip);
         joff = joff+ntri[s];
     }
-#ifndef OLD
-    fprintf(stderr,"t ");
-    mne_transpose_square_40(ip_solution,nlast);
-#endif
     fprintf(stderr,"33 ");
     /*
      * The lower right corner is a special case
      */
+    for (j = 0; j < nlast; j++)
+        sub[j] = solution[j+koff]+koff;
     for (j = 0; j < nlast; j++)
         for (k = 0; k < nlast; k++)
             sub[j][k] = sub[j][k] + mult*ip_solution[j][k];
@@ -1308,7 +1379,7 @@ void FwdBemModel::fwd_bem_ip_modify_solution(float **solution, float **ip_soluti
     fprintf(stderr,"done.\n\t\tScaling...");
     mne_scale_vector_40(ip_mult,solution[0],ntot*ntot);
     fprintf(stderr,"done.\n");
-    FREE_40(row); FREE_40(sub);
+    FREE_40(sub);
     return;
 }
 
@@ -1356,12 +1427,10 @@ float **FwdBemModel::fwd_bem_solid_angles(const QList<MneSurfaceOld*>& surfs)
 {
     MneSurfaceOld* surf1;
     MneSurfaceOld* surf2;
-    MneTriangle* tri;
     int ntri1,ntri2,ntri_tot;
-    int j,k,p,q;
+    int j,p,q;
     int joff,koff;
     float **solids;
-    float result;
     float **sub_solids = NULL;
     float desired;
 
@@ -1377,14 +1446,24 @@ float **FwdBemModel::fwd_bem_solid_angles(const QList<MneSurfaceOld*>& surfs)
             surf2 = surfs[q];
             ntri2 = surf2->ntri;
             fprintf(stderr,"\t\t%s (%d) -> %s (%d) ... ",fwd_bem_explain_surface(surf1->id).toUtf8().constData(),ntri1,fwd_bem_explain_surface(surf2->id).toUtf8().constData(),ntri2);
-            for (j = 0; j < ntri1; j++)
-                for (k = 0, tri = surf2->tris; k < ntri2; k++, tri++) {
-                    if (p == q && j == k)
-                        result = 0.0;
-                    else
-                        result = MneSurfaceOrVolume::solid_angle (surf1->tris[j].cent,tri);
-                    solids[j+joff][k+koff] = result;
-                }
+            /*
+             * The rows are independent of each other, compute them in parallel tiles
+             */
+            QVector<int> tiles;
+            for (j = 0; j < ntri1; j += FWD_BEM_FILL_TILE)
+                tiles.append(j);
+            QtConcurrent::blockingMap(tiles, [&](int j0) {
+                MneTriangle* tri;
+                int          jj,kk;
+
+                for (jj = j0; jj < std::min(j0+FWD_BEM_FILL_TILE,ntri1); jj++)
+                    for (kk = 0, tri = surf2->tris; kk < ntri2; kk++, tri++) {
+                        if (p == q && jj == kk)
+                            solids[jj+joff][kk+koff] = 0.0;
+                        else
+                            solids[jj+joff][kk+koff] = MneSurfaceOrVolume::solid_angle (surf1->tris[jj].cent,tri);
+                    }
+            });
             for (j = 0; j < ntri1; j++)
                 sub_solids[j] = solids[j+joff]+koff;
             fprintf(stderr,"[done]\n");
@@ -1495,6 +1574,7 @@ int FwdBemModel::fwd_bem_load_recompute_solution(const QString& name, int bem_me
  */
 {
     int solres;
+    QString cache_name;
 
     if (!m) {
         printf ("No model specified for fwd_bem_load_recompute_solution");
@@ -1518,7 +1598,109 @@ int FwdBemModel::fwd_bem_load_recompute_solution(const QString& name, int bem_me
     }
     if (bem_method == FWD_BEM_UNKNOWN)
         bem_method = FWD_BEM_LINEAR_COLL;
-    return fwd_bem_compute_solution(m,bem_method);
+    /*
+     * A solution computed earlier for the same surfaces and conductivities may be cached next to the BEM file
+     */
+    cache_name = fwd_bem_solution_cache_name(name,bem_method,m);
+    if (!force_recompute && QFile::exists(cache_name)) {
+        if(m)
+            m->fwd_bem_free_solution();
+        if (fwd_bem_load_solution(cache_name,bem_method,m) == TRUE) {
+            fprintf(stderr,"\nLoaded cached %s BEM solution from %s\n",fwd_bem_explain_method(m->bem_method).toUtf8().constData(),cache_name.toUtf8().constData());
+            return OK;
+        }
+    }
+    if (fwd_bem_compute_solution(m,bem_method) == FAIL)
+        return FAIL;
+    /*
+     * Caching is optional, skip it if the cache directory cannot be written to
+     */
+    QFileInfo cacheDir(QFileInfo(cache_name).absolutePath());
+    if (!cacheDir.isDir() || !cacheDir.isWritable())
+        return OK;
+    fprintf(stderr,"Writing the BEM solution cache to %s...",cache_name.toUtf8().constData());
+    if (fwd_bem_save_solution(cache_name,m) == OK)
+        fprintf(stderr,"[done]\n");
+    else
+        fprintf(stderr,"[failed] The solution will be recomputed next time\n");
+    return OK;
+}
+
+//=============================================================================================================
+
+QString FwdBemModel::fwd_bem_solution_cache_name(const QString& name, int bem_method, FwdBemModel *m)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    MneSurfaceOld* surf;
+    int s,k;
+
+    hash.addData((const char*)&bem_method,sizeof(int));
+    hash.addData((const char*)&m->nsurf,sizeof(int));
+    hash.addData((const char*)m->sigma,m->nsurf*sizeof(float));
+    hash.addData((const char*)&m->ip_approach_limit,sizeof(float));
+    for (s = 0; s < m->nsurf; s++) {
+        surf = m->surfs[s];
+        hash.addData((const char*)&surf->id,sizeof(int));
+        hash.addData((const char*)&surf->np,sizeof(int));
+        hash.addData((const char*)&surf->ntri,sizeof(int));
+        for (k = 0; k < surf->np; k++)
+            hash.addData((const char*)surf->rr[k],3*sizeof(float));
+        for (k = 0; k < surf->ntri; k++)
+            hash.addData((const char*)surf->tris[k].vert,3*sizeof(int));
+    }
+
+    QFileInfo fileInfo(name);
+    QString cache_dir = QString::fromLocal8Bit(qgetenv(BEM_SOL_CACHE_DIR_ENV));
+    if (cache_dir.isEmpty())
+        cache_dir = fileInfo.absolutePath();
+    return QString("%1/%2-%3-sol.fif").arg(QDir(cache_dir).absolutePath())
+                                       .arg(fileInfo.completeBaseName())
+                                       .arg(QString(hash.result().toHex().left(16)));
+}
+
+//=============================================================================================================
+
+int FwdBemModel::fwd_bem_save_solution(const QString& name, FwdBemModel *m)
+{
+    if (!m || !m->solution) {
+        printf("No solution available for fwd_bem_save_solution\n");
+        return FAIL;
+    }
+
+    /*
+     * Write to a temporary file first and move it into place when complete, i.e., concurrent readers and
+     * interrupted writes never leave a truncated solution behind
+     */
+    QTemporaryFile file(name + ".XXXXXX");
+    file.setAutoRemove(false);
+    FiffStream::SPtr stream = FiffStream::start_file(file);
+    if (!stream) {
+        printf("Could not write the BEM solution to %s\n",name.toUtf8().constData());
+        return FAIL;
+    }
+    QString tmp_name = file.fileName();
+
+    int approx = m->bem_method == FWD_BEM_LINEAR_COLL ? FIFFV_BEM_APPROX_LINEAR : FIFFV_BEM_APPROX_CONST;
+
+    stream->start_block(FIFFB_BEM);
+    stream->write_int(FIFF_BEM_APPROX,&approx);
+    stream->write_float_matrix(FIFF_BEM_POT_SOLUTION,Map<MatrixXfRowMajor_40>(m->solution[0],m->nsol,m->nsol));
+    stream->end_block(FIFFB_BEM);
+    stream->end_file();
+    file.close();
+
+    if (file.error() != QFile::NoError) {
+        printf("Could not write the BEM solution to %s\n",tmp_name.toUtf8().constData());
+        QFile::remove(tmp_name);
+        return FAIL;
+    }
+    QFile::remove(name);
+    if (!QFile::rename(tmp_name,name)) {
+        printf("Could not move the BEM solution to %s\n",name.toUtf8().constData());
+        QFile::remove(tmp_name);
+        return FAIL;
+    }
+    return OK;
 }
 
 //=============================================================================================================
@@ -1901,6 +2083,103 @@ int FwdBemModel::fwd_bem_pot_els(float *rd, float *Q, FwdCoilSet *els, float *po
 
 //=============================================================================================================
 
+void FwdBemModel::fwd_bem_inf_pot_block(float **rd, float **Q, int ndip, FwdBemModel *m, MatrixXf& matV0)
+{
+    MneTriangle* tri;
+    float        **rr;
+    int          s,j,k,p,npoint;
+    float        mult,mri_rd[3],mri_Q[3];
+
+    matV0.resize(m->nsol,ndip);
+
+    for (j = 0; j < ndip; j++) {
+        VEC_COPY_40(mri_rd,rd[j]);
+        VEC_COPY_40(mri_Q,Q[j]);
+        if (m->head_mri_t) {
+            FiffCoordTransOld::fiff_coord_trans(mri_rd,m->head_mri_t,FIFFV_MOVE);
+            FiffCoordTransOld::fiff_coord_trans(mri_Q,m->head_mri_t,FIFFV_NO_MOVE);
+        }
+        float *v0 = matV0.col(j).data();
+        for (s = 0, p = 0; s < m->nsurf; s++) {
+            mult = m->source_mult[s];
+            if (m->bem_method == FWD_BEM_LINEAR_COLL) {
+                npoint = m->surfs[s]->np;
+                rr     = m->surfs[s]->rr;
+                for (k = 0; k < npoint; k++)
+                    v0[p++] = mult*fwd_bem_inf_pot(mri_rd,mri_Q,rr[k]);
+            }
+            else {
+                npoint = m->surfs[s]->ntri;
+                tri    = m->surfs[s]->tris;
+                for (k = 0; k < npoint; k++, tri++)
+                    v0[p++] = mult*fwd_bem_inf_pot(mri_rd,mri_Q,tri->cent);
+            }
+        }
+    }
+}
+
+//=============================================================================================================
+
+void FwdBemModel::fwd_bem_pot_calc_block(float **rd, float **Q, int ndip, FwdBemModel *m, FwdCoilSet *els, int all_surfs, float **pot)
+{
+    float       **solution;
+    int         j,k,nsol;
+    MatrixXf    matV0;
+
+    fwd_bem_inf_pot_block(rd,Q,ndip,m,matV0);
+
+    if (els) {
+        FwdBemSolution* sol = (FwdBemSolution*)els->user_data;
+        solution = sol->solution;
+        nsol     = sol->ncoil;
+    }
+    else {
+        solution = m->solution;
+        if (all_surfs)
+            nsol = m->nsol;
+        else
+            nsol = m->bem_method == FWD_BEM_LINEAR_COLL ? m->surfs[0]->np : m->surfs[0]->ntri;
+    }
+    /*
+     * The solution matrices are allocated with ALLOC_CMATRIX_40, i.e., their rows are contiguous
+     */
+    Map<const Matrix<float,Dynamic,Dynamic,RowMajor> > matSolution(solution[0],nsol,m->nsol);
+    MatrixXf matPot = matSolution * matV0;
+
+    for (j = 0; j < ndip; j++)
+        for (k = 0; k < nsol; k++)
+            pot[j][k] = matPot(k,j);
+}
+
+//=============================================================================================================
+
+int FwdBemModel::fwd_bem_pot_els_block(float **rd, float **Q, int ndip, FwdCoilSet *els, float **pot, void *client)
+{
+    FwdBemModel*    m = (FwdBemModel*)client;
+    FwdBemSolution* sol = (FwdBemSolution*)els->user_data;
+
+    if (!m) {
+        printf("No BEM model specified to fwd_bem_pot_els_block");
+        return FAIL;
+    }
+    if (!m->solution) {
+        printf("No solution available for fwd_bem_pot_els_block");
+        return FAIL;
+    }
+    if (!sol || sol->ncoil != els->ncoil) {
+        printf("No appropriate electrode-specific data available in fwd_bem_pot_els_block");
+        return FAIL;
+    }
+    if (m->bem_method != FWD_BEM_CONSTANT_COLL && m->bem_method != FWD_BEM_LINEAR_COLL) {
+        printf("Unknown BEM method : %d",m->bem_method);
+        return FAIL;
+    }
+    fwd_bem_pot_calc_block(rd,Q,ndip,m,els,FALSE,pot);
+    return OK;
+}
+
+//=============================================================================================================
+
 int FwdBemModel::fwd_bem_pot_grad_els(float *rd, float *Q, FwdCoilSet *els, float *pot, float *xgrad, float *ygrad, float *zgrad, void *client) /* The model */
 /*
      * This version calculates the potential on all surfaces
@@ -2859,6 +3138,66 @@ int FwdBemModel::fwd_bem_field(float *rd, float *Q, FwdCoilSet *coils, float *B,
 
 //=============================================================================================================
 
+void FwdBemModel::fwd_bem_field_calc_block(float **rd, float **Q, int ndip, FwdCoilSet *coils, FwdBemModel *m, float **B)
+{
+    FwdBemSolution* sol = (FwdBemSolution*)coils->user_data;
+    FwdCoil*        coil;
+    int             j,k,p;
+    float           prim;
+    MatrixXf        matV0;
+    /*
+     * Infinite-medium potentials of all dipoles
+     */
+    fwd_bem_inf_pot_block(rd,Q,ndip,m,matV0);
+    /*
+     * Volume current contribution of all dipoles with one matrix-matrix product
+     * (the coil solution is allocated with ALLOC_CMATRIX_40, i.e., its rows are contiguous)
+     */
+    Map<const Matrix<float,Dynamic,Dynamic,RowMajor> > matSolution(sol->solution[0],coils->ncoil,m->nsol);
+    MatrixXf matB = matSolution * matV0;
+    /*
+     * Primary current contribution
+     * (can be calculated in the coil/dipole coordinates)
+     */
+    for (j = 0; j < ndip; j++) {
+        for (k = 0; k < coils->ncoil; k++) {
+            coil = coils->coils[k];
+            prim = 0.0;
+            for (p = 0; p < coil->np; p++)
+                prim = prim + coil->w[p]*fwd_bem_inf_field(rd[j],Q[j],coil->rmag[p],coil->cosmag[p]);
+            /*
+             * Scale correctly
+             */
+            B[j][k] = MAG_FACTOR*(prim + matB(k,j));
+        }
+    }
+}
+
+//=============================================================================================================
+
+int FwdBemModel::fwd_bem_field_block(float **rd, float **Q, int ndip, FwdCoilSet *coils, float **B, void *client)
+{
+    FwdBemModel* m = (FwdBemModel*)client;
+    FwdBemSolution* sol = (FwdBemSolution*)coils->user_data;
+
+    if (!m) {
+        printf("No BEM model specified to fwd_bem_field_block");
+        return FAIL;
+    }
+    if (!sol || !sol->solution || sol->ncoil != coils->ncoil) {
+        printf("No appropriate coil-specific data available in fwd_bem_field_block");
+        return FAIL;
+    }
+    if (m->bem_method != FWD_BEM_CONSTANT_COLL && m->bem_method != FWD_BEM_LINEAR_COLL) {
+        printf("Unknown BEM method : %d",m->bem_method);
+        return FAIL;
+    }
+    fwd_bem_field_calc_block(rd,Q,ndip,coils,m,B);
+    return OK;
+}
+
+//=============================================================================================================
+
 int FwdBemModel::fwd_bem_field_grad(float *rd,
                                     float Q[],
                                     FwdCoilSet *coils,
@@ -2932,13 +3271,18 @@ void *FwdBemModel::meg_eeg_fwd_one_source_space(void *arg)
     FwdThreadArg* a = (FwdThreadArg*)arg;
     MneSourceSpaceOld* s = a->s;
     int            j,p,q;
+    int            from = a->from;                        /* The range of source points to process */
+    int            to   = a->to < 0 ? s->np : a->to;
     float          *xyz[3];
 
+    if (a->field_pot_block && !(a->field_pot_grad && a->res_grad))
+        return meg_eeg_fwd_one_source_space_block(arg);
+
     p = a->off;
     q = 3*a->off;
     if (a->fixed_ori) {					  /* The normal source component only */
         if (a->field_pot_grad && a->res_grad) {                   /* Gradient requested? */
-            for (j = 0; j < s->np; j++) {
+            for (j = from; j < to; j++) {
                 if (s->inuse[j]) {
                     if (a->field_pot_grad(s->rr[j],
                                           s->nn[j],
@@ -2955,7 +3299,7 @@ void *FwdBemModel::meg_eeg_fwd_one_source_space(void *arg)
                 }
             }
         } else {
-            for (j = 0; j < s->np; j++)
+            for (j = from; j < to; j++)
                 if (s->inuse[j])
                     if (a->field_pot(s->rr[j],
                                      s->nn[j],
@@ -2967,7 +3311,7 @@ void *FwdBemModel::meg_eeg_fwd_one_source_space(void *arg)
     }
     else {						  /* All source components */
         if (a->field_pot_grad && a->res_grad) {               /* Gradient requested? */
-            for (j = 0; j < s->np; j++) {
+            for (j = from; j < to; j++) {
                 if (s->inuse[j]) {
                     if (a->comp < 0) {				  /* Compute all components */
                         if (a->field_pot_grad(s->rr[j],
@@ -3047,7 +3391,7 @@ void *FwdBemModel::meg_eeg_fwd_one_source_space(void *arg)
             }
         }
         else {
-            for (j = 0; j < s->np; j++) {
+            for (j = from; j < to; j++) {
                 if (s->inuse[j]) {
                     if (a->vec_field_pot) {
                         xyz[0] = a->res[p++];
@@ -3097,6 +3441,137 @@ bad : {
 
 //=============================================================================================================
 
+void *FwdBemModel::meg_eeg_fwd_one_source_space_block(void *arg)
+/*
+ * Compute the MEG or EEG forward solution for one source space
+ * and possibly for only one source component in blocks of dipoles
+ */
+{
+    FwdThreadArg*      a = (FwdThreadArg*)arg;
+    MneSourceSpaceOld* s = a->s;
+    float              *Qxyz[3] = { Qx, Qy, Qz };
+    float              *rd[FWD_BEM_BLOCK_SIZE];
+    float              *Q[FWD_BEM_BLOCK_SIZE];
+    float              *res[FWD_BEM_BLOCK_SIZE];
+    int                j,c,p,ndip;
+    int                from = a->from;              /* The range of source points to process */
+    int                to   = a->to < 0 ? s->np : a->to;
+
+    for (j = from, p = a->off, ndip = 0; j < to; j++) {
+        if (!s->inuse[j])
+            continue;
+        if (a->fixed_ori) {				  /* The normal source component only */
+            rd[ndip]  = s->rr[j];
+            Q[ndip]   = s->nn[j];
+            res[ndip] = a->res[p++];
+            ndip++;
+        }
+        else {						  /* All or one of the source components */
+            for (c = 0; c < 3; c++, p++) {
+                if (a->comp < 0 || a->comp == c) {
+                    rd[ndip]  = s->rr[j];
+                    Q[ndip]   = Qxyz[c];
+                    res[ndip] = a->res[p];
+                    ndip++;
+                }
+            }
+        }
+        /*
+         * Compute the block once the next source might not fit anymore
+         */
+        if (ndip > FWD_BEM_BLOCK_SIZE-3) {
+            if (a->field_pot_block(rd,Q,ndip,a->coils_els,res,a->client) != OK)
+                goto bad;
+            ndip = 0;
+        }
+    }
+    if (ndip > 0)
+        if (a->field_pot_block(rd,Q,ndip,a->coils_els,res,a->client) != OK)
+            goto bad;
+
+    a->stat = OK;
+    return NULL;
+
+bad : {
+        a->stat = FAIL;
+        return NULL;
+    }
+}
+
+//=============================================================================================================
+
+int FwdBemModel::fwd_compute_source_chunks(MneSourceSpaceOld **spaces, int nspace, const QList<FwdThreadArg*>& workers)
+{
+    struct SourceChunk {
+        MneSourceSpaceOld*  s;      /* The source space */
+        int                 from;   /* First source point */
+        int                 to;     /* One past the last source point */
+        int                 off;    /* Offset of the first source in the result */
+    };
+    QVector<SourceChunk> chunks;
+    SourceChunk          chunk;
+    int                  fixed_ori = workers.first()->fixed_ori;
+    int                  nsource,chunk_size,k,j,n,off;
+    /*
+     * Chunks of one block of dipoles, but at least four chunks per worker for load balancing
+     */
+    for (k = 0, nsource = 0; k < nspace; k++)
+        nsource += spaces[k]->nuse;
+    chunk_size = fixed_ori ? FWD_BEM_BLOCK_SIZE : FWD_BEM_BLOCK_SIZE/3;
+    chunk_size = qMax(1,qMin(chunk_size,nsource/(4*workers.size())));
+
+    for (k = 0, off = 0; k < nspace; k++) {
+        MneSourceSpaceOld* s = spaces[k];
+        for (j = 0, n = 0; j < s->np; j++) {
+            if (!s->inuse[j])
+                continue;
+            if (n == 0) {
+                chunk.s    = s;
+                chunk.from = j;
+                chunk.off  = off;
+            }
+            off = fixed_ori ? off + 1 : off + 3;
+            if (++n == chunk_size) {
+                chunk.to = j+1;
+                chunks.append(chunk);
+                n = 0;
+            }
+        }
+        if (n > 0) {
+            chunk.to = s->np;
+            chunks.append(chunk);
+        }
+    }
+    /*
+     * Start the workers & wait for them to complete
+     */
+    QAtomicInt iNextChunk(0);
+    QAtomicInt iFailed(0);
+    QList<QFuture<void> > futures;
+
+    for (FwdThreadArg* worker : workers) {
+        futures.append(QtConcurrent::run([&chunks, &iNextChunk, &iFailed, worker]() {
+            int c;
+            while (!iFailed.loadAcquire() && (c = iNextChunk.fetchAndAddOrdered(1)) < chunks.size()) {
+                worker->s    = chunks[c].s;
+                worker->from = chunks[c].from;
+                worker->to   = chunks[c].to;
+                worker->off  = chunks[c].off;
+                worker->comp = -1;
+                meg_eeg_fwd_one_source_space(worker);
+                if (worker->stat != OK)
+                    iFailed.storeRelease(1);
+            }
+        }));
+    }
+    for (k = 0; k < futures.size(); k++)
+        futures[k].waitForFinished();
+
+    return iFailed.loadAcquire() ? FAIL : OK;
+}
+
+//=============================================================================================================
+
 int FwdBemModel::compute_forward_meg(MneSourceSpaceOld **spaces,
                                      int nspace,
                                      FwdCoilSet *coils,
@@ -3124,9 +3599,10 @@ int FwdBemModel::compute_forward_meg(MneSourceSpaceOld **spaces,
     fwdVecFieldFunc     vec_field;          /* Computes the field for all dipole orientations */
     fwdFieldGradFunc    field_grad;         /* Computes the field and gradient with respect to dipole position
                                              * for one dipole orientation */
+    fwdBlockFieldFunc   field_block = NULL; /* Computes the field for a block of dipoles */
     int                 nmeg = coils->ncoil;/* Number of channels */
     int                 nsource;            /* Total number of sources */
-    int                 k,p,q,off;
+    int                 k,off;
     QStringList         names;              /* Channel names */
     void                *client;
     FwdThreadArg*       one_arg = NULL;
@@ -3178,6 +3654,11 @@ int FwdBemModel::compute_forward_meg(MneSourceSpaceOld **spaces,
         vec_field  = NULL;
         field_grad = FwdCompData::fwd_comp_field_grad;
         client     = comp;
+        /*
+         * Blocks of dipoles share one matrix-matrix product with the BEM solution
+         */
+        comp->block_field = FwdBemModel::fwd_bem_field_block;
+        field_block       = FwdCompData::fwd_comp_field_block;
     }
     else {
         /*
@@ -3237,57 +3718,25 @@ int FwdBemModel::compute_forward_meg(MneSourceSpaceOld **spaces,
     one_arg->field_pot      = field;
     one_arg->vec_field_pot  = vec_field;
     one_arg->field_pot_grad = field_grad;
+    one_arg->field_pot_block = field_block;
 
     if (nproc < 2)
         use_threads = false;
 
     if (use_threads) {
-        int            nthread  = (fixed_ori || vec_field || nproc < 6) ? nspace : 3*nspace;
-        QList <FwdThreadArg*> args; //fwdThreadArg   *args    = MALLOC_40(nthread,fwdThreadArg);
+        QList <FwdThreadArg*> args;
         int            stat;
         /*
-        * We need copies to allocate separate workspace for each thread
+        * One copy per worker to allocate separate workspace for each thread. The workers pick up chunks of
+        * source points until all are computed, hence all cores are used independent of the number of source spaces.
         */
-        if (fixed_ori || vec_field || nproc < 6) {
-            for (k = 0, off = 0; k < nthread; k++) {
-                FwdThreadArg* t_arg = FwdThreadArg::create_meg_multi_thread_duplicate(one_arg,bem_model != NULL);
-                t_arg->s   = spaces[k];
-                t_arg->off = off;
-                off = fixed_ori ? off + spaces[k]->nuse : off + 3*spaces[k]->nuse;
-                args.append(t_arg);
-            }
-            fprintf(stderr,"%d processors. I will use one thread for each of the %d source spaces.\n",
-                    nproc,nspace);
-        }
-        else {
-            for (k = 0, off = 0, q = 0; k < nspace; k++) {
-                for (p = 0; p < 3; p++,q++) {
-                    FwdThreadArg* t_arg = FwdThreadArg::create_meg_multi_thread_duplicate(one_arg,bem_model != NULL);
-                    t_arg->s    = spaces[k];
-                    t_arg->off  = off;
-                    t_arg->comp = p;
-                    args.append(t_arg);
-                }
-                off = fixed_ori ? off + spaces[k]->nuse : off + 3*spaces[k]->nuse;
-            }
-            fprintf(stderr,"%d processors. I will use %d threads : %d source spaces x 3 source components.\n",
-                    nproc,nthread,nspace);
-        }
+        for (k = 0; k < nproc; k++)
+            args.append(FwdThreadArg::create_meg_multi_thread_duplicate(one_arg,bem_model != NULL));
+        fprintf(stderr,"%d processors. I will use %d threads working on chunks of source points.\n",nproc,nproc);
         fprintf(stderr,"Computing MEG at %d source locations (%s orientations)...",
                 nsource,fixed_ori ? "fixed" : "free");
-        /*
-        * Ready to start the threads & Wait for them to complete
-        */
-        QtConcurrent::blockingMap(args, meg_eeg_fwd_one_source_space);
-        /*
-        * Check the results
-        */
-        for (k = 0, stat = OK; k < nthread; k++)
-            if (args[k]->stat != OK) {
-                stat = FAIL;
-                break;
-            }
-        for (k = 0; k < args.size(); k++)//nthread == args.size()
+        stat = fwd_compute_source_chunks(spaces,nspace,args);
+        for (k = 0; k < args.size(); k++)
             FwdThreadArg::free_meg_multi_thread_duplicate(args[k],bem_model != NULL);
         if (stat != OK)
             goto bad;
@@ -3385,9 +3834,10 @@ int FwdBemModel::compute_forward_eeg(MneSourceSpaceOld **spaces,
     fwdVecFieldFunc  vec_pot;               /* Computes the potentials for all dipole orientations */
     fwdFieldGradFunc pot_grad;              /* Computes the potential and gradient with respect to dipole position
                                              * for one dipole orientation */
+    fwdBlockFieldFunc pot_block = NULL;     /* Computes the potentials for a block of dipoles */
     int             nsource;                /* Total number of sources */
     int             neeg = els->ncoil;      /* Number of channels */
-    int             k,p,q,off;
+    int             k,off;
     QStringList     names;                  /* Channel names */
     void            *client;
     FwdThreadArg*   one_arg = NULL;
@@ -3405,6 +3855,7 @@ int FwdBemModel::compute_forward_eeg(MneSourceSpaceOld **spaces,
         client   = bem_model;
         pot      = fwd_bem_pot_els;
         vec_pot  = NULL;
+        pot_block = fwd_bem_pot_els_block;
 #ifdef TEST
         fprintf(stderr,"Using differences.\n");
         pot_grad = my_bem_pot_grad;
@@ -3458,55 +3909,25 @@ int FwdBemModel::compute_forward_eeg(MneSourceSpaceOld **spaces,
     one_arg->field_pot      = pot;
     one_arg->vec_field_pot  = vec_pot;
     one_arg->field_pot_grad = pot_grad;
+    one_arg->field_pot_block = pot_block;
 
     if (nproc < 2)
         use_threads = false;
 
     if (use_threads) {
-        int            nthread  = (fixed_ori || vec_pot || nproc < 6) ? nspace : 3*nspace;
-        QList <FwdThreadArg*> args; //FwdThreadArg*   *args    = MALLOC_40(nthread,FwdThreadArg*);
+        QList <FwdThreadArg*> args;
         int            stat;
         /*
-        * We need copies to allocate separate workspace for each thread
+        * One copy per worker to allocate separate workspace for each thread. The workers pick up chunks of
+        * source points until all are computed, hence all cores are used independent of the number of source spaces.
         */
-        if (fixed_ori || vec_pot || nproc < 6) {
-            for (k = 0, off = 0; k < nthread; k++) {
-                FwdThreadArg* t_arg = FwdThreadArg::create_eeg_multi_thread_duplicate(one_arg,bem_model != NULL);
-                t_arg->s   = spaces[k];
-                t_arg->off = off;
-                off = fixed_ori ? off + spaces[k]->nuse : off + 3*spaces[k]->nuse;
-                args.append(t_arg);
-            }
-            printf("%d processors. I will use one thread for each of the %d source spaces.\n",nproc,nspace);
-        }
-        else {
-            for (k = 0, off = 0, q = 0; k < nspace; k++) {
-                for (p = 0; p < 3; p++,q++) {
-                    FwdThreadArg* t_arg = FwdThreadArg::create_eeg_multi_thread_duplicate(one_arg,bem_model != NULL);
-                    t_arg->s    = spaces[k];
-                    t_arg->off  = off;
-                    t_arg->comp = p;
-                    args.append(t_arg);
-                }
-                off = fixed_ori ? off + spaces[k]->nuse : off + 3*spaces[k]->nuse;
-            }
-            printf("%d processors. I will use %d threads : %d source spaces x 3 source components.\n",nproc,nthread,nspace);
-        }
+        for (k = 0; k < nproc; k++)
+            args.append(FwdThreadArg::create_eeg_multi_thread_duplicate(one_arg,bem_model != NULL));
+        printf("%d processors. I will use %d threads working on chunks of source points.\n",nproc,nproc);
         printf("Computing EEG at %d source locations (%s orientations)...",
                 nsource,fixed_ori ? "fixed" : "free");
-        /*
-        * Ready to start the threads & Wait for them to complete
-        */
-        QtConcurrent::blockingMap(args, meg_eeg_fwd_one_source_space);
-        /*
-        * Check the results
-        */
-        for (k = 0, stat = OK; k < nthread; k++)
-            if (args[k]->stat != OK) {
-                stat = FAIL;
-                break;
-            }
-        for (k = 0; k < args.size(); k++)//nthread == args.size()
+        stat = fwd_compute_source_chunks(spaces,nspace,args);
+        for (k = 0; k < args.size(); k++)
             FwdThreadArg::free_eeg_multi_thread_duplicate(args[k],bem_model != NULL);
         if (stat != OK)
             goto bad;
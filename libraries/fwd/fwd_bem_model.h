@@ -61,6 +61,7 @@
 
 #include <QSharedPointer>
 #include <QString>
+#include <QList>
 
 #define FWD_BEM_UNKNOWN           -1
 #define FWD_BEM_CONSTANT_COLL     1
@@ -72,6 +73,8 @@
 #define FWD_BEM_LIN_FIELD_FERGUSON  2
 #define FWD_BEM_LIN_FIELD_URANKAR   3
 
+#define FWD_BEM_BLOCK_SIZE 128      /* Number of dipoles per block in the block field computations */
+
 //=============================================================================================================
 // FORWARD DECLARATIONS
 //=============================================================================================================
@@ -100,6 +103,7 @@ namespace FWDLIB
 //=============================================================================================================
 
 class FwdEegSphereModel;
+class FwdThreadArg;
 
 //=============================================================================================================
 /**
@@ -214,6 +218,18 @@ public:
 
     //============================= fwd_bem_solution.c =============================
 
+    //=========================================================================================================
+    /**
+     * Inverts a matrix in place with a blocked, parallel LU decomposition with partial pivoting.
+     *
+     * @param[in, out] mat   The matrix, its rows have to be contiguous in memory (ALLOC_CMATRIX).
+     * @param[in] dim        The dimension of the matrix.
+     *
+     * @return mat holding the inverse, or NULL if the matrix is singular.
+     */
+    static float **fwd_bem_lu_invert(float **mat,
+                                     int dim);
+
     static float **fwd_bem_multi_solution (float **solids,    /* The solid-angle matrix */
                                     float **gamma,     /* The conductivity multipliers */
                                     int   nsurf,       /* Number of surfaces */
@@ -245,6 +261,36 @@ public:
                                         int         force_recompute,
                                         FwdBemModel* m);
 
+    //=========================================================================================================
+    /**
+     * Returns the name of the file in which the solution of the model is cached. The file resides next to the
+     * BEM file, or in the directory given by the environment variable MNE_BEM_SOLUTION_CACHE_DIR, and its name
+     * contains a hash of the surfaces, the conductivities and the method, i.e., a changed model never picks up a
+     * stale solution. The cache is not written if the directory is not writable.
+     *
+     * @param[in] name           The name of the BEM file.
+     * @param[in] bem_method     The BEM method.
+     * @param[in] m              The model.
+     *
+     * @return The name of the cache file.
+     */
+    static QString fwd_bem_solution_cache_name(const QString& name,
+                                               int         bem_method,
+                                               FwdBemModel* m);
+
+    //=========================================================================================================
+    /**
+     * Writes the solution of the model to a FIFF file, which can be read with fwd_bem_load_solution. The file is
+     * written under a temporary name and renamed when complete.
+     *
+     * @param[in] name   The name of the file.
+     * @param[in] m      The model.
+     *
+     * @return OK or FAIL.
+     */
+    static int fwd_bem_save_solution(const QString& name,
+                                     FwdBemModel* m);
+
     //============================= fwd_bem_pot.c =============================
 
     static float fwd_bem_inf_field(float *rd,      /* Dipole position */
@@ -297,6 +343,64 @@ public:
                          float       *pot,    /* Result */
                          void        *client);
 
+    //=========================================================================================================
+    /**
+     * Computes the infinite-medium potentials of a block of dipoles at the BEM collocation points (vertices for
+     * the linear, triangle centers for the constant collocation method).
+     *
+     * @param[in] rd         The dipole positions (ndip x 3).
+     * @param[in] Q          The dipole orientations (ndip x 3).
+     * @param[in] ndip       The number of dipoles.
+     * @param[in] m          The model.
+     * @param[out] matV0     The potentials (nsol x ndip).
+     */
+    static void fwd_bem_inf_pot_block(float       **rd,
+                                      float       **Q,
+                                      int         ndip,
+                                      FwdBemModel* m,
+                                      Eigen::MatrixXf& matV0);
+
+    //=========================================================================================================
+    /**
+     * Computes the potentials of a block of dipoles. The BEM solution is applied to all dipoles with a single
+     * matrix-matrix product. Works for both the linear and the constant collocation method.
+     *
+     * @param[in] rd         The dipole positions (ndip x 3).
+     * @param[in] Q          The dipole orientations (ndip x 3).
+     * @param[in] ndip       The number of dipoles.
+     * @param[in] m          The model.
+     * @param[in] els        Use this electrode set if available.
+     * @param[in] all_surfs  Compute on all surfaces?
+     * @param[out] pot       The potentials (ndip x nsol).
+     */
+    static void fwd_bem_pot_calc_block(float       **rd,
+                                       float       **Q,
+                                       int         ndip,
+                                       FwdBemModel* m,
+                                       FwdCoilSet*  els,
+                                       int         all_surfs,
+                                       float       **pot);
+
+    //=========================================================================================================
+    /**
+     * Block version of fwd_bem_pot_els.
+     *
+     * @param[in] rd         The dipole positions (ndip x 3).
+     * @param[in] Q          The dipole orientations (ndip x 3).
+     * @param[in] ndip       The number of dipoles.
+     * @param[in] els        The electrode descriptors.
+     * @param[out] pot       The potentials (ndip x nel).
+     * @param[in] client     The model.
+     *
+     * @return OK or FAIL.
+     */
+    static int fwd_bem_pot_els_block(float       **rd,
+                                     float       **Q,
+                                     int         ndip,
+                                     FwdCoilSet*  els,
+                                     float       **pot,
+                                     void        *client);
+
     static int fwd_bem_pot_grad_els (float       *rd,     /* Dipole position */
                   float       *Q,      /* Dipole orientation */
                   FwdCoilSet* els,     /* Electrode descriptors */
@@ -421,6 +525,45 @@ public:
                       float       *B,       /* Result */
                       void        *client);
 
+    //=========================================================================================================
+    /**
+     * Computes the magnetic field of a block of dipoles. The BEM solution is applied to all dipoles with a single
+     * matrix-matrix product. Works for both the linear and the constant collocation method.
+     *
+     * @param[in] rd         The dipole positions (ndip x 3).
+     * @param[in] Q          The dipole orientations (ndip x 3).
+     * @param[in] ndip       The number of dipoles.
+     * @param[in] coils      The coil descriptors.
+     * @param[in] m          The model.
+     * @param[out] B         The fields (ndip x ncoil).
+     */
+    static void fwd_bem_field_calc_block(float       **rd,
+                                         float       **Q,
+                                         int         ndip,
+                                         FwdCoilSet*  coils,
+                                         FwdBemModel* m,
+                                         float       **B);
+
+    //=========================================================================================================
+    /**
+     * Block version of fwd_bem_field. Call fwd_bem_specify_coils first.
+     *
+     * @param[in] rd         The dipole positions (ndip x 3).
+     * @param[in] Q          The dipole orientations (ndip x 3).
+     * @param[in] ndip       The number of dipoles.
+     * @param[in] coils      The coil descriptors.
+     * @param[out] B         The fields (ndip x ncoil).
+     * @param[in] client     The model.
+     *
+     * @return OK or FAIL.
+     */
+    static int fwd_bem_field_block(float       **rd,
+                                   float       **Q,
+                                   int         ndip,
+                                   FwdCoilSet*  coils,
+                                   float       **B,
+                                   void        *client);
+
     static int fwd_bem_field_grad(float        *rd,      /* The dipole location */
                    float        Q[],      /* The dipole components (xyz) */
                    FwdCoilSet*  coils,    /* The coil definitions */
@@ -434,6 +577,31 @@ public:
 
     static void *meg_eeg_fwd_one_source_space(void *arg);
 
+    //=========================================================================================================
+    /**
+     * Computes the MEG or EEG forward solution for one source space in blocks of dipoles with the block field
+     * computation function of the thread argument. Gradients are not supported.
+     *
+     * @param[in] arg    The thread argument (FwdThreadArg).
+     */
+    static void *meg_eeg_fwd_one_source_space_block(void *arg);
+
+    //=========================================================================================================
+    /**
+     * Computes the forward solution of all source spaces with a pool of workers. The source points are split
+     * into chunks, which idle workers take from a shared counter until all are done. Each chunk writes to fixed
+     * rows of the result, hence the output does not depend on the scheduling.
+     *
+     * @param[in] spaces     The source spaces.
+     * @param[in] nspace     The number of source spaces.
+     * @param[in] workers    One thread argument with its own workspace per worker.
+     *
+     * @return OK or FAIL.
+     */
+    static int fwd_compute_source_chunks(MNELIB::MneSourceSpaceOld* *spaces,
+                                         int                       nspace,
+                                         const QList<FwdThreadArg*>& workers);
+
     // TODO check if this is the correct class or move
     static int compute_forward_meg( MNELIB::MneSourceSpaceOld*  *spaces,        /**< Source spaces */
                                     int                         nspace,         /**< How many? */
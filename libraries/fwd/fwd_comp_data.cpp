@@ -131,6 +131,7 @@ FwdCompData::FwdCompData()
 ,field      (NULL)
 ,vec_field  (NULL)
 ,field_grad (NULL)
+,block_field(NULL)
 ,client     (NULL)
 ,client_free(NULL)
 ,set        (NULL)
@@ -356,6 +357,52 @@ int FwdCompData::fwd_comp_field_vec(float *rd, FwdCoilSet *coils, float **res, v
 
 //=============================================================================================================
 
+int FwdCompData::fwd_comp_field_block(float **rd, float **Q, int ndip, FwdCoilSet *coils, float **res, void *client)
+/*
+ * Calculate the compensated field (block of dipoles)
+ */
+{
+    FwdCompData* comp = (FwdCompData*)client;
+    float        **work;
+    int          k;
+
+    if (!comp->block_field) {
+        printf("Block field computation function is missing in fwd_comp_field_block");
+        return FAIL;
+    }
+    /*
+     * First compute the field in the primary set of coils
+     */
+    if (comp->block_field(rd,Q,ndip,coils,res,comp->client) == FAIL)
+        return FAIL;
+    /*
+     * Compensation needed?
+     */
+    if (!comp->comp_coils || comp->comp_coils->ncoil <= 0 || !comp->set || !comp->set->current)
+        return OK;
+    /*
+     * Compute the field in the compensation coils
+     */
+    work = ALLOC_CMATRIX_60(ndip,comp->comp_coils->ncoil);
+    if (comp->block_field(rd,Q,ndip,comp->comp_coils,work,comp->client) == FAIL) {
+        FREE_CMATRIX_60(work);
+        return FAIL;
+    }
+    /*
+     * Compute the compensated field of each dipole
+     */
+    for (k = 0; k < ndip; k++) {
+        if (MneCTFCompDataSet::mne_apply_ctf_comp(comp->set,TRUE,res[k],coils->ncoil,work[k],comp->comp_coils->ncoil) == FAIL) {
+            FREE_CMATRIX_60(work);
+            return FAIL;
+        }
+    }
+    FREE_CMATRIX_60(work);
+    return OK;
+}
+
+//=============================================================================================================
+
 int FwdCompData::fwd_comp_field_grad(float *rd, float *Q, FwdCoilSet* coils, float *res, float *xgrad, float *ygrad, float *zgrad, void *client)
 /*
  * Calculate the compensated field (one dipole component)
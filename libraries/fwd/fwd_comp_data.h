@@ -133,12 +133,28 @@ public:
                 float *res, float *xgrad, float *ygrad, float *zgrad,
                 void *client);
 
+    //=========================================================================================================
+    /**
+     * Calculates the compensated field of a block of dipoles with the block field computation function.
+     *
+     * @param[in] rd         The dipole positions (ndip x 3).
+     * @param[in] Q          The dipole orientations (ndip x 3).
+     * @param[in] ndip       The number of dipoles.
+     * @param[in] coils      The coil definitions.
+     * @param[out] res       The compensated fields (ndip x ncoil).
+     * @param[in] client     The compensation data.
+     *
+     * @return OK or FAIL.
+     */
+    static int fwd_comp_field_block(float **rd, float **Q, int ndip, FwdCoilSet* coils, float **res, void *client);
+
 public:
     MNELIB::MneCTFCompDataSet*  set;        /* The compensation data set */
     FwdCoilSet*         comp_coils; /* The compensation coil definitions */
     fwdFieldFunc        field;      /* Computes the field of given direction dipole */
     fwdVecFieldFunc     vec_field;  /* Computes the fields of all three dipole components  */
     fwdFieldGradFunc    field_grad; /* Computes the field and gradient of one dipole direction */
+    fwdBlockFieldFunc   block_field;/* Computes the fields of a block of dipoles (optional) */
     void                *client;    /* Client data to pass to the above functions */
     fwdUserFreeFunc     client_free;
     float               *work;      /* The work areas */
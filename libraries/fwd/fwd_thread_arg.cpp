@@ -92,9 +92,12 @@ FwdThreadArg::FwdThreadArg()
 ,field_pot     (NULL)
 ,vec_field_pot (NULL)
 ,field_pot_grad(NULL)
+,field_pot_block(NULL)
 ,coils_els     (NULL)
 ,client        (NULL)
 ,s             (NULL)
+,from          (0)
+,to            (-1)
 ,fixed_ori     (FALSE)
 ,stat          (FAIL)
 ,comp          (-1)
@@ -119,9 +119,12 @@ public:
     fwdFieldFunc        field_pot;         /* Computes the field or potential for one dipole orientation */
     fwdVecFieldFunc     vec_field_pot;     /* Computes the field or potential for all dipole orientations */
     fwdFieldGradFunc    field_pot_grad;    /* Computes the gradient of field or potential for one dipole orientation */
+    fwdBlockFieldFunc   field_pot_block;   /* Computes the field or potential for a block of dipoles (optional) */
     FwdCoilSet          *coils_els;        /* The coil definitions */
     void                *client;           /* Client data for the field computation function */
     MNELIB::MneSourceSpaceOld   *s;                 /* The source space to process */
+    int                 from;              /* First source space point to process */
+    int                 to;                /* One past the last source space point to process (-1 = all) */
     int                 fixed_ori;         /* Compute fixed orientation solution? */
     int                 comp;              /* Which component to compute for free orientations */
     int                 stat;
@@ -21,6 +21,10 @@ typedef int (*fwdFieldFunc)(float *rd,float *Q,FWDLIB::FwdCoilSet* coils,float *
 typedef int (*fwdVecFieldFunc)(float *rd,FWDLIB::FwdCoilSet* coils,float **res,void *client);
 typedef int (*fwdFieldGradFunc)(float *rd,float *Q,FWDLIB::FwdCoilSet* coils, float *res,
                                 float *xgrad, float *ygrad, float *zgrad, void *client);
+/*
+ * Computes the field / potential of a block of dipoles (rd and Q are ndip x 3, res is ndip x ncoil)
+ */
+typedef int (*fwdBlockFieldFunc)(float **rd,float **Q,int ndip,FWDLIB::FwdCoilSet* coils,float **res,void *client);
 
 //#define FWD_BEM_UNKNOWN           -1
 //#define FWD_BEM_CONSTANT_COLL     1
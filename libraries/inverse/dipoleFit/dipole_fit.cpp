@@ -6,6 +6,10 @@
 
 #include <string.h>
 #include <QScopedPointer>
+#include <QThread>
+#include <QVector>
+#include <QAtomicInt>
+#include <QtConcurrent>
 
 using namespace INVERSELIB;
 using namespace MNELIB;
@@ -48,6 +52,8 @@ using namespace FWDLIB;
 
 #define EPS_VALUES 0.05
 
+#define FIT_BATCH_PER_THREAD 16   /* Time points picked for each fitting thread before the fits are started */
+
 //=============================================================================================================
 // STATIC DEFINITIONS ToDo make members
 //=============================================================================================================
@@ -552,9 +558,19 @@ int mne_get_values_from_data_ch (float time,      /* Interesting time point */
 
 DipoleFit::DipoleFit(DipoleFitSettings* p_settings)
 : settings(p_settings)
+, progress(NULL)
+, progress_user(NULL)
 {
 }
 
+//=============================================================================================================
+
+void DipoleFit::setProgressFunc(dipoleFitProgressFunc func, void *user)
+{
+    progress      = func;
+    progress_user = user;
+}
+
 //=============================================================================================================
 //todo split in initFit where the settings are handed over and the actual fit
 ECDSet DipoleFit::calculateFit() const
@@ -662,7 +678,8 @@ ECDSet DipoleFit::calculateFit() const
     printf("\n---- Computing the forward solution for the guesses...\n\n");
     guess.reset(new GuessData( settings->guessname,
                                settings->guess_surfname,
-                               settings->guess_mindist, settings->guess_exclude, settings->guess_grid, fit_data));
+                               settings->guess_mindist, settings->guess_exclude, settings->guess_grid, fit_data,
+                               settings->guess_cache_dir));
     if (guess.isNull())
         goto out;
 
@@ -670,11 +687,13 @@ ECDSet DipoleFit::calculateFit() const
              1000*settings->tmin,1000*settings->tmax,1000*settings->tstep,1000*settings->integ);
 
     if (raw) {
-        if (fit_dipoles_raw(settings->measname,raw,sel,fit_data,guess.take(),settings->tmin,settings->tmax,settings->tstep,settings->integ,settings->verbose) == FAIL)
+        if (fit_dipoles_raw(settings->measname,raw,sel,fit_data,guess.take(),settings->tmin,settings->tmax,settings->tstep,settings->integ,settings->verbose,
+                            settings->nthreads,progress,progress_user) == FAIL)
             goto out;
     }
     else {
-        if (fit_dipoles(settings->measname,data,fit_data,guess.take(),settings->tmin,settings->tmax,settings->tstep,settings->integ,settings->verbose,set) == FAIL)
+        if (fit_dipoles(settings->measname,data,fit_data,guess.take(),settings->tmin,settings->tmax,settings->tstep,settings->integ,settings->verbose,set,
+                        settings->nthreads,progress,progress_user) == FAIL)
             goto out;
     }
     printf("%d dipoles fitted\n",set.size());
@@ -685,53 +704,219 @@ out : {
 }
 
 //=============================================================================================================
+// fit_dipoles.c
+
+namespace {
+
+typedef struct {
+    float time;             /* Which time is it? */
+    float *B;               /* The field to fit */
+    bool  ok;               /* Was the fit successful? */
+    ECD   dip;              /* The fitted dipole */
+} FitPoint;
+
+typedef struct {
+    QList<DipoleFitData*> fits;             /* One fitting context per thread */
+    GuessData*            guess;            /* The initial guesses (shared) */
+    int                   verbose;
+    int                   nchan;
+    float                 **batch_data;     /* Space for the data of one batch (contiguous) */
+    QVector<FitPoint>     batch;            /* Time points waiting to be fitted */
+    int                   batch_size;
+    int                   ntime;            /* Total number of time points */
+    int                   ndone;            /* How many have been processed */
+    int                   report_interval;
+    dipoleFitProgressFunc progress;
+    void                  *progress_user;
+} FitRun;
+
+}
 
-int DipoleFit::fit_dipoles( const QString& dataname, MneMeasData* data, DipoleFitData* fit, GuessData* guess, float tmin, float tmax, float tstep, float integ, int verbose, ECDSet& p_set)
+static int count_fit_times(float tmin, float tmax, float tstep)
 {
-    float *one = MALLOC(data->nchan,float);
+    int   s;
     float time;
+
+    for (s = 0, time = tmin; time < tmax; s++, time = tmin  + s*tstep)
+        ;
+    return s;
+}
+
+static void start_fit_run(FitRun& run, DipoleFitData* fit, GuessData* guess, int nchan, int ntime, int nthreads, int verbose,
+                          dipoleFitProgressFunc progress, void *progress_user)
+/*
+ * The first thread uses the original fitting data, the others get duplicates sharing the read-only parts
+ */
+{
+    int k;
+
+    if (nthreads <= 0)
+        nthreads = QThread::idealThreadCount();
+    nthreads = qMax(1,qMin(nthreads,ntime));
+
+    run.fits.clear();
+    run.fits.append(fit);
+    for (k = 1; k < nthreads; k++)
+        run.fits.append(DipoleFitData::create_thread_duplicate(fit));
+    if (nthreads > 1)
+        fprintf(stderr,"%d threads fitting in parallel.\n",nthreads);
+
+    run.guess           = guess;
+    run.verbose         = verbose;
+    run.nchan           = nchan;
+    run.batch_size      = nthreads*FIT_BATCH_PER_THREAD;
+    run.batch_data      = ALLOC_CMATRIX(run.batch_size,nchan);
+    run.batch.clear();
+    run.batch.reserve(run.batch_size);
+    run.ntime           = ntime;
+    run.ndone           = 0;
+    run.report_interval = 10;
+    run.progress        = progress;
+    run.progress_user   = progress_user;
+}
+
+static void end_fit_run(FitRun& run)
+{
+    for (int k = 1; k < run.fits.size(); k++)
+        DipoleFitData::free_thread_duplicate(run.fits[k]);
+    run.fits.clear();
+    FREE_CMATRIX(run.batch_data);
+    run.batch_data = NULL;
+}
+
+static bool flush_fit_batch(FitRun& run, ECDSet& set)
+/*
+ * Fit the pending time points and add the results to the set in time order.
+ * Returns false if the fitting was cancelled.
+ */
+{
+    QVector<FitPoint>& batch = run.batch;
+    QVector<int>       best(batch.size());
+    QVector<float>     good(batch.size());
+    int k;
+    /*
+     * Whiten the whole batch and score it against all guesses with one matrix product
+     */
+    for (k = 0; k < batch.size(); k++)
+        batch[k].ok = DipoleFitData::whiten_fit_data(run.fits[0],batch[k].B) == OK;
+    if (run.guess->find_best_guesses(run.batch_data,batch.size(),run.nchan,DIPOLE_FIT_LIMIT,best.data(),good.data()) == FAIL)
+        best.fill(-1);
+    for (k = 0; k < batch.size(); k++) {
+        if (batch[k].ok && best[k] < 0) {
+            printf("t = %7.1f ms : No reasonable initial guess found.\n",1000*batch[k].time);
+            batch[k].ok = false;
+        }
+    }
+
+    if (run.fits.size() == 1) {
+        for (k = 0; k < batch.size(); k++)
+            if (batch[k].ok)
+                batch[k].ok = DipoleFitData::fit_one_guess(run.fits[0],run.guess->rr[best[k]],batch[k].time,batch[k].B,run.verbose,batch[k].dip);
+    }
+    else {
+        /*
+         * Each thread takes the next unfitted time point with its own fitting context.
+         * The simplex reports would be interleaved and are therefore omitted.
+         */
+        QAtomicInt iNextPoint(0);
+        QList<QFuture<void> > futures;
+
+        for (DipoleFitData* fit : run.fits) {
+            futures.append(QtConcurrent::run([&batch, &best, &iNextPoint, &run, fit]() {
+                int p;
+                while ((p = iNextPoint.fetchAndAddOrdered(1)) < batch.size())
+                    if (batch[p].ok)
+                        batch[p].ok = DipoleFitData::fit_one_guess(fit,run.guess->rr[best.at(p)],batch[p].time,batch[p].B,FALSE,batch[p].dip);
+            }));
+        }
+        for (k = 0; k < futures.size(); k++)
+            futures[k].waitForFinished();
+    }
+
+    for (k = 0; k < batch.size(); k++) {
+        if (!batch[k].ok)
+            printf("t = %7.1f ms : %s\n",1000*batch[k].time,"error (tbd: catch)");
+        else {
+            set.addEcd(batch[k].dip);
+            if (run.verbose)
+                batch[k].dip.print(stdout);
+            else {
+                if (set.size() % run.report_interval == 0)
+                    fprintf(stderr,"%d..",set.size());
+            }
+        }
+    }
+    run.ndone += batch.size();
+    batch.clear();
+
+    if (run.progress && !run.progress(run.ndone,run.ntime,run.progress_user)) {
+        fprintf(stderr,"[cancelled]\n");
+        return false;
+    }
+    return true;
+}
+
+static float *next_fit_point(FitRun& run, float time)
+/*
+ * Reserve space for the data of the next time point
+ */
+{
+    FitPoint point;
+
+    point.time = time;
+    point.B    = run.batch_data[run.batch.size()];
+    point.ok   = false;
+    run.batch.append(point);
+    return point.B;
+}
+
+//=============================================================================================================
+
+int DipoleFit::fit_dipoles( const QString& dataname, MneMeasData* data, DipoleFitData* fit, GuessData* guess, float tmin, float tmax, float tstep, float integ, int verbose, ECDSet& p_set,
+                            int nthreads, dipoleFitProgressFunc progress, void *progress_user)
+{
+    float  *one;
+    float  time;
     ECDSet set;
-    ECD   dip;
-    int   s;
-    int   report_interval = 10;
+    FitRun run;
+    int    s;
+    bool   cancelled = false;
 
     set.dataname = dataname;
 
+    start_fit_run(run,fit,guess,data->nchan,count_fit_times(tmin,tmax,tstep),nthreads,verbose,progress,progress_user);
+
     fprintf(stderr,"Fitting...%c",verbose ? '\n' : '\0');
-    for (s = 0, time = tmin; time < tmax; s++, time = tmin  + s*tstep) {
+    for (s = 0, time = tmin; time < tmax && !cancelled; s++, time = tmin  + s*tstep) {
         /*
      * Pick the data point
      */
+        one = next_fit_point(run,time);
         if (mne_get_values_from_data(time,integ,data->current->data,data->current->np,data->nchan,data->current->tmin,
                                      1.0/data->current->tstep,FALSE,one) == FAIL) {
             fprintf(stderr,"Cannot pick time: %7.1f ms\n",1000*time);
+            run.batch.removeLast();
+            run.ndone++;
             continue;
         }
-
-        if (!DipoleFitData::fit_one(fit,guess,time,one,verbose,dip))
-            printf("t = %7.1f ms : %s\n",1000*time,"error (tbd: catch)");
-        else {
-            set.addEcd(dip);
-            if (verbose)
-                dip.print(stdout);
-            else {
-                if (set.size() % report_interval == 0)
-                    fprintf(stderr,"%d..",set.size());
-            }
-        }
+        if (run.batch.size() == run.batch_size)
+            cancelled = !flush_fit_batch(run,set);
     }
-    if (!verbose)
+    if (!cancelled && !run.batch.isEmpty())
+        cancelled = !flush_fit_batch(run,set);
+    if (!verbose && !cancelled)
         fprintf(stderr,"[done]\n");
-    FREE(one);
+    end_fit_run(run);
     p_set = set;
     return OK;
 }
 
 //=============================================================================================================
 
-int DipoleFit::fit_dipoles_raw(const QString& dataname, MneRawData* raw, mneChSelection sel, DipoleFitData* fit, GuessData* guess, float tmin, float tmax, float tstep, float integ, int verbose, ECDSet& p_set)
+int DipoleFit::fit_dipoles_raw(const QString& dataname, MneRawData* raw, mneChSelection sel, DipoleFitData* fit, GuessData* guess, float tmin, float tmax, float tstep, float integ, int verbose, ECDSet& p_set,
+                               int nthreads, dipoleFitProgressFunc progress, void *progress_user)
 {
-    float *one    = MALLOC(sel->nchan,float);
+    float *one;
     float sfreq   = raw->info->sfreq;
     float myinteg = integ > 0.0 ? 2*integ : 0.1;
     int   overlap = ceil(myinteg*sfreq);
@@ -742,12 +927,14 @@ int DipoleFit::fit_dipoles_raw(const QString& dataname, MneRawData* raw, mneChSe
     int   s,picks;
     float time,stime;
     float **data  = ALLOC_CMATRIX(sel->nchan,length);
-    ECD    dip;
     ECDSet set;
-    int    report_interval = 10;
+    FitRun run;
+    bool   cancelled = false;
 
     set.dataname = dataname;
 
+    start_fit_run(run,fit,guess,sel->nchan,count_fit_times(tmin,tmax,tstep),nthreads,verbose,progress,progress_user);
+
     /*
    * Load the initial data segment
    */
@@ -755,7 +942,7 @@ int DipoleFit::fit_dipoles_raw(const QString& dataname, MneRawData* raw, mneChSe
     if (MneRawData::mne_raw_pick_data_filt(raw,sel,start,length,data) == FAIL)
         goto bad;
     fprintf(stderr,"Fitting...%c",verbose ? '\n' : '\0');
-    for (s = 0, time = tmin; time < tmax; s++, time = tmin  + s*tstep) {
+    for (s = 0, time = tmin; time < tmax && !cancelled; s++, time = tmin  + s*tstep) {
         picks = time*sfreq - start;
         if (picks > stepo) {		/* Need a new data segment? */
             start = start + step;
@@ -767,43 +954,40 @@ int DipoleFit::fit_dipoles_raw(const QString& dataname, MneRawData* raw, mneChSe
         /*
      * Get the values
      */
+        one = next_fit_point(run,time);
         if (mne_get_values_from_data_ch (time,integ,data,length,sel->nchan,stime,sfreq,FALSE,one) == FAIL) {
             fprintf(stderr,"Cannot pick time: %8.3f s\n",time);
+            run.batch.removeLast();
+            run.ndone++;
             continue;
         }
         /*
-     * Fit
+     * Fit once a batch is complete; the values have been copied so the segment may change
      */
-        if (!DipoleFitData::fit_one(fit,guess,time,one,verbose,dip))
-            qWarning() << "Error";
-        else {
-            set.addEcd(dip);
-            if (verbose)
-                dip.print(stdout);
-            else {
-                if (set.size() % report_interval == 0)
-                    fprintf(stderr,"%d..",set.size());
-            }
-        }
+        if (run.batch.size() == run.batch_size)
+            cancelled = !flush_fit_batch(run,set);
     }
-    if (!verbose)
+    if (!cancelled && !run.batch.isEmpty())
+        cancelled = !flush_fit_batch(run,set);
+    if (!verbose && !cancelled)
         fprintf(stderr,"[done]\n");
+    end_fit_run(run);
     FREE_CMATRIX(data);
-    FREE(one);
     p_set = set;
     return OK;
 
 bad : {
+        end_fit_run(run);
         FREE_CMATRIX(data);
-        FREE(one);
         return FAIL;
     }
 }
 
 //=============================================================================================================
 
-int DipoleFit::fit_dipoles_raw(const QString& dataname, MneRawData* raw, mneChSelection sel, DipoleFitData* fit, GuessData* guess, float tmin, float tmax, float tstep, float integ, int verbose)
+int DipoleFit::fit_dipoles_raw(const QString& dataname, MneRawData* raw, mneChSelection sel, DipoleFitData* fit, GuessData* guess, float tmin, float tmax, float tstep, float integ, int verbose,
+                               int nthreads, dipoleFitProgressFunc progress, void *progress_user)
 {
     ECDSet set;
-    return fit_dipoles_raw(dataname, raw, sel, fit, guess, tmin, tmax, tstep, integ, verbose, set);
+    return fit_dipoles_raw(dataname, raw, sel, fit, guess, tmin, tmax, tstep, integ, verbose, set, nthreads, progress, progress_user);
 }
@@ -70,6 +70,13 @@ namespace INVERSELIB
 //class GuessData;
 //class MneMeasData
 
+/*
+ * Called in time order after each batch of fitted time points. Return false to cancel the fitting.
+ */
+typedef bool (*dipoleFitProgressFunc)(int nfit,     /* How many time points have been processed */
+                                      int ntime,    /* Total number of time points */
+                                      void *user);
+
 //=============================================================================================================
 /**
  * Implements all required dipole fitting routines
@@ -90,6 +97,15 @@ public:
 
     virtual ~DipoleFit(){}
 
+    //=========================================================================================================
+    /**
+     * Set the function to be called with the fitting progress. The fitting is cancelled if it returns false.
+     *
+     * @param[in] func   The progress function.
+     * @param[in] user   Data to be passed to the progress function.
+     */
+    void setProgressFunc(dipoleFitProgressFunc func, void *user);
+
     //ToDo split this function into init (with settings as parameter) and the actual fit function
     ECDSet calculateFit() const;
 //    virtual const char* getName() const;
@@ -112,10 +128,14 @@ public:
      * @param[in] integ      Integration time
      * @param[in] verbose    Verbose output?
      * @param[out] p_set     the fitted ECD Set
+     * @param[in] nthreads   Number of threads fitting time points in parallel (0 = number of processors)
+     * @param[in] progress   Progress function, may cancel the fitting (optional)
+     * @param[in] progress_user  Data to be passed to the progress function
      *
      * @return true when successful
      */
-    static int fit_dipoles( const QString& dataname, MneMeasData* data, DipoleFitData* fit, GuessData* guess, float tmin, float tmax, float tstep, float integ, int verbose, ECDSet& p_set);
+    static int fit_dipoles( const QString& dataname, MneMeasData* data, DipoleFitData* fit, GuessData* guess, float tmin, float tmax, float tstep, float integ, int verbose, ECDSet& p_set,
+                            int nthreads = 1, dipoleFitProgressFunc progress = NULL, void *progress_user = NULL);
 
     //=========================================================================================================
     /**
@@ -134,10 +154,14 @@ public:
      * @param[in] integ      Integration time
      * @param[in] verbose    Verbose output?
      * @param[out] p_set     Return all results here. Warning: for large data files this may take a lot of memory
+     * @param[in] nthreads   Number of threads fitting time points in parallel (0 = number of processors)
+     * @param[in] progress   Progress function, may cancel the fitting (optional)
+     * @param[in] progress_user  Data to be passed to the progress function
      *
      * @return true when successful
      */
-    static int fit_dipoles_raw(const QString& dataname, MNELIB::MneRawData* raw, MNELIB::mneChSelection sel, DipoleFitData* fit, GuessData* guess, float tmin, float tmax, float tstep, float integ, int verbose, ECDSet& p_set);
+    static int fit_dipoles_raw(const QString& dataname, MNELIB::MneRawData* raw, MNELIB::mneChSelection sel, DipoleFitData* fit, GuessData* guess, float tmin, float tmax, float tstep, float integ, int verbose, ECDSet& p_set,
+                               int nthreads = 1, dipoleFitProgressFunc progress = NULL, void *progress_user = NULL);
 
     //=========================================================================================================
     /**
@@ -155,13 +179,19 @@ public:
      * @param[in] tstep      Time step to use
      * @param[in] integ      Integration time
      * @param[in] verbose    Verbose output?
+     * @param[in] nthreads   Number of threads fitting time points in parallel (0 = number of processors)
+     * @param[in] progress   Progress function, may cancel the fitting (optional)
+     * @param[in] progress_user  Data to be passed to the progress function
      *
      * @return true when successful
      */
-    static int fit_dipoles_raw(const QString& dataname, MNELIB::MneRawData* raw, MNELIB::mneChSelection sel, DipoleFitData* fit, GuessData* guess, float tmin, float tmax, float tstep, float integ, int verbose);
+    static int fit_dipoles_raw(const QString& dataname, MNELIB::MneRawData* raw, MNELIB::mneChSelection sel, DipoleFitData* fit, GuessData* guess, float tmin, float tmax, float tstep, float integ, int verbose,
+                               int nthreads = 1, dipoleFitProgressFunc progress = NULL, void *progress_user = NULL);
 
 private:
     DipoleFitSettings* settings;
+    dipoleFitProgressFunc progress;     /**< Progress function */
+    void *progress_user;                /**< Data to be passed to the progress function */
 };
 
 //=============================================================================================================
@@ -14,6 +14,7 @@
 #include <mne/c/mne_surface_old.h>
 
 #include <fwd/fwd_comp_data.h>
+#include <mne/c/mne_ctf_comp_data_set.h>
 
 #include <Eigen/Dense>
 
@@ -3401,6 +3402,131 @@ DipoleFitData::~DipoleFitData()
 
 //=============================================================================================================
 
+static void free_comp_data_duplicate(void *c)
+/*
+ * Free a duplicate made by dup_dipole_fit_funcs but leave the shared parts alone
+ */
+{
+    FwdCompData* comp = (FwdCompData*)c;
+
+    if (!comp)
+        return;
+    comp->comp_coils  = NULL;
+    comp->client      = NULL;
+    comp->client_free = NULL;
+    delete comp;
+}
+
+//=============================================================================================================
+
+static dipoleFitFuncs dup_dipole_fit_funcs(dipoleFitFuncs f, FwdBemModel* orig_bem, FwdBemModel* new_bem)
+/*
+ * Duplicate the forward calculation functions for one fitting thread.
+ * The compensation work space and the BEM potential work space are private to each duplicate.
+ */
+{
+    dipoleFitFuncs res;
+
+    if (!f)
+        return NULL;
+
+    res = new_dipole_fit_funcs();
+    *res = *f;
+    res->meg_client_free = NULL;
+    res->eeg_client_free = NULL;
+
+    if (f->meg_client && f->meg_client_free == FwdCompData::fwd_free_comp_data) {
+        FwdCompData* orig = (FwdCompData*)f->meg_client;
+        FwdCompData* comp = new FwdCompData;
+
+        *comp = *orig;
+        comp->work     = NULL;
+        comp->vec_work = NULL;
+        comp->set      = orig->set ? new MneCTFCompDataSet(*(orig->set)) : NULL;
+        if (orig_bem && comp->client == orig_bem)
+            comp->client = new_bem;
+        res->meg_client      = comp;
+        res->meg_client_free = free_comp_data_duplicate;
+    }
+    if (orig_bem && f->eeg_client == orig_bem)
+        res->eeg_client = new_bem;
+    return res;
+}
+
+//=============================================================================================================
+
+DipoleFitData* DipoleFitData::create_thread_duplicate(DipoleFitData* d)
+{
+    DipoleFitData* res = new DipoleFitData;
+    FwdBemModel*   bem = NULL;
+
+    *res = *d;
+    /*
+     * The BEM model is shared except for its infinite-medium potential work space
+     */
+    if (d->bem_model) {
+        bem = new FwdBemModel;
+        *bem = *(d->bem_model);
+        bem->v0 = NULL;
+        res->bem_model = bem;
+    }
+    res->sphere_funcs     = dup_dipole_fit_funcs(d->sphere_funcs,d->bem_model,bem);
+    res->bem_funcs        = dup_dipole_fit_funcs(d->bem_funcs,d->bem_model,bem);
+    res->mag_dipole_funcs = dup_dipole_fit_funcs(d->mag_dipole_funcs,d->bem_model,bem);
+    if (d->funcs == d->bem_funcs)
+        res->funcs = res->bem_funcs;
+    else if (d->funcs == d->mag_dipole_funcs)
+        res->funcs = res->mag_dipole_funcs;
+    else
+        res->funcs = res->sphere_funcs;
+    res->user      = NULL;
+    res->user_free = NULL;
+
+    return res;
+}
+
+//=============================================================================================================
+
+void DipoleFitData::free_thread_duplicate(DipoleFitData* d)
+{
+    if (!d)
+        return;
+
+    if (d->bem_model) {
+        FwdBemModel* bem = d->bem_model;
+
+        bem->surfs.clear();
+        bem->nsurf       = 0;
+        bem->ntri        = NULL;
+        bem->np          = NULL;
+        bem->sigma       = NULL;
+        bem->gamma       = NULL;
+        bem->source_mult = NULL;
+        bem->field_mult  = NULL;
+        bem->solution    = NULL;
+        bem->head_mri_t  = NULL;
+        delete bem;
+    }
+    /*
+     * Everything else except for the function duplicates is shared with the original
+     */
+    d->mri_head_t = NULL;
+    d->meg_head_t = NULL;
+    d->meg_coils  = NULL;
+    d->eeg_els    = NULL;
+    d->noise      = NULL;
+    d->noise_orig = NULL;
+    d->pick       = NULL;
+    d->bem_model  = NULL;
+    d->eeg_model  = NULL;
+    d->proj       = NULL;
+    d->user       = NULL;
+    d->user_free  = NULL;
+    delete d;
+}
+
+//=============================================================================================================
+
 int DipoleFitData::setup_forward_model(DipoleFitData *d, MneCTFCompDataSet* comp_data, FwdCoilSet *comp_coils)
 /*
      * Take care of some hairy details
@@ -4363,48 +4489,6 @@ static float fit_eval(float *rd,int npar,void *user)
     return fuser->B2-Bm2;
 }
 
-static int find_best_guess(float     *B,         /* The whitened data */
-                           int       nch,
-                           GuessData* guess,	 /* Guesses */
-                           float     limit,	 /* Pseudoradial component omission limit */
-                           int       *bestp,	 /* Which is the best */
-                           float     *goodp)	 /* Best goodness of fit */
-/*
- * Thanks to the precomputed SVD everything is really simple
- */
-{
-    int    k,c;
-    double B2,Bm2,this_good,one;
-    int    best = -1;
-    float  good = 0.0;
-    DipoleForward* fwd;
-    int    ncomp;
-
-    B2 = mne_dot_vectors_3(B,B,nch);
-    for (k = 0; k < guess->nguess; k++) {
-        fwd = guess->guess_fwd[k];
-        if (fwd->nch == nch) {
-            ncomp = fwd->sing[2]/fwd->sing[0] > limit ? 3 : 2;
-            for (c = 0, Bm2 = 0.0; c < ncomp; c++) {
-                one = mne_dot_vectors_3(fwd->uu[c],B,nch);
-                Bm2 = Bm2 + one*one;
-            }
-            this_good = 1.0 - (B2 - Bm2)/B2;
-            if (this_good > good) {
-                best = k;
-                good = this_good;
-            }
-        }
-    }
-    if (best < 0) {
-        printf("No reasonable initial guess found.");
-        return FAIL;
-    }
-     *bestp = best;
-     *goodp = good;
-    return OK;
-}
-
 static float **make_initial_dipole_simplex(float  *r0,
                                            float  size)
 /*
@@ -4656,6 +4740,17 @@ int simplex_minimize(float **p,		                              /* The initial si
     return (result);
 }
 
+//=============================================================================================================
+// fit_dipoles.c
+int DipoleFitData::whiten_fit_data(DipoleFitData* fit, float *B)
+{
+    int nchan = fit->nmeg+fit->neeg;
+
+    if (MneProjOp::mne_proj_op_proj_vector(fit->proj,B,nchan,TRUE) == FAIL)
+        return FAIL;
+    return mne_whiten_one_data(B,B,nchan,fit->noise);
+}
+
 //=============================================================================================================
 // fit_dipoles.c
 bool DipoleFitData::fit_one(DipoleFitData* fit,	            /* Precomputed fitting data */
@@ -4665,10 +4760,37 @@ bool DipoleFitData::fit_one(DipoleFitData* fit,	            /* Precomputed fitti
                     int           verbose,
                     ECD&          res               /* The fitted dipole */
                     )
+{
+    int   best;
+    float good;
+
+    if (whiten_fit_data(fit,B) == FAIL)
+        return false;
+    /*
+   * Get the initial guess
+   */
+    if (guess->find_best_guesses(&B,1,fit->nmeg+fit->neeg,DIPOLE_FIT_LIMIT,&best,&good) == FAIL)
+        return false;
+    if (best < 0) {
+        printf("No reasonable initial guess found.");
+        return false;
+    }
+    return fit_one_guess(fit,guess->rr[best],time,B,verbose,res);
+}
+
+//=============================================================================================================
+// fit_dipoles.c
+bool DipoleFitData::fit_one_guess(DipoleFitData* fit,	    /* Precomputed fitting data */
+                    float         *rd_start,          /* The initial guess */
+                    float         time,              /* Which time is it? */
+                    float         *B,	            /* The whitened field to fit */
+                    int           verbose,
+                    ECD&          res               /* The fitted dipole */
+                    )
 {
     float  **simplex       = NULL;	       /* The simplex */
     float  vals[4];			       /* Values at the vertices */
-    float  limit           = 0.2;	               /* (pseudo) radial component omission limit */
+    float  limit           = DIPOLE_FIT_LIMIT;	       /* (pseudo) radial component omission limit */
     float  size            = 1e-2;	       /* Size of the initial simplex */
     float  ftol[]          = { 1e-2, 1e-2 };     /* Tolerances on the the two passes */
     float  atol[]          = { 0.2e-3, 0.2e-3 }; /* If dipole movement between two iterations is less than this,
@@ -4677,25 +4799,12 @@ bool DipoleFitData::fit_one(DipoleFitData* fit,	            /* Precomputed fitti
     int    max_eval        = 1000;	       /* Limit for fit function evaluations */
     int    report_interval = verbose ? 1 : -1;   /* How often to report the intermediate result */
 
-    int        best;
-    float      good,rd_guess[3],rd_final[3],Q[3],final_val;
+    float      rd_guess[3],rd_final[3],Q[3],final_val;
     fitDipUserRec user;
     int        k,p,neval,neval_tot,nchan,ncomp;
     int        fit_fail;
 
     nchan = fit->nmeg+fit->neeg;
-    user.fwd = NULL;
-
-    if (MneProjOp::mne_proj_op_proj_vector(fit->proj,B,nchan,TRUE) == FAIL)
-        goto bad;
-
-    if (mne_whiten_one_data(B,B,nchan,fit->noise) == FAIL)
-        goto bad;
-    /*
-   * Get the initial guess
-   */
-    if (find_best_guess(B,nchan,guess,limit,&best,&good) < 0)
-        goto bad;
 
     user.limit = limit;
     user.B     = B;
@@ -4704,8 +4813,8 @@ bool DipoleFitData::fit_one(DipoleFitData* fit,	            /* Precomputed fitti
     user.report_dim = FALSE;
     fit->user  = &user;
 
-    VEC_COPY_3(rd_guess,guess->rr[best]);
-    VEC_COPY_3(rd_final,guess->rr[best]);
+    VEC_COPY_3(rd_guess,rd_start);
+    VEC_COPY_3(rd_final,rd_start);
 
     neval_tot = 0;
     fit_fail = FALSE;
@@ -67,6 +67,8 @@
 #define COLUMN_NORM_COMP 1	    /* Componentwise normalization */
 #define COLUMN_NORM_LOC  2	    /* Dipole locationwise normalization */
 
+#define DIPOLE_FIT_LIMIT 0.2f	    /* (Pseudo) radial component omission limit */
+
 //=============================================================================================================
 // DEFINE NAMESPACE INVERSELIB
 //=============================================================================================================
@@ -166,6 +168,26 @@ public:
                                             int   include_meg,              /**< Include MEG in the fitting? */
                                             int   include_eeg);
 
+    //=========================================================================================================
+    /**
+     * Create a duplicate of the fitting data for one fitting thread. The forward model, the noise covariance and
+     * the projection are shared with the original; the per-fit state and the forward calculation work spaces
+     * are private to the duplicate.
+     *
+     * @param[in] d      The fitting data to duplicate.
+     *
+     * @return The duplicate, to be released with free_thread_duplicate.
+     */
+    static DipoleFitData* create_thread_duplicate(DipoleFitData* d);
+
+    //=========================================================================================================
+    /**
+     * Release a duplicate created with create_thread_duplicate without touching the shared data.
+     *
+     * @param[in] d      The duplicate to release.
+     */
+    static void free_thread_duplicate(DipoleFitData* d);
+
     //=========================================================================================================
     /**
      * Fit a single dipole to the given data
@@ -180,6 +202,30 @@ public:
      */
     static bool fit_one(DipoleFitData* fit, GuessData* guess, float time, float *B, int verbose, ECD& res);
 
+    //=========================================================================================================
+    /**
+     * Apply the projection and the whitening to the data of one time point
+     *
+     * @param[in] fit        Precomputed fitting data
+     * @param[in,out] B      The field to whiten
+     *
+     * @return OK or FAIL
+     */
+    static int whiten_fit_data(DipoleFitData* fit, float *B);
+
+    //=========================================================================================================
+    /**
+     * Fit a single dipole to whitened data starting from a known initial guess
+     *
+     * @param[in] fit        Precomputed fitting data
+     * @param[in] rd_start   The initial guess location
+     * @param[in] time       Which time is it?
+     * @param[in] B          The whitened field to fit (see whiten_fit_data)
+     * @param[in] verbose
+     * @param[in] res        The fitted dipole
+     */
+    static bool fit_one_guess(DipoleFitData* fit, float *rd_start, float time, float *B, int verbose, ECD& res);
+
 //============================= dipole_forward.c
 
     static int compute_dipole_field(DipoleFitData* d, float *rd, int whiten, float **fwd);
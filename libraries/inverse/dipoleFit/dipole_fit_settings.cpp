@@ -103,6 +103,7 @@ void DipoleFitSettings::initMembers()
     do_baseline  = false;         
     setno        = 1;             
     verbose      = false;
+    nthreads     = 0;
     omit_data_proj = false;
 
          
@@ -258,11 +259,13 @@ void DipoleFitSettings::usage(char *name)
     printf("\t--guess name      The source space of initial guesses.\n");
     printf("\t                  If not present, the values below are used to generate the guess grid.\n");
     printf("\t--guesssurf name  Read the inner skull surface from this fif file to generate the guesses.\n");
+    printf("\t--guesscache dir  Save the guess fields here and reuse them in later fits with the same setup.\n");
     printf("\t--guessrad value  Radius of a spherical guess volume if neither of the above is present (default : %.1f mm)\n",1000*guess_rad);
     printf("\t--exclude dist/mm Exclude points which are closer than this distance from the CM of the inner skull surface (default =  %6.1f mm).\n",1000*guess_exclude);
     printf("\t--mindist dist/mm Exclude points which are closer than this distance from the inner skull surface  (default = %6.1f mm).\n",1000*guess_mindist);
     printf("\t--grid    dist/mm Source space grid size (default = %6.1f mm).\n",1000*guess_grid);
     printf("\t--magdip          Fit magnetic dipoles instead of current dipoles.\n");
+    printf("\t--threads n       Number of threads fitting time points in parallel (default: number of processors).\n");
     printf("\nOutput:\n\n");
     printf("\t--dip     name    xfit dip format output file name\n");
     printf("\t--bdip    name    xfit bdip format output file name\n");
@@ -335,6 +338,14 @@ bool DipoleFitSettings::check_args (int *argc,char **argv)
             }
             guess_surfname = strdup(argv[k+1]);
         }
+        else if (strcmp(argv[k],"--guesscache") == 0) {
+            found = 2;
+            if (k == *argc - 1) {
+                qCritical ("--guesscache: argument required.");
+                return false;
+            }
+            guess_cache_dir = QString(argv[k+1]);
+        }
         else if (strcmp(argv[k],"--guessrad") == 0) {
             found = 2;
             if (k == *argc - 1) {
@@ -827,6 +838,21 @@ bool DipoleFitSettings::check_args (int *argc,char **argv)
             found = 1;
             verbose = true;
         }
+        else if (strcmp(argv[k],"--threads") == 0) {
+            found = 2;
+            if (k == *argc - 1) {
+                qCritical ("--threads: argument required.");
+                return false;
+            }
+            if (sscanf(argv[k+1],"%d",&nthreads) != 1) {
+                qCritical() << "Incomprehensible number of threads:" << argv[k+1];
+                return false;
+            }
+            if (nthreads <= 0) {
+                qCritical ("Number of threads must be > 0");
+                return false;
+            }
+        }
         if (found) {
             for (int p = k; p < *argc-found; p++)
                 argv[p] = argv[p+found];
@@ -119,6 +119,7 @@ public:
 
     QString guessname;                  /**< Initial guess grid (if not present, the values below will be employed to generate the grid) */
     QString guess_surfname;             /**< Load the inner skull surface from this BEM file */
+    QString guess_cache_dir;            /**< Directory of the guess field cache (empty = no cache) */
 float guess_rad;       			/**< Radius of spherical guess surface */
     float guess_mindist;       		/**< Minimum allowed distance to the surface */
     float guess_exclude;       		/**< Exclude points closer than this to the origin */
@@ -144,6 +145,7 @@ float guess_rad;       			/**< Radius of spherical guess surface */
     bool  do_baseline;         		/**< Are both baseline limits set? */
     int   setno;             		/**< Which data set */
     bool  verbose;
+    int   nthreads;                     /**< Number of fitting threads (0 = number of processors) */
     MNELIB::mneFilterDefRec filter;
     QStringList projnames;              /**< Projection file names */
     bool omit_data_proj;
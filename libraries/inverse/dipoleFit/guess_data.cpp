@@ -48,6 +48,13 @@
 #include <fiff/fiff_tag.h>
 
 #include <QFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QDataStream>
+#include <QCryptographicHash>
+#include <QThread>
+#include <QAtomicInt>
+#include <QtConcurrent>
 
 //=============================================================================================================
 // USED NAMESPACES
@@ -129,6 +136,13 @@ float **mne_cmatrix_16(int nr,int nc)
 #define FREE_16(x) if ((char *)(x) != NULL) free((char *)(x))
 #define FREE_CMATRIX_16(m) mne_free_cmatrix_16((m))
 
+#define GUESS_SCORE_BLOCK 64        /* Time points scored against the guesses at once */
+
+#define GUESS_CHUNK 32              /* Guess fields computed by one thread at a time */
+
+#define GUESS_CACHE_MAGIC   0x47464c44  /* Identifies a guess field cache file */
+#define GUESS_CACHE_VERSION 1
+
 void mne_free_cmatrix_16 (float **m)
 {
     if (m) {
@@ -181,7 +195,7 @@ GuessData::GuessData()
 
 //=============================================================================================================
 
-GuessData::GuessData(const QString &guessname, const QString &guess_surfname, float mindist, float exclude, float grid, DipoleFitData *f)
+GuessData::GuessData(const QString &guessname, const QString &guess_surfname, float mindist, float exclude, float grid, DipoleFitData *f, const QString &guess_cache_dir)
 {
     MneSourceSpaceOld* *sp = NULL;
     int            nsp = 0;
@@ -189,7 +203,6 @@ GuessData::GuessData(const QString &guessname, const QString &guess_surfname, fl
     int            k,p;
     float          guessrad = 0.080;
     MneSourceSpaceOld* guesses = NULL;
-    dipoleFitFuncs orig;
 
     if (!guessname.isEmpty()) {
         /*
@@ -242,30 +255,14 @@ GuessData::GuessData(const QString &guessname, const QString &guess_surfname, fl
         }
     delete guesses; guesses = NULL;
 
-    fprintf(stderr,"Go through all guess source locations...");
     this->guess_fwd = MALLOC_16(this->nguess,DipoleForward*);
     for (k = 0; k < this->nguess; k++)
         this->guess_fwd[k] = NULL;
     /*
         * Compute the guesses using the sphere model for speed
         */
-    orig = f->funcs;
-    if (f->fit_mag_dipoles)
-        f->funcs = f->mag_dipole_funcs;
-    else
-        f->funcs = f->sphere_funcs;
-
-    for (k = 0; k < this->nguess; k++) {
-        if ((this->guess_fwd[k] = DipoleFitData::dipole_forward_one(f,this->rr[k],NULL)) == NULL)
-            goto bad;
-#ifdef DEBUG
-        sing = this->guess_fwd[k]->sing;
-        printf("%f %f %f\n",sing[0],sing[1],sing[2]);
-#endif
-    }
-    f->funcs = orig;
-
-    fprintf(stderr,"[done %d sources]\n",p);
+    if (!this->compute_guess_fields(f,guess_cache_dir))
+        goto bad;
 
     return;
 //    return res;
@@ -397,9 +394,11 @@ GuessData::~GuessData()
 
 //=============================================================================================================
 
-bool GuessData::compute_guess_fields(DipoleFitData* f)
+bool GuessData::compute_guess_fields(DipoleFitData* f, const QString& guess_cache_dir)
 {
     dipoleFitFuncs orig = NULL;
+    QString        cache_name;
+    bool           ok;
 
     if (!f) {
         qCritical("Data missing in compute_guess_fields");
@@ -415,19 +414,249 @@ bool GuessData::compute_guess_fields(DipoleFitData* f)
         f->funcs = f->mag_dipole_funcs;
     else
         f->funcs = f->sphere_funcs;
-    for (int k = 0; k < this->nguess; k++) {
-        if ((this->guess_fwd[k] = DipoleFitData::dipole_forward_one(f,this->rr[k],this->guess_fwd[k])) == NULL){
-            if (orig)
-                f->funcs = orig;
-            return false;
+    /*
+     * Previously computed fields for the same setup?
+     */
+    if (!guess_cache_dir.isEmpty()) {
+        cache_name = guess_fields_cache_name(f,guess_cache_dir);
+        if (!cache_name.isEmpty() && read_guess_fields(cache_name,f->nmeg+f->neeg)) {
+            f->funcs = orig;
+            this->pack_guess_fields();
+            printf("[read %d sources from %s]\n",this->nguess,cache_name.toUtf8().constData());
+            return true;
         }
+    }
+    /*
+     * Each thread works on chunks of guesses with its own duplicate of the fitting data
+     */
+    int nthreads = qMax(1,qMin(QThread::idealThreadCount(),this->nguess/GUESS_CHUNK));
+    QList<DipoleFitData*> fits;
+
+    fits.append(f);
+    for (int k = 1; k < nthreads; k++)
+        fits.append(DipoleFitData::create_thread_duplicate(f));
+
+    QAtomicInt iNextGuess(0);
+    QAtomicInt iFailed(0);
+    QList<QFuture<void> > futures;
+
+    for (DipoleFitData* fit : fits) {
+        futures.append(QtConcurrent::run([this, &iNextGuess, &iFailed, fit]() {
+            int c,k;
+            while (!iFailed.loadAcquire() && (c = iNextGuess.fetchAndAddOrdered(GUESS_CHUNK)) < this->nguess) {
+                for (k = c; k < qMin(c+GUESS_CHUNK,this->nguess); k++) {
+                    if ((this->guess_fwd[k] = DipoleFitData::dipole_forward_one(fit,this->rr[k],this->guess_fwd[k])) == NULL) {
+                        iFailed.storeRelease(1);
+                        break;
+                    }
 #ifdef DEBUG
-        sing = this->guess_fwd[k]->sing;
-        printf("%f %f %f\n",sing[0],sing[1],sing[2]);
+                    float *sing = this->guess_fwd[k]->sing;
+                    printf("%f %f %f\n",sing[0],sing[1],sing[2]);
 #endif
+                }
+            }
+        }));
     }
+    for (int k = 0; k < futures.size(); k++)
+        futures[k].waitForFinished();
+    for (int k = 1; k < fits.size(); k++)
+        DipoleFitData::free_thread_duplicate(fits[k]);
+    ok = !iFailed.loadAcquire();
+
     f->funcs = orig;
+    if (!ok)
+        return false;
+    this->pack_guess_fields();
     printf("[done %d sources]\n",this->nguess);
 
+    if (!cache_name.isEmpty()) {
+        if (write_guess_fields(cache_name))
+            printf("Saved the guess fields to %s\n",cache_name.toUtf8().constData());
+        else
+            printf("Could not save the guess fields to %s\n",cache_name.toUtf8().constData());
+    }
     return true;
 }
+
+//=============================================================================================================
+
+QString GuessData::guess_fields_cache_name(DipoleFitData* f, const QString& guess_cache_dir) const
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    int nch = f->nmeg+f->neeg;
+    int k,p;
+
+    if (this->nguess <= 0)
+        return QString();
+    /*
+     * The guess grid and the channels
+     */
+    hash.addData((const char*)&this->nguess,sizeof(int));
+    for (k = 0; k < this->nguess; k++)
+        hash.addData((const char*)this->rr[k],3*sizeof(float));
+    hash.addData((const char*)&nch,sizeof(int));
+    for (k = 0; k < f->ch_names.size(); k++)
+        hash.addData(f->ch_names[k].toUtf8());
+    hash.addData((const char*)&f->coord_frame,sizeof(int));
+    hash.addData((const char*)&f->column_norm,sizeof(int));
+    hash.addData((const char*)&f->fit_mag_dipoles,sizeof(int));
+    /*
+     * The projected and whitened fields of a few probe locations depend on everything else:
+     * the forward model, the sensor locations, the noise covariance and the projection
+     */
+    int probes[] = { 0, this->nguess/2, this->nguess-1 };
+    for (p = 0; p < 3; p++) {
+        DipoleForward* fwd = DipoleFitData::dipole_forward_one(f,this->rr[probes[p]],NULL);
+        if (!fwd)
+            return QString();
+        hash.addData((const char*)fwd->fwd[0],3*nch*sizeof(float));
+        delete fwd;
+    }
+
+    return QString("%1/guess-%2-fwd.dat").arg(QDir(guess_cache_dir).absolutePath())
+                                         .arg(QString(hash.result().toHex().left(16)));
+}
+
+//=============================================================================================================
+
+bool GuessData::write_guess_fields(const QString& name) const
+{
+    QDir().mkpath(QFileInfo(name).absolutePath());
+    QFile file(name);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    int nch = this->guess_fwd[0]->nch;
+    QDataStream stream(&file);
+    stream.setByteOrder(QDataStream::BigEndian);
+    stream.setVersion(QDataStream::Qt_5_0);
+    /*
+     * The fields are written in the native byte order, the header tells which one
+     */
+    stream << (quint32)GUESS_CACHE_MAGIC << (qint32)GUESS_CACHE_VERSION << (qint32)QSysInfo::ByteOrder;
+    stream << (qint32)this->nguess << (qint32)nch;
+    for (int k = 0; k < this->nguess; k++) {
+        DipoleForward* fwd = this->guess_fwd[k];
+        stream.writeRawData((const char*)fwd->rd[0],3*sizeof(float));
+        stream.writeRawData((const char*)fwd->fwd[0],3*nch*sizeof(float));
+        stream.writeRawData((const char*)fwd->uu[0],3*nch*sizeof(float));
+        stream.writeRawData((const char*)fwd->vv[0],9*sizeof(float));
+        stream.writeRawData((const char*)fwd->sing,3*sizeof(float));
+        stream.writeRawData((const char*)fwd->scales,3*sizeof(float));
+    }
+    if (stream.status() != QDataStream::Ok) {
+        file.remove();
+        return false;
+    }
+    return true;
+}
+
+//=============================================================================================================
+
+bool GuessData::read_guess_fields(const QString& name, int nch)
+{
+    QFile file(name);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream stream(&file);
+    stream.setByteOrder(QDataStream::BigEndian);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic;
+    qint32  version,byte_order,file_nguess,file_nch;
+    stream >> magic >> version >> byte_order >> file_nguess >> file_nch;
+    if (stream.status() != QDataStream::Ok || magic != GUESS_CACHE_MAGIC || version != GUESS_CACHE_VERSION ||
+            byte_order != QSysInfo::ByteOrder || file_nguess != this->nguess || file_nch != nch)
+        return false;
+
+    QVector<DipoleForward*> fwds(this->nguess,NULL);
+    int  nvec   = 3*sizeof(float);
+    int  nfield = 3*nch*sizeof(float);
+    bool ok = true;
+    for (int k = 0; k < this->nguess && ok; k++) {
+        DipoleForward* fwd = fwds[k] = new DipoleForward;
+        fwd->ndip   = 1;
+        fwd->nch    = nch;
+        fwd->rd     = ALLOC_CMATRIX_16(1,3);
+        fwd->fwd    = ALLOC_CMATRIX_16(3,nch);
+        fwd->uu     = ALLOC_CMATRIX_16(3,nch);
+        fwd->vv     = ALLOC_CMATRIX_16(3,3);
+        fwd->sing   = MALLOC_16(3,float);
+        fwd->scales = MALLOC_16(3,float);
+        ok = stream.readRawData((char*)fwd->rd[0],nvec) == nvec &&
+             stream.readRawData((char*)fwd->fwd[0],nfield) == nfield &&
+             stream.readRawData((char*)fwd->uu[0],nfield) == nfield &&
+             stream.readRawData((char*)fwd->vv[0],3*nvec) == 3*nvec &&
+             stream.readRawData((char*)fwd->sing,nvec) == nvec &&
+             stream.readRawData((char*)fwd->scales,nvec) == nvec;
+    }
+    if (!ok) {
+        qDeleteAll(fwds);
+        return false;
+    }
+    for (int k = 0; k < this->nguess; k++) {
+        delete this->guess_fwd[k];
+        this->guess_fwd[k] = fwds[k];
+    }
+    return true;
+}
+
+//=============================================================================================================
+
+void GuessData::pack_guess_fields()
+{
+    int nch = this->nguess > 0 ? this->guess_fwd[0]->nch : 0;
+    int k,c;
+
+    this->guess_uu.resize(3*this->nguess,nch);
+    this->guess_sing_ratio.resize(this->nguess);
+    for (k = 0; k < this->nguess; k++) {
+        DipoleForward* fwd = this->guess_fwd[k];
+        for (c = 0; c < 3; c++)
+            this->guess_uu.row(3*k+c) = Map<RowVectorXf>(fwd->uu[c],nch);
+        this->guess_sing_ratio[k] = fwd->sing[2]/fwd->sing[0];
+    }
+}
+
+//=============================================================================================================
+
+int GuessData::find_best_guesses(float **B, int ntime, int nch, float limit, int *best, float *good) const
+{
+    int   j,k,t,nb,idx;
+    float B2,Bm2;
+
+    if (this->nguess <= 0 || this->guess_uu.cols() != nch) {
+        printf("Guess fields do not match the data (%d channels).\n",nch);
+        return FAIL;
+    }
+    /*
+     * Omit the pseudoradial component of the guesses below the limit
+     */
+    VectorXf vecWeight = VectorXf::Ones(3*this->nguess);
+    for (k = 0; k < this->nguess; k++)
+        if (!(this->guess_sing_ratio[k] > limit))
+            vecWeight[3*k+2] = 0.0f;
+
+    Map<const MatrixXf> matB(B[0],nch,ntime);
+    MatrixXf matProj;
+
+    for (t = 0; t < ntime; t += GUESS_SCORE_BLOCK) {
+        nb = qMin(GUESS_SCORE_BLOCK,ntime-t);
+        /*
+         * Project all guesses at once and sum the squared projections of each guess
+         */
+        matProj.noalias() = this->guess_uu*matB.middleCols(t,nb);
+        matProj = (matProj.array().square().colwise()*vecWeight.array()).matrix();
+        MatrixXf matBm2 = Map<MatrixXf>(matProj.data(),3,this->nguess*nb).colwise().sum();
+        Map<MatrixXf> matGuessBm2(matBm2.data(),this->nguess,nb);
+
+        for (j = 0; j < nb; j++) {
+            Bm2 = matGuessBm2.col(j).maxCoeff(&idx);
+            B2  = matB.col(t+j).squaredNorm();
+            good[t+j] = 1.0 - (B2 - Bm2)/B2;
+            best[t+j] = good[t+j] > 0.0 ? idx : -1;
+        }
+    }
+    return OK;
+}
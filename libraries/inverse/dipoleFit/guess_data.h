@@ -55,6 +55,7 @@
 //=============================================================================================================
 
 #include <QSharedPointer>
+#include <QString>
 
 //=============================================================================================================
 // DEFINE NAMESPACE INVERSELIB
@@ -104,7 +105,7 @@ public:
      * @param[in] guessname
      *
      */
-    GuessData( const QString& guessname, const QString& guess_surfname, float mindist, float exclude, float grid, DipoleFitData* f);
+    GuessData( const QString& guessname, const QString& guess_surfname, float mindist, float exclude, float grid, DipoleFitData* f, const QString& guess_cache_dir = QString());
 
     //=========================================================================================================
     /**
@@ -128,16 +129,79 @@ public:
      * Once the guess locations have been set up we can compute the fields
      * Refactored: compute_guess_fields (dipole_fit_setup.c)
      *
-     * @param[in] f      Dipole Fit Data to the Compute Guess Fields
+     * The fields are computed in parallel. If a cache directory is given, the fields are read from there when
+     * they have been computed before for the same guess grid, forward model, noise covariance and projection,
+     * and saved there otherwise.
+     *
+     * @param[in] f                  Dipole Fit Data to the Compute Guess Fields
+     * @param[in] guess_cache_dir    Directory for the guess field cache (optional)
+     *
+     * @return true when successful
+     */
+    bool compute_guess_fields(DipoleFitData* f, const QString& guess_cache_dir = QString());
+
+    //=========================================================================================================
+    /**
+     * Pack the left singular vectors of all guess fields into guess_uu. Called whenever the fields change.
+     */
+    void pack_guess_fields();
+
+    //=========================================================================================================
+    /**
+     * Find the best initial guess for a block of time points with one matrix product per block instead of
+     * separate projections for each guess and time point.
+     *
+     * @param[in] B          The whitened data, one row per time point stored contiguously (ntime x nch)
+     * @param[in] ntime      Number of time points
+     * @param[in] nch        Number of channels
+     * @param[in] limit      Pseudoradial component omission limit
+     * @param[out] best      The index of the best guess for each time point, -1 if none is reasonable
+     * @param[out] good      The goodness of fit of the best guess for each time point
+     *
+     * @return OK or FAIL
+     */
+    int find_best_guesses(float **B, int ntime, int nch, float limit, int *best, float *good) const;
+
+private:
+    //=========================================================================================================
+    /**
+     * Compose the name of the guess field cache file. The name is a hash of the guess grid and of the fields of
+     * a few probe locations, which depend on the forward model, the noise covariance and the projection.
+     *
+     * @param[in] f                  Dipole Fit Data with the forward functions already selected
+     * @param[in] guess_cache_dir    Directory for the guess field cache
+     *
+     * @return The file name, empty if it could not be composed
+     */
+    QString guess_fields_cache_name(DipoleFitData* f, const QString& guess_cache_dir) const;
+
+    //=========================================================================================================
+    /**
+     * Write the guess fields to a cache file
+     *
+     * @param[in] name   The cache file name
+     *
+     * @return true when successful
+     */
+    bool write_guess_fields(const QString& name) const;
+
+    //=========================================================================================================
+    /**
+     * Read the guess fields from a cache file. The current fields are kept if the file does not match.
+     *
+     * @param[in] name   The cache file name
+     * @param[in] nch    Expected number of channels
      *
      * @return true when successful
      */
-    bool compute_guess_fields(DipoleFitData* f);
+    bool read_guess_fields(const QString& name, int nch);
 
 public:
     float          **rr;            /**< These are the guess dipole locations */
     DipoleForward** guess_fwd;      /**< Forward solutions for the guesses */
     int            nguess;          /**< How many sources */
+    Eigen::MatrixXf guess_uu;       /**< Left singular vectors of all guess fields, three rows per guess ((3 nguess) x nch) */
+    Eigen::VectorXf guess_sing_ratio;   /**< Ratio of the smallest and the largest singular value of each guess field */
 
 // ### OLD STRUCT ###
 //    typedef struct {
@@ -62,6 +62,7 @@
 //=============================================================================================================
 
 #include <QFuture>
+#include <QElapsedTimer>
 #include <QtConcurrent/QtConcurrent>
 
 //=============================================================================================================
@@ -90,6 +91,8 @@ HPIFit::HPIFit(FiffInfo::SPtr pFiffInfo,
     m_vecInnerind = QVector<int>();
     m_sensors = SensorSet ();
     m_lBads = pFiffInfo->bads;
+    m_matProjectors = MatrixXd(0,0);
+    m_matProjectorsInnerind = MatrixXd(0,0);
     m_matModel = MatrixXd(0,0);
     m_vecFreqs = QVector<int>();
 
@@ -132,9 +135,13 @@ void HPIFit::fitHPI(const MatrixXd& t_mat,
         m_lBads = pFiffInfo->bads;
         updateChannels(pFiffInfo);
         updateSensor();
+        m_matProjectors.resize(0,0);
         bUpdateModel = true;
     }
 
+    // the projector reduced to the inner channels is only rebuilt if it changed
+    updateProjectors(t_matProjectors);
+
     // check if we have to update the model
     if(bUpdateModel || (m_matModel.rows() == 0) || (m_vecFreqs != vecFreqs) || (t_mat.cols() != m_matModel.cols())) {
         updateModel(pFiffInfo->sfreq,t_mat.cols(),pFiffInfo->linefreq,vecFreqs);
@@ -193,18 +200,6 @@ void HPIFit::fitHPI(const MatrixXd& t_mat,
         matHeadHPI.fill(0);
     }
 
-    //Create new projector based on the excluded channels, first exclude the rows then the columns
-    MatrixXd matProjectorsRows(m_vecInnerind.size(),t_matProjectors.cols());
-    MatrixXd matProjectorsInnerind(m_vecInnerind.size(),m_vecInnerind.size());
-
-    for (int i = 0; i < matProjectorsRows.rows(); ++i) {
-        matProjectorsRows.row(i) = t_matProjectors.row(m_vecInnerind.at(i));
-    }
-
-    for (int i = 0; i < matProjectorsInnerind.cols(); ++i) {
-        matProjectorsInnerind.col(i) = matProjectorsRows.col(m_vecInnerind.at(i));
-    }
-
     // Get the data from inner layer channels
     MatrixXd matInnerdata(m_vecInnerind.size(), t_mat.cols());
 
@@ -260,9 +255,10 @@ void HPIFit::fitHPI(const MatrixXd& t_mat,
     vecError.resize(iNumCoils);
     double dError = std::accumulate(vecError.begin(), vecError.end(), .0) / vecError.size();
     MatrixXd matCoilPos = MatrixXd::Zero(iNumCoils,3);
+    bool bWarmStart = !(transDevHead.trans == MatrixXd::Identity(4,4).cast<float>() || dError > 0.010);
 
     // Generate seed point by projection the found channel position 3cm inwards if previous transDevHead is identity or bad fit
-    if(transDevHead.trans == MatrixXd::Identity(4,4).cast<float>() || dError > 0.010) {
+    if(!bWarmStart) {
         for (int j = 0; j < vecChIdcs.rows(); ++j) {
             if(vecChIdcs(j) < pFiffInfo->chs.size()) {
                 Vector3f r0 = pFiffInfo->chs.at(vecChIdcs(j)).chpos.r0;
@@ -276,7 +272,7 @@ void HPIFit::fitHPI(const MatrixXd& t_mat,
     coil.pos = matCoilPos;
 
     // Perform actual localization
-    coil = dipfit(coil, m_sensors, matAmp, iNumCoils, matProjectorsInnerind);
+    coil = dipfit(coil, m_sensors, matAmp, iNumCoils, m_matProjectorsInnerind, bWarmStart);
 
     Matrix4d matTrans = computeTransformation(matHeadHPI, coil.pos);
     //Eigen::Matrix4d matTrans = computeTransformation(coil.pos, matHeadHPI);
@@ -364,6 +360,59 @@ void HPIFit::fitHPI(const MatrixXd& t_mat,
 
 //=============================================================================================================
 
+QList<HpiFitResult> HPIFit::trackHPI(const MatrixXd& t_mat,
+                                     const MatrixXd& t_matProjectors,
+                                     int iWindowSize,
+                                     int iStepSize,
+                                     float fTimeOffset,
+                                     FiffCoordTrans& transDevHead,
+                                     const QVector<int>& vecFreqs,
+                                     FiffInfo::SPtr pFiffInfo)
+{
+    QList<HpiFitResult> lFitResults;
+
+    if(iWindowSize <= 0 || iStepSize <= 0 || t_mat.cols() < iWindowSize) {
+        qWarning() << "HPIFit::trackHPI - Window size" << iWindowSize << "or step size" << iStepSize << "do not fit the data. Returning.";
+        return lFitResults;
+    }
+
+    QElapsedTimer timer;
+    QVector<double> vecError;
+    VectorXd vecGoF;
+
+    for(int iStart = 0; iStart + iWindowSize <= t_mat.cols(); iStart += iStepSize) {
+        HpiFitResult fitResult;
+
+        // every fit starts from the previous transformation and error, which enables the warm start
+        timer.start();
+        fitHPI(t_mat.middleCols(iStart, iWindowSize),
+               t_matProjectors,
+               transDevHead,
+               vecFreqs,
+               vecError,
+               vecGoF,
+               fitResult.fittedCoils,
+               pFiffInfo);
+
+        fitResult.dFitDuration = timer.nsecsElapsed() / 1e6;
+        fitResult.fTime = fTimeOffset + iStart / pFiffInfo->sfreq;
+        fitResult.devHeadTrans = transDevHead;
+        fitResult.errorDistances = vecError;
+        fitResult.GoF = vecGoF;
+
+        if(!lFitResults.isEmpty()) {
+            fitResult.fHeadMovementDistance = lFitResults.last().devHeadTrans.translationTo(transDevHead.trans);
+            fitResult.fHeadMovementAngle = lFitResults.last().devHeadTrans.angleTo(transDevHead.trans);
+        }
+
+        lFitResults.append(fitResult);
+    }
+
+    return lFitResults;
+}
+
+//=============================================================================================================
+
 void HPIFit::findOrder(const MatrixXd& t_mat,
                        const MatrixXd& t_matProjectors,
                        FiffCoordTrans& transDevHead,
@@ -435,18 +484,21 @@ CoilParam HPIFit::dipfit(struct CoilParam coil,
                          const SensorSet& sensors,
                          const MatrixXd& matData,
                          int iNumCoils,
-                         const MatrixXd& t_matProjectors)
+                         const MatrixXd& t_matProjectors,
+                         bool bWarmStart)
 {
     //Do this in conncurrent mode
     //Generate QList structure which can be handled by the QConcurrent framework
+    //The sensors and the projector are shared read-only between all coils
     QList<HPIFitData> lCoilData;
 
     for(qint32 i = 0; i < iNumCoils; ++i) {
         HPIFitData coilData;
         coilData.coilPos = coil.pos.row(i);
         coilData.sensorData = matData.col(i);
-        coilData.sensors = sensors;
-        coilData.matProjector = t_matProjectors;
+        coilData.pSensors = &sensors;
+        coilData.pMatProjector = &t_matProjectors;
+        coilData.bWarmStart = bWarmStart;
 
         lCoilData.append(coilData);
     }
@@ -627,6 +679,9 @@ void HPIFit::updateSensor()
         m_coilTemplate = FwdCoilSet::read_coil_defs(qPath);
     }
     // create sensor set
+    if(m_coilMeg) {
+        delete m_coilMeg;
+    }
     m_coilMeg = m_coilTemplate->create_meg_coils(m_lChannels,iNch,iAcc,t);
     createSensorSet(m_sensors,m_coilMeg);
 }
@@ -637,6 +692,9 @@ void HPIFit::updateChannels(QSharedPointer<FIFFLIB::FiffInfo> pFiffInfo)
 {
     // Get the indices of inner layer channels and exclude bad channels and create channellist
     int iNumCh = pFiffInfo->nchan;
+    m_vecInnerind.clear();
+    m_lChannels.clear();
+
     for (int i = 0; i < iNumCh; ++i) {
         if(pFiffInfo->chs[i].chpos.coil_type == FIFFV_COIL_BABY_MAG ||
                 pFiffInfo->chs[i].chpos.coil_type == FIFFV_COIL_VV_PLANAR_T1 ||
@@ -654,6 +712,29 @@ void HPIFit::updateChannels(QSharedPointer<FIFFLIB::FiffInfo> pFiffInfo)
 
 //=============================================================================================================
 
+void HPIFit::updateProjectors(const MatrixXd& t_matProjectors)
+{
+    if(t_matProjectors.rows() == m_matProjectors.rows() &&
+       t_matProjectors.cols() == m_matProjectors.cols() &&
+       t_matProjectors == m_matProjectors) {
+        return;
+    }
+
+    m_matProjectors = t_matProjectors;
+
+    //Create new projector based on the excluded channels
+    int iNumInner = m_vecInnerind.size();
+    m_matProjectorsInnerind.resize(iNumInner,iNumInner);
+
+    for (int j = 0; j < iNumInner; ++j) {
+        for (int i = 0; i < iNumInner; ++i) {
+            m_matProjectorsInnerind(i,j) = t_matProjectors(m_vecInnerind.at(i),m_vecInnerind.at(j));
+        }
+    }
+}
+
+//=============================================================================================================
+
 void HPIFit::updateModel(const int iSamF,
                          const int iSamLoc,
                          int iLineF,
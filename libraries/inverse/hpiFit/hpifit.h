@@ -105,9 +105,11 @@ struct HpiFitResult {
     QVector<double>             errorDistances;
     Eigen::VectorXd             GoF;
     QString                     sFilePathDigitzers;
-    bool                        bIsLargeHeadMovement;
-    float                       fHeadMovementDistance;
-    float                       fHeadMovementAngle;
+    bool                        bIsLargeHeadMovement = false;
+    float                       fHeadMovementDistance = 0.0f;
+    float                       fHeadMovementAngle = 0.0f;
+    float                       fTime = 0.0f;           /**< The time of the fitted data in seconds */
+    double                      dFitDuration = 0.0;     /**< The time the fit took in ms */
 };
 
 /**
@@ -176,6 +178,32 @@ public:
                 bool bDoDebug = false,
                 const QString& sHPIResourceDir = QString("./HPIFittingDebug"));
 
+    //=========================================================================================================
+    /**
+     * Track the head position over a data segment. The segment is split into windows of iWindowSize samples,
+     * which start iStepSize samples apart. Each window is fitted with fitHPI, warm-starting from the fit of the
+     * previous window.
+     *
+     * @param[in]      t_mat              Data to track the HPI positions in.
+     * @param[in]      t_matProjectors    The projectors to apply. Bad channels are still included.
+     * @param[in]      iWindowSize        The number of samples per fit.
+     * @param[in]      iStepSize          The number of samples between the starts of two fits.
+     * @param[in]      fTimeOffset        The time of the first sample of t_mat in seconds.
+     * @param[in,out]  transDevHead       The dev head transformation to start from. Holds the last fit on return.
+     * @param[in]      vecFreqs           The frequencies for each coil.
+     * @param[in]      pFiffInfo          Associated Fiff Information.
+     *
+     * @return The fit results, one per window in time order, including the time and duration of each fit.
+     */
+    QList<HpiFitResult> trackHPI(const Eigen::MatrixXd& t_mat,
+                                 const Eigen::MatrixXd& t_matProjectors,
+                                 int iWindowSize,
+                                 int iStepSize,
+                                 float fTimeOffset,
+                                 FIFFLIB::FiffCoordTrans &transDevHead,
+                                 const QVector<int>& vecFreqs,
+                                 QSharedPointer<FIFFLIB::FiffInfo> pFiffInfo);
+
     //=========================================================================================================
     /**
      * assign frequencies to correct position
@@ -227,7 +255,8 @@ protected:
      * @param[in] sensors           The sensor information.
      * @param[in] matData           The data which used to fit the coils.
      * @param[in] iNumCoils         The number of coils.
-     * @param[in] t_matProjectors   The projectors to apply. Bad channels are still included.
+     * @param[in] t_matProjectors   The projectors to apply. Bad channels are excluded.
+     * @param[in] bWarmStart        Whether the coil positions are the previous fit and can be refined locally.
      *
      * @return Returns the coil parameters.
      */
@@ -235,7 +264,8 @@ protected:
                      const SensorSet& sensors,
                      const Eigen::MatrixXd &matData,
                      int iNumCoils,
-                     const Eigen::MatrixXd &t_matProjectors);
+                     const Eigen::MatrixXd &t_matProjectors,
+                     bool bWarmStart = false);
 
     //=========================================================================================================
     /**
@@ -285,6 +315,17 @@ private:
     QVector<int>                 m_vecInnerind;           /**< index of inner channels  */
     QList<QString>               m_lBads;                 /**< contains bad channels  */
 
+    //=========================================================================================================
+    /**
+     * Update the projector reduced to the inner channels if the projector or the channellist changed
+     *
+     * @param[in] t_matProjectors   The projectors to apply. Bad channels are still included.
+     */
+    void updateProjectors(const Eigen::MatrixXd& t_matProjectors);
+
+    Eigen::MatrixXd              m_matProjectors;         /**< The projector the reduced projector was created from */
+    Eigen::MatrixXd              m_matProjectorsInnerind; /**< The projector reduced to the inner channels */
+
     //=========================================================================================================
     /**
      * Update the model of sinoids for the hpi data
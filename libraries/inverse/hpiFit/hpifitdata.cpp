@@ -49,6 +49,8 @@
 // EIGEN INCLUDES
 //=============================================================================================================
 
+#include <Eigen/Dense>
+
 //=============================================================================================================
 // QT INCLUDES
 //=============================================================================================================
@@ -61,6 +63,16 @@
 
 using namespace INVERSELIB;
 
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define HPI_SIMPLEX_MAXITER     200     /**< Maximum number of simplex iterations */
+#define HPI_LM_MAXITER          50      /**< Maximum number of Levenberg-Marquardt iterations */
+#define HPI_LM_STEP             1e-6    /**< Forward difference step for the Jacobian in m */
+#define HPI_LM_TOLX             1e-7    /**< Position tolerance in m */
+#define HPI_LM_TOLF             1e-9    /**< Relative tolerance of the residual norm */
+
 //=============================================================================================================
 // DEFINE GLOBAL METHODS
 //=============================================================================================================
@@ -70,6 +82,9 @@ using namespace INVERSELIB;
 //=============================================================================================================
 
 HPIFitData::HPIFitData()
+: pSensors(NULL)
+, pMatProjector(NULL)
+, bWarmStart(false)
 {
 }
 
@@ -80,79 +95,71 @@ void HPIFitData::doDipfitConcurrent()
     // Initialize variables
     Eigen::RowVectorXd vecCurrentCoil = this->coilPos;
     Eigen::VectorXd vecCurrentData = this->sensorData;
-    SensorSet currentSensors = this->sensors;
+    const SensorSet& currentSensors = *this->pSensors;
+    const Eigen::MatrixXd& matProjector = *this->pMatProjector;
 
     int iDisplay = 0;
-    int iMaxiter = 200;
-    int iSimplexNumitr = 0;
-
-    this->coilPos = fminsearch(vecCurrentCoil,
-                               iMaxiter,
-                               2 * iMaxiter * vecCurrentCoil.cols(),
-                               iDisplay,
-                               vecCurrentData,
-                               this->matProjector,
-                               currentSensors,
-                               iSimplexNumitr);
+    int iNumitr = 0;
+    bool bConverged = false;
+
+    // Warm start: a few gradient steps are enough to follow the coil from the previous fit
+    if(this->bWarmStart) {
+        vecCurrentCoil = lmsearch(vecCurrentCoil,
+                                  HPI_LM_MAXITER,
+                                  vecCurrentData,
+                                  matProjector,
+                                  currentSensors,
+                                  iNumitr,
+                                  bConverged);
+    }
+
+    if(!bConverged) {
+        int iSimplexNumitr = 0;
+
+        vecCurrentCoil = fminsearch(vecCurrentCoil,
+                                    HPI_SIMPLEX_MAXITER,
+                                    2 * HPI_SIMPLEX_MAXITER * vecCurrentCoil.cols(),
+                                    iDisplay,
+                                    vecCurrentData,
+                                    matProjector,
+                                    currentSensors,
+                                    iSimplexNumitr);
+
+        iNumitr += iSimplexNumitr;
+    }
+
+    this->coilPos = vecCurrentCoil;
 
     this->errorInfo = dipfitError(vecCurrentCoil,
                                   vecCurrentData,
                                   currentSensors,
-                                  this->matProjector);
+                                  matProjector);
 
-    this->errorInfo.numIterations = iSimplexNumitr;
+    this->errorInfo.numIterations = iNumitr;
 }
 
 //=============================================================================================================
 
-Eigen::MatrixXd HPIFitData::magnetic_dipole(Eigen::MatrixXd matPos,
-                                            Eigen::MatrixXd matPnt,
-                                            Eigen::MatrixXd matOri)
+Eigen::MatrixXd HPIFitData::magnetic_dipole(const Eigen::MatrixXd& matPos,
+                                            const Eigen::MatrixXd& matPnt,
+                                            const Eigen::MatrixXd& matOri)
 {
     double u0 = 1e-7;
-    int iNchan;
-    Eigen::MatrixXd r, r2, r5, x, y, z, mx, my, mz, Tx, Ty, Tz, lf;
-
-    iNchan = matPnt.rows();
+    int iNchan = matPnt.rows();
+    Eigen::RowVector3d vecPos(matPos(0), matPos(1), matPos(2));
 
     // Shift the magnetometers so that the dipole is in the origin
-    matPnt.array().col(0) -=matPos(0);
-    matPnt.array().col(1) -=matPos(1);
-    matPnt.array().col(2) -=matPos(2);
+    Eigen::MatrixXd matR = matPnt.rowwise() - vecPos;
 
-    r = matPnt.array().square().rowwise().sum().sqrt();
+    // lf = u0/(4*pi) * (3*(r.ori)*r - r^2*ori)/r^5 for all points at once
+    Eigen::ArrayXd vecR2 = matR.rowwise().squaredNorm();
+    Eigen::ArrayXd vecScale = u0 / (4 * M_PI * vecR2.square() * vecR2.sqrt());
+    Eigen::ArrayXd vecROri = 3 * matR.cwiseProduct(matOri).rowwise().sum().array();
 
-    r2 = r5 = x = y = z = mx = my = mz = Tx = Ty = Tz = lf = Eigen::MatrixXd::Zero(iNchan,3);
+    Eigen::MatrixXd lf(iNchan,3);
 
-    for(int i = 0;i < iNchan;i++) {
-        r2.row(i).array().fill(pow(r(i),2));
-        r5.row(i).array().fill(pow(r(i),5));
-    }
-
-    for(int i = 0;i < iNchan;i++) {
-        x.row(i).array().fill(matPnt(i,0));
-        y.row(i).array().fill(matPnt(i,1));
-        z.row(i).array().fill(matPnt(i,2));
-    }
-
-    mx.col(0).array().fill(1);
-    my.col(1).array().fill(1);
-    mz.col(2).array().fill(1);
-
-    Tx = 3 * x.cwiseProduct(matPnt) - mx.cwiseProduct(r2);
-    Ty = 3 * y.cwiseProduct(matPnt) - my.cwiseProduct(r2);
-    Tz = 3 * z.cwiseProduct(matPnt) - mz.cwiseProduct(r2);
-
-    for(int i = 0;i < iNchan;i++) {
-        lf(i,0) = Tx.row(i).dot(matOri.row(i));
-        lf(i,1) = Ty.row(i).dot(matOri.row(i));
-        lf(i,2) = Tz.row(i).dot(matOri.row(i));
-    }
-
-    for(int i = 0;i < iNchan;i++) {
-        for(int j = 0;j < 3;j++) {
-            lf(i,j) = u0 * lf(i,j)/(4 * M_PI * r5(i,j));
-        }
+    for(int j = 0; j < 3; j++) {
+        lf.col(j) = ((vecROri * matR.col(j).array() - vecR2 * matOri.col(j).array()) * vecScale).matrix();
     }
 
     return lf;
@@ -162,12 +169,16 @@ Eigen::MatrixXd HPIFitData::magnetic_dipole(Eigen::MatrixXd matPos,
 
 Eigen::MatrixXd HPIFitData::compute_leadfield(const Eigen::MatrixXd& matPos, const SensorSet& sensors)
 {
+    int iNp = sensors.np;
+    Eigen::MatrixXd matLf(sensors.ncoils,3);
 
-    Eigen::MatrixXd matPnt, matOri, matLf;
-    matPnt = sensors.rmag; // position of each integrationpoint
-    matOri = sensors.cosmag; // mOrientation of each coil
+    // calculate lf for all sensorpoints
+    Eigen::MatrixXd matLfSensor = magnetic_dipole(matPos, sensors.rmag, sensors.cosmag);
 
-    matLf = magnetic_dipole(matPos, matPnt, matOri);
+    // apply averaging per coil
+    for(int i = 0; i < sensors.ncoils; i++){
+        matLf.row(i) = sensors.w.segment(i*iNp,iNp) * matLfSensor.middleRows(i*iNp,iNp);
+    }
 
     return matLf;
 }
@@ -181,17 +192,10 @@ DipFitError HPIFitData::dipfitError(const Eigen::MatrixXd& matPos,
 {
     // Variable Declaration
     struct DipFitError e;
-    Eigen::MatrixXd matLfSensor, matDif;
-    Eigen::MatrixXd matLf(matData.size(),3);
-    int iNp = sensors.np;
+    Eigen::MatrixXd matDif;
 
-    // calculate lf for all sensorpoints
-    matLfSensor = compute_leadfield(matPos, sensors);
-
-    // apply averaging per coil
-    for(int i = 0; i < sensors.ncoils; i++){
-        matLf.row(i) = sensors.w.segment(i*iNp,iNp) * matLfSensor.block(i*iNp,0,iNp,matLfSensor.cols());
-    }
+    // calculate lf averaged per coil
+    Eigen::MatrixXd matLf = compute_leadfield(matPos, sensors);
     //matLf = sensors.tra * matLf;
 
     // Compute lead field for a magnetic dipole in infinite vacuum
@@ -209,6 +213,19 @@ DipFitError HPIFitData::dipfitError(const Eigen::MatrixXd& matPos,
 
 //=============================================================================================================
 
+Eigen::VectorXd HPIFitData::dipfitResidual(const Eigen::MatrixXd& matPos,
+                                           const Eigen::MatrixXd& matData,
+                                           const struct SensorSet& sensors,
+                                           const Eigen::MatrixXd& matProjectors)
+{
+    Eigen::MatrixXd matLf = compute_leadfield(matPos, sensors);
+    Eigen::MatrixXd matMoment = UTILSLIB::MNEMath::pinv(matLf) * matData;
+
+    return matData - matProjectors * (matLf * matMoment);
+}
+
+//=============================================================================================================
+
 bool HPIFitData::compare(HPISortStruct a, HPISortStruct b)
 {
     return (a.base_arr < b.base_arr);
@@ -460,3 +477,75 @@ Eigen::MatrixXd HPIFitData::fminsearch(const Eigen::MatrixXd& matPos,
     return x;
 }
 
+//=============================================================================================================
+
+Eigen::MatrixXd HPIFitData::lmsearch(const Eigen::MatrixXd& matPos,
+                                     int iMaxiter,
+                                     const Eigen::MatrixXd& matData,
+                                     const Eigen::MatrixXd& matProjectors,
+                                     const struct SensorSet& sensors,
+                                     int &iNumitr,
+                                     bool &bConverged)
+{
+    Eigen::MatrixXd x = matPos, xTrial;
+    Eigen::VectorXd vecRes = dipfitResidual(x, matData, sensors, matProjectors);
+    Eigen::VectorXd vecResTrial;
+    Eigen::MatrixXd matJ(vecRes.size(), 3);
+    Eigen::Matrix3d matJtJ, matA;
+    Eigen::Vector3d vecJtr, vecDelta;
+    double dCost = vecRes.squaredNorm();
+    double dCostTrial;
+    double dLambda = 1e-3;
+
+    bConverged = false;
+    iNumitr = 0;
+
+    while(iNumitr < iMaxiter && !bConverged) {
+        iNumitr++;
+
+        // Jacobian of the residual with respect to the position by forward differences
+        for(int j = 0; j < 3; j++) {
+            xTrial = x;
+            xTrial(j) += HPI_LM_STEP;
+            matJ.col(j) = (dipfitResidual(xTrial, matData, sensors, matProjectors) - vecRes) / HPI_LM_STEP;
+        }
+
+        matJtJ = matJ.transpose() * matJ;
+        vecJtr = matJ.transpose() * vecRes;
+
+        // Increase the damping until the step reduces the residual
+        bool bImproved = false;
+
+        while(!bImproved && dLambda < 1e10) {
+            matA = matJtJ;
+            matA.diagonal() *= 1 + dLambda;
+            vecDelta = -matA.ldlt().solve(vecJtr);
+
+            xTrial = x;
+            for(int j = 0; j < 3; j++) {
+                xTrial(j) += vecDelta(j);
+            }
+
+            vecResTrial = dipfitResidual(xTrial, matData, sensors, matProjectors);
+            dCostTrial = vecResTrial.squaredNorm();
+
+            if(dCostTrial < dCost) {
+                bConverged = vecDelta.norm() < HPI_LM_TOLX || dCost - dCostTrial < HPI_LM_TOLF * dCost;
+                x = xTrial;
+                vecRes = vecResTrial;
+                dCost = dCostTrial;
+                dLambda = std::max(dLambda / 10, 1e-10);
+                bImproved = true;
+            } else {
+                dLambda *= 10;
+            }
+        }
+
+        // No step reduces the residual anymore, we are at the minimum
+        if(!bImproved) {
+            bConverged = true;
+        }
+    }
+
+    return x;
+}
@@ -122,14 +122,17 @@ public:
     //=========================================================================================================
     /**
      * dipfit function is adapted from Fieldtrip Software.
+     * If bWarmStart is set the coil position is refined with a Levenberg-Marquardt search first, the simplex
+     * search is only used if that search does not converge.
      */
     void doDipfitConcurrent();
 
-    Eigen::MatrixXd         coilPos;
-    Eigen::RowVectorXd      sensorData;
-    DipFitError             errorInfo;
-    struct SensorSet        sensors;
-    Eigen::MatrixXd         matProjector;
+    Eigen::MatrixXd             coilPos;
+    Eigen::RowVectorXd          sensorData;
+    DipFitError                 errorInfo;
+    const struct SensorSet*     pSensors;           /**< The sensors, shared read-only between all coils */
+    const Eigen::MatrixXd*      pMatProjector;      /**< The projector, shared read-only between all coils */
+    bool                        bWarmStart;         /**< Whether coilPos is close to the solution (previous fit) */
 
 protected:
     //=========================================================================================================
@@ -137,9 +140,9 @@ protected:
      * magnetic_dipole leadfield for a magnetic dipole in an infinite medium.
      * The function has been compared with matlab magnetic_dipole and it gives same output.
      */
-    Eigen::MatrixXd magnetic_dipole(Eigen::MatrixXd matPos,
-                                    Eigen::MatrixXd matPnt,
-                                    Eigen::MatrixXd matOri);
+    Eigen::MatrixXd magnetic_dipole(const Eigen::MatrixXd& matPos,
+                                    const Eigen::MatrixXd& matPnt,
+                                    const Eigen::MatrixXd& matOri);
 
     //=========================================================================================================
     /**
@@ -148,7 +151,7 @@ protected:
      * matrix (Nchan*3), where each column corresponds with the potential or field
      * distributions on all sensors for one of the x,y,z-orientations of the dipole.
      * The function has been compared with matlab ft_compute_leadfield and it gives
-     * same output.
+     * same output. The integration points are averaged per coil.
      */
     Eigen::MatrixXd compute_leadfield(const Eigen::MatrixXd& matPos,
                                       const struct SensorSet& sensors);
@@ -165,6 +168,16 @@ protected:
                             const struct SensorSet& sensors,
                             const Eigen::MatrixXd& matProjectors);
 
+    //=========================================================================================================
+    /**
+     * dipfitResidual computes the residual between measured and model data, the moment
+     * being solved linearly for the given position.
+     */
+    Eigen::VectorXd dipfitResidual(const Eigen::MatrixXd& matPos,
+                                   const Eigen::MatrixXd& matData,
+                                   const struct SensorSet& sensors,
+                                   const Eigen::MatrixXd& matProjectors);
+
     //=========================================================================================================
     /**
      * Compare function for sorting
@@ -185,6 +198,21 @@ protected:
                                const Eigen::MatrixXd& matProjectors,
                                const struct SensorSet& sensors,
                                int &iSimplexNumitr);
+
+    //=========================================================================================================
+    /**
+     * lmsearch Levenberg-Marquardt minimization of the dipfitError over the dipole position.
+     * The moment is solved linearly for each position and the Jacobian of the residual is
+     * computed by forward differences. Meant for starting points close to the solution, e.g.
+     * the position of the previous fit when tracking.
+     */
+    Eigen::MatrixXd lmsearch(const Eigen::MatrixXd& matPos,
+                             int iMaxiter,
+                             const Eigen::MatrixXd& matData,
+                             const Eigen::MatrixXd& matProjectors,
+                             const struct SensorSet& sensors,
+                             int &iNumitr,
+                             bool &bConverged);
 };
 
 //=============================================================================================================
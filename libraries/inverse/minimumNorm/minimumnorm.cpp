@@ -61,6 +61,12 @@ using namespace INVERSELIB;
 using namespace UTILSLIB;
 using namespace FIFFLIB;
 
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define MNE_INVERSE_BLOCK 64    /**< Number of samples the current components are combined for at once */
+
 //=============================================================================================================
 // DEFINE MEMBER METHODS
 //=============================================================================================================
@@ -181,56 +187,84 @@ MNESourceEstimate MinimumNorm::calculateInverse(const FiffEvoked &p_fiffEvoked,
 //=============================================================================================================
 
 MNESourceEstimate MinimumNorm::calculateInverse(const MatrixXd &data, float tmin, float tstep, bool pick_normal) const
+{
+    MatrixXd sol;
+
+    if(!applyInverse(data, sol, pick_normal)) {
+        return MNESourceEstimate();
+    }
+
+    return MNESourceEstimate(sol, m_vecVertices, tmin, tstep);
+}
+
+//=============================================================================================================
+
+bool MinimumNorm::applyInverse(const MatrixXd &data, MatrixXd &matSol, bool pick_normal) const
 {
     if(!inverseSetup)
     {
-        qWarning("MinimumNorm::calculateInverse - Inverse not setup -> call doInverseSetup first!");
-        return MNESourceEstimate();
+        qWarning("MinimumNorm::applyInverse - Inverse not setup -> call doInverseSetup first!");
+        return false;
     }
 
     if(K.cols() != data.rows()) {
-        qWarning() << "MinimumNorm::calculateInverse - Dimension mismatch between K.cols() and data.rows() -" << K.cols() << "and" << data.rows();
-        return MNESourceEstimate();
+        qWarning() << "MinimumNorm::applyInverse - Dimension mismatch between K.cols() and data.rows() -" << K.cols() << "and" << data.rows();
+        return false;
     }
 
-    MatrixXd sol = K * data; //apply imaging kernel
-
     if (inv.source_ori == FIFFV_MNE_FREE_ORI && pick_normal == false)
     {
-        printf("combining the current components...\n");
+        //
+        //   Combine the current components: sol = sqrt(x^2 + y^2 + z^2), where the x, y and z
+        //   kernels are every third row of K. Done for blocks of samples to keep the components small.
+        //
+        qint32 nsrc = K.rows()/3;
+        qint32 nblock = std::min<qint32>(MNE_INVERSE_BLOCK, data.cols());
+        MatrixXd comp(nsrc, nblock);
+
+        matSol.resize(nsrc, data.cols());
 
-        MatrixXd sol1(sol.rows()/3,sol.cols());
-        for(qint32 i = 0; i < sol.cols(); ++i)
+        for(qint32 start = 0; start < data.cols(); start += MNE_INVERSE_BLOCK)
         {
-            VectorXd* tmp = MNEMath::combine_xyz(sol.col(i));
-            sol1.block(0,i,sol.rows()/3,1) = tmp->cwiseSqrt();
-            delete tmp;
+            qint32 ncols = std::min<qint32>(MNE_INVERSE_BLOCK, data.cols() - start);
+
+            for(qint32 k = 0; k < 3; ++k)
+            {
+                Map<const MatrixXd, 0, Stride<Dynamic, 3> > K_comp(K.data() + k, nsrc, K.cols(), Stride<Dynamic, 3>(K.outerStride(), 3));
+                comp.leftCols(ncols).noalias() = K_comp * data.middleCols(start, ncols);
+
+                if(k == 0)
+                    matSol.middleCols(start, ncols) = comp.leftCols(ncols).cwiseAbs2();
+                else
+                    matSol.middleCols(start, ncols) += comp.leftCols(ncols).cwiseAbs2();
+            }
+            matSol.middleCols(start, ncols) = matSol.middleCols(start, ncols).cwiseSqrt();
         }
-        sol.resize(sol1.rows(),sol1.cols());
-        sol = sol1;
     }
-
-    if (m_bdSPM)
-    {
-        printf("(dSPM)...");
-        sol = inv.noisenorm*sol;
-    }
-    else if (m_bsLORETA)
+    else
     {
-        printf("(sLORETA)...");
-        sol = inv.noisenorm*sol;
+        matSol.noalias() = K * data; //apply imaging kernel
     }
-    printf("[done]\n");
 
-    //Results
-    VectorXi p_vecVertices(inv.src[0].vertno.size() + inv.src[1].vertno.size());
-    p_vecVertices << inv.src[0].vertno, inv.src[1].vertno;
+    return true;
+}
 
-//    VectorXi p_vecVertices();
-//    for(qint32 h = 0; h < inv.src.size(); ++h)
-//        t_qListVertices.push_back(inv.src[h].vertno);
+//=============================================================================================================
 
-    return MNESourceEstimate(sol, p_vecVertices, tmin, tstep);
+bool MinimumNorm::applyInverse(const MatrixXd &data, MNESourceEstimate &p_sourceEstimate, float tmin, float tstep, bool pick_normal) const
+{
+    if(!applyInverse(data, p_sourceEstimate.data, pick_normal)) {
+        return false;
+    }
+
+    p_sourceEstimate.vertices = m_vecVertices;
+    p_sourceEstimate.tmin = tmin;
+    p_sourceEstimate.tstep = tstep;
+    p_sourceEstimate.times.resize(data.cols());
+    for(qint32 i = 0; i < data.cols(); ++i)
+        p_sourceEstimate.times[i] = tmin + i*tstep;
+
+    return true;
 }
 
 //=============================================================================================================
@@ -247,6 +281,32 @@ void MinimumNorm::doInverseSetup(qint32 nave, bool pick_normal)
 
     std::cout << "K " << K.rows() << " x " << K.cols() << std::endl;
 
+    //
+    //   Fold the noise normalization into the kernel. The factors are positive, so they can
+    //   be applied before the current components are combined.
+    //
+    if(m_bdSPM || m_bsLORETA)
+    {
+        VectorXd noisenorm = inv.noisenorm.diagonal();
+
+        if(noisenorm.size() == K.rows())
+        {
+            K = noisenorm.asDiagonal() * K;
+        }
+        else if(3*noisenorm.size() == K.rows())
+        {
+            for(qint32 i = 0; i < noisenorm.size(); ++i)
+                K.middleRows(3*i, 3) *= noisenorm[i];
+        }
+        else
+        {
+            qWarning() << "MinimumNorm::doInverseSetup - Noise normalization of size" << noisenorm.size() << "does not match the kernel with" << K.rows() << "rows. Using the kernel without noise normalization.";
+        }
+    }
+
+    m_vecVertices.resize(inv.src[0].vertno.size() + inv.src[1].vertno.size());
+    m_vecVertices << inv.src[0].vertno, inv.src[1].vertno;
+
     inverseSetup = true;
 }
 
@@ -114,9 +114,42 @@ public:
 
     virtual MNELIB::MNESourceEstimate calculateInverse(const Eigen::MatrixXd &data, float tmin, float tstep, bool pick_normal = false) const;
 
+    //=========================================================================================================
+    /**
+     * Applies the assembled kernel to a block of data. The noise normalization is already part of the kernel
+     * (see doInverseSetup), so the kernel multiplication and the combining of the current components are done
+     * in one pass. The solution is written to matSol, which is only reallocated if its size changes.
+     *
+     * @param[in] data           The data block (channels x samples).
+     * @param[out] matSol        The solution (sources x samples).
+     * @param[in] pick_normal    If True, rather than pooling the orientations by taking the norm, only the
+     *                           radial component is kept. This is only applied when working with loose orientations.
+     *
+     * @return true if the inverse was applied, false if it was not setup or the dimensions do not match.
+     */
+    bool applyInverse(const Eigen::MatrixXd &data, Eigen::MatrixXd &matSol, bool pick_normal = false) const;
+
+    //=========================================================================================================
+    /**
+     * Applies the assembled kernel to the next block of a data stream. The data, vertices and times of
+     * p_sourceEstimate are overwritten in place, so the same source estimate can be reused for every block.
+     *
+     * @param[in] data                   The data block (channels x samples).
+     * @param[in,out] p_sourceEstimate   The source estimate to write the solution to.
+     * @param[in] tmin                   The time of the first sample of the block.
+     * @param[in] tstep                  The time between two samples.
+     * @param[in] pick_normal            If True, rather than pooling the orientations by taking the norm, only the
+     *                                   radial component is kept. This is only applied when working with loose
+     *                                   orientations.
+     *
+     * @return true if the inverse was applied, false if it was not setup or the dimensions do not match.
+     */
+    bool applyInverse(const Eigen::MatrixXd &data, MNELIB::MNESourceEstimate &p_sourceEstimate, float tmin, float tstep, bool pick_normal = false) const;
+
     //=========================================================================================================
     /**
      * Perform the inverse setup: Prepares this inverse operator and assembles the kernel.
+     * For dSPM and sLORETA the noise normalization is folded into the kernel.
      *
      * @param[in] nave           Number of averages to use.
      * @param[in] pick_normal    If True, rather than pooling the orientations by taking the norm, only the
@@ -175,7 +208,7 @@ public:
 
     //=========================================================================================================
     /**
-     * Get the assembled kernel
+     * Get the assembled kernel, for dSPM and sLORETA with the noise normalization applied
      *
      * @return the assembled kernel
      */
@@ -193,7 +226,8 @@ private:
     Eigen::SparseMatrix<double> noise_norm;         /**< The noise normalization */
     QList<Eigen::VectorXi> vertno;                  /**< The vertices numbers */
     FSLIB::Label label;                             /**< The corresponding labels */
-    Eigen::MatrixXd K;                              /**< Imaging kernel */
+    Eigen::MatrixXd K;                              /**< Imaging kernel, noise normalized for dSPM and sLORETA */
+    Eigen::VectorXi m_vecVertices;                  /**< The vertices of both hemispheres */
 };
 
 //=============================================================================================================
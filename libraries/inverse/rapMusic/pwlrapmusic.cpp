@@ -189,6 +189,11 @@ MNESourceEstimate PwlRapMusic::calculateInverse(const MatrixXd& p_matMeasurement
         VectorXT t_vecRoh(m_iNumLeadFieldCombinations,1);
         t_vecRoh.setZero();
 
+        //Orthonormal bases of all sources -> the pair correlations only need 6 x 6 kernels
+        MatrixXT t_matQ, t_matU_B_Q;
+        Eigen::VectorXi t_vecRank;
+        calcSourceBases(t_matProj_LeadField, t_matU_B, t_matQ, t_matU_B_Q, t_vecRank);
+
         //subcorr benchmark
         //Stop the time
         clock_t start_subcorr, end_subcorr;
@@ -226,16 +231,11 @@ MNESourceEstimate PwlRapMusic::calculateInverse(const MatrixXd& p_matMeasurement
                 for(int i = 0; i < t_iNumVecElements; i++)
                 {
                     int k = t_pVecIdxElements(i);
-                    //new Version: calculate matrix multiplication before
-                    //Create Lead Field combinations -> It would be better to use a pointer construction, to increase performance
-                    MatrixX6T t_matProj_G(t_matProj_LeadField.rows(),6);
 
                     int idx1 = m_ppPairIdxCombinations[k]->x1;
                     int idx2 = m_ppPairIdxCombinations[k]->x2;
 
-                    RapMusic::getGainMatrixPair(t_matProj_LeadField, t_matProj_G, idx1, idx2);
-
-                    t_vecRoh(k) = RapMusic::subcorr(t_matProj_G, t_matU_B);//t_vecRoh holds the correlations roh_k
+                    t_vecRoh(k) = RapMusic::pairCorr(t_matQ, t_matU_B_Q, t_vecRank, idx1, idx2);//t_vecRoh holds the correlations roh_k
                 }
             }
 
@@ -45,6 +45,20 @@
 #include <omp.h>
 #endif
 
+//=============================================================================================================
+// EIGEN INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Eigenvalues>
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QAtomicInt>
+#include <QThread>
+#include <QtConcurrent/QtConcurrent>
+
 //=============================================================================================================
 // USED NAMESPACES
 //=============================================================================================================
@@ -54,6 +68,12 @@ using namespace MNELIB;
 using namespace FIFFLIB;
 using namespace UTILSLIB;
 
+//=============================================================================================================
+// DEFINES
+//=============================================================================================================
+
+#define RAP_MUSIC_PAIR_CHUNK    16      /**< Number of sources handed out to a thread at once in the pair search */
+
 //=============================================================================================================
 // DEFINE MEMBER METHODS
 //=============================================================================================================
@@ -66,6 +86,7 @@ RapMusic::RapMusic()
 , m_iNumLeadFieldCombinations(0)
 , m_ppPairIdxCombinations(NULL)
 , m_iMaxNumThreads(1)
+, m_dPairDistanceCutoff(-1)
 , m_bIsInit(false)
 , m_iSamplesStcWindow(-1)
 , m_fStcOverlap(-1)
@@ -82,6 +103,7 @@ RapMusic::RapMusic(MNEForwardSolution& p_pFwd, bool p_bSparsed, int p_iN, double
 , m_iNumLeadFieldCombinations(0)
 , m_ppPairIdxCombinations(NULL)
 , m_iMaxNumThreads(1)
+, m_dPairDistanceCutoff(-1)
 , m_bIsInit(false)
 , m_iSamplesStcWindow(-1)
 , m_fStcOverlap(-1)
@@ -107,8 +129,8 @@ bool RapMusic::init(MNEForwardSolution& p_pFwd, bool p_bSparsed, int p_iN, doubl
         std::cout << "OpenMP enabled" << std::endl;
         m_iMaxNumThreads = omp_get_max_threads();
     #else
-        std::cout << "OpenMP disabled (to enable it: VS2010->Project Properties->C/C++->Language, then modify OpenMP Support)" << std::endl;
-        m_iMaxNumThreads = 1;
+        std::cout << "OpenMP disabled, the pair search uses the global thread pool" << std::endl;
+        m_iMaxNumThreads = QThread::idealThreadCount();
     #endif
         std::cout << "Available Threats: " << m_iMaxNumThreads << std::endl << std::endl;
 
@@ -459,53 +481,15 @@ MNESourceEstimate RapMusic::calculateInverse(const MatrixXd& p_matMeasurement, Q
         MatrixXT t_matU_B;
         useFullRank(t_svdProj_Phi_S.matrixU(), t_svdProj_Phi_S.singularValues().asDiagonal(), t_matU_B);
 
-        //Inits
-        VectorXT t_vecRoh(m_iNumLeadFieldCombinations,1);
-        t_vecRoh.setZero();
-
         //subcorr benchmark
         //Stop the time
         clock_t start_subcorr, end_subcorr;
         start_subcorr = clock();
 
-        //Multithreading correlation calculation
-        #ifdef _OPENMP
-        #pragma omp parallel num_threads(m_iMaxNumThreads)
-        #endif
-        {
-        #ifdef _OPENMP
-        #pragma omp for
-        #endif
-            for(int i = 0; i < m_iNumLeadFieldCombinations; i++)
-            {
-                //new Version: calculate matrix multiplication before
-                //Create Lead Field combinations -> It would be better to use a pointer construction, to increase performance
-                MatrixX6T t_matProj_G(t_matProj_LeadField.rows(),6);
-
-                int idx1 = m_ppPairIdxCombinations[i]->x1;
-                int idx2 = m_ppPairIdxCombinations[i]->x2;
-
-                RapMusic::getGainMatrixPair(t_matProj_LeadField, t_matProj_G, idx1, idx2);
-
-                t_vecRoh(i) = RapMusic::subcorr(t_matProj_G, t_matU_B);//t_vecRoh holds the correlations roh_k
-            }
-        }
-
-//         if(r==0)
-//         {
-//             std::fstream filestr;
-//             std::stringstream filename;
-//             filename << "Roh_gold.txt";
-//
-//             filestr.open ( filename.str().c_str(), std::fstream::out);
-//             for(int i = 0; i < m_iNumLeadFieldCombinations; ++i)
-//             {
-//               filestr << t_vecRoh(i) << "\n";
-//             }
-//             filestr.close();
-//
-//             //exit(0);
-//         }
+        //Multithreading correlation calculation -> find the maximum of correlation
+        int t_iIdx1 = 0;
+        int t_iIdx2 = 0;
+        double t_val_roh_k = findMaxCorrelatedPair(t_matProj_LeadField, t_matU_B, t_iIdx1, t_iIdx2);//p_vecCor = ^roh_k
 
         //subcorr benchmark
         end_subcorr = clock();
@@ -513,17 +497,6 @@ MNESourceEstimate RapMusic::calculateInverse(const MatrixXd& p_matMeasurement, Q
         float t_fSubcorrElapsedTime = ( (float)(end_subcorr-start_subcorr) / (float)CLOCKS_PER_SEC ) * 1000.0f;
         std::cout << "Time Elapsed: " << t_fSubcorrElapsedTime << " ms" << std::endl;
 
-        //Find the maximum of correlation - can't put this in the for loop because it's running in different threads.
-        double t_val_roh_k;
-
-        VectorXT::Index t_iMaxIdx;
-
-        t_val_roh_k = t_vecRoh.maxCoeff(&t_iMaxIdx);//p_vecCor = ^roh_k
-
-        //get positions in sparsed leadfield from index combinations;
-        int t_iIdx1 = m_ppPairIdxCombinations[t_iMaxIdx]->x1;
-        int t_iIdx2 = m_ppPairIdxCombinations[t_iMaxIdx]->x2;
-
         // (Idx+1) because of MATLAB positions -> starting with 1 not with 0
         std::cout << "Iteration: " << r+1 << " of " << t_iMaxSearch
             << "; Correlation: " << t_val_roh_k<< "; Position (Idx+1): " << t_iIdx1+1 << " - " << t_iIdx2+1 <<"\n\n";
@@ -611,20 +584,17 @@ double RapMusic::subcorr(MatrixX6T& p_matProj_G, const MatrixXT& p_matU_B)
 {
     //Orthogonalisierungstest wegen performance weggelassen -> ohne is es viel schneller
 
-    Matrix6T t_matSigma_A(6, 6);
     Matrix6XT t_matU_A_T(6, p_matProj_G.rows()); //rows and cols are changed, because of CV_SVD_U_T
 
     Eigen::JacobiSVD<MatrixXT> t_svdProj_G(p_matProj_G, Eigen::ComputeThinU);
 
-    t_matSigma_A = t_svdProj_G.singularValues().asDiagonal();
     t_matU_A_T = t_svdProj_G.matrixU().transpose();
 
     //lt. Mosher 1998 ToDo: Only Retain those Components of U_A and U_B that correspond to nonzero singular values
     //for U_A and U_B the number of columns corresponds to their ranks
-    MatrixXT t_matU_A_T_full;
     //reduce to rank only when directions aren't calculated, otherwise use the full t_matU_A_T
-
-    useFullRank(t_matU_A_T, t_matSigma_A, t_matU_A_T_full, IS_TRANSPOSED);//lt. Mosher 1998: Only Retain those Components of U_A that correspond to nonzero singular values -> for U_A the number of columns corresponds to their ranks
+    //the rank rule is the same as in calcSourceBases and pairCorr
+    MatrixXT t_matU_A_T_full = t_matU_A_T.topRows(getLeadFieldRank(t_svdProj_G.singularValues()));
 
     MatrixXT t_matCor(t_matU_A_T_full.rows(), p_matU_B.cols());
 
@@ -737,6 +707,162 @@ double RapMusic::subcorr(MatrixX6T& p_matProj_G, const MatrixXT& p_matU_B, Vecto
 
 //=============================================================================================================
 
+void RapMusic::calcSourceBases(const MatrixXT& p_matProj_LeadField,
+                               const MatrixXT& p_matU_B,
+                               MatrixXT& p_matQ,
+                               MatrixXT& p_matU_B_Q,
+                               VectorXi& p_vecRank) const
+{
+    int t_iNumSources = p_matProj_LeadField.cols()/3;
+
+    p_matQ.setZero(p_matProj_LeadField.rows(), p_matProj_LeadField.cols());
+    p_matU_B_Q.resize(p_matU_B.cols(), p_matProj_LeadField.cols());
+    p_vecRank.resize(t_iNumSources);
+
+    //U of the thin SVD of each 3 column block, only the directions with non-zero singular values are kept
+    for(int i = 0; i < t_iNumSources; ++i)
+    {
+        Eigen::JacobiSVD<MatrixXT> t_svdG(p_matProj_LeadField.middleCols<3>(3*i), Eigen::ComputeThinU);
+
+        int t_iRank = getLeadFieldRank(t_svdG.singularValues());
+
+        p_matQ.middleCols(3*i, t_iRank) = t_svdG.matrixU().leftCols(t_iRank);
+        p_vecRank(i) = t_iRank;
+    }
+
+    p_matU_B_Q.noalias() = p_matU_B.transpose() * p_matQ;
+}
+
+//=============================================================================================================
+
+double RapMusic::pairCorr(const MatrixXT& p_matQ,
+                          const MatrixXT& p_matU_B_Q,
+                          const VectorXi& p_vecRank,
+                          int p_iIdx1, int p_iIdx2)
+{
+    //Gram matrix M of the pair basis [Q_1 Q_2] -> the bases are orthonormal, only the cross term has to be computed
+    Matrix3T t_matC = p_matQ.middleCols<3>(3*p_iIdx1).transpose().lazyProduct(p_matQ.middleCols<3>(3*p_iIdx2));
+
+    Matrix6T t_matM = Matrix6T::Zero();
+    for(int k = 0; k < 3; ++k)
+    {
+        t_matM(k,k) = k < p_vecRank(p_iIdx1) ? 1.0 : 0.0;
+        t_matM(3+k,3+k) = k < p_vecRank(p_iIdx2) ? 1.0 : 0.0;
+    }
+    t_matM.block<3,3>(0,3) = t_matC;
+    t_matM.block<3,3>(3,0) = t_matC.transpose();
+
+    //N = [Q_1 Q_2]^T * U_B * U_B^T * [Q_1 Q_2]
+    Matrix6T t_matN;
+    t_matN.block<3,3>(0,0) = p_matU_B_Q.middleCols<3>(3*p_iIdx1).transpose().lazyProduct(p_matU_B_Q.middleCols<3>(3*p_iIdx1));
+    t_matN.block<3,3>(0,3) = p_matU_B_Q.middleCols<3>(3*p_iIdx1).transpose().lazyProduct(p_matU_B_Q.middleCols<3>(3*p_iIdx2));
+    t_matN.block<3,3>(3,0) = t_matN.block<3,3>(0,3).transpose();
+    t_matN.block<3,3>(3,3) = p_matU_B_Q.middleCols<3>(3*p_iIdx2).transpose().lazyProduct(p_matU_B_Q.middleCols<3>(3*p_iIdx2));
+
+    //T = V_M * Sigma_M^-1/2 restricted to the range of M -> [Q_1 Q_2]*T is the orthonormal U_A of the pair
+    //The eigenvalues of M are the squared singular values of [Q_1 Q_2], the rank rule is the one of getLeadFieldRank
+    Eigen::SelfAdjointEigenSolver<Matrix6T> t_eigM(t_matM);
+    Matrix6T t_matT = t_eigM.eigenvectors();
+    double t_dEigMin = RAP_MUSIC_RANK_TOL*RAP_MUSIC_RANK_TOL*t_eigM.eigenvalues()(5);
+
+    for(int k = 0; k < 6; ++k)
+    {
+        double t_dEig = t_eigM.eigenvalues()(k);
+        t_matT.col(k) *= t_dEig > t_dEigMin ? 1.0/std::sqrt(t_dEig) : 0.0;
+    }
+
+    //The eigenvalues of U_A^T*U_B*U_B^T*U_A are the squared singular values of C = U_A^T*U_B
+    Matrix6T t_matCor = t_matT.transpose() * t_matN * t_matT;
+    Eigen::SelfAdjointEigenSolver<Matrix6T> t_eigCor(t_matCor, Eigen::EigenvaluesOnly);
+
+    return std::sqrt(std::max(t_eigCor.eigenvalues()(5), 0.0)); //Take only the correlation of the first principal components
+}
+
+//=============================================================================================================
+
+double RapMusic::findMaxCorrelatedPair(const MatrixXT& p_matProj_LeadField,
+                                       const MatrixXT& p_matU_B,
+                                       int &p_iIdx1,
+                                       int &p_iIdx2) const
+{
+    MatrixXT t_matQ, t_matU_B_Q;
+    VectorXi t_vecRank;
+    calcSourceBases(p_matProj_LeadField, p_matU_B, t_matQ, t_matU_B_Q, t_vecRank);
+
+    bool t_bCutoff = m_dPairDistanceCutoff > 0;
+    if(t_bCutoff && m_ForwardSolution.source_rr.rows() != m_iNumGridPoints)
+    {
+        std::cout << "Source locations do not fit to the number of grid points, the distance cutoff is not applied." << std::endl;
+        t_bCutoff = false;
+    }
+    double t_dCutoff2 = m_dPairDistanceCutoff*m_dPairDistanceCutoff;
+
+    //Each thread searches chunks of first pair indices and keeps its own maximum
+    int t_iNumThreads = qMax(1, qMin(m_iMaxNumThreads, m_iNumGridPoints/RAP_MUSIC_PAIR_CHUNK));
+
+    QVector<double> t_vecMax(t_iNumThreads, -1.0);
+    QVector<int> t_vecMaxIdx1(t_iNumThreads, 0);
+    QVector<int> t_vecMaxIdx2(t_iNumThreads, 0);
+    QAtomicInt t_iNextSource(0);
+    QList<QFuture<void> > t_listFutures;
+
+    for(int t = 0; t < t_iNumThreads; ++t)
+    {
+        t_listFutures.append(QtConcurrent::run([&, t]() {
+            double t_dMax = -1.0;
+            int t_iMax1 = 0, t_iMax2 = 0;
+            int c;
+
+            while((c = t_iNextSource.fetchAndAddOrdered(RAP_MUSIC_PAIR_CHUNK)) < m_iNumGridPoints)
+            {
+                for(int i = c; i < qMin(c + RAP_MUSIC_PAIR_CHUNK, m_iNumGridPoints); ++i)
+                {
+                    for(int j = i; j < m_iNumGridPoints; ++j)
+                    {
+                        if(t_bCutoff && j != i &&
+                           (m_ForwardSolution.source_rr.row(i) - m_ForwardSolution.source_rr.row(j)).squaredNorm() > t_dCutoff2)
+                            continue;
+
+                        double t_dCor = RapMusic::pairCorr(t_matQ, t_matU_B_Q, t_vecRank, i, j);
+
+                        //keep the first maximum in pair order (i,j), like maxCoeff over all combinations
+                        if(t_dCor > t_dMax || (t_dCor == t_dMax && (i < t_iMax1 || (i == t_iMax1 && j < t_iMax2))))
+                        {
+                            t_dMax = t_dCor;
+                            t_iMax1 = i;
+                            t_iMax2 = j;
+                        }
+                    }
+                }
+            }
+
+            t_vecMax[t] = t_dMax;
+            t_vecMaxIdx1[t] = t_iMax1;
+            t_vecMaxIdx2[t] = t_iMax2;
+        }));
+    }
+
+    for(int t = 0; t < t_listFutures.size(); ++t)
+        t_listFutures[t].waitForFinished();
+
+    //Reduce the maxima of all threads
+    int t_iBest = 0;
+    for(int t = 1; t < t_iNumThreads; ++t)
+    {
+        if(t_vecMax[t] > t_vecMax[t_iBest] ||
+           (t_vecMax[t] == t_vecMax[t_iBest] && (t_vecMaxIdx1[t] < t_vecMaxIdx1[t_iBest] ||
+                                                 (t_vecMaxIdx1[t] == t_vecMaxIdx1[t_iBest] && t_vecMaxIdx2[t] < t_vecMaxIdx2[t_iBest]))))
+            t_iBest = t;
+    }
+
+    p_iIdx1 = t_vecMaxIdx1[t_iBest];
+    p_iIdx2 = t_vecMaxIdx2[t_iBest];
+
+    return t_vecMax[t_iBest];
+}
+
+//=============================================================================================================
+
 void RapMusic::calcA_k_1(   const MatrixX6T& p_matG_k_1,
                             const Vector6T& p_matPhi_k_1,
                             const int p_iIdxk_1,
@@ -881,3 +1007,10 @@ void RapMusic::setStcAttr(int p_iSampStcWin, float p_fStcOverlap)
     m_iSamplesStcWindow = p_iSampStcWin;
     m_fStcOverlap = p_fStcOverlap;
 }
+
+//=============================================================================================================
+
+void RapMusic::setPairDistanceCutoff(double p_dMaxDistance)
+{
+    m_dPairDistanceCutoff = p_dMaxDistance;
+}
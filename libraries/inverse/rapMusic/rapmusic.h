@@ -72,6 +72,7 @@ namespace INVERSELIB
 
 #define NOT_TRANSPOSED   0  /**< Defines NOT_TRANSPOSED */
 #define IS_TRANSPOSED   1   /**< Defines IS_TRANSPOSED */
+#define RAP_MUSIC_RANK_TOL      1e-6    /**< Relative singular value below which a Lead Field direction is dropped */
 
 //=============================================================================================================
 /**
@@ -112,6 +113,8 @@ public:
                                                                              1> as VectorXT type. */
     typedef Eigen::Matrix<double, 6, 1> Vector6T;                            /**< Defines Eigen::Matrix<T, 6, 1>
                                                                              as Vector6T type. */
+    typedef Eigen::Matrix<double, 3, 3> Matrix3T;                            /**< Defines Eigen::Matrix<T, 3, 3>
+                                                                             as Matrix3T type. */
 
     //=========================================================================================================
     /**
@@ -165,6 +168,16 @@ public:
      */
     void setStcAttr(int p_iSampStcWin, float p_fStcOverlap);
 
+    //=========================================================================================================
+    /**
+     * Restricts the pair search to sources which are at most p_dMaxDistance apart. The pair of a source with
+     * itself is always searched. This reduces the number of searched pairs from quadratic to roughly linear
+     * in the number of sources.
+     *
+     * @param[in] p_dMaxDistance     The maximal distance of a pair in m (<= 0 searches all pairs, default).
+     */
+    void setPairDistanceCutoff(double p_dMaxDistance);
+
 protected:
     //=========================================================================================================
     /**
@@ -210,6 +223,59 @@ protected:
      */
     static double subcorr(MatrixX6T& p_matProj_G, const MatrixXT& p_matU_B, Vector6T& p_vec_phi_k_1);
 
+    //=========================================================================================================
+    /**
+     * Computes an orthonormal basis of the projected Lead Field of every source and projects it onto the
+     * signal subspace. This is done once per iteration, so that the correlation of a pair only needs 6 x 6
+     * kernels (see pairCorr).
+     *
+     * @param[in] p_matProj_LeadField    The projected Lead Field (m x 3*sources).
+     * @param[in] p_matU_B               The matrix U is the subspace projection of the orthogonal projected Phi_s
+     * @param[out] p_matQ                The orthonormal bases (m x 3*sources). Columns beyond the rank of a
+     *                                   source are zero.
+     * @param[out] p_matU_B_Q            The bases projected onto the signal subspace U_B^T*Q (r x 3*sources).
+     * @param[out] p_vecRank             The rank of the Lead Field of every source.
+     */
+    void calcSourceBases(const MatrixXT& p_matProj_LeadField,
+                         const MatrixXT& p_matU_B,
+                         MatrixXT& p_matQ,
+                         MatrixXT& p_matU_B_Q,
+                         Eigen::VectorXi& p_vecRank) const;
+
+    //=========================================================================================================
+    /**
+     * Computes the subspace correlation of a source pair from the orthonormal bases of both sources. Gives the
+     * same correlation as subcorr of the pair's projected Lead Field combination, but works on 3 x 3 and 6 x 6
+     * blocks only and does not allocate.
+     *
+     * @param[in] p_matQ         The orthonormal bases of all sources (see calcSourceBases).
+     * @param[in] p_matU_B_Q     The bases projected onto the signal subspace (see calcSourceBases).
+     * @param[in] p_vecRank      The rank of the Lead Field of every source (see calcSourceBases).
+     * @param[in] p_iIdx1        first Lead Field index point
+     * @param[in] p_iIdx2        second Lead Field index point
+     * @return   The maximal correlation c_1 of the subspace correlation of the pair and the projected measurement.
+     */
+    static double pairCorr(const MatrixXT& p_matQ,
+                           const MatrixXT& p_matU_B_Q,
+                           const Eigen::VectorXi& p_vecRank,
+                           int p_iIdx1, int p_iIdx2);
+
+    //=========================================================================================================
+    /**
+     * Searches the source pair with the maximal subspace correlation. The sources are handed out in chunks to
+     * the threads of the global thread pool. Pairs farther apart than the distance cutoff are skipped.
+     *
+     * @param[in] p_matProj_LeadField    The projected Lead Field (m x 3*sources).
+     * @param[in] p_matU_B               The matrix U is the subspace projection of the orthogonal projected Phi_s
+     * @param[out] p_iIdx1               first Lead Field index point of the best pair
+     * @param[out] p_iIdx2               second Lead Field index point of the best pair
+     * @return   The maximal correlation.
+     */
+    double findMaxCorrelatedPair(const MatrixXT& p_matProj_LeadField,
+                                 const MatrixXT& p_matU_B,
+                                 int &p_iIdx1,
+                                 int &p_iIdx2) const;
+
     //=========================================================================================================
     /**
      * Calculates the accumulated manifold vectors A_{k1}
@@ -310,6 +376,8 @@ protected:
 
     int m_iMaxNumThreads;   /**< Number of available CPU threads. */
 
+    double m_dPairDistanceCutoff;   /**< Maximal distance of a searched source pair in m (<= 0 = all pairs). */
+
     bool m_bIsInit; /**< Whether the algorithm is initialized. */
 
     //Stc stuff
@@ -326,6 +394,16 @@ protected:
      */
     static inline int getRank(const MatrixXT& p_matSigma);
 
+    //=========================================================================================================
+    /**
+     * Returns the rank of a Lead Field from its singular values. A direction is kept if its singular value is
+     * larger than RAP_MUSIC_RANK_TOL times the largest one. subcorr, calcSourceBases and pairCorr share this rule.
+     *
+     * @param[in] p_vecSigma     The singular values in decreasing order.
+     * @return The rank.
+     */
+    static inline int getLeadFieldRank(const VectorXT& p_vecSigma);
+
     //=========================================================================================================
     /**
      * lt. Mosher 1998 -> Only Retain those Components of U_A and U_B that correspond to nonzero singular values
@@ -371,6 +449,17 @@ inline int RapMusic::getRank(const MatrixXT& p_matSigma)
 
 //=============================================================================================================
 
+inline int RapMusic::getLeadFieldRank(const VectorXT& p_vecSigma)
+{
+    int t_iRank = 0;
+    while(t_iRank < p_vecSigma.size() && p_vecSigma(t_iRank) > RAP_MUSIC_RANK_TOL * p_vecSigma(0))
+        ++t_iRank;
+
+    return t_iRank;
+}
+
+//=============================================================================================================
+
 inline int RapMusic::useFullRank(   const MatrixXT& p_Mat,
                                     const MatrixXT& p_matSigma_src,
                                     MatrixXT& p_matFull_Rank,
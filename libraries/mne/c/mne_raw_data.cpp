@@ -41,8 +41,15 @@
 #include "mne_raw_data.h"
 
 #include <QFile>
+#include <QVector>
+#include <QtConcurrent>
+#include <QAtomicInt>
 
 #include <Eigen/Core>
+#include <unsupported/Eigen/FFT>
+
+#include <complex>
+#include <vector>
 
 #define _USE_MATH_DEFINES
 #include <math.h>
@@ -327,72 +334,96 @@ int mne_compare_filters(mneFilterDef f1,
 
 //============================= mne_fft.c =============================
 
-void mne_fft_ana(float *data,int np, float **precalcp)
+namespace {
+
+/*
+ * FFT plans and scratch of one thread. Eigen's FFT caches the plan (twiddles and factorization) for every length
+ * it has seen, so only the first transform of a given length per thread pays for the planning.
+ */
+typedef struct {
+    Eigen::FFT<float>                   fft;    /* Plans for all lengths seen so far */
+    std::vector<std::complex<float> >   freq;   /* Half spectrum */
+} mneFFTWorkspaceRec;
+
+mneFFTWorkspaceRec& mne_fft_workspace(int np)
+{
+    static thread_local mneFFTWorkspaceRec ws;
+    ws.fft.SetFlag(Eigen::FFT<float>::HalfSpectrum);
+    if ((int)ws.freq.size() < np/2+1)
+        ws.freq.resize(np/2+1);
+    return ws;
+}
+
+}
+
+void MneRawData::mne_fft_ana(float *data,int np, float **precalcp)
 /*
       * FFT analysis for real data
+      *
+      * The result is stored in place in the FFTPACK (rfftf) order:
+      * r0, r1, i1, r2, i2, ..., [r(np/2) if np is even]
+      *
+      * The plans are cached per thread and length, precalcp is kept for compatibility and is not used.
       */
 {
-    float *precalc;
-
-    printf("##################### DEBUG Error: FFT analysis needs to be implemented");
-
-    //  if (precalcp && *precalcp)
-    //    precalc = *precalcp;
-    //  else {
-    //    precalc = MALLOC(2*np+15,float);
-    //    rffti(&np,precalc);
-    //    if (precalcp)
-    //      *precalcp = precalc;
-    //  }
-    //  rfftf(&np,data,precalc);
-    if (!precalcp)
-        FREE_36(precalc);
+    int k,n;
+    Q_UNUSED(precalcp);
+
+    if (np <= 1)	/* The transform of a single value is the value itself */
+        return;
+    mneFFTWorkspaceRec& ws = mne_fft_workspace(np);
+    std::complex<float> *freq = ws.freq.data();
+
+    ws.fft.fwd(freq,data,np);
+
+    n = np % 2 == 0 ? np/2 : (np+1)/2;
+    data[0] = freq[0].real();
+    for (k = 1; k < n; k++) {
+        data[2*k-1] = freq[k].real();
+        data[2*k]   = freq[k].imag();
+    }
+    if (np % 2 == 0)
+        data[np-1] = freq[n].real();
     return;
 }
 
-void mne_fft_syn(float *data,int np, float **precalcp)
+void MneRawData::mne_fft_syn(float *data,int np, float **precalcp)
 /*
       * FFT synthesis for real data
+      *
+      * The input is expected in the order produced by mne_fft_ana. The result is normalized, i.e.,
+      * mne_fft_syn(mne_fft_ana(x)) = x.
       */
 {
-    float *precalc;
-    float mult;
-
-    printf("##################### DEBUG Error: FFT synthesis needs to be implemented");
-
-    //  if (precalcp && *precalcp)
-    //    precalc = *precalcp;
-    //  else {
-    //    precalc = MALLOC(2*np+15,float);
-    //    rffti(&np,precalc);
-    //    if (precalcp)
-    //      *precalcp = precalc;
-    //  }
-    //  rfftb(&np,data,precalc);
-    //  /*
-    //   * Normalization
-    //   */
-    //  mult = 1.0/np;
-    //  mne_scale_vector(mult,data,np);
-
-    if (!precalcp)
-        FREE_36(precalc);
+    int k,n;
+    Q_UNUSED(precalcp);
+
+    if (np <= 1)	/* The transform of a single value is the value itself */
+        return;
+    mneFFTWorkspaceRec& ws = mne_fft_workspace(np);
+    std::complex<float> *freq = ws.freq.data();
+
+    n = np % 2 == 0 ? np/2 : (np+1)/2;
+    freq[0] = std::complex<float>(data[0],0.0f);
+    for (k = 1; k < n; k++)
+        freq[k] = std::complex<float>(data[2*k-1],data[2*k]);
+    if (np % 2 == 0)
+        freq[n] = std::complex<float>(data[np-1],0.0f);
+    /*
+     * Eigen normalizes the inverse transform with 1/np
+     */
+    ws.fft.inv(data,freq,np);
     return;
 }
 
-int mne_apply_filter(mneFilterDef filter, void *datap, float *data, int ns, int zero_pad, float dc_offset, int kind)
+static int apply_filter_one(mneFilterDef filter, filterData d, float *data, int ns, int zero_pad, float dc_offset, int kind, int filter_on)
 /*
- * Do the magick trick
+ * Filter one channel. filter_on overrides filter->filter_on so that several channels can be processed in parallel.
  */
 {
     int   k,p,n;
-    filterData d = (filterData)datap;
     float *freq_resp;
 
-    if (ns != filter->size + 2*filter->taper_size) {
-        printf("Incorrect data length in apply_filter");
-        return FAIL;
-    }
     /*
    * Zero padding
    */
@@ -402,7 +433,7 @@ int mne_apply_filter(mneFilterDef filter, void *datap, float *data, int ns, int
         for (k = filter->taper_size + filter->size; k < ns; k++)
             data[k] = 0.0;
     }
-    if (!filter->filter_on)	/* Nothing else to do */
+    if (!filter_on)	/* Nothing else to do */
         return OK;
     /*
    * Make things nice by compensating for the dc offset
@@ -418,7 +449,7 @@ int mne_apply_filter(mneFilterDef filter, void *datap, float *data, int ns, int
     /*
    * Next comes the FFT
    */
-    mne_fft_ana(data,ns,&d->precalc);
+    MneRawData::mne_fft_ana(data,ns,&d->precalc);
     /*
    * Multiply with the frequency response
    * See FFTpack doc for details of the arrangement
@@ -446,8 +477,52 @@ int mne_apply_filter(mneFilterDef filter, void *datap, float *data, int ns, int
     if (ns % 2 == 0)
         data[p] = data[p]*freq_resp[k];
 
-    mne_fft_syn(data,ns,&d->precalc);
+    MneRawData::mne_fft_syn(data,ns,&d->precalc);
+
+    return OK;
+}
+
+int mne_apply_filter(mneFilterDef filter, void *datap, float *data, int ns, int zero_pad, float dc_offset, int kind)
+/*
+ * Do the magick trick
+ */
+{
+    if (ns != filter->size + 2*filter->taper_size) {
+        printf("Incorrect data length in apply_filter");
+        return FAIL;
+    }
+    return apply_filter_one(filter,(filterData)datap,data,ns,zero_pad,dc_offset,kind,filter->filter_on);
+}
 
+int mne_apply_filter_multi(mneFilterDef filter, void *datap, float **data, int nch, int ns, int zero_pad, const float *dc_offsets, const int *kinds)
+/*
+ * Filter several channels of equal length in one pass. The channels are distributed over the available threads,
+ * each of which uses its own cached FFT plans. Stimulus channels are only zero padded.
+ */
+{
+    filterData  d = (filterData)datap;
+    QVector<int> chs(nch);
+    QAtomicInt  nfail(0);
+
+    if (ns != filter->size + 2*filter->taper_size) {
+        printf("Incorrect data length in apply_filter");
+        return FAIL;
+    }
+    for (int c = 0; c < nch; c++)
+        chs[c] = c;
+
+    QtConcurrent::blockingMap(chs, [&](int c) {
+        if (apply_filter_one(filter,d,data[c],ns,zero_pad,
+                             dc_offsets ? dc_offsets[c] : 0.0f,
+                             kinds[c],
+                             filter->filter_on && kinds[c] != FIFFV_STIM_CH) != OK)
+            nfail.ref();
+    });
+
+    if (nfail.load() > 0) {
+        printf("Filtering failed for %d of %d channels in apply_filter",nfail.load(),nch);
+        return FAIL;
+    }
     return OK;
 }
 
@@ -1418,9 +1493,11 @@ int MneRawData::mne_raw_pick_data_proj(MneRawData *data, mneChSelection sel, int
 
 //=============================================================================================================
 
-int MneRawData::load_one_filt_buf(MneRawData *data, MneRawBufDef *buf)
+int MneRawData::load_one_filt_buf(MneRawData *data, MneRawBufDef *buf, const int *chs, int nchs, const float *dc)
 /*
      * Load and filter one buffer
+     *
+     * The channels listed in chs which have not been filtered yet are filtered in one batched pass.
      */
 {
     int k;
@@ -1433,7 +1510,7 @@ int MneRawData::load_one_filt_buf(MneRawData *data, MneRawBufDef *buf)
         mne_allocate_from_ring(data->filt_ring, buf->nchan, buf->ns,&buf->vals);
     }
     if (buf->valid)
-        return OK;
+        return filter_one_buf(data,buf,chs,nchs,dc);
 
     vals = MALLOC_36(buf->nchan,float *);
     for (k = 0; k < buf->nchan; k++) {
@@ -1451,6 +1528,62 @@ int MneRawData::load_one_filt_buf(MneRawData *data, MneRawBufDef *buf)
                 buf->firsts,buf->lasts,buf->lasts-buf->firsts+1,buf->ns,data->first_samp + data->nsamp);
 #endif
     buf->valid = res == OK;
+    if (res != OK)
+        return res;
+    return filter_one_buf(data,buf,chs,nchs,dc);
+}
+
+//=============================================================================================================
+
+int MneRawData::filter_one_buf(MneRawData *data, MneRawBufDef *buf, const int *chs, int nchs, const float *dc)
+/*
+     * Filter the listed channels of a loaded buffer which have not been filtered yet
+     */
+{
+    int   k,c,nfilt;
+    int   res;
+    float **vals;
+    float *dc_offsets;
+    int   *kinds;
+    int   *filt;
+
+    if (!chs || nchs <= 0)
+        return OK;
+
+    vals       = MALLOC_36(nchs,float *);
+    dc_offsets = MALLOC_36(nchs,float);
+    kinds      = MALLOC_36(nchs,int);
+    filt       = MALLOC_36(nchs,int);
+
+    for (k = 0, nfilt = 0; k < nchs; k++) {
+        c = chs[k];
+        if (c < 0 || buf->ch_filtered[c])
+            continue;
+        /*
+         * Do not pick a channel twice
+         */
+        buf->ch_filtered[c] = TRUE;
+        filt[nfilt]       = c;
+        vals[nfilt]       = buf->vals[c];
+        kinds[nfilt]      = data->info->chInfo[c].kind;
+        dc_offsets[nfilt] = (dc && kinds[nfilt] != FIFFV_STIM_CH) ? dc[c] : 0.0;
+        nfilt++;
+    }
+
+    res = OK;
+    if (nfilt > 0) {
+        res = mne_apply_filter_multi(data->filter,data->filter_data,vals,nfilt,buf->ns,TRUE,dc_offsets,kinds);
+        if (res != OK) {
+            for (k = 0; k < nfilt; k++)
+                buf->ch_filtered[filt[k]] = FALSE;
+        }
+    }
+
+    FREE_36(vals);
+    FREE_36(dc_offsets);
+    FREE_36(kinds);
+    FREE_36(filt);
+
     return res;
 }
 
@@ -1467,10 +1600,9 @@ int MneRawData::mne_raw_pick_data_filt(MneRawData *data, mneChSelection sel, int
     float        *values;
     float        **deriv_vals = NULL;
     float        *dc          = NULL;
-    float        dc_offset;
     int          deriv_ns     = 0;
     int          nderiv       = 0;
-    int          filter_was;
+    QVector<int> filt_chs;
 
     if (!data->filter || !data->filter->filter_on)
         return mne_raw_pick_data_proj(data,sel,firsts,ns,picked);
@@ -1504,7 +1636,24 @@ int MneRawData::mne_raw_pick_data_filt(MneRawData *data, mneChSelection sel, int
             if (MneProjOp::mne_proj_op_proj_vector(data->proj,dc,data->info->nchan,TRUE) != OK)
                 goto bad;
     }
-    filter_was = data->filter->filter_on;
+    /*
+       * The channels to filter: the selected ones and those included in derivations if they are used
+       */
+    if (sel) {
+        for (c = 0; c < sel->nchan; c++)
+            if (sel->pick[c] >= 0)
+                filt_chs.append(sel->pick[c]);
+        if (sel->nderiv > 0 && data->deriv_matched) {
+            MneDeriv* der = data->deriv_matched;
+            for (c = 0; c < der->deriv_data->ncol; c++)
+                if (der->in_use[c] > 0)
+                    filt_chs.append(c);
+        }
+    }
+    else {
+        for (c = 0; c < data->info->nchan; c++)
+            filt_chs.append(c);
+    }
     /*
        * Find the first buffer to consider
        */
@@ -1517,86 +1666,10 @@ int MneRawData::mne_raw_pick_data_filt(MneRawData *data, mneChSelection sel, int
         fprintf(stderr,"this_buf (%d): %d..%d\n",k,this_buf->firsts,this_buf->lasts);
 #endif
         /*
-         * Load the buffer first and apply projection
+         * Load the buffer first, apply projection and filter all relevant channels in one pass
          */
-        if (load_one_filt_buf(data,this_buf) != OK)
+        if (load_one_filt_buf(data,this_buf,filt_chs.constData(),filt_chs.size(),dc) != OK)
             goto bad;
-        /*
-         * Then filter all relevant channels (not stimuli)
-         */
-        if (sel) {
-            for (c = 0; c < sel->nchan; c++) {
-                if (sel->pick[c] >= 0) {
-                    if (!this_buf->ch_filtered[sel->pick[c]]) {
-                        /*
-                 * Do not filter stimulus channels
-                 */
-                        dc_offset = 0.0;
-                        if (data->info->chInfo[sel->pick[c]].kind == FIFFV_STIM_CH)
-                            data->filter->filter_on = FALSE;
-                        else if (dc)
-                            dc_offset = dc[sel->pick[c]];
-                        if (mne_apply_filter(data->filter,data->filter_data,this_buf->vals[sel->pick[c]],this_buf->ns,TRUE,
-                                             dc_offset,data->info->chInfo[sel->pick[c]].kind) != OK) {
-                            data->filter->filter_on = filter_was;
-                            goto bad;
-                        }
-                        this_buf->ch_filtered[sel->pick[c]] = TRUE;
-                        data->filter->filter_on = filter_was;
-                    }
-                }
-            }
-            /*
-           * Also check channels included in derivations if they are used
-           */
-            if (sel->nderiv > 0 && data->deriv_matched) {
-                MneDeriv* der = data->deriv_matched;
-                for (c = 0; c < der->deriv_data->ncol; c++) {
-                    if (der->in_use[c] > 0 &&
-                            !this_buf->ch_filtered[c]) {
-                        /*
-                 * Do not filter stimulus channels
-                 */
-                        dc_offset = 0.0;
-                        if (data->info->chInfo[c].kind == FIFFV_STIM_CH)
-                            data->filter->filter_on = FALSE;
-                        else if (dc)
-                            dc_offset = dc[c];
-                        if (mne_apply_filter(data->filter,data->filter_data,this_buf->vals[c],this_buf->ns,TRUE,
-                                             dc_offset,data->info->chInfo[c].kind) != OK) {
-                            data->filter->filter_on = filter_was;
-                            goto bad;
-                        }
-                        this_buf->ch_filtered[c] = TRUE;
-                        data->filter->filter_on = filter_was;
-                    }
-                }
-            }
-        }
-        else {
-            /*
-           * Simply filter all channels if there is no selection
-           */
-            for (c = 0; c < data->info->nchan; c++) {
-                if (!this_buf->ch_filtered[c]) {
-                    /*
-               * Do not filter stimulus channels
-               */
-                    dc_offset = 0.0;
-                    if (data->info->chInfo[c].kind == FIFFV_STIM_CH)
-                        data->filter->filter_on = FALSE;
-                    else if (dc)
-                        dc_offset = dc[c];
-                    if (mne_apply_filter(data->filter,data->filter_data,this_buf->vals[c],this_buf->ns,TRUE,
-                                         dc_offset,data->info->chInfo[c].kind) != OK) {
-                        data->filter->filter_on = filter_was;
-                        goto bad;
-                    }
-                    this_buf->ch_filtered[c] = TRUE;
-                    data->filter->filter_on = filter_was;
-                }
-            }
-        }
         /*
          * Decide the picking limits
          */
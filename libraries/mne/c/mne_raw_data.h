@@ -123,7 +123,9 @@ public:
                                int            ns,
                                float          **picked);
 
-    static int load_one_filt_buf(MneRawData* data, MneRawBufDef* buf);
+    static int load_one_filt_buf(MneRawData* data, MneRawBufDef* buf, const int* chs = NULL, int nchs = 0, const float* dc = NULL);
+
+    static int filter_one_buf(MneRawData* data, MneRawBufDef* buf, const int* chs, int nchs, const float* dc);
 
     static int mne_raw_pick_data_filt(MneRawData*    data,
                                mneChSelection sel,
@@ -135,6 +137,30 @@ public:
 
     static MneRawData* mne_raw_open_file(const QString& name, int omit_skip, int allow_maxshield, mneFilterDef filter);
 
+    //=========================================================================================================
+    /**
+     * FFT analysis of real data. The result is stored in place in the FFTPACK (rfftf) order:
+     * r0, r1, i1, r2, i2, ..., [r(np/2) if np is even]
+     * Refactored: mne_fft_ana (mne_fft.c)
+     *
+     * @param[in, out] data      The data to transform (np values).
+     * @param[in] np             The number of values.
+     * @param[in] precalcp       Kept for compatibility, not used. The FFT plans are cached per thread and length.
+     */
+    static void mne_fft_ana(float *data, int np, float **precalcp = NULL);
+
+    //=========================================================================================================
+    /**
+     * FFT synthesis of real data in the order produced by mne_fft_ana. The result is normalized, i.e.,
+     * mne_fft_syn(mne_fft_ana(x)) = x.
+     * Refactored: mne_fft_syn (mne_fft.c)
+     *
+     * @param[in, out] data      The data to transform (np values).
+     * @param[in] np             The number of values.
+     * @param[in] precalcp       Kept for compatibility, not used. The FFT plans are cached per thread and length.
+     */
+    static void mne_fft_syn(float *data, int np, float **precalcp = NULL);
+
 public:
     QString         filename;             /* This is our file */
     //  FIFFLIB::fiffFile       file;
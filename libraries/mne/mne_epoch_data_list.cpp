@@ -43,6 +43,8 @@
 
 #include <utils/mnemath.h>
 
+#include <algorithm>
+
 //=============================================================================================================
 // QT INCLUDES
 //=============================================================================================================
@@ -92,24 +94,91 @@ MNEEpochDataList MNEEpochDataList::readEpochs(const FiffRawData& raw,
 {
     MNEEpochDataList data;
 
-    // Select the desired events
+    MNEEpochTensor tensor = readEpochTensor(raw,
+                                            events,
+                                            tmin,
+                                            tmax,
+                                            event,
+                                            mapReject,
+                                            lExcludeChs,
+                                            picks);
+
+    fiff_int_t dropCount = 0;
+
+    for (qint32 p = 0; p < tensor.size(); ++p) {
+        MNEEpochData::SPtr epoch(new MNEEpochData());
+
+        epoch->epoch = tensor.epoch(p);
+        epoch->event = event;
+        epoch->tmin = tmin;
+        epoch->tmax = tmax;
+        epoch->bReject = tensor.rejected.at(p);
+
+        if (epoch->bReject) {
+            dropCount++;
+        }
+
+        data.append(epoch);
+    }
+
+    qInfo().noquote() << "[MNEEpochDataList::readEpochs] Read a total of"<< data.size() <<"epochs of type" << event << "and marked"<< dropCount <<"for rejection.";
+
+    return data;
+}
+
+//=============================================================================================================
+
+MNEEpochTensor MNEEpochDataList::readEpochTensor(const FiffRawData& raw,
+                                                 const MatrixXi& events,
+                                                 float tmin,
+                                                 float tmax,
+                                                 qint32 event,
+                                                 const QMap<QString,double>& mapReject,
+                                                 const QStringList& lExcludeChs,
+                                                 const RowVectorXi& picks)
+{
+    MNEEpochTensor tensor;
+    tensor.event = event;
+    tensor.tmin = tmin;
+    tensor.tmax = tmax;
+
+    // Select the desired events and determine their sample ranges
     qint32 count = 0;
     qint32 p;
-    MatrixXi selected = MatrixXi::Zero(1, events.rows());
-    for (p = 0; p < events.rows(); ++p)
-    {
-        if (events(p,1) == 0 && events(p,2) == event)
-        {
-            selected(0,count) = p;
+    fiff_int_t event_samp, from, to;
+    QVector<qint32> vecSelected;
+    QVector<fiff_int_t> vecFrom;
+
+    for (p = 0; p < events.rows(); ++p) {
+        if (events(p,1) == 0 && events(p,2) == event) {
             ++count;
+
+            event_samp = events(p,0);
+            from = event_samp + tmin*raw.info.sfreq;
+            to   = event_samp + floor(tmax*raw.info.sfreq + 0.5);
+
+            if (from < raw.first_samp || to > raw.last_samp) {
+                qWarning("[MNEEpochDataList::readEpochTensor] Can't read the event data segment %d ... %d.", from, to);
+                continue;
+            }
+
+            //Check if data block has the same size as the previous one
+            if (tensor.nsamp == 0) {
+                tensor.nsamp = to - from + 1;
+            } else if (to - from + 1 != tensor.nsamp) {
+                continue;
+            }
+
+            vecSelected.append(p);
+            vecFrom.append(from);
         }
     }
-    selected.conservativeResize(1, count);
+
     if (count > 0) {
-        qInfo("[MNEEpochDataList::readEpochs] %d matching events found",count);
+        qInfo("[MNEEpochDataList::readEpochTensor] %d matching events found",count);
     } else {
-        qWarning("[MNEEpochDataList::readEpochs] No desired events found.");
-        return MNEEpochDataList();
+        qWarning("[MNEEpochDataList::readEpochTensor] No desired events found.");
+        return tensor;
     }
 
     // If picks are empty, pick all
@@ -121,57 +190,150 @@ MNEEpochDataList MNEEpochDataList::readEpochs(const FiffRawData& raw,
         }
     }
 
-    fiff_int_t event_samp, from, to;
-    fiff_int_t dropCount = 0;
-    MatrixXd timesDummy;
-    MatrixXd times;
+    const qint32 nEpochs = vecSelected.size();
+    const qint32 nsamp = tensor.nsamp;
 
-    QScopedPointer<MNEEpochData> epoch(Q_NULLPTR);
+    tensor.data.resize(picksNew.cols(), nEpochs * nsamp);
+    tensor.events.resize(nEpochs);
+    tensor.rejected.fill(false, nEpochs);
+    for (p = 0; p < nEpochs; ++p) {
+        tensor.events(p) = vecSelected.at(p);
+    }
 
-    for (p = 0; p < count; ++p) {
-        // Read a data segment
-        event_samp = events(selected(p),0);
-        from = event_samp + tmin*raw.info.sfreq;
-        to   = event_samp + floor(tmax*raw.info.sfreq + 0.5);
+    // Map the channels to scan for artifacts to their rows in the picked data
+    QList<ArtifactRejectionData> lRejectChs = getArtifactChannels(raw.info,
+                                                                  mapReject,
+                                                                  lExcludeChs);
+    QMutableListIterator<ArtifactRejectionData> itCh(lRejectChs);
+    while (itCh.hasNext()) {
+        ArtifactRejectionData& chData = itCh.next();
+        qint32 iRow = -1;
+        for (qint32 r = 0; r < picksNew.cols(); ++r) {
+            if (picksNew(r) == chData.iChIdx) {
+                iRow = r;
+                break;
+            }
+        }
+
+        if (iRow < 0) {
+            itCh.remove();
+        } else {
+            chData.iChIdx = iRow;
+        }
+    }
 
-        epoch.reset(new MNEEpochData());
+    // Walk the raw buffers in sample order and scatter each decoded buffer into all epochs it overlaps
+    QVector<qint32> vecOrder(nEpochs);
+    for (p = 0; p < nEpochs; ++p) {
+        vecOrder[p] = p;
+    }
+    std::stable_sort(vecOrder.begin(), vecOrder.end(), [&vecFrom](qint32 a, qint32 b) {
+        return vecFrom.at(a) < vecFrom.at(b);
+    });
+
+    const MatrixXd* pData = &tensor.data;
+    QList<QPair<qint32,QFuture<bool> > > lRejectFutures;
+    QList<qint32> lActive;
+    QVector<bool> vecDropped(nEpochs, false);
+    qint32 iNext = 0;
+    MatrixXd matBuffer;
+
+    for (qint32 k = 0; k < raw.rawdir.size() && (iNext < nEpochs || !lActive.isEmpty()); ++k) {
+        const FiffRawDir& thisRawDir = raw.rawdir.at(k);
+
+        while (iNext < nEpochs && vecFrom.at(vecOrder.at(iNext)) <= thisRawDir.last) {
+            lActive.append(vecOrder.at(iNext++));
+        }
 
-        if(raw.read_raw_segment(epoch->epoch, timesDummy, from, to, picksNew)) {
-            if (p == 0) {
-                times.resize(1, to-from+1);
-                for (qint32 i = 0; i < times.cols(); ++i)
-                    times(0, i) = ((float)(from-event_samp+i)) / raw.info.sfreq;
-            }
+        if (lActive.isEmpty()) {
+            continue;
+        }
+
+        const bool bBufferRead = raw.read_raw_buffer(k, matBuffer, picksNew);
 
-            epoch->event = event;
-            epoch->tmin = tmin;
-            epoch->tmax = tmax;
+        if (!bBufferRead) {
+            qWarning("[MNEEpochDataList::readEpochTensor] Can't read raw data buffer %d. Leaving out the epochs overlapping it.", k);
+        }
 
-            epoch->bReject = checkForArtifact(epoch->epoch,
-                                              raw.info,
-                                              mapReject,
-                                              lExcludeChs);
+        QMutableListIterator<qint32> itEpoch(lActive);
+        while (itEpoch.hasNext()) {
+            const qint32 e = itEpoch.next();
+            const fiff_int_t epochFrom = vecFrom.at(e);
+            const fiff_int_t epochTo = epochFrom + nsamp - 1;
+            const fiff_int_t first = qMax(epochFrom, thisRawDir.first);
+            const fiff_int_t last = qMin(epochTo, thisRawDir.last);
+
+            if (first <= last) {
+                // As with a failed segment read, an epoch missing some of its samples is not returned
+                if (!bBufferRead) {
+                    vecDropped[e] = true;
+                    itEpoch.remove();
+                    continue;
+                }
 
-            if (epoch->bReject) {
-                dropCount++;
+                tensor.data.middleCols(e * nsamp + first - epochFrom, last - first + 1) = matBuffer.middleCols(first - thisRawDir.first, last - first + 1);
             }
 
-            //Check if data block has the same size as the previous one
-            if(!data.isEmpty()) {
-                if(epoch->epoch.size() == data.last()->epoch.size()) {
-                    data.append(MNEEpochData::SPtr(epoch.take()));//List takes ownwership of the pointer - no delete need
+            // The epoch is complete, scan it for artifacts while the next buffers are decoded
+            if (epochTo <= thisRawDir.last) {
+                if (!lRejectChs.isEmpty()) {
+                    lRejectFutures.append(qMakePair(e, QtConcurrent::run([pData, e, nsamp, lRejectChs]() {
+                        Block<const MatrixXd> matEpoch = pData->block(0, e * nsamp, pData->rows(), nsamp);
+                        for (int i = 0; i < lRejectChs.size(); ++i) {
+                            ArtifactRejectionData chData = lRejectChs.at(i);
+                            chData.data = matEpoch.row(chData.iChIdx);
+                            checkChThreshold(chData);
+                            if (chData.bRejected) {
+                                qInfo().noquote() << "[MNEEpochDataList::readEpochTensor] Reject trial because of channel" << chData.sChName;
+                                return true;
+                            }
+                        }
+                        return false;
+                    })));
                 }
-            } else {
-                data.append(MNEEpochData::SPtr(epoch.take()));//List takes ownwership of the pointer - no delete need
+                itEpoch.remove();
             }
-        } else {
-            qWarning("[MNEEpochDataList::readEpochs] Can't read the event data segments.");
         }
     }
 
-    qInfo().noquote() << "[MNEEpochDataList::readEpochs] Read a total of"<< data.size() <<"epochs of type" << event << "and marked"<< dropCount <<"for rejection.";
+    if (!lActive.isEmpty()) {
+        qWarning("[MNEEpochDataList::readEpochTensor] %d epochs exceed the raw data buffers. Leaving them out.", lActive.size());
+        for (int i = 0; i < lActive.size(); ++i) {
+            vecDropped[lActive.at(i)] = true;
+        }
+    }
 
-    return data;
+    if (!mapReject.isEmpty() && lRejectChs.isEmpty()) {
+        qWarning() << "[MNEEpochDataList::readEpochTensor] No channels found to scan for artifacts. Do not reject.";
+    }
+
+    for (int i = 0; i < lRejectFutures.size(); ++i) {
+        tensor.rejected[lRejectFutures.at(i).first] = lRejectFutures.at(i).second.result();
+    }
+
+    // Move the remaining epochs to the front, in event order
+    qint32 nKept = 0;
+    for (p = 0; p < nEpochs; ++p) {
+        if (vecDropped.at(p)) {
+            continue;
+        }
+
+        if (nKept != p) {
+            tensor.data.middleCols(nKept * nsamp, nsamp) = tensor.data.middleCols(p * nsamp, nsamp);
+            tensor.events(nKept) = tensor.events(p);
+            tensor.rejected[nKept] = tensor.rejected.at(p);
+        }
+
+        ++nKept;
+    }
+
+    if (nKept < nEpochs) {
+        tensor.data.conservativeResize(NoChange, nKept * nsamp);
+        tensor.events.conservativeResize(nKept);
+        tensor.rejected.resize(nKept);
+    }
+
+    return tensor;
 }
 
 //=============================================================================================================
@@ -280,56 +442,16 @@ bool MNEEpochDataList::checkForArtifact(const MatrixXd& data,
     bool bReject = false;
 
     //Prepare concurrent data handling
-    QList<ArtifactRejectionData> lchData;
-    QList<int> lChTypes;
-
-    if(mapReject.contains("grad") ||
-       mapReject.contains("mag") ) {
-        lChTypes << FIFFV_MEG_CH;
-    }
-
-    if(mapReject.contains("eeg")) {
-        lChTypes << FIFFV_EEG_CH;
-    }
-
-    if(mapReject.contains("eog")) {
-        lChTypes << FIFFV_EOG_CH;
-    }
+    QList<ArtifactRejectionData> lchData = getArtifactChannels(pFiffInfo,
+                                                               mapReject,
+                                                               lExcludeChs);
 
-    if(lChTypes.isEmpty()) {
+    if(mapReject.isEmpty()) {
         return bReject;
     }
 
-    for(int i = 0; i < pFiffInfo.chs.size(); ++i) {
-        if(lChTypes.contains(pFiffInfo.chs.at(i).kind)
-           && !lExcludeChs.contains(pFiffInfo.chs.at(i).ch_name)
-           && !pFiffInfo.bads.contains(pFiffInfo.chs.at(i).ch_name)
-           && pFiffInfo.chs.at(i).chpos.coil_type != FIFFV_COIL_BABY_REF_MAG
-           && pFiffInfo.chs.at(i).chpos.coil_type != FIFFV_COIL_BABY_REF_MAG2) {
-            ArtifactRejectionData tempData;
-            tempData.data = data.row(i);
-
-            switch (pFiffInfo.chs.at(i).kind) {
-            case FIFFV_MEG_CH:
-                if(pFiffInfo.chs.at(i).unit == FIFF_UNIT_T) {
-                    tempData.dThreshold = mapReject["mag"];
-                } else if(pFiffInfo.chs.at(i).unit == FIFF_UNIT_T_M) {
-                    tempData.dThreshold = mapReject["grad"];
-                }
-            break;
-
-            case FIFFV_EEG_CH:
-                tempData.dThreshold = mapReject["eeg"];
-            break;
-
-            case FIFFV_EOG_CH:
-                tempData.dThreshold = mapReject["eog"];
-            break;
-            }
-
-            tempData.sChName = pFiffInfo.chs.at(i).ch_name;
-            lchData.append(tempData);
-        }
+    for(int i = 0; i < lchData.size(); ++i) {
+        lchData[i].data = data.row(lchData.at(i).iChIdx);
     }
 
     if(lchData.isEmpty()) {
@@ -388,3 +510,64 @@ void MNEEpochDataList::checkChThreshold(ArtifactRejectionData& inputData)
 //        inputData.bRejected = false;
 //    }
 }
+
+//=============================================================================================================
+
+QList<ArtifactRejectionData> MNEEpochDataList::getArtifactChannels(const FiffInfo& pFiffInfo,
+                                                                   const QMap<QString,double>& mapReject,
+                                                                   const QStringList& lExcludeChs)
+{
+    QList<ArtifactRejectionData> lchData;
+    QList<int> lChTypes;
+
+    if(mapReject.contains("grad") ||
+       mapReject.contains("mag") ) {
+        lChTypes << FIFFV_MEG_CH;
+    }
+
+    if(mapReject.contains("eeg")) {
+        lChTypes << FIFFV_EEG_CH;
+    }
+
+    if(mapReject.contains("eog")) {
+        lChTypes << FIFFV_EOG_CH;
+    }
+
+    if(lChTypes.isEmpty()) {
+        return lchData;
+    }
+
+    for(int i = 0; i < pFiffInfo.chs.size(); ++i) {
+        if(lChTypes.contains(pFiffInfo.chs.at(i).kind)
+           && !lExcludeChs.contains(pFiffInfo.chs.at(i).ch_name)
+           && !pFiffInfo.bads.contains(pFiffInfo.chs.at(i).ch_name)
+           && pFiffInfo.chs.at(i).chpos.coil_type != FIFFV_COIL_BABY_REF_MAG
+           && pFiffInfo.chs.at(i).chpos.coil_type != FIFFV_COIL_BABY_REF_MAG2) {
+            ArtifactRejectionData tempData;
+            tempData.iChIdx = i;
+
+            switch (pFiffInfo.chs.at(i).kind) {
+            case FIFFV_MEG_CH:
+                if(pFiffInfo.chs.at(i).unit == FIFF_UNIT_T) {
+                    tempData.dThreshold = mapReject["mag"];
+                } else if(pFiffInfo.chs.at(i).unit == FIFF_UNIT_T_M) {
+                    tempData.dThreshold = mapReject["grad"];
+                }
+            break;
+
+            case FIFFV_EEG_CH:
+                tempData.dThreshold = mapReject["eeg"];
+            break;
+
+            case FIFFV_EOG_CH:
+                tempData.dThreshold = mapReject["eog"];
+            break;
+            }
+
+            tempData.sChName = pFiffInfo.chs.at(i).ch_name;
+            lchData.append(tempData);
+        }
+    }
+
+    return lchData;
+}
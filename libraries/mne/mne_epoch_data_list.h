@@ -54,6 +54,7 @@
 
 #include <QList>
 #include <QSharedPointer>
+#include <QVector>
 
 //=============================================================================================================
 // DEFINE NAMESPACE MNELIB
@@ -67,6 +68,33 @@ struct ArtifactRejectionData {
     Eigen::RowVectorXd data;
     double dThreshold;
     QString sChName;
+    int iChIdx = -1;
+};
+
+//=============================================================================================================
+/**
+ * Epochs of one event kind stored in one contiguous matrix. Epoch i occupies the columns i*nsamp ... (i+1)*nsamp-1,
+ * i.e., the memory is ordered epochs x samples x channels with channels running fastest, which matches the layout
+ * of the raw data buffers.
+ */
+struct MNEEpochTensor {
+    Eigen::MatrixXd data;           /**< The epoch data (channels x (epochs * samples)). */
+    qint32 nsamp = 0;               /**< Number of samples per epoch. */
+    Eigen::VectorXi events;         /**< Row of the events matrix each epoch belongs to. */
+    QVector<bool> rejected;         /**< Whether an epoch was marked for rejection. */
+    qint32 event = 0;               /**< The event kind. */
+    float tmin = 0.0f;              /**< The start time relative to the event in seconds. */
+    float tmax = 0.0f;              /**< The end time relative to the event in seconds. */
+
+    inline qint32 size() const
+    {
+        return events.size();
+    }
+
+    inline Eigen::Block<const Eigen::MatrixXd> epoch(qint32 i) const
+    {
+        return data.block(0, i * nsamp, data.rows(), nsamp);
+    }
 };
 
 //=============================================================================================================
@@ -115,6 +143,32 @@ public:
                                        const QStringList &lExcludeChs = QStringList(),
                                        const Eigen::RowVectorXi& picks = Eigen::RowVectorXi());
 
+    //=========================================================================================================
+    /**
+     * Read the epochs from a raw file based on provided events into one contiguous matrix. The events are sorted
+     * and rawdir is walked once, so that every raw data buffer is decoded at most once, even if epochs overlap.
+     * The artifact rejection of an epoch runs in parallel as soon as all of its samples were read.
+     *
+     * @param[in] raw            The raw data.
+     * @param[in] events         The events provided in samples and event kind.
+     * @param[in] tmin           The start time relative to the event in seconds.
+     * @param[in] tmax           The end time relative to the event in seconds.
+     * @param[in] event          The event kind.
+     * @param[in] mapReject      The channel data types and thresholds used for the artifact rejection.
+     * @param[in] lExcludeChs    List of channel names to exclude from the artifact rejection.
+     * @param[in] picks          Which channels to pick.
+     *
+     * @return The epochs. Epochs which exceed the raw data or overlap a raw data buffer which can't be read are left out.
+     */
+    static MNEEpochTensor readEpochTensor(const FIFFLIB::FiffRawData& raw,
+                                          const Eigen::MatrixXi& events,
+                                          float tmin,
+                                          float tmax,
+                                          qint32 event,
+                                          const QMap<QString,double>& mapReject,
+                                          const QStringList &lExcludeChs = QStringList(),
+                                          const Eigen::RowVectorXi& picks = Eigen::RowVectorXi());
+
     //=========================================================================================================
     /**
      * Averages epoch list. Note that no baseline correction performed.
@@ -170,6 +224,21 @@ public:
                                  const QStringList &lExcludeChs = QStringList());
 
     static void checkChThreshold(ArtifactRejectionData& inputData);
+
+private:
+    //=========================================================================================================
+    /**
+     * Collects the channels to scan for artifacts together with their thresholds.
+     *
+     * @param[in] pFiffInfo      The fiff info.
+     * @param[in] mapReject      The channel data types to scan for. EEG, MEG or EOG.
+     * @param[in] lExcludeChs    List of channel names to exclude.
+     *
+     * @return   The channel indices, thresholds and names. Only index, threshold and name are set.
+     */
+    static QList<ArtifactRejectionData> getArtifactChannels(const FIFFLIB::FiffInfo& pFiffInfo,
+                                                             const QMap<QString,double>& mapReject,
+                                                             const QStringList &lExcludeChs);
 };
 } // NAMESPACE
 
@@ -47,6 +47,7 @@
 //=============================================================================================================
 
 #include <QDebug>
+#include <QThread>
 
 //=============================================================================================================
 // EIGEN INCLUDES
@@ -322,50 +323,17 @@ MatrixXd RTPROCESSINGLIB::filterDataBlock(const MatrixXd& mataData,
         return mataData;
     }
 
-    // Setup filters to the correct length, so we do not have to do this everytime we call the FFT filter function
-    FilterKernel filterKernelSetup = filterKernel;
-    filterKernelSetup.prepareFilter(mataData.cols());
+    // Filter all picked rows with one engine instead of one kernel copy per channel
+    FilterEngine engine;
+    engine.setup(filterKernel,
+                 mataData.rows(),
+                 mataData.cols(),
+                 vecPicks,
+                 bUseThreads);
 
-    // Do the concurrent filtering
-    RowVectorXi vecPicksNew = vecPicks;
-    if(vecPicksNew.cols() == 0) {
-        vecPicksNew = RowVectorXi::LinSpaced(mataData.rows(), 0, mataData.rows());
-    }
-
-    // Generate QList structure which can be handled by the QConcurrent framework
-    QList<FilterObject> timeData;
-
-    // Only select channels specified in vecPicksNew
-    FilterObject data;
-    for(qint32 i = 0; i < vecPicksNew.cols(); ++i) {
-        data.filterKernel = filterKernelSetup;
-        data.iRow = vecPicksNew[i];
-        data.vecData = mataData.row(vecPicksNew[i]);
-        timeData.append(data);
-    }
-
-    // Copy in data from last data block. This is necessary in order to also delay channels which are not filtered
-    MatrixXd matDataOut(mataData.rows(), mataData.cols()+iOrder);
-    matDataOut.setZero();
-    matDataOut.block(0, iOrder/2, mataData.rows(), mataData.cols()) = mataData;
-
-    if(bUseThreads) {
-        QFuture<void> future = QtConcurrent::map(timeData,
-                                                 filterChannel);
-        future.waitForFinished();
-    } else {
-        for(int i = 0; i < timeData.size(); ++i) {
-            filterChannel(timeData[i]);
-        }
-    }
-
-    // Do the overlap add method and store in matDataOut
-    RowVectorXd tempData;
-
-    for(int r = 0; r < timeData.size(); r++) {
-        // Write the newly calculated filtered data to the filter data matrix. This data has a delay of iOrder/2 in front and back
-        matDataOut.row(timeData.at(r).iRow) = timeData.at(r).vecData;
-    }
+    // The rows which are not picked are delayed by iOrder/2 in order to stay aligned with the filtered ones
+    MatrixXd matDataOut;
+    engine.convolve(mataData, matDataOut);
 
     return matDataOut;
 }
@@ -441,6 +409,20 @@ MatrixXd FilterOverlapAdd::calculate(const MatrixXd& mataData,
         return mataData;
     }
 
+    // Filter continuously at the end of the data blocks with the persistent engine
+    if(bFilterEnd && !bKeepOverhead) {
+        m_filterEngine.setup(filterKernel,
+                             mataData.rows(),
+                             mataData.cols(),
+                             vecPicks,
+                             bUseThreads);
+
+        MatrixXd matDataOut = mataData;
+        m_filterEngine.filter(matDataOut);
+
+        return matDataOut;
+    }
+
     // Init overlaps from last block
     if(m_matOverlapBack.cols() != iOrder || m_matOverlapBack.rows() < mataData.rows()) {
         m_matOverlapBack.resize(mataData.rows(), iOrder);
@@ -530,6 +512,247 @@ MatrixXd FilterOverlapAdd::calculate(const MatrixXd& mataData,
 
 void FilterOverlapAdd::reset()
 {
+    m_filterEngine.reset();
     m_matOverlapBack.resize(0,0);
     m_matOverlapFront.resize(0,0);
 }
+
+//=============================================================================================================
+
+FilterEngine::FilterEngine()
+: m_iFftLength(0)
+, m_iNumRows(0)
+, m_bUseThreads(true)
+{
+}
+
+//=============================================================================================================
+
+void FilterEngine::setup(const FilterKernel& filterKernel,
+                         int iNumRows,
+                         int iBlockSize,
+                         const RowVectorXi& vecPicks,
+                         bool bUseThreads)
+{
+    setup(filterKernel.getCoefficients(),
+          iNumRows,
+          iBlockSize,
+          vecPicks,
+          bUseThreads);
+}
+
+//=============================================================================================================
+
+void FilterEngine::setup(const RowVectorXd& vecCoeff,
+                         int iNumRows,
+                         int iBlockSize,
+                         const RowVectorXi& vecPicks,
+                         bool bUseThreads)
+{
+    int iOrder = vecCoeff.cols();
+
+    // Keep plans, buffers and overlap if nothing changed
+    if(!m_vecWorkers.isEmpty()
+       && iNumRows == m_iNumRows
+       && iBlockSize + iOrder <= m_iFftLength
+       && bUseThreads == m_bUseThreads
+       && iOrder == m_vecCoeff.cols()
+       && vecCoeff == m_vecCoeff
+       && vecPicks.cols() == m_vecPicks.cols()
+       && vecPicks == m_vecPicks) {
+        return;
+    }
+
+    #ifdef EIGEN_FFTW_DEFAULT
+    fftw_make_planner_thread_safe();
+    #endif
+
+    m_vecCoeff = vecCoeff;
+    m_vecPicks = vecPicks;
+    m_iNumRows = iNumRows;
+    m_bUseThreads = bUseThreads;
+
+    int exp = ceil(MNEMath::log2(iBlockSize + iOrder));
+    m_iFftLength = pow(2, exp);
+
+    // Rows which are not picked are only delayed
+    m_vecFilterRow.fill(vecPicks.cols() == 0, iNumRows);
+    for(int i = 0; i < vecPicks.cols(); ++i) {
+        if(vecPicks[i] >= 0 && vecPicks[i] < iNumRows) {
+            m_vecFilterRow[vecPicks[i]] = true;
+        }
+    }
+
+    // Transform the zero padded kernel once
+    Eigen::FFT<double> fft;
+    fft.SetFlag(fft.HalfSpectrum);
+
+    VectorXd vecCoeffPadded = VectorXd::Zero(m_iFftLength);
+    vecCoeffPadded.head(iOrder) = vecCoeff.transpose();
+    m_vecKernelFreq.resize(m_iFftLength/2+1);
+    fft.fwd(m_vecKernelFreq.data(), vecCoeffPadded.data(), m_iFftLength);
+
+    // Distribute the rows over the workers. Every worker keeps its own plans and scratch buffers.
+    int iNumWorkers = bUseThreads ? qMin(QThread::idealThreadCount(), iNumRows) : 1;
+    iNumWorkers = qMax(iNumWorkers, 1);
+    int iRowsPerWorker = (iNumRows + iNumWorkers - 1) / iNumWorkers;
+
+    m_vecWorkers.resize(iNumWorkers);
+    for(int i = 0; i < iNumWorkers; ++i) {
+        Worker& worker = m_vecWorkers[i];
+        worker.fft.SetFlag(worker.fft.HalfSpectrum);
+        worker.vecTime.setZero(m_iFftLength);
+        worker.vecFreq.setZero(m_iFftLength/2+1);
+        worker.iRowStart = qMin(i * iRowsPerWorker, iNumRows);
+        worker.iRowEnd = qMin((i + 1) * iRowsPerWorker, iNumRows);
+
+        // Plan once by running a dummy transform
+        worker.fft.fwd(worker.vecFreq.data(), worker.vecTime.data(), m_iFftLength);
+        worker.fft.inv(worker.vecTime.data(), worker.vecFreq.data(), m_iFftLength);
+    }
+
+    m_matOverlap.setZero(iNumRows, iOrder);
+}
+
+//=============================================================================================================
+
+void FilterEngine::filter(MatrixXd& matData)
+{
+    if(m_vecWorkers.isEmpty()) {
+        qWarning() << "[FilterEngine::filter] The engine was not set up. Returning.";
+        return;
+    }
+
+    int iOrder = m_vecCoeff.cols();
+    int iNumSamples = matData.cols();
+
+    fitBlock(matData.rows(), iNumSamples);
+
+    runWorkers([&](Worker& worker) {
+        for(int r = worker.iRowStart; r < worker.iRowEnd; ++r) {
+            convolveRow(worker, matData, r);
+
+            // Add the tail of the previous block to the beginning of this one
+            for(int i = 0; i < iNumSamples; ++i) {
+                matData(r,i) = worker.vecTime[i] + (i < iOrder ? m_matOverlap(r,i) : 0.0);
+            }
+
+            // Keep the new tail together with what is left of the previous one if the block was shorter than the filter
+            for(int j = 0; j < iOrder; ++j) {
+                m_matOverlap(r,j) = worker.vecTime[iNumSamples + j] + (iNumSamples + j < iOrder ? m_matOverlap(r,iNumSamples + j) : 0.0);
+            }
+        }
+    });
+}
+
+//=============================================================================================================
+
+void FilterEngine::convolve(const MatrixXd& matData,
+                            MatrixXd& matDataOut)
+{
+    if(m_vecWorkers.isEmpty()) {
+        qWarning() << "[FilterEngine::convolve] The engine was not set up. Returning.";
+        return;
+    }
+
+    int iOrder = m_vecCoeff.cols();
+    int iNumSamples = matData.cols();
+
+    fitBlock(matData.rows(), iNumSamples);
+
+    if(matDataOut.rows() != matData.rows() || matDataOut.cols() != iNumSamples + iOrder) {
+        matDataOut.resize(matData.rows(), iNumSamples + iOrder);
+    }
+
+    runWorkers([&](Worker& worker) {
+        for(int r = worker.iRowStart; r < worker.iRowEnd; ++r) {
+            convolveRow(worker, matData, r);
+            matDataOut.row(r) = worker.vecTime.head(iNumSamples + iOrder).transpose();
+        }
+    });
+}
+
+//=============================================================================================================
+
+const MatrixXd& FilterEngine::getOverlap() const
+{
+    return m_matOverlap;
+}
+
+//=============================================================================================================
+
+void FilterEngine::reset()
+{
+    m_matOverlap.setZero();
+}
+
+//=============================================================================================================
+
+int FilterEngine::getFilterOrder() const
+{
+    return m_vecWorkers.isEmpty() ? 0 : m_vecCoeff.cols();
+}
+
+//=============================================================================================================
+
+void FilterEngine::fitBlock(int iNumRows,
+                            int iNumSamples)
+{
+    if(iNumRows == m_iNumRows && iNumSamples + m_vecCoeff.cols() <= m_iFftLength) {
+        return;
+    }
+
+    if(iNumRows != m_iNumRows) {
+        qWarning() << "[FilterEngine::fitBlock] The number of rows changed from" << m_iNumRows << "to" << iNumRows << ". Starting a new data stream.";
+
+        setup(RowVectorXd(m_vecCoeff),
+              iNumRows,
+              iNumSamples,
+              RowVectorXi(m_vecPicks),
+              m_bUseThreads);
+        return;
+    }
+
+    // Only the FFT length needs to grow. The overlap tails depend on the filter order only and are carried over.
+    MatrixXd matOverlap = m_matOverlap;
+
+    setup(RowVectorXd(m_vecCoeff),
+          iNumRows,
+          iNumSamples,
+          RowVectorXi(m_vecPicks),
+          m_bUseThreads);
+
+    m_matOverlap = matOverlap;
+}
+
+//=============================================================================================================
+
+void FilterEngine::convolveRow(Worker& worker,
+                               const MatrixXd& matData,
+                               int iRow) const
+{
+    int iNumSamples = matData.cols();
+
+    worker.vecTime.setZero();
+
+    if(m_vecFilterRow[iRow]) {
+        worker.vecTime.head(iNumSamples) = matData.row(iRow).transpose();
+
+        worker.fft.fwd(worker.vecFreq.data(), worker.vecTime.data(), m_iFftLength);
+        worker.vecFreq.array() *= m_vecKernelFreq.array();
+        worker.fft.inv(worker.vecTime.data(), worker.vecFreq.data(), m_iFftLength);
+    } else {
+        worker.vecTime.segment(m_vecCoeff.cols()/2, iNumSamples) = matData.row(iRow).transpose();
+    }
+}
+
+//=============================================================================================================
+
+void FilterEngine::runWorkers(const std::function<void(Worker&)>& func)
+{
+    if(m_vecWorkers.size() == 1) {
+        func(m_vecWorkers[0]);
+    } else {
+        QtConcurrent::blockingMap(m_vecWorkers, func);
+    }
+}
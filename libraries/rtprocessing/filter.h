@@ -46,11 +46,14 @@
 
 #include <fiff/fiff_info.h>
 
+#include <functional>
+
 //=============================================================================================================
 // QT INCLUDES
 //=============================================================================================================
 
 #include <QSharedPointer>
+#include <QVector>
 #include <QtConcurrent/QtConcurrent>
 
 //=============================================================================================================
@@ -205,6 +208,151 @@ RTPROCESINGSHARED_EXPORT Eigen::MatrixXd filterDataBlock(const Eigen::MatrixXd&
  */
 RTPROCESINGSHARED_EXPORT void filterChannel(FilterObject &channelDataTime);
 
+//=============================================================================================================
+/**
+ * Reusable FFT overlap-add filter engine. The engine owns the transformed filter kernel, one FFT plan and set of
+ * scratch buffers per worker thread and the overlap tail of every channel. Once set up, whole channels x samples
+ * blocks are filtered without allocating memory.
+ *
+ * @brief Streaming FFT overlap-add filter engine with persistent plans and buffers.
+ */
+class RTPROCESINGSHARED_EXPORT FilterEngine
+{
+public:
+    typedef QSharedPointer<FilterEngine> SPtr;             /**< Shared pointer type for FilterEngine. */
+    typedef QSharedPointer<const FilterEngine> ConstSPtr;  /**< Const shared pointer type for FilterEngine. */
+
+    //=========================================================================================================
+    /**
+     * Default constructor.
+     */
+    FilterEngine();
+
+    //=========================================================================================================
+    /**
+     * Sets up the engine: transforms the filter kernel and allocates the FFT plans, scratch buffers and overlap
+     * tails. Nothing is done if the engine is already set up for the same kernel, rows, picks and a block size
+     * which fits into the current FFT length. The overlap tails are reset whenever the engine is set up anew.
+     *
+     * @param [in] filterKernel     The filter kernel to use.
+     * @param [in] iNumRows         The number of rows (channels) of the data blocks.
+     * @param [in] iBlockSize       The maximum number of samples per data block.
+     * @param [in] vecPicks         Rows to filter. Default is filter all rows. All other rows are only delayed by half the filter order.
+     * @param [in] bUseThreads      Whether to use multiple threads. Default is set to true.
+     */
+    void setup(const RTPROCESSINGLIB::FilterKernel& filterKernel,
+               int iNumRows,
+               int iBlockSize,
+               const Eigen::RowVectorXi& vecPicks = Eigen::RowVectorXi(),
+               bool bUseThreads = true);
+
+    //=========================================================================================================
+    /**
+     * Filters a data block in place, continuing the data stream of the previous blocks (overlap add). The output is
+     * delayed by half the filter order. Blocks with more samples than set up for grow the FFT length, the data
+     * stream continues. Blocks with a different number of rows start a new data stream.
+     *
+     * @param [in, out] matData     The data block to filter (rows x samples).
+     */
+    void filter(Eigen::MatrixXd& matData);
+
+    //=========================================================================================================
+    /**
+     * Calculates the full convolution of a single data block, ignoring the stream state. This corresponds to
+     * filterDataBlock: the output has the filter order more samples than the input.
+     *
+     * @param [in] matData          The data block to filter (rows x samples).
+     * @param [out] matDataOut      The filtered data (rows x (samples + filter order)). Only reallocated if its size does not fit.
+     */
+    void convolve(const Eigen::MatrixXd& matData,
+                  Eigen::MatrixXd& matDataOut);
+
+    //=========================================================================================================
+    /**
+     * Returns the overlap tail which is added to the beginning of the next block (rows x filter order).
+     *
+     * @return The overlap tail.
+     */
+    const Eigen::MatrixXd& getOverlap() const;
+
+    //=========================================================================================================
+    /**
+     * Resets the overlap tails, i.e., starts a new data stream.
+     */
+    void reset();
+
+    //=========================================================================================================
+    /**
+     * Returns the filter order the engine is set up for. 0 if not set up.
+     *
+     * @return The filter order.
+     */
+    int getFilterOrder() const;
+
+private:
+    /**
+     * FFT plan and scratch buffers of one worker, together with the rows it processes.
+     */
+    struct Worker {
+        Eigen::FFT<double>      fft;            /**< FFT object holding the plans of this worker. */
+        Eigen::VectorXd         vecTime;        /**< Time domain scratch buffer (FFT length). */
+        Eigen::VectorXcd        vecFreq;        /**< Frequency domain scratch buffer (FFT length/2+1). */
+        int                     iRowStart;      /**< First row processed by this worker. */
+        int                     iRowEnd;        /**< One past the last row processed by this worker. */
+    };
+
+    //=========================================================================================================
+    /**
+     * Sets up the engine for the given filter coefficients. See setup.
+     */
+    void setup(const Eigen::RowVectorXd& vecCoeff,
+               int iNumRows,
+               int iBlockSize,
+               const Eigen::RowVectorXi& vecPicks,
+               bool bUseThreads);
+
+    //=========================================================================================================
+    /**
+     * Makes sure the engine fits a block of the given size. A larger block only grows the FFT length and keeps the
+     * overlap tails. A different number of rows sets the engine up anew and resets the overlap tails.
+     *
+     * @param [in] iNumRows         The number of rows of the block.
+     * @param [in] iNumSamples      The number of samples of the block.
+     */
+    void fitBlock(int iNumRows,
+                  int iNumSamples);
+
+    //=========================================================================================================
+    /**
+     * Writes the full convolution of one row into the time domain scratch buffer of the worker.
+     *
+     * @param [in, out] worker      The worker.
+     * @param [in] matData          The data block.
+     * @param [in] iRow             The row to convolve.
+     */
+    void convolveRow(Worker& worker,
+                     const Eigen::MatrixXd& matData,
+                     int iRow) const;
+
+    //=========================================================================================================
+    /**
+     * Runs a function on all workers, in parallel if set up to use threads.
+     *
+     * @param [in] func             The function to run per worker.
+     */
+    void runWorkers(const std::function<void(Worker&)>& func);
+
+    Eigen::RowVectorXd              m_vecCoeff;         /**< The filter coefficients the engine is set up for. */
+    Eigen::VectorXcd                m_vecKernelFreq;    /**< The transformed filter kernel (FFT length/2+1). */
+    Eigen::RowVectorXi              m_vecPicks;         /**< The picks the engine is set up for. */
+    QVector<bool>                   m_vecFilterRow;     /**< Whether a row is filtered or only delayed. */
+    QVector<Worker>                 m_vecWorkers;       /**< The workers. */
+    Eigen::MatrixXd                 m_matOverlap;       /**< The overlap tail of every row (rows x filter order). */
+    int                             m_iFftLength;       /**< The FFT length. */
+    int                             m_iNumRows;         /**< The number of rows the engine is set up for. */
+    bool                            m_bUseThreads;      /**< Whether to use multiple threads. */
+};
+
 //=============================================================================================================
 /**
  * Filtering with FFT convolution and the overlap add method for continous data streams. This class will hold
@@ -277,6 +425,7 @@ public:
     void reset();
 
 private:
+    FilterEngine                    m_filterEngine;                     /**< Engine used to filter continuously at the end of the data blocks */
     Eigen::MatrixXd                 m_matOverlapBack;                   /**< Overlap block for the end of the data block */
     Eigen::MatrixXd                 m_matOverlapFront;                  /**< Overlap block for the beginning of the data block */
 };
@@ -403,7 +403,7 @@ void FilterKernel::setLowpassFreq(double dLowpassFreq)
 
 //=============================================================================================================
 
-Eigen::RowVectorXd FilterKernel::getCoefficients() const
+const Eigen::RowVectorXd& FilterKernel::getCoefficients() const
 {
     return m_vecCoeff;
 }
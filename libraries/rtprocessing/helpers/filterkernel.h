@@ -187,7 +187,7 @@ public:
     double getLowpassFreq() const;
     void setLowpassFreq(double dLowpassFreq);
 
-    Eigen::RowVectorXd getCoefficients() const;
+    const Eigen::RowVectorXd& getCoefficients() const;
     void setCoefficients(const Eigen::RowVectorXd& vecCoeff);
 
     Eigen::RowVectorXcd getFftCoefficients() const;
@@ -78,6 +78,7 @@ RtAveragingWorker::RtAveragingWorker(quint32 numAverages,
                                      FiffInfo::SPtr pFiffInfo)
 : QObject()
 , m_iNumAverages(numAverages)
+, m_bCumulativeAverage(false)
 , m_iPreStimSamples(iPreStimSamples)
 , m_iPostStimSamples(iPostStimSamples)
 , m_pFiffInfo(pFiffInfo)
@@ -125,21 +126,34 @@ void RtAveragingWorker::setAverageNumber(qint32 numAve)
         return;
     }
 
-    if(numAve < m_iNumAverages) {
-        int iDiff = m_iNumAverages - numAve;
-
-        //Do averaging for each trigger type
-        QMutableMapIterator<double,QList<Eigen::MatrixXd> > idx(m_mapStimAve);
+    if(numAve != m_iNumAverages && !m_bCumulativeAverage) {
+        //Rebuild the rings with the newest epochs of each trigger type
+        QMutableMapIterator<double,AverageBuffer> idx(m_mapStimAve);
 
         while(idx.hasNext()) {
             idx.next();
 
-            if(idx.value().size() > iDiff) {
-                //Pop data from buffer
-                for(int i = 0; i < iDiff; ++i) {
-                    idx.value().pop_front();
+            AverageBuffer& buffer = idx.value();
+            int iOldSize = buffer.vecEpochs.size();
+            int iKeep = qMin(buffer.iCount, numAve);
+
+            QVector<MatrixXd> vecEpochs(numAve);
+            buffer.matSum.setZero();
+
+            for(int i = 0; i < numAve; ++i) {
+                if(i < iKeep) {
+                    //Oldest kept epoch first
+                    int iSlot = (buffer.iNextSlot - iKeep + i + iOldSize) % iOldSize;
+                    vecEpochs[i] = buffer.vecEpochs.at(iSlot);
+                    buffer.matSum += vecEpochs.at(i);
+                } else {
+                    vecEpochs[i] = MatrixXd::Zero(buffer.matSum.rows(), buffer.matSum.cols());
                 }
             }
+
+            buffer.vecEpochs = vecEpochs;
+            buffer.iCount = iKeep;
+            buffer.iNextSlot = iKeep % numAve;
         }
     }
 
@@ -148,6 +162,20 @@ void RtAveragingWorker::setAverageNumber(qint32 numAve)
 
 //=============================================================================================================
 
+void RtAveragingWorker::setCumulativeAverage(bool bCumulative)
+{
+    if(bCumulative == m_bCumulativeAverage) {
+        return;
+    }
+
+    m_bCumulativeAverage = bCumulative;
+
+    //The stored sums do not fit the new mode anymore
+    m_mapStimAve.clear();
+}
+
+//=============================================================================================================
+
 void RtAveragingWorker::setPreStim(qint32 samples, qint32 secs)
 {
     Q_UNUSED(secs);
@@ -439,15 +467,57 @@ void RtAveragingWorker::mergeData(double dTriggerType)
     }
 
     if(!bArtifactDetected) {
-        //Add cut data to average buffer
-        m_mapStimAve[dTriggerType].append(mergedData);
-
-        //Pop data from buffer
-        int iDiff =  m_mapStimAve[dTriggerType].size() - m_iNumAverages;
-        if(iDiff > 0) {
-            for(int i = 0; i < iDiff; ++i) {
-                m_mapStimAve[dTriggerType].pop_front();
-            }
+        //Add cut data to the running average
+        addEpoch(dTriggerType, mergedData);
+    }
+}
+
+//=============================================================================================================
+
+void RtAveragingWorker::addEpoch(double dTriggerType,
+                                 const MatrixXd& matEpoch)
+{
+    if(!m_mapStimAve.contains(dTriggerType)
+       || m_mapStimAve[dTriggerType].matSum.rows() != matEpoch.rows()
+       || m_mapStimAve[dTriggerType].matSum.cols() != matEpoch.cols()) {
+        //Init the buffer and preallocate the epoch slots
+        AverageBuffer buffer;
+        buffer.matSum = MatrixXd::Zero(matEpoch.rows(), matEpoch.cols());
+        buffer.iNextSlot = 0;
+        buffer.iCount = 0;
+
+        if(!m_bCumulativeAverage) {
+            buffer.vecEpochs.fill(buffer.matSum, m_iNumAverages);
+        }
+
+        m_mapStimAve[dTriggerType] = buffer;
+    }
+
+    AverageBuffer& buffer = m_mapStimAve[dTriggerType];
+
+    if(m_bCumulativeAverage) {
+        buffer.matSum += matEpoch;
+        buffer.iCount++;
+        return;
+    }
+
+    //Replace the oldest epoch once the ring is full
+    if(buffer.iCount == buffer.vecEpochs.size()) {
+        buffer.matSum -= buffer.vecEpochs.at(buffer.iNextSlot);
+    } else {
+        buffer.iCount++;
+    }
+
+    buffer.vecEpochs[buffer.iNextSlot] = matEpoch;
+    buffer.matSum += matEpoch;
+    buffer.iNextSlot = (buffer.iNextSlot + 1) % buffer.vecEpochs.size();
+
+    //Recompute the sum once per ring cycle so that rounding errors of the subtractions do not accumulate
+    if(buffer.iNextSlot == 0) {
+        buffer.matSum.setZero();
+
+        for(int i = 0; i < buffer.vecEpochs.size(); ++i) {
+            buffer.matSum += buffer.vecEpochs.at(i);
         }
     }
 }
@@ -456,7 +526,7 @@ void RtAveragingWorker::mergeData(double dTriggerType)
 
 void RtAveragingWorker::generateEvoked(double dTriggerType)
 {
-    if(m_mapStimAve[dTriggerType].isEmpty()) {
+    if(!m_mapStimAve.contains(dTriggerType) || m_mapStimAve[dTriggerType].iCount == 0) {
         qDebug() << "[RtAveragingWorker::generateEvoked] m_mapStimAve is empty for type" << dTriggerType << "Returning.";
         return;
     }
@@ -488,16 +558,9 @@ void RtAveragingWorker::generateEvoked(double dTriggerType)
         evoked.comment = QString::number(dTriggerType);
     }
 
-    // Generate final evoked
-    MatrixXd finalAverage = MatrixXd::Zero(m_mapStimAve[dTriggerType].first().rows(), m_iPreStimSamples+m_iPostStimSamples);
-
-    for(int i = 0; i < m_mapStimAve[dTriggerType].size(); ++i) {
-        finalAverage += m_mapStimAve[dTriggerType].at(i);
-    }
-
-    if(!m_mapStimAve[dTriggerType].isEmpty()) {
-        finalAverage = finalAverage/m_mapStimAve[dTriggerType].size();
-    }
+    // Generate final evoked from the running sum
+    const AverageBuffer& buffer = m_mapStimAve[dTriggerType];
+    MatrixXd finalAverage = buffer.matSum / buffer.iCount;
 
     if(m_bDoBaselineCorrection) {
         finalAverage = MNEMath::rescale(finalAverage, evoked.times, m_pairBaselineSec, QString("mean"));
@@ -505,7 +568,7 @@ void RtAveragingWorker::generateEvoked(double dTriggerType)
 
     evoked.data = finalAverage;
 
-    evoked.nave = m_mapStimAve[dTriggerType].size();
+    evoked.nave = buffer.iCount;
 
     //Add new data to evoked data set
     if(iEvokedIdx != -1) {
@@ -574,6 +637,8 @@ RtAveraging::RtAveraging(quint32 numAverages,
 
     connect(this, &RtAveraging::averageNumberChanged,
             worker, &RtAveragingWorker::setAverageNumber);
+    connect(this, &RtAveraging::averageCumulativeChanged,
+            worker, &RtAveragingWorker::setCumulativeAverage);
     connect(this, &RtAveraging::averagePreStimChanged,
             worker, &RtAveragingWorker::setPreStim);
     connect(this, &RtAveraging::averagePostStimChanged,
@@ -649,6 +714,8 @@ void RtAveraging::restart(quint32 numAverages,
 
     connect(this, &RtAveraging::averageNumberChanged,
             worker, &RtAveragingWorker::setAverageNumber);
+    connect(this, &RtAveraging::averageCumulativeChanged,
+            worker, &RtAveragingWorker::setCumulativeAverage);
     connect(this, &RtAveraging::averagePreStimChanged,
             worker, &RtAveragingWorker::setPreStim);
     connect(this, &RtAveraging::averagePostStimChanged,
@@ -687,6 +754,13 @@ void RtAveraging::setAverageNumber(qint32 numAve)
 
 //=============================================================================================================
 
+void RtAveraging::setCumulativeAverage(bool bCumulative)
+{
+    emit averageCumulativeChanged(bCumulative);
+}
+
+//=============================================================================================================
+
 void RtAveraging::setPreStim(qint32 samples,
                              qint32 secs)
 {
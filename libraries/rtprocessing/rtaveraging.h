@@ -52,6 +52,7 @@
 #include <QThread>
 #include <QSharedPointer>
 #include <QObject>
+#include <QVector>
 
 //=============================================================================================================
 // EIGEN INCLUDES
@@ -121,6 +122,16 @@ public:
      */
     void setAverageNumber(qint32 numAve);
 
+    //=========================================================================================================
+    /**
+     * Sets cumulative averaging on or off. In cumulative mode all epochs since the last reset are averaged and no
+     * epochs are stored. Otherwise a moving average over the last number of averages epochs is computed.
+     * Switching the mode clears the averaged data.
+     *
+     * @param[in] bCumulative    Whether to average cumulatively
+     */
+    void setCumulativeAverage(bool bCumulative);
+
     //=========================================================================================================
     /**
      * Sets the number of pre stimulus samples
@@ -227,13 +238,35 @@ protected:
      */
     void generateEvoked(double dTriggerType);
 
+    //=========================================================================================================
+    /**
+     * Adds an epoch to the running sum of the trigger type. In moving average mode the epoch is stored in the
+     * ring of epoch slots and the oldest epoch is subtracted once the ring is full.
+     *
+     * @param[in] dTriggerType   The trigger type
+     * @param[in] matEpoch       The epoch to add
+     */
+    void addEpoch(double dTriggerType,
+                  const Eigen::MatrixXd& matEpoch);
+
     //=========================================================================================================
     /**
      * Check if control values have been changed
      */
     inline bool controlValuesChanged();
 
+    /**
+     * Running average of one trigger type.
+     */
+    struct AverageBuffer {
+        Eigen::MatrixXd             matSum;         /**< Running sum of the epochs contributing to the average. */
+        QVector<Eigen::MatrixXd>    vecEpochs;      /**< Ring of preallocated epoch slots. Only used for the moving average. */
+        int                         iNextSlot;      /**< Ring slot the next epoch is written to. */
+        int                         iCount;         /**< Number of epochs contributing to the average. */
+    };
+
     qint32                                          m_iNumAverages;             /**< Number of averages */
+    bool                                            m_bCumulativeAverage;       /**< Whether to average all epochs since the last reset instead of a moving average. */
 
     qint32                                          m_iPreStimSamples;          /**< Amount of samples averaged before the stimulus. */
     qint32                                          m_iNewPreStimSamples;       /**< New amount of samples averaged before the stimulus. */
@@ -257,7 +290,7 @@ protected:
     FIFFLIB::FiffEvokedSet                          m_stimEvokedSet;            /**< Holds the evoked information. */
 
     QMap<QString,double>                            m_mapThresholds;            /**< Holds the current thresholds for artifact rejection. */
-    QMap<double,QList<Eigen::MatrixXd> >            m_mapStimAve;               /**< the current stimulus average buffer. Holds m_iNumAverages vectors */
+    QMap<double,AverageBuffer>                      m_mapStimAve;               /**< The running averages of each trigger type. */
     QMap<double,Eigen::MatrixXd>                    m_mapDataPre;               /**< The matrix holding pre stim data. */
     QMap<double,Eigen::MatrixXd>                    m_mapDataPost;              /**< The matrix holding post stim data. */
     QMap<double,qint32>                             m_mapMatDataPostIdx;        /**< Current index inside of the matrix m_matDataPost */
@@ -359,6 +392,16 @@ public:
      */
     void setAverageNumber(qint32 numAve);
 
+    //=========================================================================================================
+    /**
+     * Sets cumulative averaging on or off. In cumulative mode all epochs since the last reset are averaged and no
+     * epochs are stored. Otherwise a moving average over the last number of averages epochs is computed.
+     * Switching the mode clears the averaged data.
+     *
+     * @param[in] bCumulative    Whether to average cumulatively
+     */
+    void setCumulativeAverage(bool bCumulative);
+
     //=========================================================================================================
     /**
      * Sets the number of pre stimulus samples
@@ -444,6 +487,7 @@ signals:
                     const QStringList& lResponsibleTriggerTypes);
     void operate(const Eigen::MatrixXd& matData);
     void averageNumberChanged(qint32 numAve);
+    void averageCumulativeChanged(bool bCumulative);
     void averagePreStimChanged(qint32 samples,
                                qint32 secs);
     void averagePostStimChanged(qint32 samples,
@@ -46,6 +46,8 @@
 // EIGEN INCLUDES
 //=============================================================================================================
 
+#include <Eigen/Core>
+
 //=============================================================================================================
 // QT INCLUDES
 //=============================================================================================================
@@ -59,11 +61,24 @@
 
 using namespace RTPROCESSINGLIB;
 using namespace CONNECTIVITYLIB;
+using namespace Eigen;
 
 //=============================================================================================================
 // DEFINE MEMBER METHODS RtConnectivityWorker
 //=============================================================================================================
 
+RtConnectivityWorker::RtConnectivityWorker(QSharedPointer<QAtomicInt> pNumQueuedTrials)
+: m_iSlidingWindowSize(1)
+, m_iFullRecomputeInterval(1000)
+, m_iNumEvictedTrials(0)
+, m_pNumQueuedTrials(pNumQueuedTrials)
+{
+    // The per trial intermediate data is needed to substract evicted trials from the sums
+    m_slidingWindowSettings.setStorageModeActive(true);
+}
+
+//=============================================================================================================
+
 void RtConnectivityWorker::doWork(const ConnectivitySettings &connectivitySettings)
 {
     if(this->thread()->isInterruptionRequested()) {
@@ -99,25 +114,111 @@ void RtConnectivityWorker::doWork(const ConnectivitySettings &connectivitySettin
 }
 
 //=============================================================================================================
-// DEFINE MEMBER METHODS RtConnectivity
+
+void RtConnectivityWorker::setSlidingWindowSettings(const ConnectivitySettings& connectivitySettings)
+{
+    // Only call the setters of parameters which changed, since most of them clear the intermediate data
+    if(m_slidingWindowSettings.getWindowType() != connectivitySettings.getWindowType()) {
+        m_slidingWindowSettings.setWindowType(connectivitySettings.getWindowType());
+    }
+
+    if(m_slidingWindowSettings.getSamplingFrequency() != connectivitySettings.getSamplingFrequency()) {
+        m_slidingWindowSettings.setSamplingFrequency(connectivitySettings.getSamplingFrequency());
+    }
+
+    if(m_slidingWindowSettings.getFFTSize() != connectivitySettings.getFFTSize()) {
+        m_slidingWindowSettings.setFFTSize(connectivitySettings.getFFTSize());
+    }
+
+    m_slidingWindowSettings.setFrequencyBins(connectivitySettings.getNumberBinStart(),
+                                             connectivitySettings.getNumberBinAmount());
+    m_slidingWindowSettings.setConnectivityMethods(connectivitySettings.getConnectivityMethods());
+    m_slidingWindowSettings.setNodePositions(connectivitySettings.getNodePositions());
+}
+
 //=============================================================================================================
 
-RtConnectivity::RtConnectivity(QObject *parent)
-: QObject(parent)
+void RtConnectivityWorker::setSlidingWindowSize(int iNumberTrials)
 {
-    RtConnectivityWorker *worker = new RtConnectivityWorker;
-    worker->moveToThread(&m_workerThread);
+    m_iSlidingWindowSize = qMax(iNumberTrials, 1);
 
-    connect(&m_workerThread, &QThread::finished,
-            worker, &QObject::deleteLater);
+    if(m_slidingWindowSettings.size() > m_iSlidingWindowSize) {
+        m_iNumEvictedTrials += m_slidingWindowSettings.size() - m_iSlidingWindowSize;
+        m_slidingWindowSettings.removeFirst(m_slidingWindowSettings.size() - m_iSlidingWindowSize);
+    }
+}
 
-    connect(this, &RtConnectivity::operate,
-            worker, &RtConnectivityWorker::doWork);
+//=============================================================================================================
 
-    connect(worker, &RtConnectivityWorker::resultReady,
-            this, &RtConnectivity::newConnectivityResultAvailable);
+void RtConnectivityWorker::setFullRecomputeInterval(int iNumberTrials)
+{
+    m_iFullRecomputeInterval = qMax(iNumberTrials, 1);
+}
 
-    m_workerThread.start();
+//=============================================================================================================
+
+void RtConnectivityWorker::clearSlidingWindow()
+{
+    m_slidingWindowSettings.clearAllData();
+    m_iNumEvictedTrials = 0;
+}
+
+//=============================================================================================================
+
+void RtConnectivityWorker::appendTrial(const MatrixXd& matTrialData)
+{
+    // The result of this trial is obsolete if newer trials are queued behind it
+    bool bNewerTrialQueued = m_pNumQueuedTrials && m_pNumQueuedTrials->fetchAndAddOrdered(-1) > 1;
+
+    if(this->thread()->isInterruptionRequested()) {
+        return;
+    }
+
+    // Restart the window if the trial dimensions changed, e.g. because of a new block size or new bad channels
+    if(!m_slidingWindowSettings.isEmpty()) {
+        const MatrixXd& matFirstTrial = m_slidingWindowSettings.at(0).matData;
+
+        if(matFirstTrial.rows() != matTrialData.rows() || matFirstTrial.cols() != matTrialData.cols()) {
+            m_slidingWindowSettings.clearAllData();
+            m_iNumEvictedTrials = 0;
+        }
+    }
+
+    m_slidingWindowSettings.append(matTrialData);
+
+    // Evict the oldest trials. This substracts their contribution from the intermediate sums. Trials which were never
+    // estimated have not been added to the sums and are simply dropped.
+    if(m_slidingWindowSettings.size() > m_iSlidingWindowSize) {
+        m_iNumEvictedTrials += m_slidingWindowSettings.size() - m_iSlidingWindowSize;
+        m_slidingWindowSettings.removeFirst(m_slidingWindowSettings.size() - m_iSlidingWindowSize);
+    }
+
+    if(bNewerTrialQueued || m_slidingWindowSettings.getConnectivityMethods().isEmpty()) {
+        return;
+    }
+
+    // Bound the rounding errors of the repeated substractions by recomputing the sums from scratch
+    if(m_iNumEvictedTrials >= m_iFullRecomputeInterval) {
+        m_slidingWindowSettings.clearIntermediateData();
+        m_iNumEvictedTrials = 0;
+    }
+
+    // Only the intermediate data of the new trial is computed and added to the sums
+    QList<Network> finalNetworks = Connectivity::calculate(m_slidingWindowSettings);
+
+    emit slidingWindowResultReady(finalNetworks);
+}
+
+//=============================================================================================================
+// DEFINE MEMBER METHODS RtConnectivity
+//=============================================================================================================
+
+RtConnectivity::RtConnectivity(QObject *parent)
+: QObject(parent)
+{
+    qRegisterMetaType<Eigen::MatrixXd>("Eigen::MatrixXd");
+
+    createWorker();
 }
 
 //=============================================================================================================
@@ -136,11 +237,59 @@ void RtConnectivity::append(const ConnectivitySettings& connectivitySettings)
 
 //=============================================================================================================
 
+void RtConnectivity::setSlidingWindowSettings(const ConnectivitySettings& connectivitySettings)
+{
+    emit operateSetSlidingWindowSettings(connectivitySettings);
+}
+
+//=============================================================================================================
+
+void RtConnectivity::setSlidingWindowSize(int iNumberTrials)
+{
+    emit operateSetSlidingWindowSize(iNumberTrials);
+}
+
+//=============================================================================================================
+
+void RtConnectivity::clearSlidingWindow()
+{
+    emit operateClearSlidingWindow();
+}
+
+//=============================================================================================================
+
+void RtConnectivity::appendTrial(const MatrixXd& matTrialData)
+{
+    m_pNumQueuedTrials->ref();
+    emit operateAppendTrial(matTrialData);
+}
+
+//=============================================================================================================
+
 void RtConnectivity::restart()
 {
     stop();
 
-    RtConnectivityWorker *worker = new RtConnectivityWorker;
+    createWorker();
+}
+
+//=============================================================================================================
+
+void RtConnectivity::stop()
+{
+    m_workerThread.requestInterruption();
+    m_workerThread.quit();
+    m_workerThread.wait();
+}
+
+//=============================================================================================================
+
+void RtConnectivity::createWorker()
+{
+    // The trials queued for the previous worker are dropped with it
+    m_pNumQueuedTrials = QSharedPointer<QAtomicInt>::create(0);
+
+    RtConnectivityWorker *worker = new RtConnectivityWorker(m_pNumQueuedTrials);
     worker->moveToThread(&m_workerThread);
 
     connect(&m_workerThread, &QThread::finished,
@@ -152,14 +301,20 @@ void RtConnectivity::restart()
     connect(worker, &RtConnectivityWorker::resultReady,
             this, &RtConnectivity::newConnectivityResultAvailable);
 
-    m_workerThread.start();
-}
+    connect(this, &RtConnectivity::operateSetSlidingWindowSettings,
+            worker, &RtConnectivityWorker::setSlidingWindowSettings);
 
-//=============================================================================================================
+    connect(this, &RtConnectivity::operateSetSlidingWindowSize,
+            worker, &RtConnectivityWorker::setSlidingWindowSize);
 
-void RtConnectivity::stop()
-{
-    m_workerThread.requestInterruption();
-    m_workerThread.quit();
-    m_workerThread.wait();
+    connect(this, &RtConnectivity::operateClearSlidingWindow,
+            worker, &RtConnectivityWorker::clearSlidingWindow);
+
+    connect(this, &RtConnectivity::operateAppendTrial,
+            worker, &RtConnectivityWorker::appendTrial);
+
+    connect(worker, &RtConnectivityWorker::slidingWindowResultReady,
+            this, &RtConnectivity::newSlidingWindowResultAvailable);
+
+    m_workerThread.start();
 }
@@ -41,16 +41,22 @@
 
 #include "rtprocessing_global.h"
 
+#include <connectivity/connectivitysettings.h>
+
 //=============================================================================================================
 // EIGEN INCLUDES
 //=============================================================================================================
 
+#include <Eigen/Core>
+
 //=============================================================================================================
 // QT INCLUDES
 //=============================================================================================================
 
 #include <QObject>
 #include <QThread>
+#include <QAtomicInt>
+#include <QSharedPointer>
 
 //=============================================================================================================
 // FORWARD DECLARATIONS
@@ -61,7 +67,6 @@ namespace FIFFLIB {
 }
 
 namespace CONNECTIVITYLIB {
-    class ConnectivitySettings;
     class Network;
 }
 
@@ -78,7 +83,11 @@ namespace RTPROCESSINGLIB
 
 //=============================================================================================================
 /**
- * Real-time connectivity worker.
+ * Real-time connectivity worker. Besides estimating the connectivity of a whole ConnectivitySettings object, the
+ * worker can hold a sliding window of trials itself. In this mode only new trials are sent to the worker. The
+ * contribution of a new trial is added to the sums of the window and the contribution of the evicted trial is
+ * substracted, so that an update costs the work of a single trial instead of the whole window. If newer trials
+ * are already queued, a trial is only added to the window and the estimation is left to the newest one.
  *
  * @brief Real-time connectivity worker.
  */
@@ -87,6 +96,15 @@ class RTPROCESINGSHARED_EXPORT RtConnectivityWorker : public QObject
     Q_OBJECT
 
 public:
+    //=========================================================================================================
+    /**
+     * Constructs a RtConnectivityWorker.
+     *
+     * @param[in] pNumQueuedTrials      The number of trials queued for appendTrial. It is incremented by the sender
+     *                                  before a trial is queued. Pass an empty pointer if the trials are not queued.
+     */
+    explicit RtConnectivityWorker(QSharedPointer<QAtomicInt> pNumQueuedTrials = QSharedPointer<QAtomicInt>());
+
     //=========================================================================================================
     /**
      * Perform actual connectivity estimation.
@@ -95,8 +113,61 @@ public:
      */
     void doWork(const CONNECTIVITYLIB::ConnectivitySettings& connectivitySettings);
 
+    //=========================================================================================================
+    /**
+     * Takes over the parameters (methods, sampling frequency, FFT length, window type, frequency bins and node
+     * positions) of the sliding window. The trials of the current window are kept. Their intermediate data is only
+     * recomputed if a parameter it depends on changed. Trials stored in connectivitySettings are ignored.
+     *
+     * @param[in] connectivitySettings           The connectivity settings to be used for the sliding window.
+     */
+    void setSlidingWindowSettings(const CONNECTIVITYLIB::ConnectivitySettings& connectivitySettings);
+
+    //=========================================================================================================
+    /**
+     * Sets the number of trials of the sliding window.
+     *
+     * @param[in] iNumberTrials                  The number of trials.
+     */
+    void setSlidingWindowSize(int iNumberTrials);
+
+    //=========================================================================================================
+    /**
+     * Sets after how many evicted trials the sums of the sliding window are recomputed from scratch. This bounds the
+     * rounding errors which accumulate when evicted trials are substracted.
+     *
+     * @param[in] iNumberTrials                  The number of evicted trials.
+     */
+    void setFullRecomputeInterval(int iNumberTrials);
+
+    //=========================================================================================================
+    /**
+     * Removes all trials from the sliding window.
+     */
+    void clearSlidingWindow();
+
+    //=========================================================================================================
+    /**
+     * Appends a trial to the sliding window, evicts the oldest trials if the window is full and estimates the
+     * connectivity of the window. The estimation is skipped if newer trials are queued already. The window is
+     * restarted if the dimensions of the trial differ from the ones in the window, e.g. because the block size or
+     * the bad channels changed.
+     *
+     * @param[in] matTrialData                   The data of the new trial (rows x samples).
+     */
+    void appendTrial(const Eigen::MatrixXd& matTrialData);
+
+protected:
+    CONNECTIVITYLIB::ConnectivitySettings   m_slidingWindowSettings;    /**< The settings and trials of the sliding window. */
+    int                                     m_iSlidingWindowSize;       /**< The number of trials of the sliding window. */
+    int                                     m_iFullRecomputeInterval;   /**< The number of evicted trials after which the sums are recomputed. */
+    int                                     m_iNumEvictedTrials;        /**< The number of trials evicted since the sums were last computed from scratch. */
+    QSharedPointer<QAtomicInt>              m_pNumQueuedTrials;         /**< The number of trials queued for appendTrial. */
+
 signals:
     void resultReady(const  QList<CONNECTIVITYLIB::Network>& connectivityResults, const CONNECTIVITYLIB::ConnectivitySettings& connectivitySettings);
+
+    void slidingWindowResultReady(const QList<CONNECTIVITYLIB::Network>& connectivityResults);
 };
 
 //=============================================================================================================
@@ -135,6 +206,37 @@ public:
      */
     void append(const CONNECTIVITYLIB::ConnectivitySettings& connectivitySettings);
 
+    //=========================================================================================================
+    /**
+     * Sets the parameters of the sliding window. See RtConnectivityWorker::setSlidingWindowSettings.
+     *
+     * @param[in] connectivitySettings   The connectivity settings to be used for the sliding window.
+     */
+    void setSlidingWindowSettings(const CONNECTIVITYLIB::ConnectivitySettings& connectivitySettings);
+
+    //=========================================================================================================
+    /**
+     * Sets the number of trials of the sliding window.
+     *
+     * @param[in] iNumberTrials  The number of trials.
+     */
+    void setSlidingWindowSize(int iNumberTrials);
+
+    //=========================================================================================================
+    /**
+     * Removes all trials from the sliding window.
+     */
+    void clearSlidingWindow();
+
+    //=========================================================================================================
+    /**
+     * Appends a trial to the sliding window. Only the trial itself is passed to the worker thread. If the worker
+     * falls behind, only the newest window is estimated. The result is emitted via newSlidingWindowResultAvailable.
+     *
+     * @param[in] matTrialData   The data of the new trial (rows x samples).
+     */
+    void appendTrial(const Eigen::MatrixXd& matTrialData);
+
     //=========================================================================================================
     /**
      * Restarts the thread by interrupting its computation queue, quitting, waiting and then starting it again.
@@ -148,12 +250,25 @@ public:
     void stop();
 
 protected:
-    QThread             m_workerThread;         /**< The worker thread. */
+    //=========================================================================================================
+    /**
+     * Creates a worker, moves it to the worker thread and connects it.
+     */
+    void createWorker();
+
+    QThread                     m_workerThread;         /**< The worker thread. */
+    QSharedPointer<QAtomicInt>  m_pNumQueuedTrials;     /**< The number of trials queued for the worker. */
 
 signals:
     void newConnectivityResultAvailable(const QList<CONNECTIVITYLIB::Network>& connectivityResults, const CONNECTIVITYLIB::ConnectivitySettings& connectivitySettings);
 
     void operate(const CONNECTIVITYLIB::ConnectivitySettings& connectivitySettings);
+
+    void newSlidingWindowResultAvailable(const QList<CONNECTIVITYLIB::Network>& connectivityResults);
+    void operateSetSlidingWindowSettings(const CONNECTIVITYLIB::ConnectivitySettings& connectivitySettings);
+    void operateSetSlidingWindowSize(int iNumberTrials);
+    void operateClearSlidingWindow();
+    void operateAppendTrial(const Eigen::MatrixXd& matTrialData);
 };
 
 //=============================================================================================================
@@ -161,4 +276,9 @@ signals:
 //=============================================================================================================
 } // NAMESPACE
 
+#ifndef metatype_matrix
+#define metatype_matrix
+Q_DECLARE_METATYPE(Eigen::MatrixXd); /**< Provides QT META type declaration of the Eigen::MatrixXd type. For signal/slot usage.*/
+#endif
+
 #endif // RTCONNECTIVITY_RTPROCESSING_H
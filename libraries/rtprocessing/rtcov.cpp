@@ -40,13 +40,19 @@
 
 #include "rtcov.h"
 
+#include <cmath>
 
 //=============================================================================================================
 // QT INCLUDES
 //=============================================================================================================
 
 #include <QDebug>
-#include <QtConcurrent>
+
+//=============================================================================================================
+// EIGEN INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Dense>
 
 //=============================================================================================================
 // USED NAMESPACES
@@ -61,9 +67,12 @@ using namespace Eigen;
 //=============================================================================================================
 
 RtCov::RtCov(QSharedPointer<FIFFLIB::FiffInfo> pFiffInfo)
-: m_fiffInfo(*pFiffInfo)
+: m_estimationMode(BlockWise)
+, m_iUpdateInterval(0)
 , m_iSamples(0)
+, m_fiffInfo(*pFiffInfo)
 {
+    reset();
 }
 
 //=============================================================================================================
@@ -76,93 +85,171 @@ FiffCov RtCov::estimateCovariance(const Eigen::MatrixXd& matData,
         return FiffCov();
     }
 
-    m_lData.append(matData);
-    m_iSamples += matData.cols();
-
-    if(m_iSamples < iNewMaxSamples) {
+    if(matData.rows() != m_fiffInfo.chs.size() || matData.cols() == 0) {
+        qWarning() << "[RtCov::estimateCovariance] Data rows do not match the number of channels. Returning empty covariance estimation.";
         return FiffCov();
     }
 
-    QFuture<RtCovComputeResult> result = QtConcurrent::mappedReduced(m_lData,
-                                                                     compute,
-                                                                     reduce);
+    //Use the first block as shift so that the sums do not suffer from cancellation for data with large offsets
+    if(m_vecShift.size() != matData.rows()) {
+        m_vecShift = matData.rowwise().mean();
+    }
 
-    result.waitForFinished();
+    const MatrixXd matShifted = matData.colwise() - m_vecShift;
+
+    switch(m_estimationMode) {
+        case ExponentialForgetting: {
+            //Per sample forgetting factor with an effective memory of iNewMaxSamples samples
+            double dLambda = std::pow(1.0 - 1.0 / qMax(iNewMaxSamples, 2), matData.cols());
+            m_sums.vecSum *= dLambda;
+            m_sums.matSumSq *= dLambda;
+            m_sums.dWeight *= dLambda;
+            addToSums(m_sums, matShifted);
+            break;
+        }
 
-    RtCovComputeResult finalResult = result.result();
+        case SlidingWindow: {
+            addToSums(m_sums, matShifted);
+
+            //Close the current chunk and drop the chunks which fell out of the window
+            int iChunkSize = qMax(iNewMaxSamples / SlidingWindowChunks, 1);
+            if(m_sums.dWeight >= iChunkSize) {
+                m_lChunks.append(m_sums);
+                initSums(m_sums);
+
+                double dWindowWeight = 0.0;
+                for(int i = 0; i < m_lChunks.size(); ++i) {
+                    dWindowWeight += m_lChunks.at(i).dWeight;
+                }
+
+                while(m_lChunks.size() > 1 && dWindowWeight - m_lChunks.first().dWeight >= iNewMaxSamples) {
+                    dWindowWeight -= m_lChunks.first().dWeight;
+                    m_lChunks.removeFirst();
+                }
+            }
+            break;
+        }
 
-    //Final computation
-    FiffCov computedCov;
-    computedCov.data = finalResult.matData;
+        default:
+            addToSums(m_sums, matShifted);
+            break;
+    }
 
-    QStringList exclude;
-    for(int i = 0; i<m_fiffInfo.chs.size(); i++) {
-        if(m_fiffInfo.chs.at(i).kind != FIFFV_MEG_CH &&
-           m_fiffInfo.chs.at(i).kind != FIFFV_EEG_CH) {
-            exclude << m_fiffInfo.chs.at(i).ch_name;
-        }
+    m_iSamples += matData.cols();
+
+    int iInterval = (m_estimationMode == BlockWise || m_iUpdateInterval <= 0) ? iNewMaxSamples : m_iUpdateInterval;
+
+    if(m_iSamples < iInterval) {
+        return FiffCov();
     }
-    bool doProj = true;
 
-    if(m_iSamples > 0) {
-        finalResult.mu /= (float)m_iSamples;
-        computedCov.data.array() -= m_iSamples * (finalResult.mu * finalResult.mu.transpose()).array();
-        computedCov.data.array() /= (m_iSamples - 1);
+    m_iSamples = 0;
 
-        computedCov.kind = FIFFV_MNE_NOISE_COV;
-        computedCov.diag = false;
-        computedCov.dim = computedCov.data.rows();
+    if(m_estimationMode == SlidingWindow) {
+        CovSums window = m_sums;
 
-        //ToDo do picks
-        computedCov.names = m_fiffInfo.ch_names;
-        computedCov.projs = m_fiffInfo.projs;
-        computedCov.bads = m_fiffInfo.bads;
-        computedCov.nfree = m_iSamples;
+        for(int i = 0; i < m_lChunks.size(); ++i) {
+            window.vecSum += m_lChunks.at(i).vecSum;
+            window.matSumSq += m_lChunks.at(i).matSumSq;
+            window.dWeight += m_lChunks.at(i).dWeight;
+        }
 
-        // regularize noise covariance
-        computedCov = computedCov.regularize(m_fiffInfo, 0.05, 0.05, 0.1, doProj, exclude);
+        return computeCovariance(window);
+    }
 
-//            qint32 samples = rawSegment.cols();
-//            VectorXf mu = rawSegment.rowwise().sum().array() / (float)samples;
+    FiffCov computedCov = computeCovariance(m_sums);
 
-//            MatrixXf noise_covariance = rawSegment * rawSegment.transpose();// noise_covariance == raw_covariance
-//            noise_covariance.array() -= samples * (mu * mu.transpose()).array();
-//            noise_covariance.array() /= (samples - 1);
+    if(m_estimationMode == BlockWise) {
+        initSums(m_sums);
+    }
 
-//            std::cout << "Noise Covariance:\n" << noise_covariance.block(0,0,10,10) << std::endl;
+    return computedCov;
+}
 
-//            printf("%d raw buffer (%d x %d) generated\r\n", count, tmp.rows(), tmp.cols());
+//=============================================================================================================
 
-        m_lData.clear();
-        m_iSamples = 0;
+void RtCov::setEstimationMode(EstimationMode mode)
+{
+    m_estimationMode = mode;
+    reset();
+}
 
-        return computedCov;
-    } else {
-        qWarning() << "[RtCov::estimateCovariance] Number of samples equals zero. Regularization not possible. Returning empty covariance estimation.";
-        return FiffCov();
-    }
+//=============================================================================================================
+
+void RtCov::setUpdateInterval(int iSamples)
+{
+    m_iUpdateInterval = iSamples;
+}
 
+//=============================================================================================================
+
+void RtCov::reset()
+{
+    m_iSamples = 0;
+    m_vecShift.resize(0);
+    m_lChunks.clear();
+    initSums(m_sums);
 }
 
 //=============================================================================================================
 
-RtCovComputeResult RtCov::compute(const MatrixXd &matData)
+void RtCov::addToSums(CovSums& sums,
+                      const MatrixXd& matData)
 {
-    RtCovComputeResult result;
-    result.mu = matData.rowwise().sum();
-    result.matData = matData * matData.transpose();
-    return result;
+    sums.vecSum += matData.rowwise().sum();
+    sums.matSumSq.selfadjointView<Lower>().rankUpdate(matData);
+    sums.dWeight += matData.cols();
 }
 
 //=============================================================================================================
 
-void RtCov::reduce(RtCovComputeResult& finalResult, const RtCovComputeResult &tempResult)
+FiffCov RtCov::computeCovariance(const CovSums& sums)
 {
-    if(finalResult.matData.size() == 0 || finalResult.mu.size() == 0) {
-        finalResult.mu = tempResult.mu;
-        finalResult.matData = tempResult.matData;
-    } else {
-        finalResult.mu += tempResult.mu;
-        finalResult.matData += tempResult.matData;
+    if(sums.dWeight <= 1.0) {
+        qWarning() << "[RtCov::computeCovariance] Number of samples too small. Regularization not possible. Returning empty covariance estimation.";
+        return FiffCov();
+    }
+
+    //Final computation. The covariance is invariant to the shift.
+    VectorXd mu = sums.vecSum / sums.dWeight;
+
+    FiffCov computedCov;
+    computedCov.data = sums.matSumSq.selfadjointView<Lower>();
+    computedCov.data -= sums.dWeight * (mu * mu.transpose());
+    computedCov.data /= (sums.dWeight - 1.0);
+
+    QStringList exclude;
+    for(int i = 0; i<m_fiffInfo.chs.size(); i++) {
+        if(m_fiffInfo.chs.at(i).kind != FIFFV_MEG_CH &&
+           m_fiffInfo.chs.at(i).kind != FIFFV_EEG_CH) {
+            exclude << m_fiffInfo.chs.at(i).ch_name;
+        }
     }
+    bool doProj = true;
+
+    computedCov.kind = FIFFV_MNE_NOISE_COV;
+    computedCov.diag = false;
+    computedCov.dim = computedCov.data.rows();
+
+    //ToDo do picks
+    computedCov.names = m_fiffInfo.ch_names;
+    computedCov.projs = m_fiffInfo.projs;
+    computedCov.bads = m_fiffInfo.bads;
+    computedCov.nfree = qRound(sums.dWeight);
+
+    // regularize noise covariance
+    computedCov = computedCov.regularize(m_fiffInfo, 0.05, 0.05, 0.1, doProj, exclude);
+
+    return computedCov;
+}
+
+//=============================================================================================================
+
+void RtCov::initSums(CovSums& sums) const
+{
+    int iNumChannels = m_fiffInfo.chs.size();
+
+    sums.vecSum = VectorXd::Zero(iNumChannels);
+    sums.matSumSq = MatrixXd::Zero(iNumChannels, iNumChannels);
+    sums.dWeight = 0.0;
 }
@@ -51,6 +51,7 @@
 
 #include <QSharedPointer>
 #include <QThread>
+#include <QList>
 
 //=============================================================================================================
 // EIGEN INCLUDES
@@ -77,14 +78,10 @@ namespace RTPROCESSINGLIB
 // RTPROCESSINGLIB FORWARD DECLARATIONS
 //=============================================================================================================
 
-struct RtCovComputeResult {
-    Eigen::VectorXd mu;
-    Eigen::MatrixXd matData;
-};
-
 //=============================================================================================================
 /**
- * Real-time covariance worker.
+ * Real-time covariance estimation. Incoming data blocks are folded into running sums of the (shifted) data and
+ * its outer products on arrival, so no raw samples are buffered and the cost is spread evenly across the blocks.
  *
  * @brief Real-time covariance worker.
  */
@@ -93,40 +90,100 @@ class RTPROCESINGSHARED_EXPORT RtCov : public QObject
     Q_OBJECT
 
 public:
+    /**
+     * How the running sums are maintained between two estimates.
+     */
+    enum EstimationMode {
+        BlockWise,                  /**< The sums are cleared after each estimate (non-overlapping estimates). */
+        ExponentialForgetting,      /**< Older samples are down-weighted with an effective memory of the estimation samples. */
+        SlidingWindow               /**< Only the most recent estimation samples contribute. */
+    };
+
     RtCov(QSharedPointer<FIFFLIB::FiffInfo> pFiffInfo);
 
     //=========================================================================================================
     /**
      * Perform actual covariance estimation.
      *
-     * @param[in] inputData  Data to estimate the covariance from.
+     * @param[in] matData           Data to estimate the covariance from.
+     * @param[in] iNewMaxSamples    The number of samples per estimate. This is the window length for the sliding
+     *                              window and the effective memory for the exponential forgetting mode.
+     *
+     * @return The regularized covariance if a new estimate is due, an empty covariance otherwise.
      */
     FIFFLIB::FiffCov estimateCovariance(const Eigen::MatrixXd& matData,
                                         int iNewMaxSamples);
 
+    //=========================================================================================================
+    /**
+     * Sets the estimation mode. This resets the running sums.
+     *
+     * @param[in] mode      The new estimation mode.
+     */
+    void setEstimationMode(EstimationMode mode);
+
+    //=========================================================================================================
+    /**
+     * Sets the number of samples between two estimates in the exponential forgetting and sliding window mode.
+     * 0 (default) uses the number of estimation samples.
+     *
+     * @param[in] iSamples  The number of samples between two estimates.
+     */
+    void setUpdateInterval(int iSamples);
+
+    //=========================================================================================================
+    /**
+     * Clears the running sums.
+     */
+    void reset();
+
 protected:
+    /**
+     * Running sums over a range of samples.
+     */
+    struct CovSums {
+        Eigen::VectorXd     vecSum;         /**< Weighted sum of the shifted samples. */
+        Eigen::MatrixXd     matSumSq;       /**< Weighted sum of the outer products of the shifted samples. Only the lower triangle is used. */
+        double              dWeight;        /**< Sum of the weights, i.e., the (effective) number of samples. */
+    };
+
     //=========================================================================================================
     /**
-     * Computer multiplication with transposed.
+     * Adds a data block to the running sums.
      *
-     * @param[in] matData  Data to self multiply with.
+     * @param[in, out] sums     The sums to update.
+     * @param[in] matData       The shifted data block.
+     */
+    static void addToSums(CovSums& sums,
+                          const Eigen::MatrixXd& matData);
+
+    //=========================================================================================================
+    /**
+     * Computes the regularized covariance from the sums.
+     *
+     * @param[in] sums          The sums.
      *
-     * @return   The multiplication result.
+     * @return The regularized covariance.
      */
-    static RtCovComputeResult compute(const Eigen::MatrixXd &matData);
+    FIFFLIB::FiffCov computeCovariance(const CovSums& sums);
 
     //=========================================================================================================
     /**
-     * Computer multiplication with transposed.
+     * Initializes the given sums with zeros for the current number of channels.
      *
-     * @param[out]   finalResult     The final covariance estimation.
-     * @param[in]    tempResult      The intermediate result from the compute function
+     * @param[out] sums         The sums to initialize.
      */
-    static void reduce(RtCovComputeResult& finalResult, const RtCovComputeResult &tempResult);
+    void initSums(CovSums& sums) const;
+
+    enum {SlidingWindowChunks = 8};                     /**< Number of chunks the sliding window is divided into. */
 
-    int                     m_iSamples;                 /**< The number of stored samples. */
+    EstimationMode          m_estimationMode;           /**< The estimation mode. */
+    int                     m_iUpdateInterval;          /**< Samples between two estimates. 0 uses the number of estimation samples. */
+    int                     m_iSamples;                 /**< The number of samples since the last estimate. */
 
-    QList<Eigen::MatrixXd>  m_lData;                    /**< The stored data blocks. */
+    Eigen::VectorXd         m_vecShift;                 /**< Per channel shift subtracted before accumulation to avoid cancellation. */
+    CovSums                 m_sums;                     /**< The running sums (the current chunk in sliding window mode). */
+    QList<CovSums>          m_lChunks;                  /**< The completed chunks of the sliding window. */
 
     FIFFLIB::FiffInfo       m_fiffInfo;                 /**< Holds the fiff measurement information. */
 };
@@ -83,6 +83,9 @@ void RtHpiWorker::doWork(const Eigen::MatrixXd& matData,
     fitResult.devHeadTrans.from = 1;
     fitResult.devHeadTrans.to = 4;
 
+    QElapsedTimer timer;
+    timer.start();
+
     m_pHpiFit->fitHPI(matData,
                       matProjectors,
                       fitResult.devHeadTrans,
@@ -92,6 +95,8 @@ void RtHpiWorker::doWork(const Eigen::MatrixXd& matData,
                       fitResult.fittedCoils,
                       pFiffInfo);
 
+    fitResult.dFitDuration = timer.nsecsElapsed() / 1e6;
+
     emit resultReady(fitResult);
 }
 
@@ -41,6 +41,7 @@
 //=============================================================================================================
 
 #include "../utils_global.h"
+#include "circularmatrixbuffer.h"
 
 //=============================================================================================================
 // QT INCLUDES
@@ -294,8 +295,8 @@ typedef CircularBuffer<char>                     CircularBuffer_char;
 typedef CircularBuffer<double>                   CircularBuffer_double;              /**< Defines CircularBuffer of double type.*/
 typedef CircularBuffer< QPair<int, int> >        CircularBuffer_pair_int_int;        /**< Defines CircularBuffer of integer Pair type.*/
 typedef CircularBuffer< QPair<double, double> >  CircularBuffer_pair_double_double;  /**< Defines CircularBuffer of double Pair type.*/
-typedef CircularBuffer< Eigen::MatrixXd >        CircularBuffer_Matrix_double;       /**< Defines CircularBuffer of Eigen::MatrixXd type.*/
-typedef CircularBuffer< Eigen::MatrixXf >        CircularBuffer_Matrix_float;        /**< Defines CircularBuffer of Eigen::MatrixXf type.*/
+typedef CircularMatrixBuffer<double>             CircularBuffer_Matrix_double;       /**< Defines lock-free CircularMatrixBuffer of Eigen::MatrixXd type.*/
+typedef CircularMatrixBuffer<float>              CircularBuffer_Matrix_float;        /**< Defines lock-free CircularMatrixBuffer of Eigen::MatrixXf type.*/
 
 } // NAMESPACE
 
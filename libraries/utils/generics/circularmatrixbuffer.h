@@ -0,0 +1,576 @@
+//=============================================================================================================
+/**
+ * @file     circularmatrixbuffer.h
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>;
+ *           Christoph Dinh <chdinh@nmr.mgh.harvard.edu>
+ * @since    0.1.0
+ * @date     October, 2026
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2026, Lorenz Esch, Christoph Dinh. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief     CircularMatrixBuffer class declaration
+ *
+ */
+
+#ifndef CIRCULARMATRIXBUFFER_H
+#define CIRCULARMATRIXBUFFER_H
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include "../utils_global.h"
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSharedPointer>
+#include <QVector>
+#include <QWaitCondition>
+
+//=============================================================================================================
+// EIGEN INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+//=============================================================================================================
+// DEFINE NAMESPACE UTILSLIB
+//=============================================================================================================
+
+namespace UTILSLIB
+{
+
+//=============================================================================================================
+/**
+ * Lock-free single producer/single consumer ring of preallocated matrix slots. The slots keep their storage, so
+ * as long as the matrices keep their shape no memory is allocated after the first round. Besides the copying
+ * push/pop, the slots can be written and read in place via acquireWrite/commitWrite and acquireRead/releaseRead.
+ *
+ * Only one thread may write and only one thread may read at a time. The reader or writer only blocks (with a
+ * timeout) if the buffer is empty or full respectively.
+ *
+ * Pausing behaves like in CircularBuffer: the array push drops incoming matrices and pop/popBatch do not take any
+ * matrices out of the buffer while paused. The single matrix push and the in place access are not affected.
+ *
+ * @brief Lock-free single producer/single consumer circular buffer of matrices.
+ */
+template<typename _Scalar>
+class CircularMatrixBuffer
+{
+public:
+    typedef QSharedPointer<CircularMatrixBuffer> SPtr;              /**< Shared pointer type for CircularMatrixBuffer. */
+    typedef QSharedPointer<const CircularMatrixBuffer> ConstSPtr;   /**< Const shared pointer type for CircularMatrixBuffer. */
+
+    typedef Eigen::Matrix<_Scalar, Eigen::Dynamic, Eigen::Dynamic> Matrix;  /**< The matrix type of the slots. */
+
+    //=========================================================================================================
+    /**
+     * Constructs a CircularMatrixBuffer.
+     *
+     * @param [in] uiMaxNumElements     Number of slots.
+     * @param [in] iRows                Rows to preallocate each slot with. Default is 0, i.e., the slots take the shape of the first matrices written.
+     * @param [in] iCols                Columns to preallocate each slot with.
+     */
+    explicit CircularMatrixBuffer(unsigned int uiMaxNumElements,
+                                  int iRows = 0,
+                                  int iCols = 0);
+
+    //=========================================================================================================
+    /**
+     * Copies a whole array of matrices into the next slots. Waits until there are enough free slots for all of
+     * them. Nothing is added while the buffer is paused, the matrices are counted as dropped.
+     *
+     * @param [in] pArray   Pointer to the matrices which should be added.
+     * @param [in] size     Number of matrices in the array.
+     *
+     * @return Whether the matrices were added or dropped. False if not enough slots became free before the timeout (counted as overrun).
+     */
+    inline bool push(const Matrix* pArray,
+                     unsigned int size);
+
+    //=========================================================================================================
+    /**
+     * Copies a matrix into the next slot. Waits for a free slot if the buffer is full.
+     *
+     * @param [in] matrix   The matrix to add.
+     *
+     * @return Whether the matrix was added. False if no slot became free before the timeout (counted as overrun).
+     */
+    inline bool push(const Matrix& matrix);
+
+    //=========================================================================================================
+    /**
+     * Copies the oldest matrix out of the buffer. Waits for data if the buffer is empty. While the buffer is paused
+     * nothing is popped and the matrix is left untouched.
+     *
+     * @param [out] matrix  The oldest matrix.
+     *
+     * @return Whether a matrix was popped or the buffer is paused. False if no data arrived before the timeout.
+     */
+    inline bool pop(Matrix& matrix);
+
+    //=========================================================================================================
+    /**
+     * Pops all available matrices (at most iMaxElements) at once and concatenates them horizontally. Stops at the
+     * first matrix with a different number of rows. Waits for data if the buffer is empty. While the buffer is
+     * paused nothing is popped.
+     *
+     * @param [out] matrix          The concatenated matrices. Only reallocated if its size changes.
+     * @param [in] iMaxElements     Maximum number of matrices to pop. Default is -1, i.e., all available.
+     *
+     * @return The number of popped matrices.
+     */
+    inline int popBatch(Matrix& matrix,
+                        int iMaxElements = -1);
+
+    //=========================================================================================================
+    /**
+     * Returns the next free slot to write to in place. Waits for a free slot if the buffer is full. The slot is
+     * handed to the reader by commitWrite.
+     *
+     * @return The slot or NULL if no slot became free before the timeout (counted as overrun).
+     */
+    inline Matrix* acquireWrite();
+
+    //=========================================================================================================
+    /**
+     * Hands the slot returned by acquireWrite over to the reader.
+     */
+    inline void commitWrite();
+
+    //=========================================================================================================
+    /**
+     * Returns the oldest slot to read in place. Waits for data if the buffer is empty. The slot is handed back to
+     * the writer by releaseRead.
+     *
+     * @return The slot or NULL if no data arrived before the timeout.
+     */
+    inline const Matrix* acquireRead();
+
+    //=========================================================================================================
+    /**
+     * Hands the slot returned by acquireRead back to the writer.
+     */
+    inline void releaseRead();
+
+    //=========================================================================================================
+    /**
+     * Clears the buffer. Must be called from the reading thread or while no thread is reading. The discarded
+     * matrices are counted as dropped.
+     */
+    inline void clear();
+
+    //=========================================================================================================
+    /**
+     * Pauses the buffer. While paused, the array push drops the incoming matrices and pop/popBatch do not take any
+     * matrices out of the buffer.
+     */
+    inline void pause(bool bPause);
+
+    //=========================================================================================================
+    /**
+     * Returns the number of elements available for reading.
+     */
+    inline int getFreeElementsRead() const;
+
+    //=========================================================================================================
+    /**
+     * Returns the number of free slots available for writing.
+     */
+    inline int getFreeElementsWrite() const;
+
+    //=========================================================================================================
+    /**
+     * Returns the number of matrices which were dropped because the buffer was paused or cleared.
+     */
+    inline int getDroppedCount() const;
+
+    //=========================================================================================================
+    /**
+     * Returns the number of matrices which could not be written because the buffer was full.
+     */
+    inline int getOverrunCount() const;
+
+private:
+    //=========================================================================================================
+    /**
+     * Returns the number of used slots for the given read and write indices.
+     */
+    inline int usedElements(int iReadIndex,
+                            int iWriteIndex) const;
+
+    //=========================================================================================================
+    /**
+     * Maps an index in [0, 2 * number of slots) to its slot.
+     */
+    inline int slot(int iIndex) const;
+
+    //=========================================================================================================
+    /**
+     * Waits until iNumElements matrices can be read (bRead) or written (!bRead), at most m_iTimeout milliseconds.
+     *
+     * @return Whether the matrices can be read or written.
+     */
+    inline bool wait(bool bRead,
+                     int iNumElements = 1);
+
+    //=========================================================================================================
+    /**
+     * Returns whether iNumElements matrices can be read (bRead) or written (!bRead) if iUsed slots are in use.
+     */
+    inline bool isAvailable(bool bRead,
+                            int iNumElements,
+                            int iUsed) const;
+
+    //=========================================================================================================
+    /**
+     * Wakes up a waiting reader or writer.
+     */
+    inline void wake();
+
+    int                 m_iMaxNumElements;  /**< Holds the number of slots.*/
+    QVector<Matrix>     m_vecSlots;         /**< Holds the slots.*/
+    QAtomicInt          m_iReadIndex;       /**< Holds the read index in [0, 2 * number of slots). Only advanced by the reader.*/
+    QAtomicInt          m_iWriteIndex;      /**< Holds the write index in [0, 2 * number of slots). Only advanced by the writer.*/
+    QAtomicInt          m_iWaiting;         /**< Holds the number of threads waiting for data or free slots.*/
+    QAtomicInt          m_iDropped;         /**< Holds the number of dropped matrices.*/
+    QAtomicInt          m_iOverrun;         /**< Holds the number of matrices which could not be written.*/
+    QAtomicInt          m_bPause;           /**< Holds whether the buffer is paused.*/
+    QMutex              m_mutex;            /**< Guards the wait condition. Never taken on the fast path.*/
+    QWaitCondition      m_waitCondition;    /**< Wakes up a waiting reader or writer.*/
+    int                 m_iTimeout;         /**< Holds the timeout value after which a waiting read or write returns.*/
+};
+
+//=============================================================================================================
+// DEFINE MEMBER METHODS
+//=============================================================================================================
+
+template<typename _Scalar>
+CircularMatrixBuffer<_Scalar>::CircularMatrixBuffer(unsigned int uiMaxNumElements,
+                                                    int iRows,
+                                                    int iCols)
+: m_iMaxNumElements(qMax(int(uiMaxNumElements), 1))
+, m_vecSlots(m_iMaxNumElements)
+, m_iReadIndex(0)
+, m_iWriteIndex(0)
+, m_iWaiting(0)
+, m_iDropped(0)
+, m_iOverrun(0)
+, m_bPause(0)
+, m_iTimeout(1000)
+{
+    if(iRows > 0 && iCols > 0) {
+        for(int i = 0; i < m_vecSlots.size(); ++i) {
+            m_vecSlots[i].resize(iRows, iCols);
+        }
+    }
+}
+
+//=============================================================================================================
+
+template<typename _Scalar>
+inline bool CircularMatrixBuffer<_Scalar>::push(const Matrix* pArray,
+                                                unsigned int size)
+{
+    if(m_bPause.loadAcquire()) {
+        m_iDropped.fetchAndAddRelaxed(int(size));
+        return true;
+    }
+
+    if(!wait(false, int(size))) {
+        m_iOverrun.fetchAndAddRelaxed(int(size));
+        return false;
+    }
+
+    int iWriteIndex = m_iWriteIndex.loadAcquire();
+
+    for(unsigned int i = 0; i < size; ++i) {
+        m_vecSlots[slot(iWriteIndex + int(i))] = pArray[i];
+    }
+
+    //Publish all matrices at once
+    m_iWriteIndex.fetchAndStoreOrdered((iWriteIndex + int(size)) % (2 * m_iMaxNumElements));
+    wake();
+
+    return true;
+}
+
+//=============================================================================================================
+
+template<typename _Scalar>
+inline bool CircularMatrixBuffer<_Scalar>::push(const Matrix& matrix)
+{
+    Matrix* pSlot = acquireWrite();
+
+    if(!pSlot) {
+        return false;
+    }
+
+    //Assigning a matrix of the same shape reuses the storage of the slot
+    *pSlot = matrix;
+    commitWrite();
+
+    return true;
+}
+
+//=============================================================================================================
+
+template<typename _Scalar>
+inline bool CircularMatrixBuffer<_Scalar>::pop(Matrix& matrix)
+{
+    if(m_bPause.loadAcquire()) {
+        return true;
+    }
+
+    const Matrix* pSlot = acquireRead();
+
+    if(!pSlot) {
+        return false;
+    }
+
+    matrix = *pSlot;
+    releaseRead();
+
+    return true;
+}
+
+//=============================================================================================================
+
+template<typename _Scalar>
+inline int CircularMatrixBuffer<_Scalar>::popBatch(Matrix& matrix,
+                                                   int iMaxElements)
+{
+    if(m_bPause.loadAcquire() || !wait(true)) {
+        return 0;
+    }
+
+    int iReadIndex = m_iReadIndex.loadAcquire();
+    int iAvailable = usedElements(iReadIndex, m_iWriteIndex.loadAcquire());
+
+    if(iMaxElements > 0) {
+        iAvailable = qMin(iAvailable, iMaxElements);
+    }
+
+    int iRows = m_vecSlots.at(slot(iReadIndex)).rows();
+    int iCols = 0;
+    int iNumElements = 0;
+
+    for(; iNumElements < iAvailable; ++iNumElements) {
+        const Matrix& slotMatrix = m_vecSlots.at(slot(iReadIndex + iNumElements));
+
+        if(slotMatrix.rows() != iRows) {
+            break;
+        }
+
+        iCols += slotMatrix.cols();
+    }
+
+    matrix.resize(iRows, iCols);
+
+    for(int i = 0, iCol = 0; i < iNumElements; ++i) {
+        const Matrix& slotMatrix = m_vecSlots.at(slot(iReadIndex + i));
+        matrix.middleCols(iCol, slotMatrix.cols()) = slotMatrix;
+        iCol += slotMatrix.cols();
+    }
+
+    m_iReadIndex.fetchAndStoreOrdered((iReadIndex + iNumElements) % (2 * m_iMaxNumElements));
+    wake();
+
+    return iNumElements;
+}
+
+//=============================================================================================================
+
+template<typename _Scalar>
+inline typename CircularMatrixBuffer<_Scalar>::Matrix* CircularMatrixBuffer<_Scalar>::acquireWrite()
+{
+    if(!wait(false)) {
+        m_iOverrun.fetchAndAddRelaxed(1);
+        return NULL;
+    }
+
+    return &m_vecSlots[slot(m_iWriteIndex.loadAcquire())];
+}
+
+//=============================================================================================================
+
+template<typename _Scalar>
+inline void CircularMatrixBuffer<_Scalar>::commitWrite()
+{
+    m_iWriteIndex.fetchAndStoreOrdered((m_iWriteIndex.loadAcquire() + 1) % (2 * m_iMaxNumElements));
+    wake();
+}
+
+//=============================================================================================================
+
+template<typename _Scalar>
+inline const typename CircularMatrixBuffer<_Scalar>::Matrix* CircularMatrixBuffer<_Scalar>::acquireRead()
+{
+    if(!wait(true)) {
+        return NULL;
+    }
+
+    return &m_vecSlots.at(slot(m_iReadIndex.loadAcquire()));
+}
+
+//=============================================================================================================
+
+template<typename _Scalar>
+inline void CircularMatrixBuffer<_Scalar>::releaseRead()
+{
+    m_iReadIndex.fetchAndStoreOrdered((m_iReadIndex.loadAcquire() + 1) % (2 * m_iMaxNumElements));
+    wake();
+}
+
+//=============================================================================================================
+
+template<typename _Scalar>
+inline void CircularMatrixBuffer<_Scalar>::clear()
+{
+    int iWriteIndex = m_iWriteIndex.loadAcquire();
+
+    m_iDropped.fetchAndAddRelaxed(usedElements(m_iReadIndex.loadAcquire(), iWriteIndex));
+    m_iReadIndex.fetchAndStoreOrdered(iWriteIndex);
+    wake();
+}
+
+//=============================================================================================================
+
+template<typename _Scalar>
+inline void CircularMatrixBuffer<_Scalar>::pause(bool bPause)
+{
+    m_bPause.storeRelease(bPause ? 1 : 0);
+}
+
+//=============================================================================================================
+
+template<typename _Scalar>
+inline int CircularMatrixBuffer<_Scalar>::getFreeElementsRead() const
+{
+    return usedElements(m_iReadIndex.loadAcquire(), m_iWriteIndex.loadAcquire());
+}
+
+//=============================================================================================================
+
+template<typename _Scalar>
+inline int CircularMatrixBuffer<_Scalar>::getFreeElementsWrite() const
+{
+    return m_iMaxNumElements - getFreeElementsRead();
+}
+
+//=============================================================================================================
+
+template<typename _Scalar>
+inline int CircularMatrixBuffer<_Scalar>::getDroppedCount() const
+{
+    return m_iDropped.loadAcquire();
+}
+
+//=============================================================================================================
+
+template<typename _Scalar>
+inline int CircularMatrixBuffer<_Scalar>::getOverrunCount() const
+{
+    return m_iOverrun.loadAcquire();
+}
+
+//=============================================================================================================
+
+template<typename _Scalar>
+inline int CircularMatrixBuffer<_Scalar>::usedElements(int iReadIndex,
+                                                       int iWriteIndex) const
+{
+    return (iWriteIndex - iReadIndex + 2 * m_iMaxNumElements) % (2 * m_iMaxNumElements);
+}
+
+//=============================================================================================================
+
+template<typename _Scalar>
+inline int CircularMatrixBuffer<_Scalar>::slot(int iIndex) const
+{
+    iIndex %= 2 * m_iMaxNumElements;
+    return iIndex >= m_iMaxNumElements ? iIndex - m_iMaxNumElements : iIndex;
+}
+
+//=============================================================================================================
+
+template<typename _Scalar>
+inline bool CircularMatrixBuffer<_Scalar>::wait(bool bRead,
+                                                int iNumElements)
+{
+    //Fast path without any locking
+    if(isAvailable(bRead, iNumElements, getFreeElementsRead())) {
+        return true;
+    }
+
+    //More slots than the buffer has can never become free
+    if(iNumElements > m_iMaxNumElements) {
+        return false;
+    }
+
+    //Announce the waiting thread before checking again, so that the other side cannot miss it (see wake)
+    QMutexLocker locker(&m_mutex);
+    m_iWaiting.fetchAndAddOrdered(1);
+
+    bool bAvailable = isAvailable(bRead, iNumElements, getFreeElementsRead());
+    if(!bAvailable) {
+        m_waitCondition.wait(&m_mutex, m_iTimeout);
+        bAvailable = isAvailable(bRead, iNumElements, getFreeElementsRead());
+    }
+
+    m_iWaiting.fetchAndAddOrdered(-1);
+
+    return bAvailable;
+}
+
+//=============================================================================================================
+
+template<typename _Scalar>
+inline bool CircularMatrixBuffer<_Scalar>::isAvailable(bool bRead,
+                                                       int iNumElements,
+                                                       int iUsed) const
+{
+    return bRead ? iUsed >= iNumElements : m_iMaxNumElements - iUsed >= iNumElements;
+}
+
+//=============================================================================================================
+
+template<typename _Scalar>
+inline void CircularMatrixBuffer<_Scalar>::wake()
+{
+    //The indices are published with full barriers, so a thread which announced itself as waiting after this check
+    //is guaranteed to see the new index.
+    if(m_iWaiting.loadAcquire() > 0) {
+        QMutexLocker locker(&m_mutex);
+        m_waitCondition.wakeAll();
+    }
+}
+} // NAMESPACE
+
+#endif // CIRCULARMATRIXBUFFER_H
@@ -0,0 +1,230 @@
+//=============================================================================================================
+/**
+ * @file     sampleblock.h
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>;
+ *           Christoph Dinh <chdinh@nmr.mgh.harvard.edu>
+ * @since    0.1.0
+ * @date     October, 2026
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2026, Lorenz Esch, Christoph Dinh. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief    Contains the declaration of the SampleBlock class.
+ *
+ */
+
+#ifndef SAMPLEBLOCK_H
+#define SAMPLEBLOCK_H
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include "../utils_global.h"
+
+#include <utility>
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QSharedData>
+#include <QSharedDataPointer>
+
+//=============================================================================================================
+// EIGEN INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+//=============================================================================================================
+// DEFINE NAMESPACE UTILSLIB
+//=============================================================================================================
+
+namespace UTILSLIB
+{
+
+//=============================================================================================================
+/**
+ * Shared storage of a SampleBlock.
+ */
+class SampleBlockData : public QSharedData
+{
+public:
+    Eigen::MatrixXd     matData;    /**< The samples (channels x samples). */
+};
+
+//=============================================================================================================
+/**
+ * Implicitly shared block of samples (channels x samples). Copying a SampleBlock only increments a reference
+ * count, so one block can be handed to any number of consumers without copying the samples. The samples are only
+ * copied if a consumer asks for write access while the block is still shared (copy on write).
+ *
+ * @brief Implicitly shared, copy on write sample block.
+ */
+class SampleBlock
+{
+public:
+    //=========================================================================================================
+    /**
+     * Constructs an empty SampleBlock.
+     */
+    inline SampleBlock();
+
+    //=========================================================================================================
+    /**
+     * Constructs a SampleBlock by copying the given samples.
+     *
+     * @param[in] matData    The samples.
+     */
+    inline SampleBlock(const Eigen::MatrixXd& matData);
+
+    //=========================================================================================================
+    /**
+     * Constructs a SampleBlock by taking over the given samples without copying them.
+     *
+     * @param[in] matData    The samples.
+     */
+    inline SampleBlock(Eigen::MatrixXd&& matData);
+
+    //=========================================================================================================
+    /**
+     * Returns read access to the shared samples.
+     *
+     * @return The samples.
+     */
+    inline const Eigen::MatrixXd& data() const;
+
+    //=========================================================================================================
+    /**
+     * Returns read access to the shared samples, so that a SampleBlock can be passed wherever a const
+     * Eigen::MatrixXd reference is expected.
+     */
+    inline operator const Eigen::MatrixXd&() const;
+
+    //=========================================================================================================
+    /**
+     * Returns write access to the samples. The samples are copied first if the block is shared.
+     *
+     * @return The samples.
+     */
+    inline Eigen::MatrixXd& detach();
+
+    //=========================================================================================================
+    /**
+     * Returns whether the samples are currently shared with another SampleBlock.
+     *
+     * @return Whether the samples are shared.
+     */
+    inline bool isShared() const;
+
+    //=========================================================================================================
+    /**
+     * Returns the number of rows (channels).
+     *
+     * @return The number of rows.
+     */
+    inline Eigen::Index rows() const;
+
+    //=========================================================================================================
+    /**
+     * Returns the number of columns (samples).
+     *
+     * @return The number of columns.
+     */
+    inline Eigen::Index cols() const;
+
+private:
+    QSharedDataPointer<SampleBlockData>     m_pData;    /**< The shared samples. */
+};
+
+//=============================================================================================================
+// INLINE DEFINITIONS
+//=============================================================================================================
+
+inline SampleBlock::SampleBlock()
+: m_pData(new SampleBlockData)
+{
+}
+
+//=============================================================================================================
+
+inline SampleBlock::SampleBlock(const Eigen::MatrixXd& matData)
+: m_pData(new SampleBlockData)
+{
+    m_pData->matData = matData;
+}
+
+//=============================================================================================================
+
+inline SampleBlock::SampleBlock(Eigen::MatrixXd&& matData)
+: m_pData(new SampleBlockData)
+{
+    m_pData->matData = std::move(matData);
+}
+
+//=============================================================================================================
+
+inline const Eigen::MatrixXd& SampleBlock::data() const
+{
+    return m_pData->matData;
+}
+
+//=============================================================================================================
+
+inline SampleBlock::operator const Eigen::MatrixXd&() const
+{
+    return m_pData->matData;
+}
+
+//=============================================================================================================
+
+inline Eigen::MatrixXd& SampleBlock::detach()
+{
+    //Non-const access detaches the shared data pointer
+    return m_pData->matData;
+}
+
+//=============================================================================================================
+
+inline bool SampleBlock::isShared() const
+{
+    return m_pData->ref.load() > 1;
+}
+
+//=============================================================================================================
+
+inline Eigen::Index SampleBlock::rows() const
+{
+    return m_pData->matData.rows();
+}
+
+//=============================================================================================================
+
+inline Eigen::Index SampleBlock::cols() const
+{
+    return m_pData->matData.cols();
+}
+} // NAMESPACE
+
+#endif // SAMPLEBLOCK_H
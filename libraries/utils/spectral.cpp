@@ -56,6 +56,13 @@
 #include <QtMath>
 #include <QtConcurrent>
 #include <QVector>
+#include <QDebug>
+
+//=============================================================================================================
+// STL INCLUDES
+//=============================================================================================================
+
+#include <numeric>
 
 //=============================================================================================================
 // USED NAMESPACES
@@ -64,6 +71,72 @@
 using namespace UTILSLIB;
 using namespace Eigen;
 
+//=============================================================================================================
+// DEFINE GLOBAL METHODS
+//=============================================================================================================
+
+namespace {
+
+/*
+ * FFT plans and buffers of one thread. Eigen's FFT caches the plan (twiddles and factorization) for every length it has
+ * seen, so only the first transform of a given length per thread pays for the planning.
+ */
+struct SpectralFFTWorkspace {
+    FFT<double>     fft;            /* Plans for all lengths seen so far */
+    VectorXd        vecInput;       /* Demeaned, tapered and zero padded input of one transform */
+    VectorXcd       vecSpectrum;    /* Half spectrum of one transform */
+};
+
+SpectralFFTWorkspace& spectralFFTWorkspace()
+{
+    static thread_local SpectralFFTWorkspace ws;
+    ws.fft.SetFlag(ws.fft.HalfSpectrum);
+    return ws;
+}
+
+//=============================================================================================================
+
+void computeTaperedSpectraOfRow(MatrixXcd& matTapSpectra,
+                                const MatrixXd& matData,
+                                const MatrixXd& matTaper,
+                                const VectorXd& vecTapWeights,
+                                int iNfft,
+                                bool bDemean,
+                                int iRow)
+{
+    SpectralFFTWorkspace& ws = spectralFFTWorkspace();
+
+    const int iNRows = matData.rows();
+    const int iNTapers = matTaper.rows();
+    const int iNFreqs = iNfft / 2 + 1;
+    const int iNSamples = std::min<int>(matData.cols(), iNfft);
+    const double dMean = bDemean ? matData.row(iRow).mean() : 0.0;
+
+    ws.vecInput.resize(iNfft);
+    ws.vecInput.tail(iNfft - iNSamples).setZero();
+    ws.vecSpectrum.resize(iNFreqs);
+
+    for (int j = 0; j < iNTapers; ++j) {
+        ws.vecInput.head(iNSamples) = ((matData.row(iRow).head(iNSamples).array() - dMean)
+                                       * matTaper.row(j).head(iNSamples).array()).transpose();
+
+        ws.fft.fwd(ws.vecSpectrum.data(), ws.vecInput.data(), iNfft);
+
+        // Bin f of this row and taper goes to column f * iNTapers + j
+        Map<RowVectorXcd, 0, InnerStride<> > vecTapSpectrum(matTapSpectra.data() + iRow + j * iNRows,
+                                                            iNFreqs,
+                                                            InnerStride<>(iNTapers * iNRows));
+
+        if(vecTapWeights.size() == 0) {
+            vecTapSpectrum = ws.vecSpectrum.transpose();
+        } else {
+            vecTapSpectrum = ws.vecSpectrum.transpose() * vecTapWeights(j);
+        }
+    }
+}
+
+}
+
 //=============================================================================================================
 // DEFINE MEMBER METHODS
 //=============================================================================================================
@@ -72,94 +145,109 @@ MatrixXcd Spectral::computeTaperedSpectraRow(const RowVectorXd &vecData,
                                              const MatrixXd &matTaper,
                                              int iNfft)
 {
-    //qDebug() << "Spectral::computeTaperedSpectra Matrixwise";
-    FFT<double> fft;
-    fft.SetFlag(fft.HalfSpectrum);
-
     //Check inputs
     if (vecData.cols() != matTaper.cols() || iNfft < vecData.cols()) {
         return MatrixXcd();
     }
 
-    //FFT for freq domain returning the half spectrum
-    RowVectorXd vecInputFFT;
-    RowVectorXcd vecTmpFreq;
-    MatrixXcd matTapSpectrum(matTaper.rows(), int(floor(iNfft / 2.0)) + 1);
-    for (int i=0; i < matTaper.rows(); i++) {
-        vecInputFFT = vecData.cwiseProduct(matTaper.row(i));
-        fft.fwd(vecTmpFreq, vecInputFFT, iNfft);
-        matTapSpectrum.row(i) = vecTmpFreq;
+    //FFT for freq domain returning the half spectrum. Zero padding is done by the batched computation.
+    MatrixXcd matTapSpectra;
+    computeTaperedSpectraMatrix(matTapSpectra,
+                                vecData,
+                                matTaper,
+                                iNfft,
+                                VectorXd(),
+                                false,
+                                false);
+
+    if(matTapSpectra.size() == 0) {
+        return MatrixXcd();
     }
 
-    return matTapSpectrum;
+    // With a single row the interleaved layout is the (tapers x frequencies) matrix in column major order
+    return Map<const MatrixXcd>(matTapSpectra.data(), matTaper.rows(), matTapSpectra.cols() / matTaper.rows());
 }
 
 //=============================================================================================================
 
-QVector<MatrixXcd> Spectral::computeTaperedSpectraMatrix(const MatrixXd &matData,
-                                                         const MatrixXd &matTaper,
-                                                         int iNfft,
-                                                         bool bUseThreads)
+void Spectral::computeTaperedSpectraMatrix(MatrixXcd &matTapSpectra,
+                                           const MatrixXd &matData,
+                                           const MatrixXd &matTaper,
+                                           int iNfft,
+                                           const VectorXd &vecTapWeights,
+                                           bool bDemean,
+                                           bool bUseThreads)
 {
+    if (matData.cols() != matTaper.cols() || iNfft <= 0) {
+        qWarning() << "Spectral::computeTaperedSpectraMatrix - Number of samples and taper length do not match or FFT length is invalid. Returning.";
+        matTapSpectra.resize(0,0);
+        return;
+    }
+
+    if (vecTapWeights.size() != 0 && vecTapWeights.size() != matTaper.rows()) {
+        qWarning() << "Spectral::computeTaperedSpectraMatrix - Number of taper weights and tapers do not match. Returning.";
+        matTapSpectra.resize(0,0);
+        return;
+    }
+
     #ifdef EIGEN_FFTW_DEFAULT
         fftw_make_planner_thread_safe();
     #endif
 
-    QVector<MatrixXcd> finalResult;
+    matTapSpectra.resize(matData.rows(), (iNfft / 2 + 1) * matTaper.rows());
 
     if(!bUseThreads) {
         // Sequential
-//        QElapsedTimer timer;
-//        int iTime = 0;
-//        int iTimeAll = 0;
-//        timer.start();
-
-        FFT<double> fft;
-        fft.SetFlag(fft.HalfSpectrum);
-
-        RowVectorXd vecInputFFT, rowData;
-        RowVectorXcd vecTmpFreq;
-
-        MatrixXcd matTapSpectrum(matTaper.rows(), int(floor(iNfft / 2.0)) + 1);
-        int j;
         for (int i = 0; i < matData.rows(); ++i) {
-            rowData = matData.row(i);
+            computeTaperedSpectraOfRow(matTapSpectra, matData, matTaper, vecTapWeights, iNfft, bDemean, i);
+        }
+    } else {
+        // Parallel. Every row writes to its own elements, the data and tapers are shared without copying.
+        QVector<int> vecRows(matData.rows());
+        std::iota(vecRows.begin(), vecRows.end(), 0);
 
-            //FFT for freq domain returning the half spectrum
-            for (j = 0; j < matTaper.rows(); j++) {
-                vecInputFFT = rowData.cwiseProduct(matTaper.row(j));
-                fft.fwd(vecTmpFreq, vecInputFFT, iNfft);
-                matTapSpectrum.row(j) = vecTmpFreq;
-            }
+        std::function<void(int&)> computeLambda = [&](int& iRow) {
+            computeTaperedSpectraOfRow(matTapSpectra, matData, matTaper, vecTapWeights, iNfft, bDemean, iRow);
+        };
 
-            finalResult.append(matTapSpectrum);
+        QFuture<void> result = QtConcurrent::map(vecRows,
+                                                 computeLambda);
+        result.waitForFinished();
+    }
+}
 
-//            iTime = timer.elapsed();
-//            qDebug() << QThread::currentThreadId() << "Spectral::computeTaperedSpectraMatrix - Row-wise computation:" << iTime;
-//            iTimeAll += iTime;
-//            timer.restart();
-        }
+//=============================================================================================================
 
-//        qDebug() << QThread::currentThreadId() << "Spectral::computeTaperedSpectraMatrix - Complete computation:" << iTimeAll;
-    } else {
-        // Parallel
-        QList<TaperedSpectraInputData> lData;
-        TaperedSpectraInputData dataTemp;
-        dataTemp.matTaper = matTaper;
-        dataTemp.iNfft = iNfft;
+QVector<MatrixXcd> Spectral::computeTaperedSpectraMatrix(const MatrixXd &matData,
+                                                         const MatrixXd &matTaper,
+                                                         int iNfft,
+                                                         bool bUseThreads)
+{
+    QVector<MatrixXcd> finalResult;
 
-        for (int i = 0; i < matData.rows(); ++i) {
-            dataTemp.vecData = matData.row(i);
+    MatrixXcd matTapSpectra;
+    computeTaperedSpectraMatrix(matTapSpectra,
+                                matData,
+                                matTaper,
+                                iNfft,
+                                VectorXd(),
+                                false,
+                                bUseThreads);
+
+    if(matTapSpectra.size() == 0) {
+        return finalResult;
+    }
 
-            lData.append(dataTemp);
-        }
+    // Split into one (tapers x frequencies) matrix per row
+    const int iNRows = matData.rows();
+    const int iNTapers = matTaper.rows();
+    finalResult.reserve(iNRows);
 
-        QFuture<QVector<MatrixXcd> > result = QtConcurrent::mappedReduced(lData,
-                                                                          compute,
-                                                                          reduce,
-                                                                          QtConcurrent::OrderedReduce);
-        result.waitForFinished();
-        finalResult = result.result();
+    for (int i = 0; i < iNRows; ++i) {
+        finalResult.append(Map<const MatrixXcd, 0, Stride<Dynamic, Dynamic> >(matTapSpectra.data() + i,
+                                                                              iNTapers,
+                                                                              matTapSpectra.cols() / iNTapers,
+                                                                              Stride<Dynamic, Dynamic>(iNTapers * iNRows, iNRows)));
     }
 
     return finalResult;
@@ -167,21 +255,27 @@ QVector<MatrixXcd> Spectral::computeTaperedSpectraMatrix(const MatrixXd &matData
 
 //=============================================================================================================
 
-MatrixXcd Spectral::compute(const TaperedSpectraInputData& inputData)
+void Spectral::computeInverseHalfSpectra(MatrixXd &matData,
+                                         const MatrixXcd &matSpectra,
+                                         int iNfft)
 {
-    //qDebug() << "Spectral::compute";
-    return computeTaperedSpectraRow(inputData.vecData,
-                                    inputData.matTaper,
-                                    inputData.iNfft);
-}
+    if (iNfft <= 0 || matSpectra.rows() != iNfft / 2 + 1) {
+        qWarning() << "Spectral::computeInverseHalfSpectra - Number of frequency bins does not match the FFT length. Returning.";
+        matData.resize(0,0);
+        return;
+    }
 
-//=============================================================================================================
+    #ifdef EIGEN_FFTW_DEFAULT
+        fftw_make_planner_thread_safe();
+    #endif
 
-void Spectral::reduce(QVector<MatrixXcd>& finalData,
-                      const MatrixXcd& resultData)
-{
-    //qDebug() << "Spectral::reduce";
-    finalData.append(resultData);
+    SpectralFFTWorkspace& ws = spectralFFTWorkspace();
+
+    matData.resize(iNfft, matSpectra.cols());
+
+    for (int i = 0; i < matSpectra.cols(); ++i) {
+        ws.fft.inv(matData.col(i).data(), matSpectra.col(i).data(), iNfft);
+    }
 }
 
 //=============================================================================================================
@@ -66,12 +66,6 @@
 namespace UTILSLIB
 {
 
-struct TaperedSpectraInputData {
-    Eigen::RowVectorXd vecData;
-    Eigen::MatrixXd matTaper;
-    int iNfft;
-};
-
 //=============================================================================================================
 /**
  * Computes spectral measures of input data such as spectra, power spectral density, cross-spectral density.
@@ -102,9 +96,34 @@ public:
                                                      const Eigen::MatrixXd &matTaper,
                                                      int iNfft);
 
+    //=========================================================================================================
+    /**
+     * Calculates the tapered spectra of all rows of a given input matrix data in one call. The spectra are written
+     * into one contiguous buffer with one row per data row and the tapers interleaved per frequency bin, i.e. bin f of
+     * taper j is column f * matTaper.rows() + j. This is the layout used for the cross-spectral density. The FFT plans
+     * are cached per thread and FFT length and are reused across calls. If the rows are longer than iNfft only the
+     * first iNfft samples are transformed.
+     *
+     * @param[out] matTapSpectra  The tapered spectra (rows x ((iNfft/2+1) * tapers)).
+     * @param[in] matData         input matrix data (time domain), for which the spectrum is computed.
+     * @param[in] matTaper        tapers used to compute the spectra.
+     * @param[in] iNfft           FFT length.
+     * @param[in] vecTapWeights   taper weights multiplied to the spectra. No weighting if empty.
+     * @param[in] bDemean         Whether to subtract the mean of each row before tapering.
+     * @param[in] bUseThreads     Whether to use multiple threads.
+     */
+    static void computeTaperedSpectraMatrix(Eigen::MatrixXcd &matTapSpectra,
+                                            const Eigen::MatrixXd &matData,
+                                            const Eigen::MatrixXd &matTaper,
+                                            int iNfft,
+                                            const Eigen::VectorXd &vecTapWeights = Eigen::VectorXd(),
+                                            bool bDemean = false,
+                                            bool bUseThreads = true);
+
     //=========================================================================================================
     /**
      * Calculates the full tapered spectra of a given input matrix data. This function calculates each row in parallel.
+     * Every returned matrix holds the (tapers x frequencies) spectra of one row.
      *
      * @param[in] matData         input matrix data (time domain), for which the spectrum is computed.
      * @param[in] matTaper        tapers used to compute the spectra.
@@ -120,23 +139,16 @@ public:
 
     //=========================================================================================================
     /**
-     * Computes the tapered spectra for a row vector. This function gets called in parallel.
-     *
-     * @param[in] inputData    The input data.
-     *
-     * @return                 The tapered spectra for one data row.
-     */
-    static Eigen::MatrixXcd compute(const TaperedSpectraInputData& inputData);
-
-    //=========================================================================================================
-    /**
-     * Reduces the taperedSpectra results to a final result. This function gets called in parallel.
+     * Calculates the inverse FFT of the given half spectra in one call, using the same cached FFT plans as
+     * computeTaperedSpectraMatrix.
      *
-     * @param[out] finalData    The final data data.
-     * @param[in]  resultData   The resulting data from the computation step.
+     * @param[out] matData        The time domain data (iNfft x spectra), one column per spectrum.
+     * @param[in] matSpectra      The half spectra ((iNfft/2+1) x spectra), one column per spectrum.
+     * @param[in] iNfft           FFT length.
      */
-    static void reduce(QVector<Eigen::MatrixXcd>& finalData,
-                       const Eigen::MatrixXcd& resultData);
+    static void computeInverseHalfSpectra(Eigen::MatrixXd &matData,
+                                          const Eigen::MatrixXcd &matSpectra,
+                                          int iNfft);
 
     //=========================================================================================================
     /**
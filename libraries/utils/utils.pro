@@ -88,6 +88,8 @@ HEADERS += \
     sphere.h \
     simplex_algorithm.h \
     generics/circularbuffer.h \
+    generics/circularmatrixbuffer.h \
+    generics/sampleblock.h \
     generics/commandpattern.h \
     generics/observerpattern.h \
     generics/applicationlogger.h \
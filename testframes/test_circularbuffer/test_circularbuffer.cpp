@@ -0,0 +1,330 @@
+//=============================================================================================================
+/**
+ * @file     test_circularbuffer.cpp
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @since    0.1.0
+ * @date     October, 2026
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2026, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief    The circular matrix buffer test implementation
+ *
+ */
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <utils/generics/circularbuffer.h>
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QtTest>
+#include <QtConcurrent>
+
+//=============================================================================================================
+// EIGEN INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace UTILSLIB;
+using namespace Eigen;
+
+//=============================================================================================================
+/**
+ * DECLARE CLASS TestCircularBuffer
+ *
+ * @brief The TestCircularBuffer class provides tests of the lock-free circular matrix buffer
+ *
+ */
+class TestCircularBuffer: public QObject
+{
+    Q_OBJECT
+
+public:
+    TestCircularBuffer();
+
+private slots:
+    void initTestCase();
+    void wrapAround();
+    void overrun();
+    void batchPop();
+    void pause();
+    void clear();
+    void producerConsumer();
+    void cleanupTestCase();
+
+private:
+    MatrixXd block(int iRows,
+                   int iCols,
+                   double dValue);
+};
+
+//=============================================================================================================
+
+TestCircularBuffer::TestCircularBuffer()
+{
+}
+
+//=============================================================================================================
+
+void TestCircularBuffer::initTestCase()
+{
+}
+
+//=============================================================================================================
+
+void TestCircularBuffer::wrapAround()
+{
+    // Push and pop more matrices than there are slots, the matrices have to come out in order
+    CircularBuffer_Matrix_double buffer(3);
+    MatrixXd matPopped;
+
+    QCOMPARE(buffer.getFreeElementsRead(), 0);
+    QCOMPARE(buffer.getFreeElementsWrite(), 3);
+
+    for(int i = 0; i < 10; ++i) {
+        QVERIFY(buffer.push(block(2, 4, i)));
+        QVERIFY(buffer.push(block(2, 4, i + 0.5)));
+        QCOMPARE(buffer.getFreeElementsRead(), 2);
+        QCOMPARE(buffer.getFreeElementsWrite(), 1);
+
+        QVERIFY(buffer.pop(matPopped));
+        QCOMPARE(matPopped, block(2, 4, i));
+        QVERIFY(buffer.pop(matPopped));
+        QCOMPARE(matPopped, block(2, 4, i + 0.5));
+    }
+
+    // In place access
+    MatrixXd* pSlot = buffer.acquireWrite();
+    QVERIFY(pSlot != Q_NULLPTR);
+    *pSlot = block(3, 1, 7.0);
+    buffer.commitWrite();
+
+    const MatrixXd* pRead = buffer.acquireRead();
+    QVERIFY(pRead != Q_NULLPTR);
+    QCOMPARE(*pRead, block(3, 1, 7.0));
+    buffer.releaseRead();
+
+    QCOMPARE(buffer.getFreeElementsRead(), 0);
+    QCOMPARE(buffer.getDroppedCount(), 0);
+    QCOMPARE(buffer.getOverrunCount(), 0);
+}
+
+//=============================================================================================================
+
+void TestCircularBuffer::overrun()
+{
+    CircularBuffer_Matrix_double buffer(2);
+    MatrixXd matPopped;
+
+    QVERIFY(buffer.push(block(1, 1, 1.0)));
+    QVERIFY(buffer.push(block(1, 1, 2.0)));
+
+    // The buffer is full, the push times out and is counted as overrun
+    QVERIFY(!buffer.push(block(1, 1, 3.0)));
+    QCOMPARE(buffer.getOverrunCount(), 1);
+
+    // More matrices than slots can never be written
+    MatrixXd arrayBlocks[3] = {block(1, 1, 4.0), block(1, 1, 5.0), block(1, 1, 6.0)};
+    QVERIFY(!buffer.push(arrayBlocks, 3));
+    QCOMPARE(buffer.getOverrunCount(), 4);
+
+    // Nothing was overwritten
+    QVERIFY(buffer.pop(matPopped));
+    QCOMPARE(matPopped, block(1, 1, 1.0));
+    QVERIFY(buffer.pop(matPopped));
+    QCOMPARE(matPopped, block(1, 1, 2.0));
+
+    // The empty buffer times out on reading
+    QVERIFY(!buffer.pop(matPopped));
+    QVERIFY(buffer.acquireRead() == Q_NULLPTR);
+
+    // An array that fits is written as a whole
+    QVERIFY(buffer.push(arrayBlocks, 2));
+    QCOMPARE(buffer.getFreeElementsRead(), 2);
+}
+
+//=============================================================================================================
+
+void TestCircularBuffer::batchPop()
+{
+    CircularBuffer_Matrix_double buffer(4);
+    MatrixXd matBatch;
+
+    // Wrap around first so that the batch spans the end of the slots
+    QVERIFY(buffer.push(block(2, 1, 0.0)));
+    QVERIFY(buffer.push(block(2, 1, 0.0)));
+    QVERIFY(buffer.push(block(2, 1, 0.0)));
+    QCOMPARE(buffer.popBatch(matBatch), 3);
+    QCOMPARE(matBatch.cols(), 3);
+
+    QVERIFY(buffer.push(block(2, 3, 1.0)));
+    QVERIFY(buffer.push(block(2, 2, 2.0)));
+    QVERIFY(buffer.push(block(3, 1, 3.0)));
+    QVERIFY(buffer.push(block(3, 2, 4.0)));
+
+    // The batch stops at the first matrix with a different number of rows
+    QCOMPARE(buffer.popBatch(matBatch), 2);
+    QCOMPARE(matBatch.rows(), 2);
+    QCOMPARE(matBatch.cols(), 5);
+    QCOMPARE(MatrixXd(matBatch.leftCols(3)), block(2, 3, 1.0));
+    QCOMPARE(MatrixXd(matBatch.rightCols(2)), block(2, 2, 2.0));
+
+    // The number of matrices can be limited
+    QCOMPARE(buffer.popBatch(matBatch, 1), 1);
+    QCOMPARE(matBatch, block(3, 1, 3.0));
+
+    QCOMPARE(buffer.popBatch(matBatch), 1);
+    QCOMPARE(matBatch, block(3, 2, 4.0));
+
+    QCOMPARE(buffer.getFreeElementsRead(), 0);
+    QCOMPARE(buffer.popBatch(matBatch), 0);
+}
+
+//=============================================================================================================
+
+void TestCircularBuffer::pause()
+{
+    CircularBuffer_Matrix_double buffer(4);
+    MatrixXd matPopped = block(1, 1, -1.0);
+
+    QVERIFY(buffer.push(block(1, 1, 1.0)));
+
+    buffer.pause(true);
+
+    // The array push drops while paused
+    MatrixXd arrayBlocks[2] = {block(1, 1, 2.0), block(1, 1, 3.0)};
+    QVERIFY(buffer.push(arrayBlocks, 2));
+    QCOMPARE(buffer.getDroppedCount(), 2);
+    QCOMPARE(buffer.getFreeElementsRead(), 1);
+
+    // The single push is not affected
+    QVERIFY(buffer.push(block(1, 1, 4.0)));
+    QCOMPARE(buffer.getFreeElementsRead(), 2);
+
+    // Nothing is popped while paused
+    QVERIFY(buffer.pop(matPopped));
+    QCOMPARE(matPopped, block(1, 1, -1.0));
+    QCOMPARE(buffer.popBatch(matPopped), 0);
+    QCOMPARE(buffer.getFreeElementsRead(), 2);
+
+    buffer.pause(false);
+
+    QVERIFY(buffer.pop(matPopped));
+    QCOMPARE(matPopped, block(1, 1, 1.0));
+    QVERIFY(buffer.pop(matPopped));
+    QCOMPARE(matPopped, block(1, 1, 4.0));
+}
+
+//=============================================================================================================
+
+void TestCircularBuffer::clear()
+{
+    CircularBuffer_Matrix_double buffer(3);
+    MatrixXd matPopped;
+
+    QVERIFY(buffer.push(block(1, 1, 1.0)));
+    QVERIFY(buffer.push(block(1, 1, 2.0)));
+
+    buffer.clear();
+
+    QCOMPARE(buffer.getDroppedCount(), 2);
+    QCOMPARE(buffer.getFreeElementsRead(), 0);
+    QCOMPARE(buffer.getFreeElementsWrite(), 3);
+
+    QVERIFY(buffer.push(block(1, 1, 3.0)));
+    QVERIFY(buffer.pop(matPopped));
+    QCOMPARE(matPopped, block(1, 1, 3.0));
+}
+
+//=============================================================================================================
+
+void TestCircularBuffer::producerConsumer()
+{
+    // One producer and one consumer thread, every matrix has to arrive exactly once and in order
+    const int iNumBlocks = 5000;
+    CircularBuffer_Matrix_float buffer(8);
+
+    QFuture<void> future = QtConcurrent::run([&buffer, iNumBlocks]() {
+        for(int i = 0; i < iNumBlocks; ++i) {
+            while(!buffer.push(MatrixXf::Constant(4, 16, float(i)))) {
+            }
+        }
+    });
+
+    MatrixXf matPopped;
+    int iNext = 0;
+    bool bInOrder = true;
+
+    while(iNext < iNumBlocks) {
+        if(iNext % 2 == 0) {
+            if(buffer.pop(matPopped)) {
+                bInOrder &= matPopped == MatrixXf::Constant(4, 16, float(iNext));
+                ++iNext;
+            }
+        } else {
+            int iPopped = buffer.popBatch(matPopped, 3);
+            for(int i = 0; i < iPopped; ++i) {
+                bInOrder &= matPopped.middleCols(16 * i, 16) == MatrixXf::Constant(4, 16, float(iNext));
+                ++iNext;
+            }
+        }
+    }
+
+    future.waitForFinished();
+
+    QVERIFY(bInOrder);
+    QCOMPARE(iNext, iNumBlocks);
+    QCOMPARE(buffer.getFreeElementsRead(), 0);
+}
+
+//=============================================================================================================
+
+void TestCircularBuffer::cleanupTestCase()
+{
+}
+
+//=============================================================================================================
+
+MatrixXd TestCircularBuffer::block(int iRows,
+                                   int iCols,
+                                   double dValue)
+{
+    return MatrixXd::Constant(iRows, iCols, dValue);
+}
+
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+QTEST_GUILESS_MAIN(TestCircularBuffer)
+#include "test_circularbuffer.moc"
@@ -39,18 +39,66 @@
 
 #include <inverse/dipoleFit/dipole_fit_settings.h>
 #include <inverse/dipoleFit/dipole_fit.h>
+#include <inverse/dipoleFit/dipole_fit_data.h>
+#include <inverse/dipoleFit/dipole_forward.h>
+#include <inverse/dipoleFit/guess_data.h>
 
 //=============================================================================================================
 // QT INCLUDES
 //=============================================================================================================
 
 #include <QtTest>
+#include <QTemporaryDir>
+
+//=============================================================================================================
+// EIGEN INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Core>
 
 //=============================================================================================================
 // USED NAMESPACES
 //=============================================================================================================
 
 using namespace INVERSELIB;
+using namespace Eigen;
+
+//=============================================================================================================
+/**
+ * Records the progress reported by the dipole fitting.
+ */
+static bool recordProgress(int nfit, int ntime, void *user)
+{
+    QList<QPair<int,int> >* pProgress = static_cast<QList<QPair<int,int> >*>(user);
+    pProgress->append(qMakePair(nfit, ntime));
+    return true;
+}
+
+//=============================================================================================================
+/**
+ * Sets up the fitting data the same way as DipoleFit::calculateFit does for MEG.
+ */
+static DipoleFitData* setupFitData(DipoleFitSettings& settings)
+{
+    return DipoleFitData::setup_dipole_fit_data(settings.mriname,
+                                                settings.measname,
+                                                settings.bemname,
+                                                &settings.r0,
+                                                NULL,
+                                                settings.accurate,
+                                                settings.badname,
+                                                settings.noisename,
+                                                settings.grad_std,
+                                                settings.mag_std,
+                                                settings.eeg_std,
+                                                settings.mag_reg,
+                                                settings.grad_reg,
+                                                settings.eeg_reg,
+                                                settings.diagnoise,
+                                                settings.projnames,
+                                                settings.include_meg,
+                                                false);
+}
 
 //=============================================================================================================
 /**
@@ -70,10 +118,14 @@ private slots:
     void initTestCase();
     void dipoleFitSimple();
     void dipoleFitAdvanced();
+    void dipoleFitParallel();
+    void guessScoring();
+    void guessCache();
     void cleanupTestCase();
 
 private:
     void compareFit();
+    void simpleSettings(DipoleFitSettings& settings);
 
     double epsilon;
 
@@ -99,7 +151,6 @@ void TestDipoleFit::initTestCase()
 void TestDipoleFit::dipoleFitSimple()
 {
     QString refFileName(QCoreApplication::applicationDirPath() + "/mne-cpp-test-data/Result/ref_dip_fit.dat");
-    QFile testFile;
 
     //*********************************************************************************************************
     // Dipole Fit Settings
@@ -107,22 +158,8 @@ void TestDipoleFit::dipoleFitSimple()
 
     printf(">>>>>>>>>>>>>>>>>>>>>>>>> Dipole Fit Settings >>>>>>>>>>>>>>>>>>>>>>>>>\n");
 
-    //Following is equivalent to: --meas ./mne-cpp-test-data/MEG/sample/sample_audvis-ave.fif --set 1 --meg
-    //--eeg --tmin 32 --tmax 148 --bmin -100 --bmax 0 --dip ./mne-cpp-test-data/Result/dip_fit.dat
     DipoleFitSettings settings;
-    testFile.setFileName(QCoreApplication::applicationDirPath() + "/mne-cpp-test-data/MEG/sample/sample_audvis-ave.fif"); QVERIFY( testFile.exists() );
-    settings.measname = testFile.fileName();
-    settings.is_raw = false;
-    settings.setno = 1;
-    settings.include_meg = true;
-    settings.include_eeg = true;
-    settings.tmin = 32.0f/1000.0f;
-    settings.tmax = 148.0f/1000.0f;
-    settings.bmin = -100.0f/1000.0f;
-    settings.bmax = 0.0f/1000.0f;
-    settings.dipname = QCoreApplication::applicationDirPath() + "/mne-cpp-test-data/Result/dip_fit.dat";
-
-    settings.checkIntegrity();
+    simpleSettings(settings);
 
     printf("<<<<<<<<<<<<<<<<<<<<<<<<< Dipole Fit Settings Finished <<<<<<<<<<<<<<<<<<<<<<<<<\n");
 
@@ -294,6 +331,202 @@ void TestDipoleFit::compareFit()
 
 //=============================================================================================================
 
+void TestDipoleFit::dipoleFitParallel()
+{
+    DipoleFitSettings settings;
+    simpleSettings(settings);
+
+    // The serial fit
+    settings.nthreads = 1;
+    ECDSet serialSet = DipoleFit(&settings).calculateFit();
+    QVERIFY(serialSet.size() > 0);
+
+    // Several threads, the time points are fitted in more than one batch
+    settings.nthreads = 4;
+    QList<QPair<int,int> > progress;
+    DipoleFit dipFit(&settings);
+    dipFit.setProgressFunc(recordProgress, &progress);
+    ECDSet parallelSet = dipFit.calculateFit();
+
+    // The threads work on the same data with their own fit contexts, hence the results are identical and in time order
+    QCOMPARE(parallelSet.size(), serialSet.size());
+    for (int i = 0; i < serialSet.size(); ++i) {
+        QCOMPARE(parallelSet[i].valid, serialSet[i].valid);
+        QCOMPARE(parallelSet[i].time, serialSet[i].time);
+        QVERIFY(parallelSet[i].rd == serialSet[i].rd);
+        QVERIFY(parallelSet[i].Q == serialSet[i].Q);
+        QCOMPARE(parallelSet[i].good, serialSet[i].good);
+        QCOMPARE(parallelSet[i].khi2, serialSet[i].khi2);
+        QCOMPARE(parallelSet[i].nfree, serialSet[i].nfree);
+        QCOMPARE(parallelSet[i].neval, serialSet[i].neval);
+    }
+
+    // The progress is reported after each batch until all time points are done
+    QVERIFY(progress.size() > 1);
+    for (int i = 1; i < progress.size(); ++i) {
+        QVERIFY(progress[i].first > progress[i-1].first);
+    }
+    QCOMPARE(progress.last().first, progress.last().second);
+}
+
+//=============================================================================================================
+
+void TestDipoleFit::guessScoring()
+{
+    DipoleFitSettings settings;
+    simpleSettings(settings);
+    settings.include_eeg = false;
+
+    QScopedPointer<DipoleFitData> pFitData(setupFitData(settings));
+    QVERIFY(!pFitData.isNull());
+    GuessData guess(settings.guessname, settings.guess_surfname, settings.guess_mindist, settings.guess_exclude, settings.guess_grid, pFitData.data());
+    QVERIFY(guess.nguess > 0);
+
+    // More than two blocks of time points and a remainder
+    int nch = pFitData->nmeg + pFitData->neeg;
+    int ntime = 150;
+    std::srand(0);
+    MatrixXf matB = MatrixXf::Random(nch, ntime);
+    QVector<float*> B(ntime);
+    for (int t = 0; t < ntime; ++t) {
+        B[t] = matB.col(t).data();
+    }
+
+    QVector<int> best(ntime);
+    QVector<float> good(ntime);
+    QVERIFY(guess.find_best_guesses(B.data(), ntime, nch, DIPOLE_FIT_LIMIT, best.data(), good.data()) == 0);
+
+    // Score each time point against one guess after the other, omitting the pseudoradial component below the limit
+    bool bOmitted = false;
+    VectorXf vecBm2(guess.nguess);
+    for (int t = 0; t < ntime; ++t) {
+        float B2 = matB.col(t).squaredNorm();
+        float Bm2max = 0.0f;
+        for (int k = 0; k < guess.nguess; ++k) {
+            DipoleForward* fwd = guess.guess_fwd[k];
+            int ncomp = fwd->sing[2]/fwd->sing[0] > DIPOLE_FIT_LIMIT ? 3 : 2;
+            bOmitted = bOmitted || ncomp == 2;
+            vecBm2[k] = 0.0f;
+            for (int c = 0; c < ncomp; ++c) {
+                float proj = Map<VectorXf>(fwd->uu[c], nch).dot(matB.col(t));
+                vecBm2[k] += proj*proj;
+            }
+            if (vecBm2[k] > Bm2max) {
+                Bm2max = vecBm2[k];
+            }
+        }
+
+        // Neighbouring guesses may tie within the rounding, the picked one must score as high as the best
+        QVERIFY(best[t] >= 0 && best[t] < guess.nguess);
+        QVERIFY(qAbs(vecBm2[best[t]] - Bm2max) <= 1e-5f * B2);
+        QVERIFY(qAbs(good[t] - (1.0f - (B2 - Bm2max)/B2)) < 1e-5f);
+    }
+    QVERIFY(bOmitted);
+}
+
+//=============================================================================================================
+
+void TestDipoleFit::guessCache()
+{
+    DipoleFitSettings settings;
+    simpleSettings(settings);
+    settings.include_eeg = false;
+
+    QTemporaryDir cacheDir;
+    QVERIFY(cacheDir.isValid());
+
+    QScopedPointer<DipoleFitData> pFitData(setupFitData(settings));
+    QVERIFY(!pFitData.isNull());
+    GuessData guessRef(settings.guessname, settings.guess_surfname, settings.guess_mindist, settings.guess_exclude, settings.guess_grid, pFitData.data());
+    QVERIFY(guessRef.nguess > 0);
+
+    // Computing the fields writes them to the cache
+    GuessData guessWritten(settings.guessname, settings.guess_surfname, settings.guess_mindist, settings.guess_exclude, settings.guess_grid, pFitData.data(), cacheDir.path());
+    QStringList files = QDir(cacheDir.path()).entryList(QDir::Files);
+    QCOMPARE(files.size(), 1);
+    QString sCacheName = QDir(cacheDir.path()).filePath(files.first());
+    qint64 iCacheSize = QFileInfo(sCacheName).size();
+    QVERIFY(guessWritten.guess_uu == guessRef.guess_uu);
+
+    // Mark the location of the first guess behind the header, the reload has to pick it up
+    QFile cacheFile(sCacheName);
+    QVERIFY(cacheFile.open(QIODevice::ReadWrite));
+    float marker[3] = { 1.0f, 2.0f, 3.0f };
+    QVERIFY(cacheFile.seek(sizeof(quint32) + 4 * sizeof(qint32)));
+    QVERIFY(cacheFile.write((const char*)marker, sizeof(marker)) == sizeof(marker));
+    cacheFile.close();
+
+    GuessData guessRead(settings.guessname, settings.guess_surfname, settings.guess_mindist, settings.guess_exclude, settings.guess_grid, pFitData.data(), cacheDir.path());
+    QCOMPARE(guessRead.nguess, guessRef.nguess);
+    QVERIFY(Map<Vector3f>(guessRead.guess_fwd[0]->rd[0]) == Map<Vector3f>(marker));
+    QVERIFY(guessRead.guess_uu == guessRef.guess_uu);
+    QVERIFY(guessRead.guess_sing_ratio == guessRef.guess_sing_ratio);
+
+    // A truncated file is not used, the fields are computed and written again
+    QVERIFY(cacheFile.resize(iCacheSize / 2));
+    GuessData guessTruncated(settings.guessname, settings.guess_surfname, settings.guess_mindist, settings.guess_exclude, settings.guess_grid, pFitData.data(), cacheDir.path());
+    QVERIFY(Map<Vector3f>(guessTruncated.guess_fwd[0]->rd[0]) == Map<Vector3f>(guessRef.guess_fwd[0]->rd[0]));
+    QVERIFY(guessTruncated.guess_uu == guessRef.guess_uu);
+    QCOMPARE(QFileInfo(sCacheName).size(), iCacheSize);
+
+    // A different noise covariance changes the key, the stale fields are not used
+    DipoleFitSettings noiseSettings;
+    simpleSettings(noiseSettings);
+    noiseSettings.include_eeg = false;
+    noiseSettings.grad_std *= 2.0f;
+
+    QScopedPointer<DipoleFitData> pNoiseFitData(setupFitData(noiseSettings));
+    QVERIFY(!pNoiseFitData.isNull());
+    GuessData guessNoiseRef(settings.guessname, settings.guess_surfname, settings.guess_mindist, settings.guess_exclude, settings.guess_grid, pNoiseFitData.data());
+    GuessData guessNoise(settings.guessname, settings.guess_surfname, settings.guess_mindist, settings.guess_exclude, settings.guess_grid, pNoiseFitData.data(), cacheDir.path());
+    QCOMPARE(QDir(cacheDir.path()).entryList(QDir::Files).size(), 2);
+    QVERIFY(guessNoise.guess_uu == guessNoiseRef.guess_uu);
+    QVERIFY(guessNoise.guess_uu != guessRef.guess_uu);
+
+    // A fit reading the fields from the cache gives the same dipoles as one computing them
+    settings.guess_cache_dir = cacheDir.path();
+    ECDSet cachedSet = DipoleFit(&settings).calculateFit();
+    QCOMPARE(QDir(cacheDir.path()).entryList(QDir::Files).size(), 2);
+
+    settings.guess_cache_dir.clear();
+    ECDSet set = DipoleFit(&settings).calculateFit();
+
+    QVERIFY(set.size() > 0);
+    QCOMPARE(cachedSet.size(), set.size());
+    for (int i = 0; i < set.size(); ++i) {
+        QCOMPARE(cachedSet[i].time, set[i].time);
+        QVERIFY(cachedSet[i].rd == set[i].rd);
+        QVERIFY(cachedSet[i].Q == set[i].Q);
+        QCOMPARE(cachedSet[i].good, set[i].good);
+        QCOMPARE(cachedSet[i].neval, set[i].neval);
+    }
+}
+
+//=============================================================================================================
+
+void TestDipoleFit::simpleSettings(DipoleFitSettings& settings)
+{
+    QFile testFile;
+
+    //Following is equivalent to: --meas ./mne-cpp-test-data/MEG/sample/sample_audvis-ave.fif --set 1 --meg
+    //--eeg --tmin 32 --tmax 148 --bmin -100 --bmax 0 --dip ./mne-cpp-test-data/Result/dip_fit.dat
+    testFile.setFileName(QCoreApplication::applicationDirPath() + "/mne-cpp-test-data/MEG/sample/sample_audvis-ave.fif"); QVERIFY( testFile.exists() );
+    settings.measname = testFile.fileName();
+    settings.is_raw = false;
+    settings.setno = 1;
+    settings.include_meg = true;
+    settings.include_eeg = true;
+    settings.tmin = 32.0f/1000.0f;
+    settings.tmax = 148.0f/1000.0f;
+    settings.bmin = -100.0f/1000.0f;
+    settings.bmax = 0.0f/1000.0f;
+    settings.dipname = QCoreApplication::applicationDirPath() + "/mne-cpp-test-data/Result/dip_fit.dat";
+
+    settings.checkIntegrity();
+}
+
+//=============================================================================================================
+
 void TestDipoleFit::cleanupTestCase()
 {
 }
@@ -0,0 +1,282 @@
+//=============================================================================================================
+/**
+ * @file     test_fiff_raw_data.cpp
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @since    0.1.0
+ * @date     October, 2026
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2026, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief    The FiffRawData test implementation
+ *
+ */
+
+
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <utils/generics/applicationlogger.h>
+
+#include <fiff/fiff.h>
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QtTest>
+#include <QBuffer>
+#include <QTemporaryDir>
+
+//=============================================================================================================
+// EIGEN INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace FIFFLIB;
+using namespace Eigen;
+
+//=============================================================================================================
+/**
+ * DECLARE CLASS TestFiffRawData
+ *
+ * @brief The TestFiffRawData class compares raw data read from the memory-mapped file with raw data read tag by tag
+ *
+ */
+class TestFiffRawData: public QObject
+{
+    Q_OBJECT
+
+public:
+    TestFiffRawData();
+
+private slots:
+    void initTestCase();
+    void compareReads_data();
+    void compareReads();
+    void cleanupTestCase();
+
+private:
+    void writeRaw(QIODevice& device,
+                  fiff_int_t type,
+                  const MatrixXd& matValues);
+
+    double dEpsilon;
+
+    QFile m_fileRaw;
+    FiffRawData m_raw;
+    qint32 m_iNSampBuffer;
+    qint32 m_iNBuffers;
+    QTemporaryDir m_tempDir;
+};
+
+//=============================================================================================================
+
+TestFiffRawData::TestFiffRawData()
+: dEpsilon(1e-12)
+, m_fileRaw(QCoreApplication::applicationDirPath() + "/mne-cpp-test-data/MEG/sample/sample_audvis_trunc_raw.fif")
+, m_iNSampBuffer(100)
+, m_iNBuffers(3)
+{
+}
+
+//=============================================================================================================
+
+void TestFiffRawData::initTestCase()
+{
+    qInstallMessageHandler(UTILSLIB::ApplicationLogger::customLogWriter);
+
+    // The measurement info, including the projectors, is taken from the sample data
+    m_raw = FiffRawData(m_fileRaw);
+    QVERIFY(m_raw.info.nchan > 0);
+    QVERIFY(!m_raw.info.projs.isEmpty());
+    QVERIFY(m_tempDir.isValid());
+}
+
+//=============================================================================================================
+
+void TestFiffRawData::compareReads_data()
+{
+    QTest::addColumn<int>("type");
+    QTest::addColumn<double>("dScale");
+
+    // FIFF files are big endian, i.e., on little endian hosts the mapped samples are byte swapped
+    QTest::newRow("short") << int(FIFFT_SHORT) << 1.0;
+    QTest::newRow("dau16") << int(FIFFT_DAU_PACK16) << 1.0;
+    QTest::newRow("int") << int(FIFFT_INT) << 65537.0;
+    QTest::newRow("float") << int(FIFFT_FLOAT) << 0.125;
+}
+
+//=============================================================================================================
+
+void TestFiffRawData::compareReads()
+{
+    QFETCH(int, type);
+    QFETCH(double, dScale);
+
+    const qint32 nchan = m_raw.info.nchan;
+    const qint32 nsamp = m_iNSampBuffer * m_iNBuffers;
+
+    // Values which are exactly representable in the storage type, with negative values and all bytes in use
+    MatrixXd matValues(nchan, nsamp);
+    for(qint32 c = 0; c < nchan; ++c) {
+        for(qint32 s = 0; s < nsamp; ++s) {
+            matValues(c, s) = dScale * double((c * 131 + s * 17) % 60001 - 30000);
+        }
+    }
+
+    QString sFileName = m_tempDir.path() + QString("/raw_type_%1.fif").arg(type);
+    QFile t_fileOut(sFileName);
+    writeRaw(t_fileOut, type, matValues);
+
+    // A QFile is read from the memory-mapped file, a QBuffer tag by tag
+    QFile t_fileMapped(sFileName);
+    FiffRawData rawMapped(t_fileMapped);
+
+    QFile t_fileCopy(sFileName);
+    QVERIFY(t_fileCopy.open(QIODevice::ReadOnly));
+    QByteArray baFile = t_fileCopy.readAll();
+    t_fileCopy.close();
+    QBuffer t_bufferStream(&baFile);
+    FiffRawData rawStream(t_bufferStream);
+
+    QCOMPARE(rawMapped.rawdir.size(), m_iNBuffers);
+    QCOMPARE(rawStream.rawdir.size(), m_iNBuffers);
+
+    const fiff_int_t first = rawMapped.first_samp;
+    const fiff_int_t last = rawMapped.last_samp;
+    QCOMPARE(last - first + 1, nsamp);
+
+    RowVectorXi sel = m_raw.info.pick_types(true, false, false);
+    QVERIFY(sel.size() > 0 && sel.size() < nchan);
+
+    MatrixXd matMapped, matStream, times;
+
+    // Calibrated samples of all channels
+    QVERIFY(rawMapped.read_raw_segment(matMapped, times, first, last));
+    QVERIFY(rawStream.read_raw_segment(matStream, times, first, last));
+    MatrixXd matExpected = rawMapped.cals.transpose().asDiagonal() * matValues;
+    QVERIFY((matMapped - matExpected).cwiseAbs().maxCoeff() <= dEpsilon * matExpected.cwiseAbs().maxCoeff());
+    QVERIFY(matMapped == matStream);
+
+    // A selection within and across buffers
+    QVERIFY(rawMapped.read_raw_segment(matMapped, times, first + m_iNSampBuffer / 2, last - 1, sel));
+    QVERIFY(rawStream.read_raw_segment(matStream, times, first + m_iNSampBuffer / 2, last - 1, sel));
+    QCOMPARE(int(matMapped.rows()), int(sel.size()));
+    QCOMPARE(int(matMapped.cols()), nsamp - m_iNSampBuffer / 2 - 1);
+    for(qint32 i = 0; i < sel.size(); ++i) {
+        QVERIFY(matMapped.row(i) == matExpected.row(sel[i]).segment(m_iNSampBuffer / 2, matMapped.cols()));
+    }
+    QVERIFY(matMapped == matStream);
+
+    // A selection with the projection applied
+    for(qint32 k = 0; k < rawMapped.info.projs.size(); ++k) {
+        rawMapped.info.projs[k].active = true;
+        rawStream.info.projs[k].active = true;
+    }
+    MatrixXd matProj;
+    QVERIFY(rawMapped.info.make_projector(matProj) > 0);
+    rawMapped.setProj(matProj);
+    rawStream.setProj(matProj);
+
+    QVERIFY(rawMapped.read_raw_segment(matMapped, times, first, last, sel));
+    QVERIFY(rawStream.read_raw_segment(matStream, times, first, last, sel));
+    MatrixXd matProjected = matProj * matExpected;
+    for(qint32 i = 0; i < sel.size(); ++i) {
+        QVERIFY((matMapped.row(i) - matProjected.row(sel[i])).cwiseAbs().maxCoeff() <= dEpsilon * matExpected.cwiseAbs().maxCoeff());
+    }
+    QVERIFY((matMapped - matStream).cwiseAbs().maxCoeff() <= dEpsilon * matExpected.cwiseAbs().maxCoeff());
+
+    // Single buffers with the projection applied
+    QVERIFY(rawMapped.read_raw_buffer(1, matMapped, sel));
+    QVERIFY(rawStream.read_raw_buffer(1, matStream, sel));
+    QCOMPARE(int(matMapped.cols()), m_iNSampBuffer);
+    QVERIFY((matMapped - matStream).cwiseAbs().maxCoeff() <= dEpsilon * matExpected.cwiseAbs().maxCoeff());
+
+    // Removing the projection again is picked up by the cached operators
+    rawMapped.setProj(MatrixXd());
+    QVERIFY(rawMapped.read_raw_segment(matMapped, times, first, last));
+    QVERIFY(matMapped == rawMapped.cals.transpose().asDiagonal() * matValues);
+}
+
+//=============================================================================================================
+
+void TestFiffRawData::cleanupTestCase()
+{
+}
+
+//=============================================================================================================
+
+void TestFiffRawData::writeRaw(QIODevice& device,
+                               fiff_int_t type,
+                               const MatrixXd& matValues)
+{
+    RowVectorXd cals;
+    FiffStream::SPtr pStream = FiffStream::start_writing_raw(device, m_raw.info, cals);
+    QVERIFY(!pStream.isNull());
+
+    for(qint32 b = 0; b < m_iNBuffers; ++b) {
+        MatrixXd matBuffer = matValues.middleCols(b * m_iNSampBuffer, m_iNSampBuffer);
+        const fiff_int_t nel = matBuffer.size();
+
+        switch(type) {
+            case FIFFT_SHORT:
+            case FIFFT_DAU_PACK16: {
+                *pStream << (qint32)FIFF_DATA_BUFFER;
+                *pStream << (qint32)type;
+                *pStream << (qint32)(nel * 2);
+                *pStream << (qint32)FIFFV_NEXT_SEQ;
+                for(fiff_int_t i = 0; i < nel; ++i) {
+                    *pStream << (qint16)matBuffer.data()[i];
+                }
+                break;
+            }
+            case FIFFT_INT: {
+                VectorXi vecBuffer = Map<VectorXd>(matBuffer.data(), nel).cast<int>();
+                pStream->write_int(FIFF_DATA_BUFFER, vecBuffer.data(), nel);
+                break;
+            }
+            case FIFFT_FLOAT: {
+                VectorXf vecBuffer = Map<VectorXd>(matBuffer.data(), nel).cast<float>();
+                pStream->write_float(FIFF_DATA_BUFFER, vecBuffer.data(), nel);
+                break;
+            }
+        }
+    }
+
+    pStream->finish_writing_raw();
+}
+
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+QTEST_GUILESS_MAIN(TestFiffRawData)
+#include "test_fiff_raw_data.moc"
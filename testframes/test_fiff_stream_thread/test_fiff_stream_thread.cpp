@@ -0,0 +1,283 @@
+//=============================================================================================================
+/**
+ * @file     test_fiff_stream_thread.cpp
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @since    0.1.0
+ * @date     October, 2026
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2026, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief    The FiffStreamThread send queue test implementation
+ *
+ */
+
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include "fiffstreamthread.h"
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QtTest>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace RTSERVER;
+
+//=============================================================================================================
+/**
+ * Gives the test access to the send queue of a FiffStreamThread, which is never started.
+ */
+class FiffStreamThreadQueue : public FiffStreamThread
+{
+public:
+    FiffStreamThreadQueue(qint32 id)
+    : FiffStreamThread(id, -1, Q_NULLPTR)
+    {
+    }
+
+    using FiffStreamThread::SendFrame;
+    using FiffStreamThread::flushSendQueue;
+    using FiffStreamThread::startMeas;
+    using FiffStreamThread::stopMeas;
+    using FiffStreamThread::m_qSendQueue;
+};
+
+Q_DECLARE_METATYPE(FiffStreamThread::SlowClientPolicy)
+
+//=============================================================================================================
+/**
+ * DECLARE CLASS TestFiffStreamThread
+ *
+ * @brief The TestFiffStreamThread class provides tests of the bounded per client send queue of mne_rt_server
+ *
+ */
+class TestFiffStreamThread: public QObject
+{
+    Q_OBJECT
+
+public:
+    TestFiffStreamThread();
+
+private slots:
+    void initTestCase();
+    void rawBufferSending();
+    void slowClientPolicy_data();
+    void slowClientPolicy();
+    void coalesceControlFramesOnly();
+    void statistics();
+    void cleanupTestCase();
+
+private:
+    QList<QByteArray> queuedRawBuffers(const FiffStreamThreadQueue& thread);
+
+    qint32 m_iClientId;
+};
+
+//=============================================================================================================
+
+TestFiffStreamThread::TestFiffStreamThread()
+: m_iClientId(7)
+{
+}
+
+//=============================================================================================================
+
+void TestFiffStreamThread::initTestCase()
+{
+}
+
+//=============================================================================================================
+
+void TestFiffStreamThread::rawBufferSending()
+{
+    // Raw buffers are only queued between the start and the end block
+    FiffStreamThreadQueue thread(m_iClientId);
+
+    thread.sendRawBuffer("before");
+    QCOMPARE(thread.getStatistics().iQueuedFrames, 0);
+
+    thread.startMeas(m_iClientId + 1);
+    thread.sendRawBuffer("other client");
+    QCOMPARE(thread.getStatistics().iQueuedFrames, 0);
+
+    thread.startMeas(m_iClientId);
+    thread.sendRawBuffer("during");
+    thread.stopMeas(m_iClientId);
+    thread.sendRawBuffer("after");
+
+    QCOMPARE(thread.m_qSendQueue.size(), 3);
+    QVERIFY(!thread.m_qSendQueue.at(0).bIsRawBuffer);
+    QCOMPARE(thread.m_qSendQueue.at(1).blockData, QByteArray("during"));
+    QVERIFY(!thread.m_qSendQueue.at(2).bIsRawBuffer);
+    QCOMPARE(thread.getStatistics().iFramesDropped, qint64(0));
+}
+
+//=============================================================================================================
+
+void TestFiffStreamThread::slowClientPolicy_data()
+{
+    QTest::addColumn<FiffStreamThread::SlowClientPolicy>("policy");
+    QTest::addColumn<QList<QByteArray> >("lExpected");
+    QTest::addColumn<int>("iExpectedSignals");
+
+    QTest::newRow("drop newest") << FiffStreamThread::DropNewest << (QList<QByteArray>() << "1" << "2" << "3") << 1;
+    QTest::newRow("coalesce") << FiffStreamThread::Coalesce << (QList<QByteArray>() << "4" << "5" << "6") << 1;
+    QTest::newRow("disconnect") << FiffStreamThread::Disconnect << (QList<QByteArray>() << "1" << "2" << "3") << 2;
+}
+
+//=============================================================================================================
+
+void TestFiffStreamThread::slowClientPolicy()
+{
+    // Fill the queue of 4 frames, the start block and 3 raw buffers, then send 3 more raw buffers
+    QFETCH(FiffStreamThread::SlowClientPolicy, policy);
+    QFETCH(QList<QByteArray>, lExpected);
+    QFETCH(int, iExpectedSignals);
+
+    FiffStreamThreadQueue thread(m_iClientId);
+    thread.setSlowClientPolicy(policy);
+    thread.setMaxQueuedFrames(4);
+
+    QSignalSpy spy(&thread, &FiffStreamThread::sendQueueFilled);
+
+    thread.startMeas(m_iClientId);
+    for(int i = 1; i <= 6; ++i) {
+        thread.sendRawBuffer(QByteArray::number(i));
+    }
+
+    QCOMPARE(thread.getStatistics().iQueuedFrames, 4);
+    QCOMPARE(thread.getStatistics().iFramesDropped, qint64(3));
+    QVERIFY(!thread.m_qSendQueue.head().bIsRawBuffer);
+    QCOMPARE(queuedRawBuffers(thread), lExpected);
+
+    // The queue filled signal is emitted once for the empty queue and once for the disconnect request
+    QCOMPARE(spy.count(), iExpectedSignals);
+
+    // Control frames are never dropped
+    thread.stopMeas(m_iClientId);
+    QCOMPARE(thread.getStatistics().iQueuedFrames, 5);
+    QVERIFY(!thread.m_qSendQueue.last().bIsRawBuffer);
+    QCOMPARE(thread.getStatistics().iFramesDropped, qint64(3));
+}
+
+//=============================================================================================================
+
+void TestFiffStreamThread::coalesceControlFramesOnly()
+{
+    // Without a raw buffer in the full queue the new raw buffer is dropped
+    FiffStreamThreadQueue thread(m_iClientId);
+    thread.setSlowClientPolicy(FiffStreamThread::Coalesce);
+    thread.setMaxQueuedFrames(1);
+
+    thread.startMeas(m_iClientId);
+    thread.sendRawBuffer("1");
+
+    QCOMPARE(thread.getStatistics().iQueuedFrames, 1);
+    QCOMPARE(thread.getStatistics().iFramesDropped, qint64(1));
+    QVERIFY(queuedRawBuffers(thread).isEmpty());
+}
+
+//=============================================================================================================
+
+void TestFiffStreamThread::statistics()
+{
+    // Flush the queue into a loopback connection, the frames have to arrive in order and be counted
+    QTcpServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    QTcpSocket socket;
+    socket.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    QVERIFY(socket.waitForConnected(5000));
+    QVERIFY(server.waitForNewConnection(5000));
+    QTcpSocket* pPeer = server.nextPendingConnection();
+    QVERIFY(pPeer != Q_NULLPTR);
+
+    FiffStreamThreadQueue thread(m_iClientId);
+    thread.startMeas(m_iClientId);
+    for(int i = 0; i < 10; ++i) {
+        thread.sendRawBuffer(QByteArray(100 + i, char('a' + i)));
+    }
+
+    QByteArray expected;
+    for(int i = 0; i < thread.m_qSendQueue.size(); ++i) {
+        expected.append(thread.m_qSendQueue.at(i).blockData);
+    }
+
+    QTest::qSleep(50);
+    thread.flushSendQueue(socket);
+    QVERIFY(socket.waitForBytesWritten(5000) || socket.bytesToWrite() == 0);
+
+    QByteArray received;
+    while(received.size() < expected.size() && pPeer->waitForReadyRead(5000)) {
+        received.append(pPeer->readAll());
+    }
+
+    QCOMPARE(received, expected);
+
+    FiffStreamThread::ClientStatistics stats = thread.getStatistics();
+    QCOMPARE(stats.iFramesSent, qint64(11));
+    QCOMPARE(stats.iBytesSent, qint64(expected.size()));
+    QCOMPARE(stats.iQueuedFrames, 0);
+    QCOMPARE(stats.iFramesDropped, qint64(0));
+    QVERIFY(stats.iMaxLagMs >= 40);
+    QVERIFY(stats.dMeanLagMs >= 40.0);
+    QVERIFY(stats.dMeanLagMs <= stats.iMaxLagMs);
+}
+
+//=============================================================================================================
+
+void TestFiffStreamThread::cleanupTestCase()
+{
+}
+
+//=============================================================================================================
+
+QList<QByteArray> TestFiffStreamThread::queuedRawBuffers(const FiffStreamThreadQueue& thread)
+{
+    QList<QByteArray> lRawBuffers;
+
+    for(int i = 0; i < thread.m_qSendQueue.size(); ++i) {
+        if(thread.m_qSendQueue.at(i).bIsRawBuffer) {
+            lRawBuffers.append(thread.m_qSendQueue.at(i).blockData);
+        }
+    }
+
+    return lRawBuffers;
+}
+
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+QTEST_GUILESS_MAIN(TestFiffStreamThread)
+#include "test_fiff_stream_thread.moc"
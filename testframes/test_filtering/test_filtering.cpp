@@ -84,6 +84,7 @@ private slots:
     void initTestCase();
     void compareData();
     void compareTimes();
+    void compareStreamingEngine();
     void cleanupTestCase();
 
 private:
@@ -231,6 +232,66 @@ void TestFiltering::compareTimes()
     QVERIFY( mTimesDiff.sum() < dEpsilon );
 }
 
+//=============================================================================================================
+
+void TestFiltering::compareStreamingEngine()
+{
+    // Filtering a stream block by block must give the same result as filtering it in one go, also when the block
+    // size changes during the stream
+    int iNumRows = 8;
+    int iNumSamples = 5000;
+    double dSFreq = 600.0;
+
+    std::srand(42);
+    MatrixXd matData = MatrixXd::Random(iNumRows, iNumSamples);
+
+    FilterKernel kernel("engine_test",
+                        FilterKernel::BPF,
+                        256,
+                        10.0/(dSFreq/2.0),
+                        10.0/(dSFreq/2.0),
+                        1.0/(dSFreq/2.0),
+                        dSFreq,
+                        FilterKernel::Cosine);
+
+    // Rows 4 and 6 are not picked and only delayed
+    RowVectorXi vecPicks(6);
+    vecPicks << 0, 1, 2, 3, 5, 7;
+
+    MatrixXd matOneShot = RTPROCESSINGLIB::filterDataBlock(matData,
+                                                           vecPicks,
+                                                           kernel);
+
+    // The engine is set up for 100 samples, larger blocks grow the FFT length in the middle of the stream. The block
+    // of 50 samples is shorter than the filter order.
+    QList<int> lBlockSizes({100, 100, 700, 50, 1500, 300, 2250});
+
+    FilterEngine engine;
+    engine.setup(kernel,
+                 iNumRows,
+                 lBlockSizes.first(),
+                 vecPicks);
+
+    MatrixXd matStreamed(iNumRows, iNumSamples);
+    MatrixXd matBlock;
+    int iStart = 0;
+
+    for(int iBlockSize : lBlockSizes) {
+        matBlock = matData.middleCols(iStart, iBlockSize);
+        engine.filter(matBlock);
+        matStreamed.middleCols(iStart, iBlockSize) = matBlock;
+        iStart += iBlockSize;
+    }
+
+    QCOMPARE(iStart, iNumSamples);
+    QVERIFY((matStreamed - matOneShot.leftCols(iNumSamples)).cwiseAbs().maxCoeff() < dEpsilon);
+
+    // What is left in the overlap is the end of the one shot convolution
+    QVERIFY((engine.getOverlap() - matOneShot.rightCols(matOneShot.cols() - iNumSamples)).cwiseAbs().maxCoeff() < dEpsilon);
+}
+
+//=============================================================================================================
+
 void TestFiltering::cleanupTestCase()
 {
 }
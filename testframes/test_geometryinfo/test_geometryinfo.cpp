@@ -86,6 +86,7 @@ private slots:
     void testEmptyInputsForProjecting();
     void testEmptyInputsForSCDC();
     void testDimensionsForSCDC();
+    void testSparseSCDC();
     void cleanupTestCase();
 
 private:
@@ -204,6 +205,31 @@ void TestGeometryInfo::testDimensionsForSCDC() {
 
 //=============================================================================================================
 
+void TestGeometryInfo::testSparseSCDC() {
+    const double dCancelDist = 0.03;
+    // vertex IDs of the small subset are valid on the real surface as well
+    QVector<int> vSubset = vSmallSubset;
+    QSharedPointer<MatrixXd> pDistTable = GeometryInfo::scdc(realSurface.rr, realSurface.neighbor_vert, vSubset, dCancelDist);
+    QSharedPointer<SparseMatrix<double, RowMajor> > pSparseDistTable = GeometryInfo::scdcSparse(realSurface.rr, realSurface.neighbor_vert, vSubset, dCancelDist);
+
+    QVERIFY(pSparseDistTable->rows() == pDistTable->rows());
+    QVERIFY(pSparseDistTable->cols() == pDistTable->cols());
+
+    // the sparse table holds exactly the distances up to the cancel distance
+    qint64 iWithinCancelDist = 0;
+    for (qint32 col = 0; col < pDistTable->cols(); ++col) {
+        for (qint32 row = 0; row < pDistTable->rows(); ++row) {
+            if (pDistTable->coeff(row, col) <= dCancelDist) {
+                iWithinCancelDist++;
+                QVERIFY(std::fabs(pSparseDistTable->coeff(row, col) - pDistTable->coeff(row, col)) < 1e-12);
+            }
+        }
+    }
+    QVERIFY(pSparseDistTable->nonZeros() == iWithinCancelDist);
+}
+
+//=============================================================================================================
+
 void TestGeometryInfo::cleanupTestCase() {
 }
 
@@ -98,6 +98,7 @@ private slots:
     void compareMove();
     void compareDetect();
     void compareTime();
+    void trackSimulated();
     void cleanupTestCase();
 
 private:
@@ -106,11 +107,41 @@ private:
     double dErrorTime = 0.00000001;
     double dErrorAngle = 0.1;
     double dErrorDetect = 0;
+    double dErrorSim = 0.0005;
     MatrixXd mRefPos;
     MatrixXd mHpiPos;
     MatrixXd mRefResult;
     MatrixXd mHpiResult;
     QVector<int> vFreqs;
+    QSharedPointer<FiffInfo> m_pFiffInfoSim;
+};
+
+//=============================================================================================================
+/**
+ * Gives access to the sensor set of the HPI fit, so that data can be simulated for the same sensors.
+ */
+class HPIFitSensors : public HPIFit
+{
+public:
+    explicit HPIFitSensors(QSharedPointer<FiffInfo> pFiffInfo)
+    : HPIFit(pFiffInfo)
+    {
+    }
+
+    const SensorSet& sensors() const
+    {
+        return m_sensors;
+    }
+};
+
+//=============================================================================================================
+/**
+ * Gives access to the magnetic dipole forward model of the HPI fit.
+ */
+class HPIFitForward : public HPIFitData
+{
+public:
+    using HPIFitData::compute_leadfield;
 };
 
 //=============================================================================================================
@@ -139,6 +170,9 @@ void TestHpiFit::initTestCase()
     raw = FiffRawData(t_fileIn);
     QSharedPointer<FiffInfo> pFiffInfo = QSharedPointer<FIFFLIB::FiffInfo>(new FiffInfo(raw.info));
 
+    // Keep an untouched copy for the simulation, the fits below overwrite dev_head_t
+    m_pFiffInfoSim = QSharedPointer<FIFFLIB::FiffInfo>(new FiffInfo(raw.info));
+
     // Only filter MEG channels
     RowVectorXi picks = raw.info.pick_types(true, false, false);
     RowVectorXd cals;
@@ -319,6 +353,115 @@ void TestHpiFit::compareTime()
 
 //=============================================================================================================
 
+void TestHpiFit::trackSimulated()
+{
+    // Simulate the coils of the measurement as magnetic dipoles while the head moves and track them. The first
+    // window is fitted from the seed points, the following ones warm start from the previous fit.
+    QSharedPointer<FiffInfo> pFiffInfo = m_pFiffInfoSim;
+    FiffCoordTrans transTruth = pFiffInfo->dev_head_t;
+
+    QList<FiffDigPoint> lHPIPoints;
+    for(int i = 0; i < pFiffInfo->dig.size(); ++i) {
+        if(pFiffInfo->dig[i].kind == FIFFV_POINT_HPI) {
+            lHPIPoints.append(pFiffInfo->dig[i]);
+        }
+    }
+    int iNumCoils = lHPIPoints.size();
+    QVERIFY(iNumCoils > 0);
+
+    MatrixX3f matHeadHPI(iNumCoils,3);
+    for(int i = 0; i < iNumCoils; ++i) {
+        matHeadHPI.row(i) << lHPIPoints.at(i).r[0], lHPIPoints.at(i).r[1], lHPIPoints.at(i).r[2];
+    }
+    MatrixXd matCoilDev = transTruth.apply_inverse_trans(matHeadHPI).cast<double>();
+
+    // The inner channels in the order of the sensor set
+    QVector<int> vecInnerind;
+    for(int i = 0; i < pFiffInfo->nchan; ++i) {
+        int iCoilType = pFiffInfo->chs[i].chpos.coil_type;
+        if((iCoilType == FIFFV_COIL_BABY_MAG ||
+            iCoilType == FIFFV_COIL_VV_PLANAR_T1 ||
+            iCoilType == FIFFV_COIL_VV_PLANAR_T2 ||
+            iCoilType == FIFFV_COIL_VV_PLANAR_T3) &&
+           !pFiffInfo->bads.contains(pFiffInfo->ch_names.at(i))) {
+            vecInnerind.append(i);
+        }
+    }
+
+    HPIFitSensors HPI(pFiffInfo);
+    HPIFitForward forward;
+    QCOMPARE(HPI.sensors().ncoils, vecInnerind.size());
+
+    // The head moves 1 mm per window
+    QVector<int> vecFreqs {154,158,161,166};
+    int iWindowSize = ceil(0.2 * pFiffInfo->sfreq);
+    int iNumWindows = 5;
+    RowVector3d vecShift(0.001, 0.0005, 0.0);
+    float fTimeOffset = 1.5f;
+
+    MatrixXd matData = MatrixXd::Zero(pFiffInfo->nchan, iNumWindows * iWindowSize);
+    QList<MatrixXd> lCoilTruth;
+
+    for(int w = 0; w < iNumWindows; ++w) {
+        MatrixXd matCoils = matCoilDev.rowwise() + w * vecShift;
+        lCoilTruth.append(matCoils);
+
+        for(int c = 0; c < iNumCoils; ++c) {
+            Vector3d vecMom = 1e-8 * matCoils.row(c).normalized().transpose();
+            VectorXd vecField = forward.compute_leadfield(matCoils.row(c), HPI.sensors()) * vecMom;
+
+            for(int s = w * iWindowSize; s < (w + 1) * iWindowSize; ++s) {
+                double dSin = sin(2.0 * M_PI * vecFreqs[c] * s / pFiffInfo->sfreq);
+                for(int i = 0; i < vecInnerind.size(); ++i) {
+                    matData(vecInnerind[i],s) += vecField(i) * dSin;
+                }
+            }
+        }
+    }
+
+    MatrixXd matProjectors = MatrixXd::Identity(pFiffInfo->nchan, pFiffInfo->nchan);
+    FiffCoordTrans transDevHead;
+    transDevHead.from = 1;
+    transDevHead.to = 4;
+
+    QList<HpiFitResult> lResults = HPI.trackHPI(matData,
+                                                matProjectors,
+                                                iWindowSize,
+                                                iWindowSize,
+                                                fTimeOffset,
+                                                transDevHead,
+                                                vecFreqs,
+                                                pFiffInfo);
+
+    QCOMPARE(lResults.size(), iNumWindows);
+
+    for(int w = 0; w < iNumWindows; ++w) {
+        const HpiFitResult& fitResult = lResults.at(w);
+
+        QVERIFY(std::abs(fitResult.fTime - (fTimeOffset + w * iWindowSize / pFiffInfo->sfreq)) < 1e-5);
+        QCOMPARE(fitResult.fittedCoils.size(), iNumCoils);
+
+        for(int c = 0; c < iNumCoils; ++c) {
+            Vector3d vecFitted(fitResult.fittedCoils[c].r[0], fitResult.fittedCoils[c].r[1], fitResult.fittedCoils[c].r[2]);
+            double dDist = (vecFitted - lCoilTruth.at(w).row(c).transpose()).norm();
+            qDebug() << "Window" << w << "coil" << c << "distance to the truth [m]" << dDist;
+            QVERIFY(dDist < dErrorSim);
+            QVERIFY(fitResult.errorDistances.at(c) < dErrorSim);
+        }
+
+        // The true dev head transformation of the moved head
+        Matrix4f matMove = Matrix4f::Identity();
+        matMove.block(0,3,3,1) = -w * vecShift.transpose().cast<float>();
+        FiffCoordTrans transMoved = transTruth;
+        transMoved.trans = transTruth.trans * matMove;
+
+        QVERIFY(transMoved.translationTo(fitResult.devHeadTrans.trans) < dErrorSim);
+        QVERIFY(transMoved.angleTo(fitResult.devHeadTrans.trans) < dErrorAngle);
+    }
+}
+
+//=============================================================================================================
+
 void TestHpiFit::cleanupTestCase()
 {
 }
@@ -85,6 +85,7 @@ private slots:
     void testDimensionsForInterpolation();
     void testSumOfRow();
     void testEmptyInputsForWeightMatrix();
+    void testSparseDistanceTable();
     void cleanupTestCase();
 
 private:
@@ -248,6 +249,46 @@ void TestInterpolation::testEmptyInputsForWeightMatrix()
 
 //=============================================================================================================
 
+void TestInterpolation::testSparseDistanceTable()
+{
+    QVector<int> vMappedSubSet = GeometryInfo::projectSensors(realSurface.rr,
+                                                              vMegSensors);
+
+    // dense and sparse distance table with cancel distance 0.05 m and filtered bad channels
+    QSharedPointer<MatrixXd> pDistanceMatrix = GeometryInfo::scdc(realSurface.rr,
+                                                                  realSurface.neighbor_vert,
+                                                                  vMappedSubSet,
+                                                                  0.05);
+    GeometryInfo::filterBadChannels(pDistanceMatrix,
+                                    evoked.info,
+                                    FIFFV_MEG_CH);
+
+    QSharedPointer<SparseMatrix<double, RowMajor> > pSparseDistanceMatrix = GeometryInfo::scdcSparse(realSurface.rr,
+                                                                                                     realSurface.neighbor_vert,
+                                                                                                     vMappedSubSet,
+                                                                                                     0.05);
+    GeometryInfo::filterBadChannels(pSparseDistanceMatrix,
+                                    evoked.info,
+                                    FIFFV_MEG_CH);
+
+    // both tables have to result in the same weight matrix
+    QSharedPointer<SparseMatrix<float> > pW = Interpolation::createInterpolationMat(vMappedSubSet,
+                                                                                    pDistanceMatrix,
+                                                                                    Interpolation::cubic,
+                                                                                    0.05);
+    QSharedPointer<SparseMatrix<float> > pSparseW = Interpolation::createInterpolationMat(vMappedSubSet,
+                                                                                          pSparseDistanceMatrix,
+                                                                                          Interpolation::cubic,
+                                                                                          0.05);
+
+    QVERIFY(pSparseW->rows() == pW->rows());
+    QVERIFY(pSparseW->cols() == pW->cols());
+    QVERIFY(pSparseW->nonZeros() == pW->nonZeros());
+    QVERIFY((MatrixXf(*pSparseW) - MatrixXf(*pW)).cwiseAbs().maxCoeff() < 1e-6f);
+}
+
+//=============================================================================================================
+
 void TestInterpolation::cleanupTestCase()
 {
 }
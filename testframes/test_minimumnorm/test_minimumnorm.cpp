@@ -0,0 +1,223 @@
+//=============================================================================================================
+/**
+ * @file     test_minimumnorm.cpp
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @since    0.1.0
+ * @date     October, 2026
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2026, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief    The MinimumNorm test implementation
+ *
+ */
+
+
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <utils/generics/applicationlogger.h>
+#include <utils/mnemath.h>
+
+#include <fiff/fiff_cov.h>
+#include <fiff/fiff_evoked.h>
+#include <fs/label.h>
+#include <mne/mne_forwardsolution.h>
+#include <mne/mne_inverse_operator.h>
+#include <mne/mne_sourceestimate.h>
+#include <inverse/minimumNorm/minimumnorm.h>
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QtTest>
+
+//=============================================================================================================
+// EIGEN INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Dense>
+#include <Eigen/SparseCore>
+
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace FIFFLIB;
+using namespace MNELIB;
+using namespace INVERSELIB;
+using namespace UTILSLIB;
+using namespace Eigen;
+
+//=============================================================================================================
+/**
+ * DECLARE CLASS TestMinimumNorm
+ *
+ * @brief The TestMinimumNorm class checks the one-pass application of the minimum norm kernel
+ *
+ */
+class TestMinimumNorm: public QObject
+{
+    Q_OBJECT
+
+public:
+    TestMinimumNorm();
+
+private slots:
+    void initTestCase();
+    void applyInverse_data();
+    void applyInverse();
+    void cleanupTestCase();
+
+private:
+    FiffEvoked m_evoked;
+    MNEInverseOperator m_inverseOperator;
+};
+
+//=============================================================================================================
+
+TestMinimumNorm::TestMinimumNorm()
+{
+}
+
+//=============================================================================================================
+
+void TestMinimumNorm::initTestCase()
+{
+    qInstallMessageHandler(UTILSLIB::ApplicationLogger::customLogWriter);
+
+    QFile fileEvoked(QCoreApplication::applicationDirPath() + "/mne-cpp-test-data/MEG/sample/sample_audvis-ave.fif");
+    QFile fileFwd(QCoreApplication::applicationDirPath() + "/mne-cpp-test-data/Result/ref-sample_audvis-meg-eeg-oct-6-fwd.fif");
+    QFile fileCov(QCoreApplication::applicationDirPath() + "/mne-cpp-test-data/MEG/sample/sample_audvis-cov.fif");
+
+    m_evoked = FiffEvoked(fileEvoked, 0, QPair<float,float>(-1.0f, -1.0f));
+    QVERIFY(!m_evoked.isEmpty());
+
+    MNEForwardSolution forward(fileFwd, false, true);
+    FiffCov noiseCov(fileCov);
+    noiseCov = noiseCov.regularize(m_evoked.info, 0.05, 0.05, 0.1, true);
+
+    // A loose orientation constraint leaves three current components per source to combine
+    m_inverseOperator = MNEInverseOperator(m_evoked.info, forward, noiseCov, 0.2f, 0.8f);
+    QCOMPARE(m_inverseOperator.source_ori, FIFFV_MNE_FREE_ORI);
+}
+
+//=============================================================================================================
+
+void TestMinimumNorm::applyInverse_data()
+{
+    QTest::addColumn<QString>("method");
+    QTest::addColumn<bool>("bPickNormal");
+
+    QTest::newRow("MNE") << "MNE" << false;
+    QTest::newRow("dSPM") << "dSPM" << false;
+    QTest::newRow("sLORETA") << "sLORETA" << false;
+    QTest::newRow("dSPM normal") << "dSPM" << true;
+    QTest::newRow("sLORETA normal") << "sLORETA" << true;
+}
+
+//=============================================================================================================
+
+void TestMinimumNorm::applyInverse()
+{
+    QFETCH(QString, method);
+    QFETCH(bool, bPickNormal);
+
+    MinimumNorm minimumNorm(m_inverseOperator, 1.0f / 9.0f, method);
+    minimumNorm.doInverseSetup(m_evoked.nave, bPickNormal);
+
+    MNEInverseOperator inv = minimumNorm.getPreparedInverseOperator();
+    MatrixXd matData = m_evoked.pick_channels(inv.noise_cov->names).data;
+    float tmin = m_evoked.times[0];
+    float tstep = 1.0f / m_evoked.info.sfreq;
+
+    // The kernel without the noise normalization, applied sample by sample as before
+    MatrixXd matKernel;
+    SparseMatrix<double> noiseNorm;
+    QList<VectorXi> vertno;
+    QVERIFY(inv.assemble_kernel(FSLIB::Label(), method, bPickNormal, matKernel, noiseNorm, vertno));
+
+    MatrixXd matRef = matKernel * matData;
+    if(!bPickNormal) {
+        MatrixXd matCombined(matRef.rows() / 3, matRef.cols());
+        for(int i = 0; i < matRef.cols(); ++i) {
+            VectorXd* pVecXyz = MNEMath::combine_xyz(matRef.col(i));
+            matCombined.col(i) = pVecXyz->cwiseSqrt();
+            delete pVecXyz;
+        }
+        matRef = matCombined;
+    }
+    if(method != "MNE") {
+        matRef = inv.noisenorm * matRef;
+    }
+
+    // The noise normalization is part of the assembled kernel
+    QCOMPARE(int(minimumNorm.getKernel().rows()), int(matKernel.rows()));
+    if(bPickNormal) {
+        QVERIFY((minimumNorm.getKernel() * matData - matRef).norm() / matRef.norm() < 1e-10);
+    }
+
+    // All samples in one pass
+    MatrixXd matSol;
+    QVERIFY(minimumNorm.applyInverse(matData, matSol, bPickNormal));
+    QCOMPARE(int(matSol.rows()), int(matRef.rows()));
+    QCOMPARE(int(matSol.cols()), int(matRef.cols()));
+    QVERIFY((matSol - matRef).norm() / matRef.norm() < 1e-10);
+
+    // A stream of blocks, which are not multiples of the combining block, reuses one source estimate
+    int iBlockSize = 100;
+    MNESourceEstimate sourceEstimate;
+    const double* pSolData = Q_NULLPTR;
+    for(int start = 0; start + iBlockSize <= matData.cols(); start += iBlockSize) {
+        QVERIFY(minimumNorm.applyInverse(matData.middleCols(start, iBlockSize), sourceEstimate, tmin + start * tstep, tstep, bPickNormal));
+
+        if(pSolData) {
+            QVERIFY(sourceEstimate.data.data() == pSolData);
+        }
+        pSolData = sourceEstimate.data.data();
+
+        QVERIFY((sourceEstimate.data - matRef.middleCols(start, iBlockSize)).norm() / matRef.middleCols(start, iBlockSize).norm() < 1e-10);
+        QCOMPARE(int(sourceEstimate.times.size()), iBlockSize);
+        QVERIFY(qAbs(sourceEstimate.tmin - (tmin + start * tstep)) < 1e-6f);
+        QVERIFY(qAbs(sourceEstimate.times[iBlockSize - 1] - (tmin + (start + iBlockSize - 1) * tstep)) < 1e-6f);
+    }
+
+    // Data which does not match the kernel is rejected
+    QVERIFY(!minimumNorm.applyInverse(matData.topRows(matData.rows() - 1), matSol, bPickNormal));
+}
+
+//=============================================================================================================
+
+void TestMinimumNorm::cleanupTestCase()
+{
+}
+
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+QTEST_GUILESS_MAIN(TestMinimumNorm)
+#include "test_minimumnorm.moc"
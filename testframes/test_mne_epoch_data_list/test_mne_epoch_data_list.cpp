@@ -0,0 +1,323 @@
+//=============================================================================================================
+/**
+ * @file     test_mne_epoch_data_list.cpp
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @since    0.1.0
+ * @date     October, 2026
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2026, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief    The MNEEpochDataList test implementation
+ *
+ */
+
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <utils/generics/applicationlogger.h>
+
+#include <fiff/fiff.h>
+
+#include <mne/mne_epoch_data_list.h>
+
+#include <algorithm>
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QtTest>
+
+//=============================================================================================================
+// EIGEN INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace FIFFLIB;
+using namespace MNELIB;
+using namespace Eigen;
+
+//=============================================================================================================
+/**
+ * DECLARE CLASS TestMneEpochDataList
+ *
+ * @brief The TestMneEpochDataList class compares the batched epoch tensor with epochs read segment by segment
+ *
+ */
+class TestMneEpochDataList: public QObject
+{
+    Q_OBJECT
+
+public:
+    TestMneEpochDataList();
+
+private slots:
+    void initTestCase();
+    void compareTensor_data();
+    void compareTensor();
+    void failedBuffer();
+    void cleanupTestCase();
+
+private:
+    void readReference(const FiffRawData& raw,
+                       const RowVectorXi& picks,
+                       QList<MatrixXd>& lEpochs,
+                       QList<bool>& lRejected,
+                       QList<int>& lEvents);
+
+    void compareEpochs(const MNEEpochTensor& tensor,
+                       const QList<MatrixXd>& lEpochs,
+                       const QList<bool>& lRejected,
+                       const QList<int>& lEvents);
+
+    double dEpsilon;
+
+    QFile m_fileRaw;
+    FiffRawData m_raw;
+    MatrixXi m_matEvents;
+    qint32 m_iEvent;
+    float m_fTMin;
+    float m_fTMax;
+    QMap<QString,double> m_mapReject;
+};
+
+//=============================================================================================================
+
+TestMneEpochDataList::TestMneEpochDataList()
+: dEpsilon(1e-10)
+, m_fileRaw(QCoreApplication::applicationDirPath() + "/mne-cpp-test-data/MEG/sample/sample_audvis_trunc_raw.fif")
+, m_iEvent(1)
+, m_fTMin(-0.1f)
+, m_fTMax(0.4f)
+{
+}
+
+//=============================================================================================================
+
+void TestMneEpochDataList::initTestCase()
+{
+    qInstallMessageHandler(UTILSLIB::ApplicationLogger::customLogWriter);
+
+    // The raw data keeps reading from the file, it has to stay open for all tests
+    m_raw = FiffRawData(m_fileRaw);
+    QVERIFY(m_raw.rawdir.size() > 2);
+
+    // Events every 0.2 s, so that consecutive epochs of 0.5 s overlap. The first event starts before the data, every
+    // third event is of another kind and one event has a non zero previous value.
+    const int iStep = int(0.2 * m_raw.info.sfreq);
+    const int iNEvents = (m_raw.last_samp - m_raw.first_samp) / iStep + 1;
+
+    m_matEvents.resize(iNEvents, 3);
+    for (int i = 0; i < iNEvents; ++i) {
+        m_matEvents(i, 0) = m_raw.first_samp + i * iStep;
+        m_matEvents(i, 1) = i == 4 ? 1 : 0;
+        m_matEvents(i, 2) = i % 3 == 2 ? 2 : m_iEvent;
+    }
+
+    // Reject at the median EOG peak to peak value, so that some epochs are rejected and some are kept
+    qint32 iEog = -1;
+    for (int i = 0; i < m_raw.info.chs.size(); ++i) {
+        if (m_raw.info.chs.at(i).kind == FIFFV_EOG_CH && !m_raw.info.bads.contains(m_raw.info.chs.at(i).ch_name)) {
+            iEog = i;
+            break;
+        }
+    }
+    QVERIFY(iEog >= 0);
+
+    QList<MatrixXd> lEpochs;
+    QList<bool> lRejected;
+    QList<int> lEvents;
+    readReference(m_raw, RowVectorXi(), lEpochs, lRejected, lEvents);
+    QVERIFY(lEpochs.size() > 4);
+
+    std::vector<double> vecPeakToPeak;
+    for (int i = 0; i < lEpochs.size(); ++i) {
+        vecPeakToPeak.push_back(lEpochs.at(i).row(iEog).maxCoeff() - lEpochs.at(i).row(iEog).minCoeff());
+    }
+    std::sort(vecPeakToPeak.begin(), vecPeakToPeak.end());
+
+    m_mapReject.insert("eog", vecPeakToPeak.at(vecPeakToPeak.size() / 2));
+}
+
+//=============================================================================================================
+
+void TestMneEpochDataList::compareTensor_data()
+{
+    QTest::addColumn<bool>("bPickAll");
+
+    QTest::newRow("all channels") << true;
+    QTest::newRow("picked channels") << false;
+}
+
+//=============================================================================================================
+
+void TestMneEpochDataList::compareTensor()
+{
+    QFETCH(bool, bPickAll);
+
+    QStringList include;
+    include << "EOG 061";
+    RowVectorXi picks = bPickAll ? RowVectorXi() : m_raw.info.pick_types(true, false, false, include, m_raw.info.bads);
+
+    QList<MatrixXd> lEpochs;
+    QList<bool> lRejected;
+    QList<int> lEvents;
+    readReference(m_raw, picks, lEpochs, lRejected, lEvents);
+
+    QVERIFY(lRejected.contains(true));
+    QVERIFY(lRejected.contains(false));
+
+    MNEEpochTensor tensor = MNEEpochDataList::readEpochTensor(m_raw,
+                                                              m_matEvents,
+                                                              m_fTMin,
+                                                              m_fTMax,
+                                                              m_iEvent,
+                                                              m_mapReject,
+                                                              QStringList(),
+                                                              picks);
+    compareEpochs(tensor, lEpochs, lRejected, lEvents);
+
+    // The list is split from the tensor
+    MNEEpochDataList data = MNEEpochDataList::readEpochs(m_raw,
+                                                         m_matEvents,
+                                                         m_fTMin,
+                                                         m_fTMax,
+                                                         m_iEvent,
+                                                         m_mapReject,
+                                                         QStringList(),
+                                                         picks);
+    QCOMPARE(data.size(), lEpochs.size());
+
+    for (int i = 0; i < data.size(); ++i) {
+        QCOMPARE(data.at(i)->epoch, tensor.epoch(i).eval());
+        QCOMPARE(data.at(i)->bReject, lRejected.at(i));
+    }
+}
+
+//=============================================================================================================
+
+void TestMneEpochDataList::failedBuffer()
+{
+    // Epochs overlapping a buffer which can't be read have to be left out like failed segment reads
+    FiffRawData rawBroken = m_raw;
+    const int iBroken = rawBroken.rawdir.size() / 2;
+
+    FiffDirEntry::SPtr pEnt(new FiffDirEntry(*rawBroken.rawdir.at(iBroken).ent));
+    pEnt->pos = 0x7FFFFF00;
+    rawBroken.rawdir[iBroken].ent = pEnt;
+
+    QList<MatrixXd> lEpochs;
+    QList<bool> lRejected;
+    QList<int> lEvents;
+    readReference(rawBroken, RowVectorXi(), lEpochs, lRejected, lEvents);
+
+    MNEEpochTensor tensor = MNEEpochDataList::readEpochTensor(rawBroken,
+                                                              m_matEvents,
+                                                              m_fTMin,
+                                                              m_fTMax,
+                                                              m_iEvent,
+                                                              m_mapReject);
+    compareEpochs(tensor, lEpochs, lRejected, lEvents);
+
+    MNEEpochTensor tensorComplete = MNEEpochDataList::readEpochTensor(m_raw,
+                                                                      m_matEvents,
+                                                                      m_fTMin,
+                                                                      m_fTMax,
+                                                                      m_iEvent,
+                                                                      m_mapReject);
+    QVERIFY(tensor.size() < tensorComplete.size());
+}
+
+//=============================================================================================================
+
+void TestMneEpochDataList::cleanupTestCase()
+{
+}
+
+//=============================================================================================================
+
+void TestMneEpochDataList::readReference(const FiffRawData& raw,
+                                         const RowVectorXi& picks,
+                                         QList<MatrixXd>& lEpochs,
+                                         QList<bool>& lRejected,
+                                         QList<int>& lEvents)
+{
+    // One segment read and artifact check per epoch, as readEpochs did before the batched reading
+    MatrixXd matData, matAllChannels, matTimes;
+
+    for (int p = 0; p < m_matEvents.rows(); ++p) {
+        if (m_matEvents(p,1) != 0 || m_matEvents(p,2) != m_iEvent) {
+            continue;
+        }
+
+        fiff_int_t from = m_matEvents(p,0) + m_fTMin*raw.info.sfreq;
+        fiff_int_t to = m_matEvents(p,0) + floor(m_fTMax*raw.info.sfreq + 0.5);
+
+        if (from < raw.first_samp || to > raw.last_samp) {
+            continue;
+        }
+
+        if (!raw.read_raw_segment(matData, matTimes, from, to, picks)
+            || !raw.read_raw_segment(matAllChannels, matTimes, from, to)) {
+            continue;
+        }
+
+        lEpochs.append(matData);
+        lRejected.append(!m_mapReject.isEmpty() && MNEEpochDataList::checkForArtifact(matAllChannels, raw.info, m_mapReject));
+        lEvents.append(p);
+    }
+}
+
+//=============================================================================================================
+
+void TestMneEpochDataList::compareEpochs(const MNEEpochTensor& tensor,
+                                         const QList<MatrixXd>& lEpochs,
+                                         const QList<bool>& lRejected,
+                                         const QList<int>& lEvents)
+{
+    QCOMPARE(tensor.size(), lEpochs.size());
+    QCOMPARE(tensor.rejected.size(), lEpochs.size());
+
+    for (int i = 0; i < lEpochs.size(); ++i) {
+        QCOMPARE(tensor.events(i), lEvents.at(i));
+        QCOMPARE(tensor.rejected.at(i), lRejected.at(i));
+        QCOMPARE(tensor.epoch(i).rows(), lEpochs.at(i).rows());
+        QCOMPARE(tensor.epoch(i).cols(), lEpochs.at(i).cols());
+        QVERIFY((tensor.epoch(i) - lEpochs.at(i)).cwiseAbs().maxCoeff() <= dEpsilon * lEpochs.at(i).cwiseAbs().maxCoeff());
+    }
+}
+
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+QTEST_GUILESS_MAIN(TestMneEpochDataList)
+#include "test_mne_epoch_data_list.moc"
@@ -42,9 +42,16 @@
 
 #include <fwd/computeFwd/compute_fwd_settings.h>
 #include <fwd/computeFwd/compute_fwd.h>
+#include <fwd/fwd_bem_model.h>
+#include <fwd/fwd_coil_set.h>
+#include <fwd/fwd_thread_arg.h>
+#include <fwd/fwd_types.h>
 #include <mne/mne.h>
+#include <mne/c/mne_surface_old.h>
+#include <mne/c/mne_source_space_old.h>
 
 #include <fiff/fiff.h>
+#include <fiff/c/fiff_coord_trans_old.h>
 #include <fiff/fiff_info.h>
 #include <fiff/fiff_named_matrix.h>
 
@@ -53,6 +60,13 @@
 //=============================================================================================================
 
 #include <QtTest>
+#include <QTemporaryDir>
+
+//=============================================================================================================
+// EIGEN INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Dense>
 
 //=============================================================================================================
 // USED NAMESPACES
@@ -60,6 +74,39 @@
 
 using namespace FWDLIB;
 using namespace MNELIB;
+using namespace Eigen;
+
+typedef Matrix<float,Dynamic,Dynamic,RowMajor> MatrixXfRowMajor;
+
+//=============================================================================================================
+/**
+ * Computes the fields or potentials of all dipoles with a block function, handing it at most iBlockSize dipoles at once.
+ */
+static MatrixXfRowMajor computeInBlocks(fwdBlockFieldFunc blockFunc,
+                                        MatrixXfRowMajor& matRd,
+                                        MatrixXfRowMajor& matQ,
+                                        int iBlockSize,
+                                        FwdCoilSet* pCoils,
+                                        void* pClient)
+{
+    int ndip = matRd.rows();
+    MatrixXfRowMajor matRes(ndip, pCoils->ncoil);
+    QVector<float*> rd(ndip), Q(ndip), res(ndip);
+
+    for(int j = 0; j < ndip; ++j) {
+        rd[j] = matRd.row(j).data();
+        Q[j] = matQ.row(j).data();
+        res[j] = matRes.row(j).data();
+    }
+
+    for(int j = 0; j < ndip; j += iBlockSize) {
+        if(blockFunc(rd.data() + j, Q.data() + j, qMin(iBlockSize, ndip - j), pCoils, res.data() + j, pClient) != 0) {
+            return MatrixXfRowMajor();
+        }
+    }
+
+    return matRes;
+}
 
 //=============================================================================================================
 /**
@@ -79,11 +126,26 @@ private slots:
     void initTestCase();
     void computeForward();
     void compareForward();
+    void luInvert_data();
+    void luInvert();
+    void luInvertSingular();
+    void solutionCache();
+    void blockForward_data();
+    void blockForward();
+    void chunkedForward_data();
+    void chunkedForward();
     void cleanupTestCase();
 
 private:
     double dEpsilon;
 
+    QScopedPointer<FwdBemModel> m_pBemModel;
+    QScopedPointer<FwdCoilSet> m_pCoilTemplates;
+    QScopedPointer<FwdCoilSet> m_pMegCoils;
+    QScopedPointer<FwdCoilSet> m_pEegEls;
+    MatrixXfRowMajor m_matRd;
+    MatrixXfRowMajor m_matQ;
+
     QSharedPointer<MNEForwardSolution> m_pFwdMEGEEGRead;
     QSharedPointer<MNEForwardSolution> m_pFwdMEGEEGRef;
 };
@@ -100,6 +162,59 @@ TestMneForwardSolution::TestMneForwardSolution()
 void TestMneForwardSolution::initTestCase()
 {
     qInstallMessageHandler(UTILSLIB::ApplicationLogger::customLogWriter);
+
+    QString sBemName = FwdBemModel::fwd_bem_make_bem_sol_name(QCoreApplication::applicationDirPath() + "/mne-cpp-test-data/subjects/sample/bem/sample-1280-1280-1280-bem.fif");
+    QString sMriName = QCoreApplication::applicationDirPath() + "/mne-cpp-test-data/MEG/sample/all-trans.fif";
+    QString sMeasName = QCoreApplication::applicationDirPath() + "/mne-cpp-test-data/MEG/sample/sample_audvis_trunc_raw.fif";
+    QString sCoilDefName = QCoreApplication::applicationDirPath() + "/resources/general/coilDefinitions/coil_def.dat";
+
+    // The three-layer model and the sensors in MRI coordinates as set up by ComputeFwd
+    m_pBemModel.reset(FwdBemModel::fwd_bem_load_three_layer_surfaces(sBemName));
+    QVERIFY(!m_pBemModel.isNull());
+    QVERIFY(FwdBemModel::fwd_bem_load_recompute_solution(sBemName, FWD_BEM_UNKNOWN, false, m_pBemModel.data()) == 0);
+
+    QFile fileMeas(sMeasName);
+    FIFFLIB::FiffRawData raw(fileMeas);
+
+    QScopedPointer<FIFFLIB::FiffCoordTransOld> pMriHeadT(FIFFLIB::FiffCoordTransOld::mne_read_mri_transform(sMriName));
+    QVERIFY(!pMriHeadT.isNull());
+    QScopedPointer<FIFFLIB::FiffCoordTransOld> pHeadMriT(pMriHeadT->fiff_invert_transform());
+    FIFFLIB::FiffCoordTransOld megHeadT = raw.info.dev_head_t.toOld();
+    QScopedPointer<FIFFLIB::FiffCoordTransOld> pMegMriT(FIFFLIB::FiffCoordTransOld::fiff_combine_transforms(FIFFV_COORD_DEVICE, FIFFV_COORD_MRI, &megHeadT, pHeadMriT.data()));
+    QVERIFY(!pMegMriT.isNull());
+
+    QList<FIFFLIB::FiffChInfo> listMegChs, listEegChs;
+    for(int k = 0; k < raw.info.chs.size(); ++k) {
+        if(raw.info.chs[k].kind == FIFFV_MEG_CH) {
+            listMegChs.append(raw.info.chs[k]);
+        } else if(raw.info.chs[k].kind == FIFFV_EEG_CH) {
+            listEegChs.append(raw.info.chs[k]);
+        }
+    }
+
+    m_pCoilTemplates.reset(FwdCoilSet::read_coil_defs(sCoilDefName));
+    QVERIFY(!m_pCoilTemplates.isNull());
+    m_pMegCoils.reset(m_pCoilTemplates->create_meg_coils(listMegChs, listMegChs.size(), FWD_COIL_ACCURACY_NORMAL, pMegMriT.data()));
+    QVERIFY(!m_pMegCoils.isNull());
+    QVERIFY(FwdBemModel::fwd_bem_specify_coils(m_pBemModel.data(), m_pMegCoils.data()) == 0);
+    m_pEegEls.reset(FwdCoilSet::create_eeg_els(listEegChs, listEegChs.size(), pHeadMriT.data()));
+    QVERIFY(!m_pEegEls.isNull());
+    QVERIFY(FwdBemModel::fwd_bem_specify_els(m_pBemModel.data(), m_pEegEls.data()) == 0);
+
+    // Dipoles well inside the inner skull, more than two blocks of the forward computation
+    MNELIB::MneSurfaceOld* pInnerSkull = m_pBemModel->fwd_bem_find_surface(FIFFV_BEM_SURF_ID_BRAIN);
+    QVERIFY(pInnerSkull != Q_NULLPTR);
+    Vector3f vecCenter = Vector3f::Zero();
+    for(int k = 0; k < pInnerSkull->np; ++k) {
+        vecCenter += Map<Vector3f>(pInnerSkull->rr[k]);
+    }
+    vecCenter /= float(pInnerSkull->np);
+
+    std::srand(0);
+    int ndip = 2 * FWD_BEM_BLOCK_SIZE + 44;
+    m_matRd = (0.03f * MatrixXf::Random(ndip, 3)).rowwise() + vecCenter.transpose();
+    m_matQ = MatrixXf::Random(ndip, 3);
+    m_matQ.rowwise().normalize();
 }
 
 //=============================================================================================================
@@ -186,6 +301,243 @@ void TestMneForwardSolution::compareForward()
 
 //=============================================================================================================
 
+void TestMneForwardSolution::luInvert_data()
+{
+    QTest::addColumn<int>("dim");
+    QTest::addColumn<bool>("bPivoting");
+
+    // The LU works in blocks of 128 rows, cover a single block, exact multiples and remainders
+    QTest::newRow("well conditioned 1") << 1 << false;
+    QTest::newRow("well conditioned 130") << 130 << false;
+    QTest::newRow("well conditioned 300") << 300 << false;
+    QTest::newRow("pivoting 5") << 5 << true;
+    QTest::newRow("pivoting 256") << 256 << true;
+    QTest::newRow("pivoting 257") << 257 << true;
+}
+
+//=============================================================================================================
+
+void TestMneForwardSolution::luInvert()
+{
+    QFETCH(int, dim);
+    QFETCH(bool, bPivoting);
+
+    std::srand(dim);
+
+    // A diagonally dominant matrix is well conditioned
+    MatrixXf matA = MatrixXf::Random(dim,dim) + float(dim) * MatrixXf::Identity(dim,dim);
+
+    if(bPivoting) {
+        // Move the dominant entries to the anti-diagonal and clear the diagonal, every column needs a row interchange
+        matA = matA.colwise().reverse().eval();
+        for(int i = 0; i < dim; ++i) {
+            if(i != dim - 1 - i) {
+                matA(i,i) = 0.0f;
+            }
+        }
+    }
+
+    // fwd_bem_lu_invert expects contiguous rows
+    MatrixXfRowMajor matInv = matA;
+    QVector<float*> rows(dim);
+    for(int i = 0; i < dim; ++i) {
+        rows[i] = matInv.data() + i * dim;
+    }
+
+    QVERIFY(FwdBemModel::fwd_bem_lu_invert(rows.data(),dim) == rows.data());
+
+    MatrixXf matRef = matA.inverse();
+
+    QVERIFY((MatrixXf(matInv) - matRef).norm() / matRef.norm() < 1e-5f);
+    QVERIFY((matA * MatrixXf(matInv) - MatrixXf::Identity(dim,dim)).cwiseAbs().maxCoeff() < 1e-4f);
+}
+
+//=============================================================================================================
+
+void TestMneForwardSolution::luInvertSingular()
+{
+    MatrixXfRowMajor matA = MatrixXfRowMajor::Random(4,4);
+    matA.row(2).setZero();
+
+    QVector<float*> rows(4);
+    for(int i = 0; i < 4; ++i) {
+        rows[i] = matA.data() + i * 4;
+    }
+
+    QVERIFY(FwdBemModel::fwd_bem_lu_invert(rows.data(),4) == NULL);
+}
+
+//=============================================================================================================
+
+void TestMneForwardSolution::solutionCache()
+{
+    QString sBemName = QCoreApplication::applicationDirPath() + "/mne-cpp-test-data/subjects/sample/bem/sample-1280-1280-1280-bem.fif";
+
+    QTemporaryDir cacheDir;
+    QVERIFY(cacheDir.isValid());
+    qputenv("MNE_BEM_SOLUTION_CACHE_DIR", cacheDir.path().toLocal8Bit());
+
+    // Recomputing writes the solution to the cache directory
+    QScopedPointer<FwdBemModel> pModel(FwdBemModel::fwd_bem_load_homog_surface(sBemName));
+    QVERIFY(!pModel.isNull());
+    QVERIFY(FwdBemModel::fwd_bem_load_recompute_solution(sBemName, FWD_BEM_LINEAR_COLL, true, pModel.data()) == 0);
+    MatrixXfRowMajor matSol = Map<MatrixXfRowMajor>(pModel->solution[0], pModel->nsol, pModel->nsol);
+
+    QString sCacheName = FwdBemModel::fwd_bem_solution_cache_name(sBemName, FWD_BEM_LINEAR_COLL, pModel.data());
+    QCOMPARE(QFileInfo(sCacheName).absolutePath(), QDir(cacheDir.path()).absolutePath());
+
+    // Only the renamed file is left, no temporary one
+    QCOMPARE(QDir(cacheDir.path()).entryList(QDir::Files), QStringList() << QFileInfo(sCacheName).fileName());
+
+    // The cached solution reads back unchanged
+    QScopedPointer<FwdBemModel> pCached(FwdBemModel::fwd_bem_load_homog_surface(sBemName));
+    QVERIFY(!pCached.isNull());
+    QVERIFY(FwdBemModel::fwd_bem_load_solution(sCacheName, FWD_BEM_LINEAR_COLL, pCached.data()) == 1);
+    QCOMPARE(pCached->nsol, pModel->nsol);
+    QVERIFY(Map<MatrixXfRowMajor>(pCached->solution[0], pCached->nsol, pCached->nsol) == matSol);
+
+    // A cache directory which cannot be written to is skipped
+    qputenv("MNE_BEM_SOLUTION_CACHE_DIR", cacheDir.path().toLocal8Bit() + "/missing");
+    QScopedPointer<FwdBemModel> pUncached(FwdBemModel::fwd_bem_load_homog_surface(sBemName));
+    QVERIFY(!pUncached.isNull());
+    QVERIFY(FwdBemModel::fwd_bem_load_recompute_solution(sBemName, FWD_BEM_LINEAR_COLL, true, pUncached.data()) == 0);
+    QVERIFY(!QFile::exists(FwdBemModel::fwd_bem_solution_cache_name(sBemName, FWD_BEM_LINEAR_COLL, pUncached.data())));
+
+    qunsetenv("MNE_BEM_SOLUTION_CACHE_DIR");
+}
+
+//=============================================================================================================
+
+void TestMneForwardSolution::blockForward_data()
+{
+    QTest::addColumn<bool>("bEeg");
+
+    QTest::newRow("meg") << false;
+    QTest::newRow("eeg") << true;
+}
+
+//=============================================================================================================
+
+void TestMneForwardSolution::blockForward()
+{
+    QFETCH(bool, bEeg);
+
+    FwdCoilSet* pCoils = bEeg ? m_pEegEls.data() : m_pMegCoils.data();
+    fwdFieldFunc fieldFunc = bEeg ? FwdBemModel::fwd_bem_pot_els : FwdBemModel::fwd_bem_field;
+    fwdBlockFieldFunc blockFieldFunc = bEeg ? FwdBemModel::fwd_bem_pot_els_block : FwdBemModel::fwd_bem_field_block;
+    int ndip = m_matRd.rows();
+
+    // Dipole by dipole with the original routine
+    MatrixXfRowMajor matRef(ndip, pCoils->ncoil);
+    for(int j = 0; j < ndip; ++j) {
+        QVERIFY(fieldFunc(m_matRd.row(j).data(), m_matQ.row(j).data(), pCoils, matRef.row(j).data(), m_pBemModel.data()) == 0);
+    }
+
+    // All dipoles at once and blocks of size one must match each other, the block size of the forward computation
+    // and a size which leaves a remainder in between
+    MatrixXfRowMajor matAll = computeInBlocks(blockFieldFunc, m_matRd, m_matQ, ndip, pCoils, m_pBemModel.data());
+    QCOMPARE(int(matAll.rows()), ndip);
+    QVERIFY((matAll - matRef).norm() / matRef.norm() < 1e-4f);
+
+    QList<int> listBlockSizes = QList<int>() << 1 << 7 << FWD_BEM_BLOCK_SIZE;
+    for(int iBlockSize : listBlockSizes) {
+        MatrixXfRowMajor matBlocks = computeInBlocks(blockFieldFunc, m_matRd, m_matQ, iBlockSize, pCoils, m_pBemModel.data());
+        QCOMPARE(int(matBlocks.rows()), ndip);
+        QVERIFY((matBlocks - matAll).norm() / matAll.norm() < 1e-5f);
+    }
+}
+
+//=============================================================================================================
+
+void TestMneForwardSolution::chunkedForward_data()
+{
+    QTest::addColumn<int>("iWorkers");
+    QTest::addColumn<bool>("bFixedOri");
+
+    // With many workers every chunk holds a single source, with one worker a chunk is a full block
+    QTest::newRow("free 1 worker") << 1 << false;
+    QTest::newRow("free 4 workers") << 4 << false;
+    QTest::newRow("free 80 workers") << 80 << false;
+    QTest::newRow("fixed 1 worker") << 1 << true;
+    QTest::newRow("fixed 80 workers") << 80 << true;
+}
+
+//=============================================================================================================
+
+void TestMneForwardSolution::chunkedForward()
+{
+    QFETCH(int, iWorkers);
+    QFETCH(bool, bFixedOri);
+
+    FwdCoilSet* pEls = m_pEegEls.data();
+    int np = m_matRd.rows() / 2;
+
+    // Two source spaces with points which are not in use
+    QList<QSharedPointer<MNELIB::MneSourceSpaceOld> > listSpaces;
+    QVector<MNELIB::MneSourceSpaceOld*> spaces;
+    int nsource = 0;
+    for(int k = 0; k < 2; ++k) {
+        QSharedPointer<MNELIB::MneSourceSpaceOld> pSpace(new MNELIB::MneSourceSpaceOld(np));
+        for(int j = 0; j < np; ++j) {
+            Map<Vector3f>(pSpace->rr[j]) = m_matRd.row(k * np + j).transpose();
+            Map<Vector3f>(pSpace->nn[j]) = m_matQ.row(k * np + j).transpose();
+            pSpace->inuse[j] = (j % 5 != 3);
+            pSpace->nuse += pSpace->inuse[j];
+        }
+        nsource += pSpace->nuse;
+        listSpaces.append(pSpace);
+        spaces.append(pSpace.data());
+    }
+
+    // Dipole by dipole with the original routine
+    int nres = bFixedOri ? nsource : 3 * nsource;
+    MatrixXfRowMajor matRef(nres, pEls->ncoil);
+    for(int k = 0, p = 0; k < spaces.size(); ++k) {
+        for(int j = 0; j < np; ++j) {
+            if(!spaces[k]->inuse[j]) {
+                continue;
+            }
+            if(bFixedOri) {
+                QVERIFY(FwdBemModel::fwd_bem_pot_els(spaces[k]->rr[j], spaces[k]->nn[j], pEls, matRef.row(p++).data(), m_pBemModel.data()) == 0);
+            } else {
+                for(int c = 0; c < 3; ++c) {
+                    Vector3f vecQ = Vector3f::Unit(c);
+                    QVERIFY(FwdBemModel::fwd_bem_pot_els(spaces[k]->rr[j], vecQ.data(), pEls, matRef.row(p++).data(), m_pBemModel.data()) == 0);
+                }
+            }
+        }
+    }
+
+    // The scheduled computation writes every chunk to its own rows of the result
+    MatrixXfRowMajor matRes = MatrixXfRowMajor::Zero(nres, pEls->ncoil);
+    QVector<float*> res(nres);
+    for(int j = 0; j < nres; ++j) {
+        res[j] = matRes.row(j).data();
+    }
+
+    FwdThreadArg one;
+    one.res = res.data();
+    one.coils_els = pEls;
+    one.client = m_pBemModel.data();
+    one.fixed_ori = bFixedOri;
+    one.field_pot = FwdBemModel::fwd_bem_pot_els;
+    one.field_pot_block = FwdBemModel::fwd_bem_pot_els_block;
+
+    QList<FwdThreadArg*> workers;
+    for(int k = 0; k < iWorkers; ++k) {
+        workers.append(FwdThreadArg::create_eeg_multi_thread_duplicate(&one, true));
+    }
+    int stat = FwdBemModel::fwd_compute_source_chunks(spaces.data(), spaces.size(), workers);
+    for(int k = 0; k < workers.size(); ++k) {
+        FwdThreadArg::free_eeg_multi_thread_duplicate(workers[k], true);
+    }
+
+    QVERIFY(stat == 0);
+    QVERIFY((matRes - matRef).norm() / matRef.norm() < 1e-4f);
+}
+
+//=============================================================================================================
+
 void TestMneForwardSolution::cleanupTestCase()
 {
 }
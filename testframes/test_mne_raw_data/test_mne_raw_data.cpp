@@ -0,0 +1,197 @@
+//=============================================================================================================
+/**
+ * @file     test_mne_raw_data.cpp
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @since    0.1.0
+ * @date     October, 2026
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2026, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief    The MneRawData test implementation
+ *
+ */
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <mne/c/mne_raw_data.h>
+
+#include <cstdlib>
+#include <cmath>
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QtTest>
+#include <QVector>
+
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace MNELIB;
+
+//=============================================================================================================
+/**
+ * DECLARE CLASS TestMneRawData
+ *
+ * @brief The TestMneRawData class provides tests of the FFT used to filter the raw data
+ *
+ */
+class TestMneRawData: public QObject
+{
+    Q_OBJECT
+
+public:
+    TestMneRawData();
+
+private slots:
+    void initTestCase();
+    void fftAnalysisOrder_data();
+    void fftAnalysisOrder();
+    void fftRoundTrip_data();
+    void fftRoundTrip();
+    void cleanupTestCase();
+
+private:
+    QVector<float> randomData(int np);
+
+    double epsilon;
+};
+
+//=============================================================================================================
+
+TestMneRawData::TestMneRawData()
+: epsilon(0.0001)
+{
+}
+
+//=============================================================================================================
+
+void TestMneRawData::initTestCase()
+{
+    std::srand(42);
+}
+
+//=============================================================================================================
+
+void TestMneRawData::fftAnalysisOrder_data()
+{
+    QTest::addColumn<int>("np");
+
+    QTest::newRow("even") << 16;
+    QTest::newRow("odd") << 15;
+}
+
+//=============================================================================================================
+
+void TestMneRawData::fftAnalysisOrder()
+{
+    // mne_fft_ana has to store the half spectrum in the FFTPACK order r0, r1, i1, r2, i2, ..., [r(np/2)]
+    QFETCH(int, np);
+
+    QVector<float> data = randomData(np);
+    QVector<float> spectrum = data;
+
+    MneRawData::mne_fft_ana(spectrum.data(), np);
+
+    int nfreq = np % 2 == 0 ? np/2 : (np+1)/2;
+
+    for (int k = 0; k <= np/2; ++k) {
+        double re = 0.0;
+        double im = 0.0;
+        for (int n = 0; n < np; ++n) {
+            re += data[n]*std::cos(2.0*M_PI*k*n/np);
+            im -= data[n]*std::sin(2.0*M_PI*k*n/np);
+        }
+
+        if (k == 0) {
+            QVERIFY(std::fabs(spectrum[0] - re) < epsilon);
+        } else if (k < nfreq) {
+            QVERIFY(std::fabs(spectrum[2*k-1] - re) < epsilon);
+            QVERIFY(std::fabs(spectrum[2*k] - im) < epsilon);
+        } else {
+            QVERIFY(std::fabs(spectrum[np-1] - re) < epsilon);
+        }
+    }
+}
+
+//=============================================================================================================
+
+void TestMneRawData::fftRoundTrip_data()
+{
+    QTest::addColumn<int>("np");
+
+    QTest::newRow("single") << 1;
+    QTest::newRow("even") << 1024;
+    QTest::newRow("odd") << 1023;
+    QTest::newRow("even non power of two") << 1200;
+    QTest::newRow("odd prime") << 1009;
+}
+
+//=============================================================================================================
+
+void TestMneRawData::fftRoundTrip()
+{
+    // Every filtered read goes through the analysis and synthesis, the synthesis of the analysis has to be the input
+    QFETCH(int, np);
+
+    QVector<float> data = randomData(np);
+    QVector<float> result = data;
+
+    MneRawData::mne_fft_ana(result.data(), np);
+    MneRawData::mne_fft_syn(result.data(), np);
+
+    for (int n = 0; n < np; ++n) {
+        QVERIFY(std::fabs(result[n] - data[n]) < epsilon);
+    }
+}
+
+//=============================================================================================================
+
+void TestMneRawData::cleanupTestCase()
+{
+}
+
+//=============================================================================================================
+
+QVector<float> TestMneRawData::randomData(int np)
+{
+    QVector<float> data(np);
+
+    for (int n = 0; n < np; ++n) {
+        data[n] = 2.0f*float(std::rand())/float(RAND_MAX) - 1.0f;
+    }
+
+    return data;
+}
+
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+QTEST_GUILESS_MAIN(TestMneRawData)
+#include "test_mne_raw_data.moc"
@@ -0,0 +1,186 @@
+//=============================================================================================================
+/**
+ * @file     test_rapmusic.cpp
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @since    0.1.0
+ * @date     October, 2026
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2026, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief    The RAP MUSIC test implementation
+ *
+ */
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <inverse/rapMusic/rapmusic.h>
+
+#include <cstdlib>
+#include <cmath>
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QtTest>
+
+//=============================================================================================================
+// EIGEN INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Dense>
+
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace INVERSELIB;
+using namespace Eigen;
+
+//=============================================================================================================
+/**
+ * Gives access to the correlation kernels of RapMusic.
+ */
+class RapMusicKernels : public RapMusic
+{
+public:
+    using RapMusic::subcorr;
+    using RapMusic::calcSourceBases;
+    using RapMusic::pairCorr;
+};
+
+//=============================================================================================================
+/**
+ * DECLARE CLASS TestRapMusic
+ *
+ * @brief The TestRapMusic class provides tests of the RAP MUSIC subspace correlation
+ *
+ */
+class TestRapMusic: public QObject
+{
+    Q_OBJECT
+
+public:
+    TestRapMusic();
+
+private slots:
+    void initTestCase();
+    void comparePairCorr_data();
+    void comparePairCorr();
+    void cleanupTestCase();
+
+private:
+    double epsilon;
+};
+
+//=============================================================================================================
+
+TestRapMusic::TestRapMusic()
+: epsilon(1e-9)
+{
+}
+
+//=============================================================================================================
+
+void TestRapMusic::initTestCase()
+{
+}
+
+//=============================================================================================================
+
+void TestRapMusic::comparePairCorr_data()
+{
+    QTest::addColumn<double>("dScale");
+
+    // The lead fields of real sources are tiny, the rank rule must not depend on their scale
+    QTest::newRow("unit scale") << 1.0;
+    QTest::newRow("lead field scale") << 1e-8;
+}
+
+//=============================================================================================================
+
+void TestRapMusic::comparePairCorr()
+{
+    // pairCorr on the source bases has to give the correlation of subcorr on the pair's Lead Field combination
+    QFETCH(double, dScale);
+
+    std::srand(3);
+
+    int iNumChannels = 30;
+    int iNumSources = 6;
+
+    // Orthonormal signal subspace
+    HouseholderQR<MatrixXd> qr(MatrixXd::Random(iNumChannels, 5));
+    MatrixXd matU_B = qr.householderQ() * MatrixXd::Identity(iNumChannels, 5);
+
+    // Sources 0 and 1 have full rank, 2 has rank 2, 3 spans the same space as 0, 4 has rank 1 and 5 is weaker
+    MatrixXd matLeadField = MatrixXd::Random(iNumChannels, 3 * iNumSources);
+
+    Vector3d vecNull = Vector3d::Random().normalized();
+    matLeadField.middleCols(6, 3) = matLeadField.middleCols(6, 3) * (Matrix3d::Identity() - vecNull * vecNull.transpose());
+    matLeadField.middleCols(9, 3) = matLeadField.middleCols(0, 3) * Matrix3d::Random();
+    matLeadField.middleCols(12, 3) = matLeadField.col(12) * RowVector3d::Random();
+    matLeadField.middleCols(15, 3) *= 1e-3;
+    matLeadField *= dScale;
+
+    RapMusicKernels rapMusic;
+    MatrixXd matQ, matU_B_Q;
+    VectorXi vecRank;
+    rapMusic.calcSourceBases(matLeadField, matU_B, matQ, matU_B_Q, vecRank);
+
+    QCOMPARE(vecRank(0), 3);
+    QCOMPARE(vecRank(2), 2);
+    QCOMPARE(vecRank(3), 3);
+    QCOMPARE(vecRank(4), 1);
+    QCOMPARE(vecRank(5), 3);
+
+    // All pairs including the ones of a source with itself
+    for(int i = 0; i < iNumSources; ++i) {
+        for(int j = i; j < iNumSources; ++j) {
+            RapMusic::MatrixX6T matProj_G(iNumChannels, 6);
+            matProj_G << matLeadField.middleCols(3 * i, 3), matLeadField.middleCols(3 * j, 3);
+
+            double dSubcorr = RapMusicKernels::subcorr(matProj_G, matU_B);
+            double dPairCorr = RapMusicKernels::pairCorr(matQ, matU_B_Q, vecRank, i, j);
+
+            QVERIFY2(std::abs(dSubcorr - dPairCorr) < epsilon,
+                     qPrintable(QString("Pair (%1, %2): subcorr %3, pairCorr %4").arg(i).arg(j).arg(dSubcorr).arg(dPairCorr)));
+        }
+    }
+}
+
+//=============================================================================================================
+
+void TestRapMusic::cleanupTestCase()
+{
+}
+
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+QTEST_GUILESS_MAIN(TestRapMusic)
+#include "test_rapmusic.moc"
@@ -0,0 +1,319 @@
+//=============================================================================================================
+/**
+ * @file     test_rtaveraging.cpp
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @since    0.1.0
+ * @date     October, 2026
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2026, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief    The RtAveraging test implementation
+ *
+ */
+
+
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <utils/generics/applicationlogger.h>
+
+#include <rtprocessing/rtaveraging.h>
+
+#include <fiff/fiff_info.h>
+#include <fiff/fiff_evoked_set.h>
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QtTest>
+
+//=============================================================================================================
+// EIGEN INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace RTPROCESSINGLIB;
+using namespace FIFFLIB;
+using namespace Eigen;
+
+//=============================================================================================================
+/**
+ * Gives the test access to the running average of the worker.
+ */
+class RtAveragingWorkerTest : public RtAveragingWorker
+{
+public:
+    RtAveragingWorkerTest(quint32 numAverages,
+                          FiffInfo::SPtr pFiffInfo)
+    : RtAveragingWorker(numAverages, 2, 3, 0, 0, 0, pFiffInfo)
+    {
+    }
+
+    using RtAveragingWorker::addEpoch;
+    using RtAveragingWorker::generateEvoked;
+    using RtAveragingWorker::m_stimEvokedSet;
+};
+
+//=============================================================================================================
+/**
+ * DECLARE CLASS TestRtAveraging
+ *
+ * @brief The TestRtAveraging class compares the running sums of RtAveraging with the mean of the averaged epochs
+ *
+ */
+class TestRtAveraging: public QObject
+{
+    Q_OBJECT
+
+public:
+    TestRtAveraging();
+
+private slots:
+    void initTestCase();
+    void movingAverage_data();
+    void movingAverage();
+    void changeAverageNumber_data();
+    void changeAverageNumber();
+    void cumulativeAverage();
+    void cleanupTestCase();
+
+private:
+    MatrixXd nextEpoch();
+
+    void compareAverage(RtAveragingWorkerTest& worker,
+                        const QList<MatrixXd>& lEpochs);
+
+    double dEpsilon;
+    double m_dTriggerType;
+    FiffInfo::SPtr m_pFiffInfo;
+};
+
+//=============================================================================================================
+
+TestRtAveraging::TestRtAveraging()
+: dEpsilon(1e-10)
+, m_dTriggerType(1.0)
+{
+}
+
+//=============================================================================================================
+
+void TestRtAveraging::initTestCase()
+{
+    qInstallMessageHandler(UTILSLIB::ApplicationLogger::customLogWriter);
+
+    m_pFiffInfo = FiffInfo::SPtr(new FiffInfo);
+    m_pFiffInfo->nchan = 3;
+    m_pFiffInfo->sfreq = 1000.0;
+
+    std::srand(7);
+}
+
+//=============================================================================================================
+
+void TestRtAveraging::movingAverage_data()
+{
+    QTest::addColumn<int>("iNumAverages");
+    QTest::addColumn<int>("iNEpochs");
+
+    QTest::newRow("single") << 1 << 5;
+    QTest::newRow("ring not full") << 4 << 3;
+    QTest::newRow("ring full") << 5 << 10;
+    QTest::newRow("ring wrapped") << 4 << 11;
+}
+
+//=============================================================================================================
+
+void TestRtAveraging::movingAverage()
+{
+    QFETCH(int, iNumAverages);
+    QFETCH(int, iNEpochs);
+
+    RtAveragingWorkerTest worker(iNumAverages, m_pFiffInfo);
+    QList<MatrixXd> lEpochs;
+
+    for(int i = 0; i < iNEpochs; ++i) {
+        MatrixXd matEpoch = nextEpoch();
+        worker.addEpoch(m_dTriggerType, matEpoch);
+
+        lEpochs.append(matEpoch);
+        while(lEpochs.size() > iNumAverages) {
+            lEpochs.removeFirst();
+        }
+
+        compareAverage(worker, lEpochs);
+    }
+}
+
+//=============================================================================================================
+
+void TestRtAveraging::changeAverageNumber_data()
+{
+    QTest::addColumn<int>("iNumAverages");
+    QTest::addColumn<int>("iNBefore");
+    QTest::addColumn<int>("iNewNumAverages");
+    QTest::addColumn<int>("iNAfter");
+
+    // setAverageNumber rebuilds the ring from the newest epochs, starting at the slot of the next epoch
+    QTest::newRow("shrink ring not full") << 5 << 2 << 3 << 4;
+    QTest::newRow("shrink ring full") << 5 << 5 << 2 << 3;
+    QTest::newRow("shrink ring wrapped") << 5 << 7 << 3 << 6;
+    QTest::newRow("grow ring not full") << 4 << 2 << 6 << 8;
+    QTest::newRow("grow ring wrapped") << 3 << 10 << 7 << 9;
+    QTest::newRow("unchanged") << 4 << 6 << 4 << 3;
+}
+
+//=============================================================================================================
+
+void TestRtAveraging::changeAverageNumber()
+{
+    QFETCH(int, iNumAverages);
+    QFETCH(int, iNBefore);
+    QFETCH(int, iNewNumAverages);
+    QFETCH(int, iNAfter);
+
+    RtAveragingWorkerTest worker(iNumAverages, m_pFiffInfo);
+    QList<MatrixXd> lEpochs;
+
+    for(int i = 0; i < iNBefore; ++i) {
+        MatrixXd matEpoch = nextEpoch();
+        worker.addEpoch(m_dTriggerType, matEpoch);
+
+        lEpochs.append(matEpoch);
+        while(lEpochs.size() > iNumAverages) {
+            lEpochs.removeFirst();
+        }
+    }
+
+    // Only the newest epochs which still fit are kept
+    worker.setAverageNumber(iNewNumAverages);
+    while(lEpochs.size() > iNewNumAverages) {
+        lEpochs.removeFirst();
+    }
+    compareAverage(worker, lEpochs);
+
+    for(int i = 0; i < iNAfter; ++i) {
+        MatrixXd matEpoch = nextEpoch();
+        worker.addEpoch(m_dTriggerType, matEpoch);
+
+        lEpochs.append(matEpoch);
+        while(lEpochs.size() > iNewNumAverages) {
+            lEpochs.removeFirst();
+        }
+
+        compareAverage(worker, lEpochs);
+    }
+}
+
+//=============================================================================================================
+
+void TestRtAveraging::cumulativeAverage()
+{
+    RtAveragingWorkerTest worker(3, m_pFiffInfo);
+    QList<MatrixXd> lEpochs;
+
+    worker.addEpoch(m_dTriggerType, nextEpoch());
+
+    // Switching the mode starts over
+    worker.setCumulativeAverage(true);
+
+    for(int i = 0; i < 20; ++i) {
+        MatrixXd matEpoch = nextEpoch();
+        worker.addEpoch(m_dTriggerType, matEpoch);
+        lEpochs.append(matEpoch);
+
+        compareAverage(worker, lEpochs);
+    }
+
+    // The number of averages does not limit the cumulative average
+    worker.setAverageNumber(2);
+    MatrixXd matEpoch = nextEpoch();
+    worker.addEpoch(m_dTriggerType, matEpoch);
+    lEpochs.append(matEpoch);
+    compareAverage(worker, lEpochs);
+
+    // Back to the moving average over the new number of averages
+    worker.setCumulativeAverage(false);
+    lEpochs.clear();
+
+    for(int i = 0; i < 5; ++i) {
+        matEpoch = nextEpoch();
+        worker.addEpoch(m_dTriggerType, matEpoch);
+
+        lEpochs.append(matEpoch);
+        while(lEpochs.size() > 2) {
+            lEpochs.removeFirst();
+        }
+
+        compareAverage(worker, lEpochs);
+    }
+}
+
+//=============================================================================================================
+
+void TestRtAveraging::cleanupTestCase()
+{
+}
+
+//=============================================================================================================
+
+MatrixXd TestRtAveraging::nextEpoch()
+{
+    // Offset and amplitudes in the range of MEG data, the running sums have to cope with the offset
+    return 1e-12 * (MatrixXd::Random(m_pFiffInfo->nchan, 5) + MatrixXd::Constant(m_pFiffInfo->nchan, 5, 100.0));
+}
+
+//=============================================================================================================
+
+void TestRtAveraging::compareAverage(RtAveragingWorkerTest& worker,
+                                     const QList<MatrixXd>& lEpochs)
+{
+    MatrixXd matMean = MatrixXd::Zero(lEpochs.first().rows(), lEpochs.first().cols());
+    for(int i = 0; i < lEpochs.size(); ++i) {
+        matMean += lEpochs.at(i);
+    }
+    matMean /= lEpochs.size();
+
+    worker.generateEvoked(m_dTriggerType);
+    QCOMPARE(worker.m_stimEvokedSet.evoked.size(), 1);
+
+    const FiffEvoked& evoked = worker.m_stimEvokedSet.evoked.first();
+    QCOMPARE(evoked.nave, lEpochs.size());
+    QVERIFY((evoked.data - matMean).norm() <= dEpsilon * matMean.norm());
+}
+
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+QTEST_GUILESS_MAIN(TestRtAveraging)
+#include "test_rtaveraging.moc"
@@ -0,0 +1,320 @@
+//=============================================================================================================
+/**
+ * @file     test_rtcov.cpp
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @since    0.1.0
+ * @date     October, 2026
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2026, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief    The RtCov test implementation
+ *
+ */
+
+
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <utils/generics/applicationlogger.h>
+
+#include <rtprocessing/rtcov.h>
+
+#include <fiff/fiff_info.h>
+#include <fiff/fiff_cov.h>
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QtTest>
+
+//=============================================================================================================
+// EIGEN INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace RTPROCESSINGLIB;
+using namespace FIFFLIB;
+using namespace Eigen;
+
+//=============================================================================================================
+/**
+ * DECLARE CLASS TestRtCov
+ *
+ * @brief The TestRtCov class compares the streaming covariance of RtCov with covariances computed from all samples
+ *
+ */
+class TestRtCov: public QObject
+{
+    Q_OBJECT
+
+public:
+    TestRtCov();
+
+private slots:
+    void initTestCase();
+    void blockWise();
+    void exponentialForgetting();
+    void slidingWindow_data();
+    void slidingWindow();
+    void cleanupTestCase();
+
+private:
+    MatrixXd weightedCovariance(const MatrixXd& matData,
+                                const VectorXd& vecWeights) const;
+
+    MatrixXd regularized(const MatrixXd& matCov) const;
+
+    void compareCovariance(const FiffCov& cov,
+                           const MatrixXd& matExpected,
+                           double dNFree) const;
+
+    double dEpsilon;
+    QSharedPointer<FiffInfo> m_pFiffInfo;
+    MatrixXd m_matData;
+};
+
+//=============================================================================================================
+
+TestRtCov::TestRtCov()
+: dEpsilon(1e-8)
+{
+}
+
+//=============================================================================================================
+
+void TestRtCov::initTestCase()
+{
+    qInstallMessageHandler(UTILSLIB::ApplicationLogger::customLogWriter);
+
+    // EEG channels only, their regularization is a scaled identity added to the covariance
+    m_pFiffInfo = QSharedPointer<FiffInfo>(new FiffInfo);
+    m_pFiffInfo->nchan = 4;
+    m_pFiffInfo->sfreq = 1000.0;
+    for(int i = 0; i < m_pFiffInfo->nchan; ++i) {
+        FiffChInfo ch;
+        ch.kind = FIFFV_EEG_CH;
+        ch.ch_name = QString("EEG %1").arg(i + 1, 3, 10, QChar('0'));
+        m_pFiffInfo->chs.append(ch);
+        m_pFiffInfo->ch_names.append(ch.ch_name);
+    }
+
+    // Correlated channels with large offsets, the sums have to cope with the offsets
+    std::srand(11);
+    MatrixXd matMix = MatrixXd::Random(m_pFiffInfo->nchan, m_pFiffInfo->nchan);
+    VectorXd vecOffset = 1e3 * VectorXd::LinSpaced(m_pFiffInfo->nchan, 1.0, 4.0);
+    m_matData = (matMix * MatrixXd::Random(m_pFiffInfo->nchan, 600)).colwise() + vecOffset;
+}
+
+//=============================================================================================================
+
+void TestRtCov::blockWise()
+{
+    const int iNSamples = 100;
+    const int iBlock = 30;
+
+    RtCov rtCov(m_pFiffInfo);
+    rtCov.setEstimationMode(RtCov::BlockWise);
+
+    // Each estimate covers all samples since the previous one
+    int iStart = 0;
+    int iNEstimates = 0;
+
+    for(int i = 0; i + iBlock <= m_matData.cols(); i += iBlock) {
+        FiffCov cov = rtCov.estimateCovariance(m_matData.middleCols(i, iBlock), iNSamples);
+
+        int iEnd = i + iBlock;
+        if(iEnd - iStart < iNSamples) {
+            QVERIFY(cov.data.size() == 0);
+            continue;
+        }
+
+        MatrixXd matBlock = m_matData.middleCols(iStart, iEnd - iStart);
+        compareCovariance(cov, regularized(weightedCovariance(matBlock, VectorXd::Ones(matBlock.cols()))), matBlock.cols());
+
+        iStart = iEnd;
+        ++iNEstimates;
+    }
+
+    QCOMPARE(iNEstimates, 5);
+}
+
+//=============================================================================================================
+
+void TestRtCov::exponentialForgetting()
+{
+    const int iNSamples = 50;
+    const int iBlock = 10;
+    const double dLambda = 1.0 - 1.0 / iNSamples;
+
+    RtCov rtCov(m_pFiffInfo);
+    rtCov.setEstimationMode(RtCov::ExponentialForgetting);
+    rtCov.setUpdateInterval(20);
+
+    int iNEstimates = 0;
+
+    for(int i = 0; i + iBlock <= m_matData.cols(); i += iBlock) {
+        FiffCov cov = rtCov.estimateCovariance(m_matData.middleCols(i, iBlock), iNSamples);
+
+        int iEnd = i + iBlock;
+        if(iEnd % 20 != 0) {
+            QVERIFY(cov.data.size() == 0);
+            continue;
+        }
+
+        // The samples of a block are down-weighted once for every sample which arrived after the block
+        VectorXd vecWeights(iEnd);
+        for(int j = 0; j < iEnd; ++j) {
+            int iBlockEnd = (j / iBlock + 1) * iBlock;
+            vecWeights[j] = std::pow(dLambda, iEnd - iBlockEnd);
+        }
+
+        MatrixXd matSeen = m_matData.leftCols(iEnd);
+        compareCovariance(cov, regularized(weightedCovariance(matSeen, vecWeights)), vecWeights.sum());
+        ++iNEstimates;
+    }
+
+    QCOMPARE(iNEstimates, int(m_matData.cols()) / 20);
+}
+
+//=============================================================================================================
+
+void TestRtCov::slidingWindow_data()
+{
+    QTest::addColumn<int>("iBlock");
+    QTest::addColumn<int>("iUpdateInterval");
+
+    // Blocks of 10 samples close a chunk of 80 / 8 samples each time, blocks of 7 samples overshoot the chunks
+    QTest::newRow("chunk aligned") << 10 << 0;
+    QTest::newRow("chunk aligned, frequent updates") << 10 << 20;
+    QTest::newRow("chunk overshoot, frequent updates") << 7 << 21;
+}
+
+//=============================================================================================================
+
+void TestRtCov::slidingWindow()
+{
+    QFETCH(int, iBlock);
+    QFETCH(int, iUpdateInterval);
+
+    const int iNSamples = 80;
+
+    RtCov rtCov(m_pFiffInfo);
+    rtCov.setEstimationMode(RtCov::SlidingWindow);
+    rtCov.setUpdateInterval(iUpdateInterval);
+
+    const int iInterval = iUpdateInterval > 0 ? iUpdateInterval : iNSamples;
+    int iSamples = 0;
+    int iNEstimates = 0;
+    int iNEvicted = 0;
+
+    for(int i = 0; i + iBlock <= m_matData.cols(); i += iBlock) {
+        FiffCov cov = rtCov.estimateCovariance(m_matData.middleCols(i, iBlock), iNSamples);
+
+        int iEnd = i + iBlock;
+        iSamples += iBlock;
+        if(iSamples < iInterval) {
+            QVERIFY(cov.data.size() == 0);
+            continue;
+        }
+        iSamples = 0;
+
+        // The window holds the most recent samples, at least the window length once enough samples arrived and
+        // less than two chunks and one block more. Chunk aligned blocks are evicted exactly.
+        int iWindow = cov.nfree;
+        if(iEnd < iNSamples) {
+            QCOMPARE(iWindow, iEnd);
+        } else if((iNSamples / 8) % iBlock == 0) {
+            QCOMPARE(iWindow, iNSamples);
+        } else {
+            QVERIFY(iWindow >= iNSamples && iWindow <= iEnd);
+            QVERIFY(iWindow < iNSamples + 2 * (iNSamples / 8) + iBlock);
+        }
+        if(iWindow < iEnd) {
+            ++iNEvicted;
+        }
+
+        MatrixXd matWindow = m_matData.middleCols(iEnd - iWindow, iWindow);
+        compareCovariance(cov, regularized(weightedCovariance(matWindow, VectorXd::Ones(iWindow))), iWindow);
+        ++iNEstimates;
+    }
+
+    QVERIFY(iNEstimates > 0);
+    QVERIFY(iNEvicted > 0);
+}
+
+//=============================================================================================================
+
+void TestRtCov::cleanupTestCase()
+{
+}
+
+//=============================================================================================================
+
+MatrixXd TestRtCov::weightedCovariance(const MatrixXd& matData,
+                                       const VectorXd& vecWeights) const
+{
+    const double dWeight = vecWeights.sum();
+    VectorXd vecMean = matData * vecWeights / dWeight;
+    MatrixXd matCentered = matData.colwise() - vecMean;
+
+    return matCentered * vecWeights.asDiagonal() * matCentered.transpose() / (dWeight - 1.0);
+}
+
+//=============================================================================================================
+
+MatrixXd TestRtCov::regularized(const MatrixXd& matCov) const
+{
+    // RtCov regularizes EEG channels with 0.1 times the mean variance
+    MatrixXd matReg = matCov;
+    matReg.diagonal().array() += 0.1 * matCov.diagonal().mean();
+
+    return matReg;
+}
+
+//=============================================================================================================
+
+void TestRtCov::compareCovariance(const FiffCov& cov,
+                                  const MatrixXd& matExpected,
+                                  double dNFree) const
+{
+    QCOMPARE(int(cov.data.rows()), int(matExpected.rows()));
+    QCOMPARE(int(cov.data.cols()), int(matExpected.cols()));
+    QCOMPARE(cov.nfree, qRound(dNFree));
+    QVERIFY((cov.data - matExpected).norm() <= dEpsilon * matExpected.norm());
+}
+
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+QTEST_GUILESS_MAIN(TestRtCov)
+#include "test_rtcov.moc"
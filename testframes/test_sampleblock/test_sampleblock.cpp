@@ -0,0 +1,210 @@
+//=============================================================================================================
+/**
+ * @file     test_sampleblock.cpp
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @since    0.1.0
+ * @date     October, 2026
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2026, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief    The SampleBlock test implementation
+ *
+ */
+
+
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <utils/generics/applicationlogger.h>
+#include <utils/generics/sampleblock.h>
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QtTest>
+
+//=============================================================================================================
+// EIGEN INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Core>
+
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace UTILSLIB;
+using namespace Eigen;
+
+//=============================================================================================================
+/**
+ * Stands in for a consumer which reads the samples through a const reference.
+ */
+static const double* consumeSamples(const MatrixXd& matData)
+{
+    return matData.data();
+}
+
+//=============================================================================================================
+/**
+ * DECLARE CLASS TestSampleBlock
+ *
+ * @brief The TestSampleBlock class checks that sample blocks are shared on fan-out and only copied on write
+ *
+ */
+class TestSampleBlock: public QObject
+{
+    Q_OBJECT
+
+public:
+    TestSampleBlock();
+
+private slots:
+    void initTestCase();
+    void construct();
+    void fanOut();
+    void detachOnWrite();
+    void cleanupTestCase();
+
+private:
+    MatrixXd m_matData;
+};
+
+//=============================================================================================================
+
+TestSampleBlock::TestSampleBlock()
+{
+}
+
+//=============================================================================================================
+
+void TestSampleBlock::initTestCase()
+{
+    qInstallMessageHandler(UTILSLIB::ApplicationLogger::customLogWriter);
+
+    m_matData = MatrixXd::Random(32, 200);
+}
+
+//=============================================================================================================
+
+void TestSampleBlock::construct()
+{
+    // A const reference is copied
+    SampleBlock blockCopied(m_matData);
+    QVERIFY(blockCopied.data().data() != m_matData.data());
+    QVERIFY(blockCopied.data() == m_matData);
+    QVERIFY(!blockCopied.isShared());
+
+    // An rvalue is taken over
+    MatrixXd matMoved = m_matData;
+    const double* pMoved = matMoved.data();
+    SampleBlock blockMoved(std::move(matMoved));
+    QVERIFY(blockMoved.data().data() == pMoved);
+    QVERIFY(blockMoved.data() == m_matData);
+    QCOMPARE(int(blockMoved.rows()), int(m_matData.rows()));
+    QCOMPARE(int(blockMoved.cols()), int(m_matData.cols()));
+}
+
+//=============================================================================================================
+
+void TestSampleBlock::fanOut()
+{
+    SampleBlock block(m_matData);
+    const double* pSamples = block.data().data();
+
+    // The measurement holds a list of blocks which each consumer copies
+    QList<SampleBlock> lMeasurement;
+    lMeasurement.append(block);
+
+    QList<QList<SampleBlock> > lConsumers;
+    for(int i = 0; i < 8; ++i) {
+        lConsumers.append(lMeasurement);
+    }
+
+    QVERIFY(block.isShared());
+
+    for(int i = 0; i < lConsumers.size(); ++i) {
+        // Read access does neither copy the samples nor detach, not even on a non-const block
+        SampleBlock& consumerBlock = lConsumers[i].first();
+        QVERIFY(consumerBlock.data().data() == pSamples);
+        QVERIFY(consumeSamples(consumerBlock) == pSamples);
+        QCOMPARE(int(consumerBlock.rows()), int(m_matData.rows()));
+        QVERIFY(consumerBlock.isShared());
+    }
+
+    QVERIFY(block.data().data() == pSamples);
+
+    // Once the consumers are done the producer owns the samples again
+    lConsumers.clear();
+    lMeasurement.clear();
+    QVERIFY(!block.isShared());
+    QVERIFY(block.data().data() == pSamples);
+}
+
+//=============================================================================================================
+
+void TestSampleBlock::detachOnWrite()
+{
+    SampleBlock block(m_matData);
+    const double* pSamples = block.data().data();
+
+    SampleBlock blockShared = block;
+    SampleBlock blockWriter = block;
+    QVERIFY(blockWriter.data().data() == pSamples);
+
+    // Writing to a shared block copies the samples first
+    MatrixXd& matWrite = blockWriter.detach();
+    QVERIFY(matWrite.data() != pSamples);
+    QVERIFY(matWrite == m_matData);
+
+    matWrite(0, 0) += 1.0;
+    QCOMPARE(blockWriter.data()(0, 0), m_matData(0, 0) + 1.0);
+    QVERIFY(!blockWriter.isShared());
+
+    // The other holders are not affected and still share the original samples
+    QVERIFY(block.data() == m_matData);
+    QVERIFY(block.data().data() == pSamples);
+    QVERIFY(blockShared.data().data() == pSamples);
+    QVERIFY(block.isShared());
+
+    // Writing to a block which is not shared does not copy
+    const double* pWriter = blockWriter.data().data();
+    QVERIFY(blockWriter.detach().data() == pWriter);
+}
+
+//=============================================================================================================
+
+void TestSampleBlock::cleanupTestCase()
+{
+}
+
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+QTEST_GUILESS_MAIN(TestSampleBlock)
+#include "test_sampleblock.moc"
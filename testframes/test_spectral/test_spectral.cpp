@@ -0,0 +1,276 @@
+//=============================================================================================================
+/**
+ * @file     test_spectral.cpp
+ * @author   Lorenz Esch <lesch@mgh.harvard.edu>
+ * @since    0.1.0
+ * @date     October, 2026
+ *
+ * @section  LICENSE
+ *
+ * Copyright (C) 2026, Lorenz Esch. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ * the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of conditions and the
+ *       following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+ *       the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *     * Neither the name of MNE-CPP authors nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @brief    The Spectral test implementation
+ *
+ */
+
+
+//=============================================================================================================
+// INCLUDES
+//=============================================================================================================
+
+#include <utils/spectral.h>
+
+//=============================================================================================================
+// QT INCLUDES
+//=============================================================================================================
+
+#include <QtTest>
+
+//=============================================================================================================
+// EIGEN INCLUDES
+//=============================================================================================================
+
+#include <Eigen/Core>
+#include <unsupported/Eigen/FFT>
+
+//=============================================================================================================
+// USED NAMESPACES
+//=============================================================================================================
+
+using namespace UTILSLIB;
+using namespace Eigen;
+
+//=============================================================================================================
+/**
+ * DECLARE CLASS TestSpectral
+ *
+ * @brief The TestSpectral class provides tests of the batched tapered spectra against a plain FFT per row
+ *
+ */
+class TestSpectral: public QObject
+{
+    Q_OBJECT
+
+public:
+    TestSpectral();
+
+private slots:
+    void initTestCase();
+    void taperedSpectraRow_data();
+    void taperedSpectraRow();
+    void taperedSpectraMatrix_data();
+    void taperedSpectraMatrix();
+    void inverseHalfSpectra();
+    void cleanupTestCase();
+
+private:
+    RowVectorXcd referenceSpectrum(const RowVectorXd& vecData,
+                                   const RowVectorXd& vecTaper,
+                                   int iNfft);
+
+    double epsilon;
+};
+
+//=============================================================================================================
+
+TestSpectral::TestSpectral()
+: epsilon(1e-10)
+{
+}
+
+//=============================================================================================================
+
+void TestSpectral::initTestCase()
+{
+    std::srand(42);
+}
+
+//=============================================================================================================
+
+void TestSpectral::taperedSpectraRow_data()
+{
+    QTest::addColumn<int>("iNSamples");
+    QTest::addColumn<int>("iNfft");
+
+    QTest::newRow("no padding") << 300 << 300;
+    QTest::newRow("padding even nfft") << 250 << 512;
+    QTest::newRow("padding odd nfft") << 250 << 301;
+    QTest::newRow("padding odd samples") << 301 << 400;
+}
+
+//=============================================================================================================
+
+void TestSpectral::taperedSpectraRow()
+{
+    // The data row has to be zero padded to the FFT length
+    QFETCH(int, iNSamples);
+    QFETCH(int, iNfft);
+
+    RowVectorXd vecData = RowVectorXd::Random(iNSamples);
+    MatrixXd matTaper = Spectral::generateTapers(iNSamples, "hanning").first;
+
+    MatrixXcd matTapSpectra = Spectral::computeTaperedSpectraRow(vecData, matTaper, iNfft);
+
+    QCOMPARE(matTapSpectra.rows(), matTaper.rows());
+    QCOMPARE(matTapSpectra.cols(), Index(iNfft / 2 + 1));
+
+    for (int j = 0; j < matTaper.rows(); ++j) {
+        RowVectorXcd vecReference = referenceSpectrum(vecData, matTaper.row(j), iNfft);
+        QVERIFY((matTapSpectra.row(j) - vecReference).cwiseAbs().maxCoeff() < epsilon * vecReference.cwiseAbs().maxCoeff());
+    }
+
+    // FFT lengths shorter than the data are rejected
+    QCOMPARE(Spectral::computeTaperedSpectraRow(vecData, matTaper, iNSamples - 1).size(), Index(0));
+}
+
+//=============================================================================================================
+
+void TestSpectral::taperedSpectraMatrix_data()
+{
+    QTest::addColumn<int>("iNSamples");
+    QTest::addColumn<int>("iNfft");
+    QTest::addColumn<bool>("bUseThreads");
+
+    QTest::newRow("no padding") << 300 << 300 << true;
+    QTest::newRow("padding even nfft") << 250 << 512 << true;
+    QTest::newRow("padding odd nfft") << 250 << 301 << true;
+    QTest::newRow("padding odd nfft sequential") << 250 << 301 << false;
+    QTest::newRow("truncation") << 300 << 200 << true;
+}
+
+//=============================================================================================================
+
+void TestSpectral::taperedSpectraMatrix()
+{
+    // The batched spectra have to be demeaned, tapered, weighted and interleaved as the plain FFT per row and taper
+    QFETCH(int, iNSamples);
+    QFETCH(int, iNfft);
+    QFETCH(bool, bUseThreads);
+
+    const int iNRows = 13;
+    const int iNTapers = 3;
+    const int iNFreqs = iNfft / 2 + 1;
+    const int iNTransformed = qMin(iNSamples, iNfft);
+
+    MatrixXd matData = MatrixXd::Random(iNRows, iNSamples).array() + 2.0;
+    MatrixXd matTaper = MatrixXd::Random(iNTapers, iNSamples);
+    VectorXd vecTapWeights = VectorXd::Random(iNTapers);
+
+    MatrixXcd matTapSpectra;
+    Spectral::computeTaperedSpectraMatrix(matTapSpectra,
+                                          matData,
+                                          matTaper,
+                                          iNfft,
+                                          vecTapWeights,
+                                          true,
+                                          bUseThreads);
+
+    QCOMPARE(matTapSpectra.rows(), Index(iNRows));
+    QCOMPARE(matTapSpectra.cols(), Index(iNFreqs * iNTapers));
+
+    double dMaxError = 0.0;
+    double dMaxReference = 0.0;
+
+    for (int i = 0; i < iNRows; ++i) {
+        RowVectorXd vecDemeaned = matData.row(i).array() - matData.row(i).mean();
+
+        for (int j = 0; j < iNTapers; ++j) {
+            RowVectorXcd vecReference = vecTapWeights(j) * referenceSpectrum(vecDemeaned.head(iNTransformed),
+                                                                             matTaper.row(j).head(iNTransformed),
+                                                                             iNfft);
+
+            for (int f = 0; f < iNFreqs; ++f) {
+                dMaxError = qMax(dMaxError, std::abs(matTapSpectra(i, f * iNTapers + j) - vecReference(f)));
+                dMaxReference = qMax(dMaxReference, std::abs(vecReference(f)));
+            }
+        }
+    }
+
+    QVERIFY(dMaxError < epsilon * dMaxReference);
+
+    // The per row overload has to split the same spectra into (tapers x frequencies) matrices
+    if(iNSamples <= iNfft) {
+        QVector<MatrixXcd> vecTapSpectra = Spectral::computeTaperedSpectraMatrix(matData,
+                                                                                matTaper,
+                                                                                iNfft,
+                                                                                bUseThreads);
+        QCOMPARE(vecTapSpectra.size(), iNRows);
+
+        for (int i = 0; i < iNRows; ++i) {
+            QCOMPARE(vecTapSpectra.at(i), Spectral::computeTaperedSpectraRow(matData.row(i), matTaper, iNfft));
+        }
+    }
+}
+
+//=============================================================================================================
+
+void TestSpectral::inverseHalfSpectra()
+{
+    // The inverse of the half spectra has to give back the data, for even and odd FFT lengths
+    for (int iNfft : {256, 255}) {
+        MatrixXd matData = MatrixXd::Random(iNfft, 5);
+        MatrixXcd matSpectra(iNfft / 2 + 1, matData.cols());
+
+        for (int i = 0; i < matData.cols(); ++i) {
+            matSpectra.col(i) = referenceSpectrum(matData.col(i).transpose(), RowVectorXd::Ones(iNfft), iNfft).transpose();
+        }
+
+        MatrixXd matResult;
+        Spectral::computeInverseHalfSpectra(matResult, matSpectra, iNfft);
+
+        QCOMPARE(matResult.rows(), matData.rows());
+        QCOMPARE(matResult.cols(), matData.cols());
+        QVERIFY((matResult - matData).cwiseAbs().maxCoeff() < epsilon);
+    }
+}
+
+//=============================================================================================================
+
+void TestSpectral::cleanupTestCase()
+{
+}
+
+//=============================================================================================================
+
+RowVectorXcd TestSpectral::referenceSpectrum(const RowVectorXd& vecData,
+                                             const RowVectorXd& vecTaper,
+                                             int iNfft)
+{
+    // Plain half spectrum FFT of one zero padded and tapered row
+    FFT<double> fft;
+    fft.SetFlag(fft.HalfSpectrum);
+
+    RowVectorXd vecInput = RowVectorXd::Zero(iNfft);
+    vecInput.head(vecData.cols()) = vecData.cwiseProduct(vecTaper);
+
+    RowVectorXcd vecSpectrum;
+    fft.fwd(vecSpectrum, vecInput, iNfft);
+
+    return vecSpectrum;
+}
+
+//=============================================================================================================
+// MAIN
+//=============================================================================================================
+
+QTEST_GUILESS_MAIN(TestSpectral)
+#include "test_spectral.moc"
@@ -50,8 +50,13 @@
 #include <connectivity/metrics/weightedphaselagindex.h>
 #include <connectivity/metrics/debiasedsquaredweightedphaselagindex.h>
 #include <connectivity/metrics/crosscorrelation.h>
+#include <connectivity/connectivity.h>
 #include <connectivity/connectivitysettings.h>
 #include <connectivity/network/network.h>
+#include <connectivity/network/networknode.h>
+#include <connectivity/network/networkedge.h>
+
+#include <rtprocessing/rtconnectivity.h>
 
 //=============================================================================================================
 // QT INCLUDES
@@ -97,6 +102,9 @@ private slots:
     void spectralConnectivityCoherence();
     void spectralConnectivityImagCoherence();
     void spectralConnectivityXCOR();
+    void spectralConnectivityMultipleMethods();
+    void networkCompactStorage();
+    void slidingWindow();
     void cleanupTestCase();
 
 private:
@@ -348,6 +356,166 @@ void TestSpectralConnectivity::spectralConnectivityXCOR()
 
 //=============================================================================================================
 
+void TestSpectralConnectivity::spectralConnectivityMultipleMethods()
+{
+    //*********************************************************************************************************
+    // Compute Connectivity for several methods sharing the spectral data
+    //*********************************************************************************************************
+
+    ConnectivitySettings connectivitySettings = m_connectivitySettings;
+    connectivitySettings.clearIntermediateData();
+    connectivitySettings.setConnectivityMethods(QStringList() << "COH" << "PLI" << "WPLI" << "PLV");
+
+    QList<Network> lNetworks = Connectivity::calculate(connectivitySettings);
+    QCOMPARE(lNetworks.size(), 4);
+
+    //*********************************************************************************************************
+    // Compare to each method computed on its own
+    //*********************************************************************************************************
+
+    for(int i = 0; i < lNetworks.size(); ++i) {
+        ConnectivitySettings singleSettings = m_connectivitySettings;
+        singleSettings.clearIntermediateData();
+        singleSettings.setConnectivityMethods(QStringList() << lNetworks.at(i).getConnectivityMethod());
+
+        m_dConnectivityOutput = lNetworks.at(i).getFullConnectivityMatrix()(0,1);
+        m_dRefConnectivityOutput = Connectivity::calculate(singleSettings).first().getFullConnectivityMatrix()(0,1);
+
+        compareConnectivity();
+    }
+}
+
+//=============================================================================================================
+
+void TestSpectralConnectivity::networkCompactStorage()
+{
+    //*********************************************************************************************************
+    // Create the same network with edge objects and with compactly stored pair weights
+    //*********************************************************************************************************
+
+    int iNumberNodes = 10;
+    int iNumberBins = 5;
+    MatrixXd matPairWeights = MatrixXd::Random(iNumberNodes*(iNumberNodes+1)/2, iNumberBins);
+
+    Network networkEdges("Test");
+    Network networkCompact("Test");
+
+    for(int i = 0; i < iNumberNodes; ++i) {
+        networkEdges.append(NetworkNode::SPtr(new NetworkNode(i, RowVectorXf::Zero(3))));
+        networkCompact.append(NetworkNode::SPtr(new NetworkNode(i, RowVectorXf::Zero(3))));
+    }
+
+    NetworkEdge::SPtr pEdge;
+    int iPair = 0;
+
+    for(int i = 0; i < iNumberNodes; ++i) {
+        for(int j = i; j < iNumberNodes; ++j, ++iPair) {
+            pEdge = NetworkEdge::SPtr(new NetworkEdge(i, j, matPairWeights.row(iPair).transpose()));
+
+            networkEdges.getNodeAt(i)->append(pEdge);
+            networkEdges.getNodeAt(j)->append(pEdge);
+            networkEdges.append(pEdge);
+        }
+    }
+
+    networkCompact.setPairWeights(matPairWeights);
+    QVERIFY(networkCompact.isCompact());
+
+    //*********************************************************************************************************
+    // Compare full and thresholded networks
+    //*********************************************************************************************************
+
+    QVERIFY((networkEdges.getFullConnectivityMatrix() - networkCompact.getFullConnectivityMatrix()).cwiseAbs().maxCoeff() < dEpsilon);
+    QCOMPARE(networkCompact.getFullEdges().size(), networkEdges.getFullEdges().size());
+
+    networkEdges.setThresholdByNumberEdges(7);
+    networkCompact.setThresholdByNumberEdges(7);
+
+    QCOMPARE(networkCompact.getThresholdedEdges().size(), 7);
+    QCOMPARE(networkEdges.getThresholdedEdges().size(), 7);
+    QVERIFY((networkEdges.getThresholdedConnectivityMatrix() - networkCompact.getThresholdedConnectivityMatrix()).cwiseAbs().maxCoeff() < dEpsilon);
+    QVERIFY(networkEdges.getThresholdedDegrees() == networkCompact.getThresholdedDegrees());
+}
+
+//=============================================================================================================
+
+void TestSpectralConnectivity::slidingWindow()
+{
+    //*********************************************************************************************************
+    // Stream all trials through the sliding window of the real-time worker
+    //*********************************************************************************************************
+
+    QList<MatrixXd> matDataList = readConnectivityData();
+    int iWindowSize = 5;
+    QVERIFY(matDataList.size() > 2 * iWindowSize);
+
+    ConnectivitySettings connectivitySettings;
+    connectivitySettings.setFFTSize(matDataList.at(0).cols());
+    connectivitySettings.setWindowType("hanning");
+    connectivitySettings.setConnectivityMethods(QStringList() << "COH" << "IMAGCOH" << "PLV" << "PLI" << "USPLI" << "WPLI" << "DSWPLI");
+
+    QSharedPointer<QAtomicInt> pNumQueuedTrials = QSharedPointer<QAtomicInt>::create(0);
+    RTPROCESSINGLIB::RtConnectivityWorker worker(pNumQueuedTrials);
+    worker.setSlidingWindowSize(iWindowSize);
+    worker.setSlidingWindowSettings(connectivitySettings);
+
+    QList<Network> lNetworks;
+    int iNumResults = 0;
+    connect(&worker, &RTPROCESSINGLIB::RtConnectivityWorker::slidingWindowResultReady,
+            [&](const QList<Network>& lResults) {
+        lNetworks = lResults;
+        ++iNumResults;
+    });
+
+    // Every trial is estimated as long as none is queued behind it
+    for(int i = 0; i < matDataList.size(); ++i) {
+        pNumQueuedTrials->ref();
+        worker.appendTrial(matDataList.at(i));
+    }
+    QCOMPARE(iNumResults, matDataList.size());
+    QCOMPARE(pNumQueuedTrials->loadAcquire(), 0);
+
+    //*********************************************************************************************************
+    // Compare to the networks computed from scratch on the last trials
+    //*********************************************************************************************************
+
+    ConnectivitySettings referenceSettings = connectivitySettings;
+    referenceSettings.append(matDataList.mid(matDataList.size() - iWindowSize));
+    QList<Network> lReference = Connectivity::calculate(referenceSettings);
+
+    QCOMPARE(lNetworks.size(), lReference.size());
+    for(int i = 0; i < lNetworks.size(); ++i) {
+        QCOMPARE(lNetworks.at(i).getConnectivityMethod(), lReference.at(i).getConnectivityMethod());
+        QVERIFY((lNetworks.at(i).getFullConnectivityMatrix() - lReference.at(i).getFullConnectivityMatrix()).cwiseAbs().maxCoeff() < 1e-8);
+    }
+
+    //*********************************************************************************************************
+    // Queued trials are added to the window, but only the newest one is estimated. The sums are now recomputed
+    // from scratch after every second evicted trial.
+    //*********************************************************************************************************
+
+    worker.setFullRecomputeInterval(2);
+    iNumResults = 0;
+
+    pNumQueuedTrials->storeRelease(3);
+    for(int i = 0; i < 3; ++i) {
+        worker.appendTrial(matDataList.at(i));
+    }
+    QCOMPARE(iNumResults, 1);
+    QCOMPARE(pNumQueuedTrials->loadAcquire(), 0);
+
+    referenceSettings.clearAllData();
+    referenceSettings.append(matDataList.mid(matDataList.size() - iWindowSize + 3));
+    referenceSettings.append(matDataList.mid(0, 3));
+    lReference = Connectivity::calculate(referenceSettings);
+
+    for(int i = 0; i < lNetworks.size(); ++i) {
+        QVERIFY((lNetworks.at(i).getFullConnectivityMatrix() - lReference.at(i).getFullConnectivityMatrix()).cwiseAbs().maxCoeff() < 1e-8);
+    }
+}
+
+//=============================================================================================================
+
 QList<MatrixXd> TestSpectralConnectivity::readConnectivityData()
 {
     MatrixXd inputTrials;
@@ -46,18 +46,29 @@ include(../mne-cpp.pri)
 TEMPLATE = subdirs
 
 SUBDIRS += \
+    test_circularbuffer \
     test_coregistration \
     test_dipole_fit \
     test_fiff_coord_trans \
+    test_fiff_raw_data \
     test_fiff_rwr \
+    test_fiff_stream_thread \
     test_fiff_mne_types_io \
     test_filtering \
     test_hpiFit \
+    test_mne_epoch_data_list \
     test_mne_forward_solution \
+    test_mne_raw_data \
     test_fiff_cov \
     test_fiff_digitizer \
     test_mne_msh_display_surface_set \
-    test_mne_project_to_surface
+    test_mne_project_to_surface \
+    test_minimumnorm \
+    test_rapmusic \
+    test_rtaveraging \
+    test_rtcov \
+    test_sampleblock \
+    test_spectral
 
     qtHaveModule(charts) {
         SUBDIRS += \